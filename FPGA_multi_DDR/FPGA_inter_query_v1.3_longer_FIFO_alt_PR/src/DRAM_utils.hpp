@@ -4,6 +4,10 @@
 #include "priority_queue.hpp"
 
 
+// Stream the queries batch by batch without draining the pipeline between batches: the queries of the next 
+//   batch are admitted while those of the previous one are still in flight, up to max_outstanding_queries 
+//   queries that are read but not yet written back (one s_finish_query per query from write_results). 
+//   The results are written at the position of their query ID, thus their completion order does not matter.
 void read_queries(
 	// in initialization
 	const int query_num, 
@@ -14,7 +18,7 @@ void read_queries(
 	const ap_uint<512>* query_vectors,
 
 	// in streams
-	hls::stream<int>& s_finish_batch,
+	hls::stream<int>& s_finish_query,
 
 	// out streams
 	hls::stream<int>& s_query_batch_size,
@@ -26,12 +30,22 @@ void read_queries(
 
 	int remained_query_num = query_num;
 	int processed_query_num = 0;
+	int outstanding_query_num = 0;
 
 	// send out queries batch by batch
 	while (remained_query_num > 0) {
 		int current_query_batch_size = remained_query_num > query_batch_size? query_batch_size : remained_query_num;
 		s_query_batch_size.write(current_query_batch_size);
 		for (int i = 0; i < current_query_batch_size; i++) {
+			if (!s_finish_query.empty()) {
+				s_finish_query.read();
+				outstanding_query_num--;
+			}
+			while (outstanding_query_num >= max_outstanding_queries) {
+				while (s_finish_query.empty()) {}
+				s_finish_query.read();
+				outstanding_query_num--;
+			}
 			int qid = processed_query_num + i;
 			for (int j = 0; j < vec_AXI_num; j++) {
 			#pragma HLS pipeline II=1
@@ -39,28 +53,39 @@ void read_queries(
 				s_query_vectors_in.write(query_vector_AXI);
 			}
 			s_entry_point_ids.write(entry_point_ids[qid]);
+			outstanding_query_num++;
 		}
 		remained_query_num -= query_batch_size;
 		processed_query_num += query_batch_size;
-
-		while (s_finish_batch.empty()) {}
-		int finish_batch = s_finish_batch.read();
 	}
 
 	// write finish all 
 	s_query_batch_size.write(-1);
+
+	// consume the remaining finish signals
+	while (outstanding_query_num > 0) {
+		while (s_finish_query.empty()) {}
+		s_finish_query.read();
+		outstanding_query_num--;
+	}
 }
 
+// Dispatch the queries to the channel PEs on completion rather than in a fixed round robin: 
+//   each channel holds up to max_queries_in_flight_per_channel queries (one running, the others waiting in its FIFOs), 
+//   and gets a new one whenever write_results has collected one of its results (s_channel_finish), such that 
+//   a few long queries on one channel do not hold back the others. Each query is sent as a batch of one.
 void split_queries(
 	// in streams
 	hls::stream<int>& s_query_batch_size,
 	hls::stream<ap_uint<512>>& s_query_vectors_in,
 	hls::stream<int>& s_entry_point_ids,
+	hls::stream<int>& s_channel_finish, // channel ID, one per finished query
 
 	// out streams
 	hls::stream<int> (&s_query_batch_size_per_channel)[N_CHANNEL],
 	hls::stream<ap_uint<512>> (&s_query_vectors_in_per_channel)[N_CHANNEL],
-	hls::stream<int> (&s_entry_point_ids_per_channel)[N_CHANNEL]
+	hls::stream<int> (&s_entry_point_ids_per_channel)[N_CHANNEL],
+	hls::stream<int> (&s_query_ids_per_channel)[N_CHANNEL] // to write_results, in the order of each channel
 ) {
 
 	const int vec_AXI_num = D % FLOAT_PER_AXI == 0? D / FLOAT_PER_AXI : D / FLOAT_PER_AXI + 1; 
@@ -69,6 +94,18 @@ void split_queries(
 	bool first_iter_s_query_vectors_in = true;
 	bool first_iter_s_entry_point_ids = true;
 
+	// queries that can still be sent to each channel
+	int credits_per_channel[N_CHANNEL];
+#pragma HLS array_partition variable=credits_per_channel complete
+	for (int i = 0; i < N_CHANNEL; i++) {
+	#pragma HLS UNROLL
+		credits_per_channel[i] = max_queries_in_flight_per_channel;
+	}
+
+	int processed_query_num = 0;
+	int in_flight_query_num = 0; // sent to the channels, not yet collected by write_results
+	int this_channel = 0;
+
 	while (true) {
 
 		wait_data_fifo_first_iter<int>(
@@ -79,53 +116,62 @@ void split_queries(
 			#pragma HLS UNROLL
 				s_query_batch_size_per_channel[i].write(-1);
 			}
+			// consume the finish signals of the queries still in flight, such that s_channel_finish is empty at exit
+			while (in_flight_query_num > 0) {
+				while (s_channel_finish.empty()) {}
+				s_channel_finish.read();
+				in_flight_query_num--;
+			}
 			break;
 		}
 
-		// send queries to different PEs in round robin manner
-		int query_batch_size_per_channel[N_CHANNEL];
-		int base_batch_size_per_channel = query_num / N_CHANNEL;
-		int remainder_batch_size_per_channel = query_num % N_CHANNEL;
-		for (int i = 0; i < N_CHANNEL; i++) {
-			query_batch_size_per_channel[i] = i < remainder_batch_size_per_channel? 
-				base_batch_size_per_channel + 1 : base_batch_size_per_channel;
-			s_query_batch_size_per_channel[i].write(query_batch_size_per_channel[i]);
-		}
-
-		// send queries to different PEs in round robin manner
 		int remained_query_num = query_num;
-		int this_channel = 0;
 
 		while (remained_query_num > 0) {
-			wait_data_fifo_first_iter<ap_uint<512>>(
-				vec_AXI_num, s_query_vectors_in, first_iter_s_query_vectors_in);
-			wait_data_fifo_first_iter<int>(
-				1, s_entry_point_ids, first_iter_s_entry_point_ids);
+			if (!s_channel_finish.empty()) {
+				int finished_channel = s_channel_finish.read();
+				credits_per_channel[finished_channel]++;
+				in_flight_query_num--;
+			} else if (credits_per_channel[this_channel] > 0) {
+				wait_data_fifo_first_iter<ap_uint<512>>(
+					vec_AXI_num, s_query_vectors_in, first_iter_s_query_vectors_in);
+				wait_data_fifo_first_iter<int>(
+					1, s_entry_point_ids, first_iter_s_entry_point_ids);
+
+				s_query_batch_size_per_channel[this_channel].write(1);
+				for (int j = 0; j < vec_AXI_num; j++) {
+				#pragma HLS pipeline II=1
+					ap_uint<512> query_vector_AXI = s_query_vectors_in.read();
+					s_query_vectors_in_per_channel[this_channel].write(query_vector_AXI);
+				}
+				s_entry_point_ids_per_channel[this_channel].write(s_entry_point_ids.read());
+				s_query_ids_per_channel[this_channel].write(processed_query_num);
 
-			for (int j = 0; j < vec_AXI_num; j++) {
-			#pragma HLS pipeline II=1
-				ap_uint<512> query_vector_AXI = s_query_vectors_in.read();
-				s_query_vectors_in_per_channel[this_channel].write(query_vector_AXI);
+				credits_per_channel[this_channel]--;
+				in_flight_query_num++;
+				processed_query_num++;
+				remained_query_num--;
 			}
-			s_entry_point_ids_per_channel[this_channel].write(s_entry_point_ids.read());
-				
+			// start looking for a free channel from the next one, such that ties are broken in round robin
 			this_channel = this_channel + 1 < N_CHANNEL? this_channel + 1 : 0;
-			remained_query_num--;
 		}
 	}
 }
 
+// Collect the results of whichever channel finishes first, and write them at the position of the query ID
 void write_results(
 	// in initialization
 	const int ef,
 	// in runtime (stream)
 	hls::stream<int>& s_query_batch_size, // -1: stop
+	hls::stream<int> (&s_query_ids_per_channel)[N_CHANNEL],
 	hls::stream<int> (&s_out_ids_per_channel)[N_CHANNEL],
 	hls::stream<float> (&s_out_dists_per_channel)[N_CHANNEL],
 	hls::stream<int> (&s_debug_signals_per_channel)[N_CHANNEL],
 
 	// out streams
-	hls::stream<int>& s_finish_batch,
+	hls::stream<int>& s_channel_finish, // to split_queries
+	hls::stream<int>& s_finish_query, // to read_queries
 
 	// out (DRAM)
     int* out_id,
@@ -134,16 +180,18 @@ void write_results(
 ) {
 
 	bool first_s_query_batch_size = true;
+	bool first_iter_s_query_ids_per_channel[N_CHANNEL];
 	bool first_iter_s_out_ids_per_channel[N_CHANNEL];
 	bool first_iter_s_out_dists_per_channel[N_CHANNEL];
 	bool first_iter_s_debug_signals_per_channel[N_CHANNEL];
 	for (int i = 0; i < N_CHANNEL; i++) {
+		first_iter_s_query_ids_per_channel[i] = true;
 		first_iter_s_out_ids_per_channel[i] = true;
 		first_iter_s_out_dists_per_channel[i] = true;
 		first_iter_s_debug_signals_per_channel[i] = true;
 	}
 
-	int processed_query_num = 0;
+	int this_channel = 0;
 
 	while (true) {
 
@@ -155,42 +203,50 @@ void write_results(
 		}
 
 		int remained_query_num = query_num;
-		int this_channel = 0;
 
 		while (remained_query_num > 0) {
 
-			wait_data_fifo_first_iter<int>(
-				ef, s_out_ids_per_channel[this_channel], first_iter_s_out_ids_per_channel[this_channel]);
-			wait_data_fifo_first_iter<float>(
-				ef, s_out_dists_per_channel[this_channel], first_iter_s_out_dists_per_channel[this_channel]);
+			if (!s_out_ids_per_channel[this_channel].empty()) {
 
-			// use two loops to infer burst per loop
-			for (int i = 0; i < ef; i++) {
-			#pragma HLS pipeline II=1
-				int start_addr = processed_query_num * ef + i;
-				out_id[start_addr] = s_out_ids_per_channel[this_channel].read();
-			}
+				wait_data_fifo_first_iter<int>(
+					1, s_query_ids_per_channel[this_channel], first_iter_s_query_ids_per_channel[this_channel]);
+				int qid = s_query_ids_per_channel[this_channel].read();
 
-			for (int i = 0; i < ef; i++) {
-			#pragma HLS pipeline II=1
-				int start_addr = processed_query_num * ef + i;
-				out_dist[start_addr] = s_out_dists_per_channel[this_channel].read();
-			}
+				wait_data_fifo_first_iter<int>(
+					ef, s_out_ids_per_channel[this_channel], first_iter_s_out_ids_per_channel[this_channel]);
+				wait_data_fifo_first_iter<float>(
+					ef, s_out_dists_per_channel[this_channel], first_iter_s_out_dists_per_channel[this_channel]);
+
+				// use two loops to infer burst per loop
+				for (int i = 0; i < ef; i++) {
+				#pragma HLS pipeline II=1
+					int start_addr = qid * ef + i;
+					out_id[start_addr] = s_out_ids_per_channel[this_channel].read();
+				}
 
-			wait_data_fifo_first_iter<int>(
-				debug_size, s_debug_signals_per_channel[this_channel], first_iter_s_debug_signals_per_channel[this_channel]);
+				for (int i = 0; i < ef; i++) {
+				#pragma HLS pipeline II=1
+					int start_addr = qid * ef + i;
+					out_dist[start_addr] = s_out_dists_per_channel[this_channel].read();
+				}
 
-			for (int i = 0; i < debug_size; i++) {
-			#pragma HLS pipeline II=1
-				int start_addr = processed_query_num * debug_size + i;
-				mem_debug[start_addr] = s_debug_signals_per_channel[this_channel].read();
+				// the channel PE sends all but the last debug signal, which is the channel itself
+				wait_data_fifo_first_iter<int>(
+					debug_size - 1, s_debug_signals_per_channel[this_channel], first_iter_s_debug_signals_per_channel[this_channel]);
+
+				for (int i = 0; i < debug_size; i++) {
+				#pragma HLS pipeline II=1
+					int start_addr = qid * debug_size + i;
+					mem_debug[start_addr] = i < debug_size - 1? s_debug_signals_per_channel[this_channel].read() : this_channel;
+				}
+
+				s_channel_finish.write(this_channel);
+				s_finish_query.write(qid);
+				remained_query_num--;
 			}
 			this_channel = this_channel + 1 < N_CHANNEL? this_channel + 1 : 0;
-			remained_query_num--;
-			processed_query_num++;
 		}
-		// finish processing this entire batch
-		s_finish_batch.write(1);
+		// the batches only count the queries: the results of consecutive batches may interleave
 	}
 }
 
@@ -198,6 +254,7 @@ void write_results(
 void fetch_neighbor_ids(
 	// in initialization
 	const int max_link_num_base,
+	const int link_layout,
 	// in runtime (should from DRAM)
 	const ap_uint<512>* links_base,
 	// in runtime (stream)
@@ -211,8 +268,11 @@ void fetch_neighbor_ids(
 	hls::stream<int>& s_finish_query_out
 ) {
 
-	const int AXI_num_per_base_link = max_link_num_base % INT_PER_AXI == 0? 
-		1 + max_link_num_base / INT_PER_AXI : 2 + max_link_num_base / INT_PER_AXI; // 4 = int size, 64 = 512 bit
+	const int AXI_num_per_base_link_stride = link_layout == LINK_LAYOUT_PACKED? 
+		1 + max_link_num_base / INT_PER_AXI : // (1 + max_link_num_base) ints, rounded up to 512 bit
+		(max_link_num_base % INT_PER_AXI == 0? 
+		1 + max_link_num_base / INT_PER_AXI : 2 + max_link_num_base / INT_PER_AXI); // 4 = int size, 64 = 512 bit
+	const int first_link_slot = link_layout == LINK_LAYOUT_PACKED? 1 : INT_PER_AXI;
 	bool first_s_query_batch_size = true;
 
 	const int max_buffer_size = 32 + 1; // supporting max of 32 * INT_PER_AXI (16) = 512 edges per node
@@ -245,10 +305,17 @@ void fetch_neighbor_ids(
 					int level_id = reg_cand.level_id;
 					bool send_node_itself = false;
 
-					ap_uint<64> start_addr = start_addr = node_id * AXI_num_per_base_link;
-					// first 64-byte = header (4 byte num links + 60 byte padding)
-					// then we have the links (4 byte each, total number = max_link_num)
-					for (int i = 0; i < AXI_num_per_base_link; i++) {
+					ap_uint<64> start_addr = start_addr = node_id * AXI_num_per_base_link_stride;
+					// original: first 64-byte = header (4 byte num links + 60 byte padding)
+					//   then we have the links (4 byte each, total number = max_link_num)
+					// packed: the links follow the 4 byte num links, only the populated words are read
+					local_links_buffer[0] = links_base[start_addr];
+					ap_uint<32> links_num_ap = local_links_buffer[0].range(31, 0);
+					int num_links = links_num_ap;
+					num_links = num_links < max_link_num_base? num_links : max_link_num_base;
+					int AXI_num_per_base_link = link_layout == LINK_LAYOUT_PACKED? 
+						1 + num_links / INT_PER_AXI : AXI_num_per_base_link_stride;
+					for (int i = 1; i < AXI_num_per_base_link; i++) {
 					#pragma HLS pipeline II=1
 						local_links_buffer[i] = links_base[start_addr + i];
 					}
@@ -258,24 +325,22 @@ void fetch_neighbor_ids(
 					// }
 
 					// write out links num & links id
-					ap_uint<32> links_num_ap = local_links_buffer[0].range(31, 0);
-					int num_links = links_num_ap;
 					// if (send_node_itself) {
 					// 	s_num_neighbors_base_level.write(num_links + 1);
 					// } else {
 						s_num_neighbors_base_level.write(num_links);
 					// }
 						
-					for (int i = 0; i < AXI_num_per_base_link - 1; i++) { // first one is the num_links
-						for (int j = 0; j < INT_PER_AXI && i * INT_PER_AXI + j < num_links; j++) {
-						#pragma HLS pipeline II=1
-							ap_uint<32> link_ap = local_links_buffer[i + 1].range(32 * (j + 1) - 1, 32 * j);
-							int link = link_ap;
-							cand_t reg_neighbor;
-							reg_neighbor.node_id = link;
-							reg_neighbor.level_id = level_id;
-							s_fetched_neighbor_ids.write(reg_neighbor);
-						}
+					for (int i = 0; i < num_links; i++) { // the links start after num_links
+					#pragma HLS pipeline II=1
+						int slot = first_link_slot + i;
+						int j = slot % INT_PER_AXI;
+						ap_uint<32> link_ap = local_links_buffer[slot / INT_PER_AXI].range(32 * (j + 1) - 1, 32 * j);
+						int link = link_ap;
+						cand_t reg_neighbor;
+						reg_neighbor.node_id = link;
+						reg_neighbor.level_id = level_id;
+						s_fetched_neighbor_ids.write(reg_neighbor);
 					}
 					// if (send_node_itself) {
 					// 	cand_t reg_node_itself;
@@ -290,6 +355,8 @@ void fetch_neighbor_ids(
 }
 
 void fetch_vectors(
+	// in initialization
+	const int vector_layout,
 	// in runtime (should from DRAM)
 	ap_uint<512>* db_vectors,
 	// in runtime (stream)
@@ -303,12 +370,13 @@ void fetch_vectors(
 	hls::stream<int>& s_finish_query_out
 ) {
 
-	const int AXI_num_per_vector_and_padding = D % FLOAT_PER_AXI == 0? 
-		D / FLOAT_PER_AXI + 1 : D / FLOAT_PER_AXI + 2; // 16 for D = 512 + visited padding
-
 	const int AXI_num_per_vector_only = D % FLOAT_PER_AXI == 0? 
 		D / FLOAT_PER_AXI : D / FLOAT_PER_AXI + 1; // 16 for D = 512
 
+	// stride between vectors, + visited padding in the original layout
+	const int AXI_num_per_vector_and_padding = vector_layout == VECTOR_LAYOUT_COMPACT? 
+		AXI_num_per_vector_only : AXI_num_per_vector_only + 1;
+
 	bool first_s_query_batch_size = true;
 	bool first_iter_s_fetched_neighbor_ids_replicated = true;
 
@@ -373,8 +441,8 @@ void results_collection(
 	hls::stream<float>& s_out_dists
 ) {
 
-	Priority_queue<result_t, hardware_result_queue_size, Collect_smallest> result_queue(ef);
-	const int sort_swap_round = ef % 2 == 0? ef / 2 : ef / 2 + 1;
+	// ef > hardware_result_queue_size: staged in registers, kept in BRAM (see Two_tier_result_queue)
+	Two_tier_result_queue<hardware_result_queue_size, hardware_large_result_queue_size> result_queue(ef);
 
 	bool first_s_query_batch_size = true;
 	bool first_iter_s_distances_base_level = true;
@@ -420,17 +488,24 @@ void results_collection(
 
 						if (num_neighbors > 0) {
 						// insert new values but without sorting
-							for (int i = 0; i < num_neighbors; i++) {
-							#pragma HLS pipeline II=1
-								result_t reg = s_distances_base_level.read();
-								// if both input & queue element are large_float, then do not insert
-								if (reg.dist < result_queue.queue[0].dist) {
-									result_queue.queue[0] = reg;
-									s_inserted_candidates.write(reg);
-									inserted_num_this_iter++;
+							int num_left = num_neighbors;
+							while (num_left > 0) {
+								// two tiers: up to the free staging registers, then merge them into BRAM
+								int num_free = result_queue.num_free();
+								int num_insertion = num_left < num_free? num_left : num_free;
+								for (int i = 0; i < num_insertion; i++) {
+								#pragma HLS pipeline II=1
+									result_t reg = s_distances_base_level.read();
+									// if both input & queue element are large_float, then do not insert
+									if (result_queue.insert(reg)) {
+										s_inserted_candidates.write(reg);
+										inserted_num_this_iter++;
+									}
+								}
+								num_left -= num_insertion;
+								if (result_queue.num_free() == 0) {
+									result_queue.sort();
 								}
-								result_queue.compare_swap_array_step_A();
-								result_queue.compare_swap_array_step_B();
 							}
 							s_num_inserted_candidates.write(inserted_num_this_iter);
 						} else { // num_neighbors == 0
@@ -439,16 +514,12 @@ void results_collection(
 					}
 
 					// sorting
-					for (int i = 0; i < sort_swap_round; i++) {
-					#pragma HLS pipeline II=1
-						result_queue.compare_swap_array_step_A();
-						result_queue.compare_swap_array_step_B();
-					}
+					result_queue.sort();
 
 					// send out largest dist in the queue:
 					//   if the queue is not full, always consider the candidate
 					//   if the queue is full, only consider the candidate when it is smaller than the largest element in the queue
-					s_largest_result_queue_elements.write(result_queue.queue[0].dist);
+					s_largest_result_queue_elements.write(result_queue.largest());
 
 					// effect_queue_size = effect_queue_size + inserted_num_this_iter < ef? effect_queue_size + inserted_num_this_iter : ef;
 					// int largest_element_position = ef - effect_queue_size;
@@ -459,8 +530,9 @@ void results_collection(
 			// write results back 
 			for (int i = 0; i < ef; i++) {
 	#pragma HLS pipeline II=1
-				s_out_ids.write(result_queue.queue[ef - 1 - i].node_id);
-				s_out_dists.write(result_queue.queue[ef - 1 - i].dist);
+				result_t reg = result_queue.result(i);
+				s_out_ids.write(reg.node_id);
+				s_out_dists.write(reg.dist);
 			}
 		}
 	}
@@ -11,6 +11,7 @@ void bloom_fetch_compute(
 	const int runtime_n_bucket_addr_bits,
 	const ap_uint<32> hash_seed,
 	const int max_bloom_out_burst_size,
+	const int vector_layout,
 
     // in runtime (from DRAM)
     ap_uint<512>* db_vectors,
@@ -98,6 +99,8 @@ void bloom_fetch_compute(
 #pragma HLS stream variable=s_finish_query_fetch_vectors depth=depth_control
 
 	fetch_vectors(
+		// in initialization
+		vector_layout,
 		// in runtime (should from DRAM)
     	db_vectors,
 		// in runtime (stream)
@@ -10,12 +10,27 @@ const int float_per_axi = FLOAT_PER_AXI;
 // #define D_MAX 1024
 #define D 128
 
+// layout of the database vectors in DRAM (bit 0 of the layout flags in meta.bin, passed as kernel argument):
+//   VECTOR_LAYOUT_PADDED: each vector is followed by a 64-byte visited padding (the original format)
+//   VECTOR_LAYOUT_COMPACT: vectors are contiguous, as the visited tags are kept in the Bloom filters
+#define VECTOR_LAYOUT_PADDED 0
+#define VECTOR_LAYOUT_COMPACT 1
+
+// layout of the base layer links in DRAM (bit 1 of the layout flags in meta.bin, passed as kernel argument):
+//   LINK_LAYOUT_ORIGINAL: 64-byte header (num_links) + max_link_num_base links, all words are fetched
+//   LINK_LAYOUT_PACKED: num_links followed by the links in the same word, only the ceil((num_links + 1) / 16)
+//     populated words are fetched (the node stride is still fixed, but the count is read before the rest)
+#define LINK_LAYOUT_ORIGINAL 0
+#define LINK_LAYOUT_PACKED 1
+
 // largest 32-bit float: 3.4028237 × 10^38
 const float large_float = 1E+20f; // 1E+20f is large enough for cosine similarity
 
 // max queue sizes
 const int hardware_result_queue_size = 64; // 128;
 const int hardware_candidate_queue_size = 32; // 128;
+// ef > hardware_result_queue_size: BRAM tier of the result queue (Two_tier_result_queue)
+const int hardware_large_result_queue_size = 512;
 
 // bloom filter setting
 const int bloom_num_hash_funs = 3; 
@@ -40,11 +55,29 @@ const int bloom_num_bucket_addr_bits = 4 + 10; // 16 * 1024
 #endif
 const int bloom_num_buckets = 1 << bloom_num_bucket_addr_bits;
 
+// reset of the Bloom filters between queries: BLOOM_RESET_SWEEP clears every 512-bit bucket after each
+//   query (runtime_num_512b_buckets cycles, up to 512), BLOOM_RESET_EPOCH tags each bucket with the epoch
+//   (query) that last wrote it (BLOOM_EPOCH_BITS LUTRAM bits per bucket), such that the buckets of older
+//   epochs read as empty and the next query starts right away; the tags are only swept when the epoch wraps
+#define BLOOM_RESET_SWEEP 0
+#define BLOOM_RESET_EPOCH 1
+#define BLOOM_RESET_MODE BLOOM_RESET_EPOCH
+#define BLOOM_EPOCH_BITS 8
+
 // async batch size tracking
 const int hardware_async_batch_size = 64; // to infer BRAM
 
-// debug signals per query
-const int debug_size = 2;
+// debug signals per query: #hops and #visited vectors on the base layer (from the channel PE),
+//   and the channel that processed the query (from write_results)
+const int debug_size = 3;
+
+// queries dispatched to a channel PE but not yet collected by write_results: one running, the rest queued 
+//   in the FIFOs of the channel, such that the channel starts the next query right after finishing one
+const int max_queries_in_flight_per_channel = 2;
+
+// queries read by read_queries but not yet written back, across query batches (must <= depth_control, 
+//   such that write_results never blocks on the finish signals)
+const int max_outstanding_queries = 64;
 
 // FIFO depth
 #if D == 128 // SIFT
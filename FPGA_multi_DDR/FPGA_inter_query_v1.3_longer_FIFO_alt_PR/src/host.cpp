@@ -1,8 +1,11 @@
 #include <stdint.h>
+#include <algorithm>
 #include <chrono>
 #include <cassert>
 
 #include "host.hpp"
+#include "index_loader.hpp"
+#include "upper_layer_search.hpp"
 
 #include "constants.hpp"
 // #include "types.hpp"
@@ -31,7 +34,7 @@ std::string concat_dir(std::string dir, std::string filename) {
 
 int main(int argc, char** argv)
 {
-    std::cout << "Usage: ./host <xclbin> <max_cand_per_group (mc)> <max_group_num_in_pipe (mg)> <ef> <graph_type> <dataset> <Max degree (MD)> <batch_size>" << std::endl;
+    std::cout << "Usage: ./host <xclbin> <max_cand_per_group (mc)> <max_group_num_in_pipe (mg)> <ef> <graph_type> <dataset> <Max degree (MD)> <batch_size> <index_load_mode (mmap_populate/mmap/huge_pages)> <entry_point_mode (upper_layers/meta)>" << std::endl;
     std::cout << "   Example: ./host xclbin/vadd.hw.xclbin 1 4 64 HNSW SIFT1M 64 10000" << std::endl;
 
     // in init
@@ -53,7 +56,7 @@ int main(int argc, char** argv)
     int ef = 64;
     if (argc > 4) { ef = atoi(argv[arg_cnt++]); }
     std::cout << "ef=" << ef << std::endl;
-    assert(ef <= hardware_result_queue_size);
+    assert(ef <= hardware_large_result_queue_size);
 
     std::string graph_type = "HNSW"; // "NSG" or "HNSW"
     if (argc > 5) { graph_type = argv[arg_cnt++]; }
@@ -79,6 +82,19 @@ int main(int argc, char** argv)
     std::cout << "query_batch_size=" << query_batch_size << std::endl;
     assert (query_batch_size <= query_num);
 
+    // "mmap_populate" (default): mmap + MAP_POPULATE; "mmap": lazy mmap; "huge_pages": 2MB pages + pread
+    std::string index_load_mode = "mmap_populate";
+    if (argc > 9) { index_load_mode = argv[arg_cnt++]; }
+    std::cout << "index_load_mode=" << index_load_mode << std::endl;
+    assert (index_load_mode == "mmap_populate" || index_load_mode == "mmap" || index_load_mode == "huge_pages");
+
+    // "upper_layers" (default): per-query entry points from the HNSW upper layers (upper_layer_search.hpp), 
+    //   "meta": the entry point of meta.bin for all queries (always the case for NSG)
+    std::string entry_point_mode = "upper_layers";
+    if (argc > 10) { entry_point_mode = argv[arg_cnt++]; }
+    std::cout << "entry_point_mode=" << entry_point_mode << std::endl;
+    assert (entry_point_mode == "upper_layers" || entry_point_mode == "meta");
+
     int max_bloom_out_burst_size = 16; // according to mem & compute speed test
 #if N_CHANNEL == 1
     int runtime_n_bucket_addr_bits = 8 + 10; // 256K buckets
@@ -94,7 +110,7 @@ int main(int argc, char** argv)
 #endif
     int runtime_n_buckets = 1 << runtime_n_bucket_addr_bits;
     uint32_t hash_seed = 1;
-    assert (ef <= hardware_result_queue_size);
+    assert (ef <= hardware_large_result_queue_size);
 
     std::string index_dir;
 
@@ -192,8 +208,8 @@ int main(int argc, char** argv)
     }
 
     // initialization values
-    int max_level; // = 16;
-    int max_link_num_upper; // = 32;
+    int max_level = 0; // HNSW only
+    int max_link_num_upper = 0; // HNSW only
     int max_link_num_base; // = 32;
     int entry_point_id; // = 0;
     int num_db_vec; // = 1000 * 1000;
@@ -207,7 +223,6 @@ int main(int argc, char** argv)
         fread(&entry_point_id, sizeof(int), 1, f_metadata);
         fread(&max_link_num_upper, sizeof(int), 1, f_metadata);
         fread(&max_link_num_base, sizeof(int), 1, f_metadata);
-        fclose(f_metadata);
         std::cout << "num_db_vec=" << num_db_vec << std::endl;
         std::cout << "max_level=" << max_level << std::endl;
         std::cout << "entry_point_id=" << entry_point_id << std::endl;
@@ -217,16 +232,38 @@ int main(int argc, char** argv)
         fread(&num_db_vec, sizeof(int), 1, f_metadata);
         fread(&entry_point_id, sizeof(int), 1, f_metadata);
         fread(&max_link_num_base, sizeof(int), 1, f_metadata);
-        fclose(f_metadata);
         std::cout << "num_db_vec=" << num_db_vec << std::endl;
         std::cout << "entry_point_id=" << entry_point_id << std::endl;
         std::cout << "max_link_num_base=" << max_link_num_base << std::endl;
     }
+    // optional last field, absent in the original format: layout flags (see constants.hpp), 
+    //   bit 0 = VECTOR_LAYOUT_COMPACT, bit 1 = LINK_LAYOUT_PACKED, bits 3 ~ 4 = vector type
+    int layout_flags = 0;
+    if (fread(&layout_flags, sizeof(int), 1, f_metadata) != 1) {
+        layout_flags = 0;
+    }
+    fclose(f_metadata);
+    int vector_layout = layout_flags & 1;
+    int link_layout = (layout_flags >> 1) & 1;
+    std::cout << "vector_layout=" << (vector_layout == VECTOR_LAYOUT_COMPACT? "compact" : "padded") << std::endl;
+    std::cout << "link_layout=" << (link_layout == LINK_LAYOUT_PACKED? "packed" : "original") << std::endl;
+    if ((layout_flags >> 2) & 1) {
+        // the neighbor codes in the links (bit 2) change the node stride, only FPGA_intra_query_v1.5 reads them
+        std::cout << "Indexes with neighbor codes are not supported by this kernel" << std::endl;
+        exit(1);
+    }
+    if ((layout_flags >> 3) & 3) {
+        // fp16 / int8 vectors (hnsw_nsg_to_FPGA --vector_type), only the intra-query kernels decode them
+        std::cout << "Indexes with fp16 / int8 vectors are not supported by this kernel" << std::endl;
+        exit(1);
+    }
     
     size_t bytes_per_vec = d * sizeof(float);
     size_t bytes_per_db_vec_plus_padding = d % 16 == 0? d * sizeof(float) : (d + 16 - d % 16) * sizeof(float);
     assert (bytes_per_db_vec_plus_padding % 64 == 0);
     int d_after_padding = bytes_per_db_vec_plus_padding / sizeof(float);
+    size_t bytes_per_db_vec_in_index = vector_layout == VECTOR_LAYOUT_COMPACT? 
+        bytes_per_db_vec_plus_padding : bytes_per_db_vec_plus_padding + 64; // + visited padding
     size_t bytes_entry_vector = bytes_per_db_vec_plus_padding;
     size_t bytes_entry_point_ids = query_num * sizeof(int);
     size_t bytes_query_vectors = query_num * bytes_per_db_vec_plus_padding;
@@ -234,280 +271,36 @@ int main(int argc, char** argv)
     size_t bytes_out_dist = query_num * ef * sizeof(float);	
     size_t bytes_mem_debug = query_num * 5 * sizeof(int);
 
-// here, for inter-query parallel, replicate rather than using different content
-#if N_CHANNEL == 1
-    std::string fname_ground_links_chan_0 = concat_dir(index_dir, "ground_links_1_chan_0.bin");
-#elif N_CHANNEL == 2
-    std::string fname_ground_links_chan_0 = concat_dir(index_dir, "ground_links_1_chan_0.bin");
-    std::string fname_ground_links_chan_1 = concat_dir(index_dir, "ground_links_1_chan_0.bin");
-#elif N_CHANNEL == 3
-    std::string fname_ground_links_chan_0 = concat_dir(index_dir, "ground_links_1_chan_0.bin");
-    std::string fname_ground_links_chan_1 = concat_dir(index_dir, "ground_links_1_chan_0.bin");
-    std::string fname_ground_links_chan_2 = concat_dir(index_dir, "ground_links_1_chan_0.bin");
-#elif N_CHANNEL == 4
-    std::string fname_ground_links_chan_0 = concat_dir(index_dir, "ground_links_1_chan_0.bin");
-    std::string fname_ground_links_chan_1 = concat_dir(index_dir, "ground_links_1_chan_0.bin");
-    std::string fname_ground_links_chan_2 = concat_dir(index_dir, "ground_links_1_chan_0.bin");
-    std::string fname_ground_links_chan_3 = concat_dir(index_dir, "ground_links_1_chan_0.bin");
-#elif N_CHANNEL == 8
-    std::string fname_ground_links_chan_0 = concat_dir(index_dir, "ground_links_1_chan_0.bin");
-    std::string fname_ground_links_chan_1 = concat_dir(index_dir, "ground_links_1_chan_0.bin");
-    std::string fname_ground_links_chan_2 = concat_dir(index_dir, "ground_links_1_chan_0.bin");
-    std::string fname_ground_links_chan_3 = concat_dir(index_dir, "ground_links_1_chan_0.bin");
-    std::string fname_ground_links_chan_4 = concat_dir(index_dir, "ground_links_1_chan_0.bin");
-    std::string fname_ground_links_chan_5 = concat_dir(index_dir, "ground_links_1_chan_0.bin");
-    std::string fname_ground_links_chan_6 = concat_dir(index_dir, "ground_links_1_chan_0.bin");
-    std::string fname_ground_links_chan_7 = concat_dir(index_dir, "ground_links_1_chan_0.bin");
-#elif N_CHANNEL == 16
-    std::string fname_ground_links_chan_0 = concat_dir(index_dir, "ground_links_1_chan_0.bin");
-    std::string fname_ground_links_chan_1 = concat_dir(index_dir, "ground_links_1_chan_0.bin");
-    std::string fname_ground_links_chan_2 = concat_dir(index_dir, "ground_links_1_chan_0.bin");
-    std::string fname_ground_links_chan_3 = concat_dir(index_dir, "ground_links_1_chan_0.bin");
-    std::string fname_ground_links_chan_4 = concat_dir(index_dir, "ground_links_1_chan_0.bin");
-    std::string fname_ground_links_chan_5 = concat_dir(index_dir, "ground_links_1_chan_0.bin");
-    std::string fname_ground_links_chan_6 = concat_dir(index_dir, "ground_links_1_chan_0.bin");
-    std::string fname_ground_links_chan_7 = concat_dir(index_dir, "ground_links_1_chan_0.bin");
-    std::string fname_ground_links_chan_8 = concat_dir(index_dir, "ground_links_1_chan_0.bin");
-    std::string fname_ground_links_chan_9 = concat_dir(index_dir, "ground_links_1_chan_0.bin");
-    std::string fname_ground_links_chan_10 = concat_dir(index_dir, "ground_links_1_chan_0.bin");
-    std::string fname_ground_links_chan_11 = concat_dir(index_dir, "ground_links_1_chan_0.bin");
-    std::string fname_ground_links_chan_12 = concat_dir(index_dir, "ground_links_1_chan_0.bin");
-    std::string fname_ground_links_chan_13 = concat_dir(index_dir, "ground_links_1_chan_0.bin");
-    std::string fname_ground_links_chan_14 = concat_dir(index_dir, "ground_links_1_chan_0.bin");
-    std::string fname_ground_links_chan_15 = concat_dir(index_dir, "ground_links_1_chan_0.bin");
-#endif
-
+    // here, for inter-query parallel, replicate rather than using different content
+    std::vector<std::string> fnames_ground_vectors = IndexLoader::channel_fnames(index_dir, "ground_vectors", N_CHANNEL, true);
+    std::vector<std::string> fnames_ground_links = IndexLoader::channel_fnames(index_dir, "ground_links", N_CHANNEL, true);
     std::string fname_ground_labels = concat_dir(index_dir, "ground_labels.bin");
 
-#if N_CHANNEL == 1
-    std::string fname_ground_vectors_chan_0 = concat_dir(index_dir, "ground_vectors_1_chan_0.bin");
-#elif N_CHANNEL == 2
-    std::string fname_ground_vectors_chan_0 = concat_dir(index_dir, "ground_vectors_1_chan_0.bin");
-    std::string fname_ground_vectors_chan_1 = concat_dir(index_dir, "ground_vectors_1_chan_0.bin");
-#elif N_CHANNEL == 3
-    std::string fname_ground_vectors_chan_0 = concat_dir(index_dir, "ground_vectors_1_chan_0.bin");
-    std::string fname_ground_vectors_chan_1 = concat_dir(index_dir, "ground_vectors_1_chan_0.bin");
-    std::string fname_ground_vectors_chan_2 = concat_dir(index_dir, "ground_vectors_1_chan_0.bin");
-#elif N_CHANNEL == 4
-    std::string fname_ground_vectors_chan_0 = concat_dir(index_dir, "ground_vectors_1_chan_0.bin");
-    std::string fname_ground_vectors_chan_1 = concat_dir(index_dir, "ground_vectors_1_chan_0.bin");
-    std::string fname_ground_vectors_chan_2 = concat_dir(index_dir, "ground_vectors_1_chan_0.bin");
-    std::string fname_ground_vectors_chan_3 = concat_dir(index_dir, "ground_vectors_1_chan_0.bin");
-#elif N_CHANNEL == 8
-    std::string fname_ground_vectors_chan_0 = concat_dir(index_dir, "ground_vectors_1_chan_0.bin");
-    std::string fname_ground_vectors_chan_1 = concat_dir(index_dir, "ground_vectors_1_chan_0.bin");
-    std::string fname_ground_vectors_chan_2 = concat_dir(index_dir, "ground_vectors_1_chan_0.bin");
-    std::string fname_ground_vectors_chan_3 = concat_dir(index_dir, "ground_vectors_1_chan_0.bin");
-    std::string fname_ground_vectors_chan_4 = concat_dir(index_dir, "ground_vectors_1_chan_0.bin");
-    std::string fname_ground_vectors_chan_5 = concat_dir(index_dir, "ground_vectors_1_chan_0.bin");
-    std::string fname_ground_vectors_chan_6 = concat_dir(index_dir, "ground_vectors_1_chan_0.bin");
-    std::string fname_ground_vectors_chan_7 = concat_dir(index_dir, "ground_vectors_1_chan_0.bin");
-#elif N_CHANNEL == 16
-    std::string fname_ground_vectors_chan_0 = concat_dir(index_dir, "ground_vectors_1_chan_0.bin");
-    std::string fname_ground_vectors_chan_1 = concat_dir(index_dir, "ground_vectors_1_chan_0.bin");
-    std::string fname_ground_vectors_chan_2 = concat_dir(index_dir, "ground_vectors_1_chan_0.bin");
-    std::string fname_ground_vectors_chan_3 = concat_dir(index_dir, "ground_vectors_1_chan_0.bin");
-    std::string fname_ground_vectors_chan_4 = concat_dir(index_dir, "ground_vectors_1_chan_0.bin");
-    std::string fname_ground_vectors_chan_5 = concat_dir(index_dir, "ground_vectors_1_chan_0.bin");
-    std::string fname_ground_vectors_chan_6 = concat_dir(index_dir, "ground_vectors_1_chan_0.bin");
-    std::string fname_ground_vectors_chan_7 = concat_dir(index_dir, "ground_vectors_1_chan_0.bin");
-    std::string fname_ground_vectors_chan_8 = concat_dir(index_dir, "ground_vectors_1_chan_0.bin");
-    std::string fname_ground_vectors_chan_9 = concat_dir(index_dir, "ground_vectors_1_chan_0.bin");
-    std::string fname_ground_vectors_chan_10 = concat_dir(index_dir, "ground_vectors_1_chan_0.bin");
-    std::string fname_ground_vectors_chan_11 = concat_dir(index_dir, "ground_vectors_1_chan_0.bin");
-    std::string fname_ground_vectors_chan_12 = concat_dir(index_dir, "ground_vectors_1_chan_0.bin");
-    std::string fname_ground_vectors_chan_13 = concat_dir(index_dir, "ground_vectors_1_chan_0.bin");
-    std::string fname_ground_vectors_chan_14 = concat_dir(index_dir, "ground_vectors_1_chan_0.bin");
-    std::string fname_ground_vectors_chan_15 = concat_dir(index_dir, "ground_vectors_1_chan_0.bin");
-#endif
-
-    FILE* f_ground_links_chan_0 = fopen(fname_ground_links_chan_0.c_str(), "rb");
-#if N_CHANNEL >= 2
-    FILE* f_ground_links_chan_1 = fopen(fname_ground_links_chan_1.c_str(), "rb");
-#endif
-#if N_CHANNEL >= 3
-    FILE* f_ground_links_chan_2 = fopen(fname_ground_links_chan_2.c_str(), "rb");
-#endif
-#if N_CHANNEL >= 4
-    FILE* f_ground_links_chan_3 = fopen(fname_ground_links_chan_3.c_str(), "rb");
-#endif
-#if N_CHANNEL >= 8
-    FILE* f_ground_links_chan_4 = fopen(fname_ground_links_chan_4.c_str(), "rb");
-    FILE* f_ground_links_chan_5 = fopen(fname_ground_links_chan_5.c_str(), "rb");
-    FILE* f_ground_links_chan_6 = fopen(fname_ground_links_chan_6.c_str(), "rb");
-    FILE* f_ground_links_chan_7 = fopen(fname_ground_links_chan_7.c_str(), "rb");
-#endif
-#if N_CHANNEL >= 16
-    FILE* f_ground_links_chan_8 = fopen(fname_ground_links_chan_8.c_str(), "rb");
-    FILE* f_ground_links_chan_9 = fopen(fname_ground_links_chan_9.c_str(), "rb");
-    FILE* f_ground_links_chan_10 = fopen(fname_ground_links_chan_10.c_str(), "rb");
-    FILE* f_ground_links_chan_11 = fopen(fname_ground_links_chan_11.c_str(), "rb");
-    FILE* f_ground_links_chan_12 = fopen(fname_ground_links_chan_12.c_str(), "rb");
-    FILE* f_ground_links_chan_13 = fopen(fname_ground_links_chan_13.c_str(), "rb");
-    FILE* f_ground_links_chan_14 = fopen(fname_ground_links_chan_14.c_str(), "rb");
-    FILE* f_ground_links_chan_15 = fopen(fname_ground_links_chan_15.c_str(), "rb");
-#endif
-
+    // HNSW: internal ID -> label; NSG: only present in reordered indexes (reorder_FPGA_index)
+    bool has_labels = graph_type == "HNSW" || GetFileSize(fname_ground_labels) > 0;
     FILE* f_ground_labels;
-    if (graph_type == "HNSW") {
+    if (has_labels) {
         f_ground_labels = fopen(fname_ground_labels.c_str(), "rb");
     }
 
-    FILE* f_ground_vectors_chan_0 = fopen(fname_ground_vectors_chan_0.c_str(), "rb");
-#if N_CHANNEL >= 2
-    FILE* f_ground_vectors_chan_1 = fopen(fname_ground_vectors_chan_1.c_str(), "rb");
-#endif
-#if N_CHANNEL >= 3
-    FILE* f_ground_vectors_chan_2 = fopen(fname_ground_vectors_chan_2.c_str(), "rb");
-#endif
-#if N_CHANNEL >= 4
-    FILE* f_ground_vectors_chan_3 = fopen(fname_ground_vectors_chan_3.c_str(), "rb");
-#endif
-#if N_CHANNEL >= 8
-    FILE* f_ground_vectors_chan_4 = fopen(fname_ground_vectors_chan_4.c_str(), "rb");
-    FILE* f_ground_vectors_chan_5 = fopen(fname_ground_vectors_chan_5.c_str(), "rb");
-    FILE* f_ground_vectors_chan_6 = fopen(fname_ground_vectors_chan_6.c_str(), "rb");
-    FILE* f_ground_vectors_chan_7 = fopen(fname_ground_vectors_chan_7.c_str(), "rb");
-#endif
-#if N_CHANNEL >= 16
-    FILE* f_ground_vectors_chan_8 = fopen(fname_ground_vectors_chan_8.c_str(), "rb");
-    FILE* f_ground_vectors_chan_9 = fopen(fname_ground_vectors_chan_9.c_str(), "rb");
-    FILE* f_ground_vectors_chan_10 = fopen(fname_ground_vectors_chan_10.c_str(), "rb");
-    FILE* f_ground_vectors_chan_11 = fopen(fname_ground_vectors_chan_11.c_str(), "rb");
-    FILE* f_ground_vectors_chan_12 = fopen(fname_ground_vectors_chan_12.c_str(), "rb");
-    FILE* f_ground_vectors_chan_13 = fopen(fname_ground_vectors_chan_13.c_str(), "rb");
-    FILE* f_ground_vectors_chan_14 = fopen(fname_ground_vectors_chan_14.c_str(), "rb");
-    FILE* f_ground_vectors_chan_15 = fopen(fname_ground_vectors_chan_15.c_str(), "rb");
-#endif
-
 FILE* f_query_vectors = fopen(fname_query_vectors.c_str(), "rb");
 FILE* f_gt_vec_ID = fopen(fname_gt_vec_ID.c_str(), "rb");
 FILE* f_gt_dist = fopen(fname_gt_dist.c_str(), "rb");
 
 // get file size
-size_t bytes_db_vectors_chan_0 = GetFileSize(fname_ground_vectors_chan_0);
-#if N_CHANNEL >= 2
-    size_t bytes_db_vectors_chan_1 = GetFileSize(fname_ground_vectors_chan_1);
-#endif
-#if N_CHANNEL >= 3
-    size_t bytes_db_vectors_chan_2 = GetFileSize(fname_ground_vectors_chan_2);
-#endif
-#if N_CHANNEL >= 4
-    size_t bytes_db_vectors_chan_3 = GetFileSize(fname_ground_vectors_chan_3);
-#endif
-#if N_CHANNEL >= 8
-    size_t bytes_db_vectors_chan_4 = GetFileSize(fname_ground_vectors_chan_4);
-    size_t bytes_db_vectors_chan_5 = GetFileSize(fname_ground_vectors_chan_5);
-    size_t bytes_db_vectors_chan_6 = GetFileSize(fname_ground_vectors_chan_6);
-    size_t bytes_db_vectors_chan_7 = GetFileSize(fname_ground_vectors_chan_7);
-#endif
-#if N_CHANNEL >= 16
-    size_t bytes_db_vectors_chan_8 = GetFileSize(fname_ground_vectors_chan_8);
-    size_t bytes_db_vectors_chan_9 = GetFileSize(fname_ground_vectors_chan_9);
-    size_t bytes_db_vectors_chan_10 = GetFileSize(fname_ground_vectors_chan_10);
-    size_t bytes_db_vectors_chan_11 = GetFileSize(fname_ground_vectors_chan_11);
-    size_t bytes_db_vectors_chan_12 = GetFileSize(fname_ground_vectors_chan_12);
-    size_t bytes_db_vectors_chan_13 = GetFileSize(fname_ground_vectors_chan_13);
-    size_t bytes_db_vectors_chan_14 = GetFileSize(fname_ground_vectors_chan_14);
-    size_t bytes_db_vectors_chan_15 = GetFileSize(fname_ground_vectors_chan_15);
-#endif
-    
-    size_t bytes_links_base_chan_0 = GetFileSize(fname_ground_links_chan_0);
-#if N_CHANNEL >= 2
-    size_t bytes_links_base_chan_1 = GetFileSize(fname_ground_links_chan_1);
-#endif
-#if N_CHANNEL >= 3
-    size_t bytes_links_base_chan_2 = GetFileSize(fname_ground_links_chan_2);
-#endif	   
-#if N_CHANNEL >= 4
-    size_t bytes_links_base_chan_3 = GetFileSize(fname_ground_links_chan_3);
-#endif
-#if N_CHANNEL >= 8
-    size_t bytes_links_base_chan_4 = GetFileSize(fname_ground_links_chan_4);
-    size_t bytes_links_base_chan_5 = GetFileSize(fname_ground_links_chan_5);
-    size_t bytes_links_base_chan_6 = GetFileSize(fname_ground_links_chan_6);
-    size_t bytes_links_base_chan_7 = GetFileSize(fname_ground_links_chan_7);
-#endif
-#if N_CHANNEL >= 16
-    size_t bytes_links_base_chan_8 = GetFileSize(fname_ground_links_chan_8);
-    size_t bytes_links_base_chan_9 = GetFileSize(fname_ground_links_chan_9);
-    size_t bytes_links_base_chan_10 = GetFileSize(fname_ground_links_chan_10);
-    size_t bytes_links_base_chan_11 = GetFileSize(fname_ground_links_chan_11);
-    size_t bytes_links_base_chan_12 = GetFileSize(fname_ground_links_chan_12);
-    size_t bytes_links_base_chan_13 = GetFileSize(fname_ground_links_chan_13);
-    size_t bytes_links_base_chan_14 = GetFileSize(fname_ground_links_chan_14);
-    size_t bytes_links_base_chan_15 = GetFileSize(fname_ground_links_chan_15);
-#endif
     size_t bytes_labels_base;
-    if (graph_type == "HNSW") {
+    if (has_labels) {
         bytes_labels_base = GetFileSize(fname_ground_labels); // int = 4 bytes
     }
     size_t raw_query_vectors_size = GetFileSize(fname_query_vectors);
     size_t raw_gt_vec_ID_size = GetFileSize(fname_gt_vec_ID);
     size_t raw_gt_dist_size = GetFileSize(fname_gt_dist);
-    std::cout << "bytes_db_vectors_chan_0=" << bytes_db_vectors_chan_0 << std::endl;
-    std::cout << "bytes_links_base_chan_0=" << bytes_links_base_chan_0 << std::endl;
     std::cout << "raw_query_vectors_size=" << raw_query_vectors_size << std::endl;
 
     // input vecs
     std::vector<int, aligned_allocator<int>> entry_point_ids(bytes_entry_point_ids / sizeof(int));
     std::vector<float, aligned_allocator<float>> query_vectors(bytes_query_vectors / sizeof(float));
 
-    // db vec
-    std::vector<float, aligned_allocator<float>> db_vectors_chan_0(bytes_db_vectors_chan_0 / sizeof(float));
-#if N_CHANNEL >= 2
-    std::vector<float, aligned_allocator<float>> db_vectors_chan_1(bytes_db_vectors_chan_1 / sizeof(float));
-#endif
-#if N_CHANNEL >= 3
-    std::vector<float, aligned_allocator<float>> db_vectors_chan_2(bytes_db_vectors_chan_2 / sizeof(float));
-#endif
-#if N_CHANNEL >= 4
-    std::vector<float, aligned_allocator<float>> db_vectors_chan_3(bytes_db_vectors_chan_3 / sizeof(float));
-#endif
-#if N_CHANNEL >= 8
-    std::vector<float, aligned_allocator<float>> db_vectors_chan_4(bytes_db_vectors_chan_4 / sizeof(float));
-    std::vector<float, aligned_allocator<float>> db_vectors_chan_5(bytes_db_vectors_chan_5 / sizeof(float));
-    std::vector<float, aligned_allocator<float>> db_vectors_chan_6(bytes_db_vectors_chan_6 / sizeof(float));
-    std::vector<float, aligned_allocator<float>> db_vectors_chan_7(bytes_db_vectors_chan_7 / sizeof(float));
-#endif
-#if N_CHANNEL >= 16
-    std::vector<float, aligned_allocator<float>> db_vectors_chan_8(bytes_db_vectors_chan_8 / sizeof(float));
-    std::vector<float, aligned_allocator<float>> db_vectors_chan_9(bytes_db_vectors_chan_9 / sizeof(float));
-    std::vector<float, aligned_allocator<float>> db_vectors_chan_10(bytes_db_vectors_chan_10 / sizeof(float));
-    std::vector<float, aligned_allocator<float>> db_vectors_chan_11(bytes_db_vectors_chan_11 / sizeof(float));
-    std::vector<float, aligned_allocator<float>> db_vectors_chan_12(bytes_db_vectors_chan_12 / sizeof(float));
-    std::vector<float, aligned_allocator<float>> db_vectors_chan_13(bytes_db_vectors_chan_13 / sizeof(float));
-    std::vector<float, aligned_allocator<float>> db_vectors_chan_14(bytes_db_vectors_chan_14 / sizeof(float));
-    std::vector<float, aligned_allocator<float>> db_vectors_chan_15(bytes_db_vectors_chan_15 / sizeof(float));
-#endif
-    
-    // links
-    std::vector<int, aligned_allocator<int>> links_base_chan_0(bytes_links_base_chan_0 / sizeof(int));
-#if N_CHANNEL >= 2
-    std::vector<int, aligned_allocator<int>> links_base_chan_1(bytes_links_base_chan_1 / sizeof(int));
-#endif
-#if N_CHANNEL >= 3
-    std::vector<int, aligned_allocator<int>> links_base_chan_2(bytes_links_base_chan_2 / sizeof(int));
-#endif
-#if N_CHANNEL >= 4
-    std::vector<int, aligned_allocator<int>> links_base_chan_3(bytes_links_base_chan_3 / sizeof(int));
-#endif
-#if N_CHANNEL >= 8
-    std::vector<int, aligned_allocator<int>> links_base_chan_4(bytes_links_base_chan_4 / sizeof(int));
-    std::vector<int, aligned_allocator<int>> links_base_chan_5(bytes_links_base_chan_5 / sizeof(int));
-    std::vector<int, aligned_allocator<int>> links_base_chan_6(bytes_links_base_chan_6 / sizeof(int));
-    std::vector<int, aligned_allocator<int>> links_base_chan_7(bytes_links_base_chan_7 / sizeof(int));
-#endif
-#if N_CHANNEL >= 16
-    std::vector<int, aligned_allocator<int>> links_base_chan_8(bytes_links_base_chan_8 / sizeof(int));
-    std::vector<int, aligned_allocator<int>> links_base_chan_9(bytes_links_base_chan_9 / sizeof(int));
-    std::vector<int, aligned_allocator<int>> links_base_chan_10(bytes_links_base_chan_10 / sizeof(int));
-    std::vector<int, aligned_allocator<int>> links_base_chan_11(bytes_links_base_chan_11 / sizeof(int));
-    std::vector<int, aligned_allocator<int>> links_base_chan_12(bytes_links_base_chan_12 / sizeof(int));
-    std::vector<int, aligned_allocator<int>> links_base_chan_13(bytes_links_base_chan_13 / sizeof(int));
-    std::vector<int, aligned_allocator<int>> links_base_chan_14(bytes_links_base_chan_14 / sizeof(int));
-    std::vector<int, aligned_allocator<int>> links_base_chan_15(bytes_links_base_chan_15 / sizeof(int));
-#endif
     
     // output
     std::vector<int, aligned_allocator<int>> out_id(bytes_out_id / sizeof(int));
@@ -516,7 +309,7 @@ size_t bytes_db_vectors_chan_0 = GetFileSize(fname_ground_vectors_chan_0);
 
     // intermediate buffer for queries, and ground truth
     std::vector<int> labels_base;
-    if (graph_type == "HNSW") {
+    if (has_labels) {
         labels_base.resize(bytes_labels_base / sizeof(int));
     }
     // init query vectors as zeros (there will be paddings in some cases for unusual d)
@@ -530,97 +323,33 @@ size_t bytes_db_vectors_chan_0 = GetFileSize(fname_ground_vectors_chan_0);
     std::vector<float> gt_dist(query_num * max_topK);
 
     // read data from file
-    std::cout << "Reading database vectors from file...\n";
-    fread(db_vectors_chan_0.data(), 1, bytes_db_vectors_chan_0, f_ground_vectors_chan_0);
-    fclose(f_ground_vectors_chan_0);
-#if N_CHANNEL >= 2
-    fread(db_vectors_chan_1.data(), 1, bytes_db_vectors_chan_1, f_ground_vectors_chan_1);
-    fclose(f_ground_vectors_chan_1);
-#endif
-#if N_CHANNEL >= 3
-    fread(db_vectors_chan_2.data(), 1, bytes_db_vectors_chan_2, f_ground_vectors_chan_2);
-    fclose(f_ground_vectors_chan_2);
-#endif
-#if N_CHANNEL >= 4
-    fread(db_vectors_chan_3.data(), 1, bytes_db_vectors_chan_3, f_ground_vectors_chan_3);
-    fclose(f_ground_vectors_chan_3);
-#endif
-#if N_CHANNEL >= 8
-    fread(db_vectors_chan_4.data(), 1, bytes_db_vectors_chan_4, f_ground_vectors_chan_4);
-    fclose(f_ground_vectors_chan_4);
-    fread(db_vectors_chan_5.data(), 1, bytes_db_vectors_chan_5, f_ground_vectors_chan_5);
-    fclose(f_ground_vectors_chan_5);
-    fread(db_vectors_chan_6.data(), 1, bytes_db_vectors_chan_6, f_ground_vectors_chan_6);
-    fclose(f_ground_vectors_chan_6);
-    fread(db_vectors_chan_7.data(), 1, bytes_db_vectors_chan_7, f_ground_vectors_chan_7);
-    fclose(f_ground_vectors_chan_7);
-#endif
-#if N_CHANNEL >= 16
-    fread(db_vectors_chan_8.data(), 1, bytes_db_vectors_chan_8, f_ground_vectors_chan_8);
-    fclose(f_ground_vectors_chan_8);
-    fread(db_vectors_chan_9.data(), 1, bytes_db_vectors_chan_9, f_ground_vectors_chan_9);
-    fclose(f_ground_vectors_chan_9);
-    fread(db_vectors_chan_10.data(), 1, bytes_db_vectors_chan_10, f_ground_vectors_chan_10);
-    fclose(f_ground_vectors_chan_10);
-    fread(db_vectors_chan_11.data(), 1, bytes_db_vectors_chan_11, f_ground_vectors_chan_11);
-    fclose(f_ground_vectors_chan_11);
-    fread(db_vectors_chan_12.data(), 1, bytes_db_vectors_chan_12, f_ground_vectors_chan_12);
-    fclose(f_ground_vectors_chan_12);
-    fread(db_vectors_chan_13.data(), 1, bytes_db_vectors_chan_13, f_ground_vectors_chan_13);
-    fclose(f_ground_vectors_chan_13);
-    fread(db_vectors_chan_14.data(), 1, bytes_db_vectors_chan_14, f_ground_vectors_chan_14);
-    fclose(f_ground_vectors_chan_14);
-    fread(db_vectors_chan_15.data(), 1, bytes_db_vectors_chan_15, f_ground_vectors_chan_15);
-    fclose(f_ground_vectors_chan_15);
-#endif
-
-
-    std::cout << "Reading base links from file...\n";
-    fread(links_base_chan_0.data(), 1, bytes_links_base_chan_0, f_ground_links_chan_0);
-    fclose(f_ground_links_chan_0);
-#if N_CHANNEL >= 2
-    fread(links_base_chan_1.data(), 1, bytes_links_base_chan_1, f_ground_links_chan_1);
-    fclose(f_ground_links_chan_1);
-#endif
-#if N_CHANNEL >= 3
-    fread(links_base_chan_2.data(), 1, bytes_links_base_chan_2, f_ground_links_chan_2);
-    fclose(f_ground_links_chan_2);
-#endif
-#if N_CHANNEL >= 4
-    fread(links_base_chan_3.data(), 1, bytes_links_base_chan_3, f_ground_links_chan_3);
-    fclose(f_ground_links_chan_3);
-#endif
-#if N_CHANNEL >= 8
-    fread(links_base_chan_4.data(), 1, bytes_links_base_chan_4, f_ground_links_chan_4);
-    fclose(f_ground_links_chan_4);
-    fread(links_base_chan_5.data(), 1, bytes_links_base_chan_5, f_ground_links_chan_5);
-    fclose(f_ground_links_chan_5);
-    fread(links_base_chan_6.data(), 1, bytes_links_base_chan_6, f_ground_links_chan_6);
-    fclose(f_ground_links_chan_6);
-    fread(links_base_chan_7.data(), 1, bytes_links_base_chan_7, f_ground_links_chan_7);
-    fclose(f_ground_links_chan_7);
-#endif
-#if N_CHANNEL >= 16
-    fread(links_base_chan_8.data(), 1, bytes_links_base_chan_8, f_ground_links_chan_8);
-    fclose(f_ground_links_chan_8);
-    fread(links_base_chan_9.data(), 1, bytes_links_base_chan_9, f_ground_links_chan_9);
-    fclose(f_ground_links_chan_9);
-    fread(links_base_chan_10.data(), 1, bytes_links_base_chan_10, f_ground_links_chan_10);
-    fclose(f_ground_links_chan_10);
-    fread(links_base_chan_11.data(), 1, bytes_links_base_chan_11, f_ground_links_chan_11);
-    fclose(f_ground_links_chan_11);
-    fread(links_base_chan_12.data(), 1, bytes_links_base_chan_12, f_ground_links_chan_12);
-    fclose(f_ground_links_chan_12);
-    fread(links_base_chan_13.data(), 1, bytes_links_base_chan_13, f_ground_links_chan_13);
-    fclose(f_ground_links_chan_13);
-    fread(links_base_chan_14.data(), 1, bytes_links_base_chan_14, f_ground_links_chan_14);
-    fclose(f_ground_links_chan_14);
-    fread(links_base_chan_15.data(), 1, bytes_links_base_chan_15, f_ground_links_chan_15);
-    fclose(f_ground_links_chan_15);
-#endif
+    std::cout << "Loading database vectors and base links (" << index_load_mode << ")...\n";
+    auto start_load = std::chrono::high_resolution_clock::now();
+    IndexLoader index_loader(/* populate */ index_load_mode != "mmap", /* huge_pages */ index_load_mode == "huge_pages");
+    index_loader.load(fnames_ground_vectors, fnames_ground_links);
+    auto end_load = std::chrono::high_resolution_clock::now();
+    std::cout << "Index loading time: " << 
+        std::chrono::duration_cast<std::chrono::milliseconds>(end_load - start_load).count() << " ms" << std::endl;
+    for (int c = 0; c < N_CHANNEL; c++) {
+        std::cout << "bytes_db_vectors_chan_" << c << "=" << index_loader.db_vectors[c].bytes << 
+            "\tbytes_links_base_chan_" << c << "=" << index_loader.links_base[c].bytes << std::endl;
+    }
+    // every channel holds a replica of the full index
+    assert(bytes_per_db_vec_in_index * num_db_vec == index_loader.db_vectors[0].bytes);
+
+    UpperLayerSearch upper_layer_search(num_db_vec, max_level, entry_point_id, max_link_num_upper);
+    bool use_upper_layers = false;
+    if (graph_type == "HNSW" && entry_point_mode == "upper_layers") {
+        // the replica in channel 0 holds all the vectors
+        use_upper_layers = upper_layer_search.load(index_dir, {(const char*) index_loader.db_vectors[0].ptr}, 
+            bytes_per_db_vec_in_index, d);
+        if (!use_upper_layers) {
+            std::cout << "No upper layers found, using the entry point of meta.bin for all queries" << std::endl;
+        }
+    }
 
     std::cout << "Reading queries and ground truths from file...\n";
-    if (graph_type == "HNSW") {
+    if (has_labels) {
         fread(labels_base.data(), 1, bytes_labels_base, f_ground_labels);
         fclose(f_ground_labels);
     }
@@ -747,96 +476,18 @@ size_t bytes_db_vectors_chan_0 = GetFileSize(fname_ground_vectors_chan_0);
     OCL_CHECK(err, cl::Buffer buffer_query_vectors (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
             bytes_query_vectors, query_vectors.data(), &err));
             
-    OCL_CHECK(err, cl::Buffer buffer_links_base_chan_0 (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
-        bytes_links_base_chan_0, links_base_chan_0.data(), &err));
-
-#if N_CHANNEL >= 2
-    OCL_CHECK(err, cl::Buffer buffer_links_base_chan_1 (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
-        bytes_links_base_chan_1, links_base_chan_1.data(), &err));
-#endif
-
-#if N_CHANNEL >= 3
-    OCL_CHECK(err, cl::Buffer buffer_links_base_chan_2 (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
-        bytes_links_base_chan_2, links_base_chan_2.data(), &err));
-#endif
-#if N_CHANNEL >= 4
-    OCL_CHECK(err, cl::Buffer buffer_links_base_chan_3 (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
-        bytes_links_base_chan_3, links_base_chan_3.data(), &err));
-#endif
-
-#if N_CHANNEL >= 8
-    OCL_CHECK(err, cl::Buffer buffer_links_base_chan_4 (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
-        bytes_links_base_chan_4, links_base_chan_4.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_links_base_chan_5 (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
-        bytes_links_base_chan_5, links_base_chan_5.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_links_base_chan_6 (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
-        bytes_links_base_chan_6, links_base_chan_6.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_links_base_chan_7 (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
-        bytes_links_base_chan_7, links_base_chan_7.data(), &err));
-#endif
-
-#if N_CHANNEL >= 16
-    OCL_CHECK(err, cl::Buffer buffer_links_base_chan_8 (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
-        bytes_links_base_chan_8, links_base_chan_8.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_links_base_chan_9 (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
-        bytes_links_base_chan_9, links_base_chan_9.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_links_base_chan_10 (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
-        bytes_links_base_chan_10, links_base_chan_10.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_links_base_chan_11 (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
-        bytes_links_base_chan_11, links_base_chan_11.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_links_base_chan_12 (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
-        bytes_links_base_chan_12, links_base_chan_12.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_links_base_chan_13 (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
-        bytes_links_base_chan_13, links_base_chan_13.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_links_base_chan_14 (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
-        bytes_links_base_chan_14, links_base_chan_14.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_links_base_chan_15 (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
-        bytes_links_base_chan_15, links_base_chan_15.data(), &err));
-#endif
+    std::vector<cl::Buffer> buffer_links_base(N_CHANNEL);
+    for (int c = 0; c < N_CHANNEL; c++) {
+        OCL_CHECK(err, buffer_links_base[c] = cl::Buffer(context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
+            index_loader.links_base[c].bytes, index_loader.links_base[c].ptr, &err));
+    }
 
     // in & out (db vec is mixed with visited list)
-    OCL_CHECK(err, cl::Buffer buffer_db_vectors_chan_0 (context,CL_MEM_USE_HOST_PTR,	
-            bytes_db_vectors_chan_0, db_vectors_chan_0.data(), &err));
-#if N_CHANNEL >= 2
-    OCL_CHECK(err, cl::Buffer buffer_db_vectors_chan_1 (context,CL_MEM_USE_HOST_PTR,	
-            bytes_db_vectors_chan_1, db_vectors_chan_1.data(), &err));
-#endif
-#if N_CHANNEL >= 3
-    OCL_CHECK(err, cl::Buffer buffer_db_vectors_chan_2 (context,CL_MEM_USE_HOST_PTR,	
-            bytes_db_vectors_chan_2, db_vectors_chan_2.data(), &err));
-#endif
-#if N_CHANNEL >= 4
-    OCL_CHECK(err, cl::Buffer buffer_db_vectors_chan_3 (context,CL_MEM_USE_HOST_PTR,	
-            bytes_db_vectors_chan_3, db_vectors_chan_3.data(), &err));
-#endif
-#if N_CHANNEL >= 8
-    OCL_CHECK(err, cl::Buffer buffer_db_vectors_chan_4 (context,CL_MEM_USE_HOST_PTR,	
-            bytes_db_vectors_chan_4, db_vectors_chan_4.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_db_vectors_chan_5 (context,CL_MEM_USE_HOST_PTR,	
-            bytes_db_vectors_chan_5, db_vectors_chan_5.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_db_vectors_chan_6 (context,CL_MEM_USE_HOST_PTR,	
-            bytes_db_vectors_chan_6, db_vectors_chan_6.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_db_vectors_chan_7 (context,CL_MEM_USE_HOST_PTR,	
-            bytes_db_vectors_chan_7, db_vectors_chan_7.data(), &err));
-#endif
-#if N_CHANNEL >= 16
-    OCL_CHECK(err, cl::Buffer buffer_db_vectors_chan_8 (context,CL_MEM_USE_HOST_PTR,	
-            bytes_db_vectors_chan_8, db_vectors_chan_8.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_db_vectors_chan_9 (context,CL_MEM_USE_HOST_PTR,	
-            bytes_db_vectors_chan_9, db_vectors_chan_9.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_db_vectors_chan_10 (context,CL_MEM_USE_HOST_PTR,	
-            bytes_db_vectors_chan_10, db_vectors_chan_10.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_db_vectors_chan_11 (context,CL_MEM_USE_HOST_PTR,	
-            bytes_db_vectors_chan_11, db_vectors_chan_11.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_db_vectors_chan_12 (context,CL_MEM_USE_HOST_PTR,	
-            bytes_db_vectors_chan_12, db_vectors_chan_12.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_db_vectors_chan_13 (context,CL_MEM_USE_HOST_PTR,	
-            bytes_db_vectors_chan_13, db_vectors_chan_13.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_db_vectors_chan_14 (context,CL_MEM_USE_HOST_PTR,	
-            bytes_db_vectors_chan_14, db_vectors_chan_14.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_db_vectors_chan_15 (context,CL_MEM_USE_HOST_PTR,	
-            bytes_db_vectors_chan_15, db_vectors_chan_15.data(), &err));
-#endif
+    std::vector<cl::Buffer> buffer_db_vectors(N_CHANNEL);
+    for (int c = 0; c < N_CHANNEL; c++) {
+        OCL_CHECK(err, buffer_db_vectors[c] = cl::Buffer(context,CL_MEM_USE_HOST_PTR,
+            index_loader.db_vectors[c].bytes, index_loader.db_vectors[c].ptr, &err));
+    }
 
     // out
     OCL_CHECK(err, cl::Buffer buffer_out_id (context,CL_MEM_USE_HOST_PTR,// | CL_MEM_WRITE_ONLY,
@@ -860,129 +511,41 @@ size_t bytes_db_vectors_chan_0 = GetFileSize(fname_ground_vectors_chan_0);
     OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, int(max_bloom_out_burst_size)));
     // OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, int(d)));
     OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, int(max_link_num_base)));
+    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, int(vector_layout)));
+    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, int(link_layout)));
 
     OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_entry_point_ids));
     OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_query_vectors));
 
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_db_vectors_chan_0));
-#if N_CHANNEL >= 2
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_db_vectors_chan_1));
-#endif
-#if N_CHANNEL >= 3
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_db_vectors_chan_2));
-#endif
-#if N_CHANNEL >= 4
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_db_vectors_chan_3));
-#endif
-#if N_CHANNEL >= 8
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_db_vectors_chan_4));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_db_vectors_chan_5));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_db_vectors_chan_6));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_db_vectors_chan_7));
-#endif
-#if N_CHANNEL >= 16
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_db_vectors_chan_8));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_db_vectors_chan_9));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_db_vectors_chan_10));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_db_vectors_chan_11));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_db_vectors_chan_12));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_db_vectors_chan_13));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_db_vectors_chan_14));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_db_vectors_chan_15));
-#endif
-
-
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_links_base_chan_0));
-#if N_CHANNEL >= 2
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_links_base_chan_1));
-#endif
-#if N_CHANNEL >= 3
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_links_base_chan_2));
-#endif
-#if N_CHANNEL >= 4
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_links_base_chan_3));
-#endif
-#if N_CHANNEL >= 8
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_links_base_chan_4));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_links_base_chan_5));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_links_base_chan_6));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_links_base_chan_7));
-#endif
-#if N_CHANNEL >= 16
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_links_base_chan_8));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_links_base_chan_9));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_links_base_chan_10));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_links_base_chan_11));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_links_base_chan_12));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_links_base_chan_13));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_links_base_chan_14));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_links_base_chan_15));
-#endif
+    for (int c = 0; c < N_CHANNEL; c++) {
+        OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_db_vectors[c]));
+    }
+    for (int c = 0; c < N_CHANNEL; c++) {
+        OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_links_base[c]));
+    }
 
     OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_out_id));
     OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_out_dist));
     OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_mem_debug));
 
-    // Copy input data to device global memory
-    OCL_CHECK(err, err = q.enqueueMigrateMemObjects({
-        // in
-        buffer_entry_point_ids,
-        buffer_query_vectors,
-        buffer_links_base_chan_0,
-#if N_CHANNEL >= 2
-        buffer_links_base_chan_1,
-#endif
-#if N_CHANNEL >= 3
-        buffer_links_base_chan_2,
-#endif
-#if N_CHANNEL >= 4
-        buffer_links_base_chan_3,
-#endif
-#if N_CHANNEL >= 8
-        buffer_links_base_chan_4,
-        buffer_links_base_chan_5,
-        buffer_links_base_chan_6,
-        buffer_links_base_chan_7,
-#endif
-#if N_CHANNEL >= 16
-        buffer_links_base_chan_8,
-        buffer_links_base_chan_9,
-        buffer_links_base_chan_10,
-        buffer_links_base_chan_11,
-        buffer_links_base_chan_12,
-        buffer_links_base_chan_13,
-        buffer_links_base_chan_14,
-        buffer_links_base_chan_15,
-#endif
-        // in & out
-
-        buffer_db_vectors_chan_0
-#if N_CHANNEL >= 2
-        , buffer_db_vectors_chan_1
-#endif
-#if N_CHANNEL >= 3
-        , buffer_db_vectors_chan_2
-#endif
-#if N_CHANNEL >= 4
-        , buffer_db_vectors_chan_3
-#endif
-#if N_CHANNEL >= 8
-        , buffer_db_vectors_chan_4,
-        buffer_db_vectors_chan_5,
-        buffer_db_vectors_chan_6,
-        buffer_db_vectors_chan_7
-#endif
-#if N_CHANNEL >= 16
-        , buffer_db_vectors_chan_8,
-        buffer_db_vectors_chan_9,
-        buffer_db_vectors_chan_10,
-        buffer_db_vectors_chan_11,
-        buffer_db_vectors_chan_12,
-        buffer_db_vectors_chan_13,
-        buffer_db_vectors_chan_14,
-        buffer_db_vectors_chan_15
-#endif
-        },0/* 0 means from host*/));
+    // Copy input data to device global memory; the entry points are migrated last, as they are 
+    //   computed on the host while the index is migrated
+    std::vector<cl::Memory> buffers_in = {buffer_query_vectors};
+    buffers_in.insert(buffers_in.end(), buffer_links_base.begin(), buffer_links_base.end());
+    // in & out
+    buffers_in.insert(buffers_in.end(), buffer_db_vectors.begin(), buffer_db_vectors.end());
+    OCL_CHECK(err, err = q.enqueueMigrateMemObjects(buffers_in, 0/* 0 means from host*/));
+    OCL_CHECK(err, err = q.flush());
+
+    if (use_upper_layers) {
+        auto start_upper = std::chrono::high_resolution_clock::now();
+        upper_layer_search.search(query_vectors.data(), query_num_after_offset, d_after_padding, entry_point_ids.data());
+        auto end_upper = std::chrono::high_resolution_clock::now();
+        std::cout << "Upper layer search (overlapped with the index migration): " << 
+            std::chrono::duration_cast<std::chrono::milliseconds>(end_upper - start_upper).count() << " ms, " <<
+            "average #hops on upper layers=" << upper_layer_search.average_hops << std::endl;
+    }
+    OCL_CHECK(err, err = q.enqueueMigrateMemObjects({buffer_entry_point_ids}, 0/* 0 means from host*/));
 
     std::cout << "Launching kernel...\n";
     // Launch the Kernel
@@ -1000,7 +563,7 @@ size_t bytes_db_vectors_chan_0 = GetFileSize(fname_ground_vectors_chan_0);
     std::cout << "Duration (including memcpy out): " << duration << " sec" << std::endl; 
 
     // Translate physical node IDs to real label IDs
-    if (graph_type == "HNSW") {
+    if (has_labels) {
         for (int i = 0; i < query_num * ef; i++) {
             out_id[i] = labels_base[out_id[i]];
         }
@@ -1070,12 +633,12 @@ size_t bytes_db_vectors_chan_0 = GetFileSize(fname_ground_vectors_chan_0);
     std::cout << "Dist match id mismatch count=" << dist_match_id_mismatch_cnt << std::endl;
 
     // count avg #hops on base layer
-    if (debug_size == 2) {
+    if (debug_size >= 2) {
         int total_hops = 0;
         int total_visited_nodes = 0;
         for (int i = 0; i < query_num_after_offset; i++) {
-            total_hops += mem_debug[2 * i];
-            total_visited_nodes += mem_debug[2 * i + 1];
+            total_hops += mem_debug[debug_size * i];
+            total_visited_nodes += mem_debug[debug_size * i + 1];
         }
         std::cout << "Average #hops on base layer=" << (float) total_hops / query_num_after_offset << std::endl;
         std::cout << "Average #visited nodes=" << (float) total_visited_nodes / query_num_after_offset << std::endl;
@@ -1087,5 +650,34 @@ size_t bytes_db_vectors_chan_0 = GetFileSize(fname_ground_vectors_chan_0);
         std::cout << "Average #hops on base layer=" << (float) total_hops / query_num_after_offset << std::endl;
     }
 
+    // per-channel breakdown: the queries are dispatched on completion, thus the channels should be about equally busy;
+    //   the kernel does not count the active cycles of the channels, so the load is shown as the visited nodes (one
+    //   vector fetch + distance each) of a channel relative to the most loaded channel, which is not a busy time
+    if (debug_size == 3) {
+        std::vector<int> channel_queries(N_CHANNEL, 0);
+        std::vector<long> channel_hops(N_CHANNEL, 0);
+        std::vector<long> channel_visited_nodes(N_CHANNEL, 0);
+        for (int i = 0; i < query_num; i++) {
+            int c = mem_debug[debug_size * i + 2];
+            if (c < 0 || c >= N_CHANNEL) { continue; }
+            channel_queries[c]++;
+            channel_hops[c] += mem_debug[debug_size * i];
+            channel_visited_nodes[c] += mem_debug[debug_size * i + 1];
+        }
+        long max_visited_nodes = *std::max_element(channel_visited_nodes.begin(), channel_visited_nodes.end());
+        long sum_visited_nodes = 0;
+        for (int c = 0; c < N_CHANNEL; c++) { sum_visited_nodes += channel_visited_nodes[c]; }
+        for (int c = 0; c < N_CHANNEL; c++) {
+            float visited_share = max_visited_nodes > 0? (float) channel_visited_nodes[c] / max_visited_nodes : 0;
+            std::cout << "Channel " << c << ": #queries=" << channel_queries[c] << " #hops=" << channel_hops[c] << 
+                " #visited nodes=" << channel_visited_nodes[c] << " visited-node share of the max channel=" << 
+                100 * visited_share << "%" << std::endl;
+        }
+        if (sum_visited_nodes > 0) {
+            std::cout << "Channel load imbalance (max / mean #visited nodes)=" << 
+                (float) max_visited_nodes * N_CHANNEL / sum_visited_nodes << std::endl;
+        }
+    }
+
     return  0;
 }
@@ -18,6 +18,8 @@ void per_channel_processing_wrapper(
 	const ap_uint<32> hash_seed,
 	const int max_bloom_out_burst_size,
 	const int max_link_num_base,
+	const int vector_layout,
+	const int link_layout,
 
     // in runtime (from DRAM)
     ap_uint<512>* db_vectors,
@@ -122,6 +124,7 @@ void per_channel_processing_wrapper(
 	fetch_neighbor_ids(
 		// in initialization
 		max_link_num_base,
+		link_layout,
 		// in runtime (should from DRAM)
     	links_base,
 		// in runtime (stream)
@@ -144,6 +147,7 @@ void per_channel_processing_wrapper(
 		runtime_n_bucket_addr_bits,
 		hash_seed,
 		max_bloom_out_burst_size,
+		vector_layout,
 
 		// in runtime (from DRAM)
 		db_vectors, // need to write visited tag
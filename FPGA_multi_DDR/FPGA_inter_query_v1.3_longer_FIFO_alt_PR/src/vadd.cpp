@@ -22,6 +22,8 @@ void vadd(
 	const ap_uint<32> hash_seed,
 	const int max_bloom_out_burst_size,
 	const int max_link_num_base,
+	const int vector_layout, // VECTOR_LAYOUT_PADDED / VECTOR_LAYOUT_COMPACT (meta.bin)
+	const int link_layout, // LINK_LAYOUT_ORIGINAL / LINK_LAYOUT_PACKED (meta.bin)
 
     // in runtime (from DRAM)
 	const int* entry_point_ids,
@@ -85,12 +87,10 @@ void vadd(
     int* out_id,
 	float* out_dist,
 
-	// debug signals (each 4 byte): 
-	//   0: bottom layer entry node id, 
-	//   1: number of hops in upper layers 
-	//   2: number of read vectors in upper layers
-	//   3: number of hops in base layer (number of pop operations)
-	//   4: number of valid read vectors in base layer
+	// debug signals (each 4 byte, debug_size per query): 
+	//   0: number of hops in base layer (number of pop operations)
+	//   1: number of valid read vectors in base layer
+	//   2: the channel that processed the query
 	int* mem_debug
     )
 {
@@ -169,8 +169,8 @@ void vadd(
 	hls::stream<int> s_entry_point_ids;
 #pragma HLS stream variable=s_entry_point_ids depth=depth_control
 
-	hls::stream<int> s_finish_batch;
-#pragma HLS stream variable=s_finish_batch depth=depth_control
+	hls::stream<int> s_finish_query;
+#pragma HLS stream variable=s_finish_query depth=depth_control
 
 	read_queries(
 		// in initialization
@@ -180,7 +180,7 @@ void vadd(
 		entry_point_ids,
 		query_vectors,
 		// in stream
-		s_finish_batch,
+		s_finish_query,
 
 		// out streams
 		s_query_batch_size,
@@ -208,16 +208,25 @@ void vadd(
 	hls::stream<int> s_entry_point_ids_per_channel[N_CHANNEL];
 #pragma HLS stream variable=s_entry_point_ids_per_channel depth=depth_control
 
+	hls::stream<int> s_query_ids_per_channel[N_CHANNEL];
+#pragma HLS stream variable=s_query_ids_per_channel depth=depth_control
+
+	hls::stream<int> s_channel_finish;
+#pragma HLS stream variable=s_channel_finish depth=depth_control
+
+	// dispatch on completion: a channel gets the next query once write_results has collected one of its results
 	split_queries(
 		// in streams
 		s_query_batch_size_replicated[0],
 		s_query_vectors_in,
 		s_entry_point_ids,
+		s_channel_finish,
 
 		// out streams
 		s_query_batch_size_in_per_channel,
 		s_query_vectors_in_per_channel,
-		s_entry_point_ids_per_channel
+		s_entry_point_ids_per_channel,
+		s_query_ids_per_channel
 	);
 
 
@@ -242,6 +251,8 @@ void vadd(
 		hash_seed,
 		max_bloom_out_burst_size,
 		max_link_num_base,
+		vector_layout,
+		link_layout,
 	
 		// in runtime (from DRAM)
 		db_vectors_chan_0,
@@ -268,6 +279,8 @@ void vadd(
 		hash_seed,
 		max_bloom_out_burst_size,
 		max_link_num_base,
+		vector_layout,
+		link_layout,
 	
 		// in runtime (from DRAM)
 		db_vectors_chan_1,
@@ -295,6 +308,8 @@ void vadd(
 		hash_seed,
 		max_bloom_out_burst_size,
 		max_link_num_base,
+		vector_layout,
+		link_layout,
 	
 		// in runtime (from DRAM)
 		db_vectors_chan_2,
@@ -322,6 +337,8 @@ void vadd(
 		hash_seed,
 		max_bloom_out_burst_size,
 		max_link_num_base,
+		vector_layout,
+		link_layout,
 	
 		// in runtime (from DRAM)
 		db_vectors_chan_3,
@@ -349,6 +366,8 @@ void vadd(
 		hash_seed,
 		max_bloom_out_burst_size,
 		max_link_num_base,
+		vector_layout,
+		link_layout,
 	
 		// in runtime (from DRAM)
 		db_vectors_chan_4,
@@ -375,6 +394,8 @@ void vadd(
 		hash_seed,
 		max_bloom_out_burst_size,
 		max_link_num_base,
+		vector_layout,
+		link_layout,
 	
 		// in runtime (from DRAM)
 		db_vectors_chan_5,
@@ -401,6 +422,8 @@ void vadd(
 		hash_seed,
 		max_bloom_out_burst_size,
 		max_link_num_base,
+		vector_layout,
+		link_layout,
 	
 		// in runtime (from DRAM)
 		db_vectors_chan_6,
@@ -427,6 +450,8 @@ void vadd(
 		hash_seed,
 		max_bloom_out_burst_size,
 		max_link_num_base,
+		vector_layout,
+		link_layout,
 	
 		// in runtime (from DRAM)
 		db_vectors_chan_7,
@@ -454,6 +479,8 @@ void vadd(
 		hash_seed,
 		max_bloom_out_burst_size,
 		max_link_num_base,
+		vector_layout,
+		link_layout,
 	
 		// in runtime (from DRAM)
 		db_vectors_chan_8,
@@ -480,6 +507,8 @@ void vadd(
 		hash_seed,
 		max_bloom_out_burst_size,
 		max_link_num_base,
+		vector_layout,
+		link_layout,
 	
 		// in runtime (from DRAM)
 		db_vectors_chan_9,
@@ -506,6 +535,8 @@ void vadd(
 		hash_seed,
 		max_bloom_out_burst_size,
 		max_link_num_base,
+		vector_layout,
+		link_layout,
 	
 		// in runtime (from DRAM)
 		db_vectors_chan_10,
@@ -532,6 +563,8 @@ void vadd(
 		hash_seed,
 		max_bloom_out_burst_size,
 		max_link_num_base,
+		vector_layout,
+		link_layout,
 	
 		// in runtime (from DRAM)
 		db_vectors_chan_11,
@@ -558,6 +591,8 @@ void vadd(
 		hash_seed,
 		max_bloom_out_burst_size,
 		max_link_num_base,
+		vector_layout,
+		link_layout,
 	
 		// in runtime (from DRAM)
 		db_vectors_chan_12,
@@ -584,6 +619,8 @@ void vadd(
 		hash_seed,
 		max_bloom_out_burst_size,
 		max_link_num_base,
+		vector_layout,
+		link_layout,
 	
 		// in runtime (from DRAM)
 		db_vectors_chan_13,
@@ -610,6 +647,8 @@ void vadd(
 		hash_seed,
 		max_bloom_out_burst_size,
 		max_link_num_base,
+		vector_layout,
+		link_layout,
 	
 		// in runtime (from DRAM)
 		db_vectors_chan_14,
@@ -636,6 +675,8 @@ void vadd(
 		hash_seed,
 		max_bloom_out_burst_size,
 		max_link_num_base,
+		vector_layout,
+		link_layout,
 	
 		// in runtime (from DRAM)
 		db_vectors_chan_15,
@@ -653,18 +694,20 @@ void vadd(
 	);
 #endif
 
-	// write in round robine same as split_queries
+	// write in the order the channels finish, at the position of each query ID
 	write_results(
 		ef,
 
 		// in streams
 		s_query_batch_size_replicated[1], // -1: stop
+		s_query_ids_per_channel,
 		s_out_ids_per_channel,
 		s_out_dists_per_channel,
 		s_debug_signals_per_channel,
 
 		// out streams
-		s_finish_batch,
+		s_channel_finish,
+		s_finish_query,
 
 		// out
 		out_id,
@@ -8,10 +8,14 @@ void read_queries(
 	// in initialization
 	const int query_num, 
 	const int query_batch_size,
+	const int runtime_num_hot_nodes,
+	const int neighbor_codes,
 
     // in runtime (from DRAM)
 	const int* entry_point_ids,
 	const ap_uint<512>* query_vectors,
+	const int* hot_node_ids,
+	const ap_uint<512>* pq_codebook,
 
 	// in streams
 	hls::stream<int>& s_finish_batch,
@@ -19,10 +23,40 @@ void read_queries(
 	// out streams
 	hls::stream<int>& s_query_batch_size,
 	hls::stream<ap_uint<512>>& s_query_vectors_in,
-	hls::stream<int>& s_entry_point_ids
+	hls::stream<int>& s_entry_point_ids,
+	hls::stream<int>& s_hot_node_ids, // to fetch_neighbor_ids
+	hls::stream<int> (&s_hot_node_ids_per_channel)[N_CHANNEL], // to fetch_vectors
+	hls::stream<ap_uint<512>>& s_pq_codebook, // to compute_pq_lookup_tables
+	hls::stream<ap_uint<512>>& s_query_vectors_pq // to compute_pq_lookup_tables
 ) {
 
-	const int vec_AXI_num = D % FLOAT_PER_AXI == 0? D / FLOAT_PER_AXI : D / FLOAT_PER_AXI + 1; 
+	const int vec_AXI_num = query_AXI_num; // including the int8 weights
+
+	// hot node list for the caches, each list ends with -1
+	for (int i = 0; i < runtime_num_hot_nodes; i++) {
+	#pragma HLS pipeline II=1
+		int node_id = hot_node_ids[i];
+		ap_uint<8> channel_id = get_channel_id(node_id);
+		s_hot_node_ids.write(node_id);
+		for (int c = 0; c < N_CHANNEL; c++) {
+		#pragma HLS unroll
+			if (c == channel_id) {
+				s_hot_node_ids_per_channel[c].write(node_id);
+			}
+		}
+	}
+	s_hot_node_ids.write(-1);
+	for (int c = 0; c < N_CHANNEL; c++) {
+	#pragma HLS unroll
+		s_hot_node_ids_per_channel[c].write(-1);
+	}
+
+	if (neighbor_codes == NEIGHBOR_CODES_PQ) {
+		for (int i = 0; i < pq_num_centroids * query_vec_AXI_num; i++) {
+		#pragma HLS pipeline II=1
+			s_pq_codebook.write(pq_codebook[i]);
+		}
+	}
 
 	int remained_query_num = query_num;
 	int processed_query_num = 0;
@@ -37,6 +71,9 @@ void read_queries(
 			#pragma HLS pipeline II=1
 				ap_uint<512> query_vector_AXI = query_vectors[qid * vec_AXI_num + j];
 				s_query_vectors_in.write(query_vector_AXI);
+				if (neighbor_codes == NEIGHBOR_CODES_PQ) {
+					s_query_vectors_pq.write(query_vector_AXI);
+				}
 			}
 			s_entry_point_ids.write(entry_point_ids[qid]);
 		}
@@ -123,9 +160,99 @@ void write_results(
 	}
 }
 
+// DRAM channel (m_axi port) holding the links of a node
+inline const ap_uint<512>* select_links_base(
+	const ap_uint<512>* links_base_chan_0,
+#if N_CHANNEL >= 2
+	const ap_uint<512>* links_base_chan_1,
+#endif
+#if N_CHANNEL >= 4
+	const ap_uint<512>* links_base_chan_2,
+	const ap_uint<512>* links_base_chan_3,
+#endif
+#if N_CHANNEL >= 8
+	const ap_uint<512>* links_base_chan_4,
+	const ap_uint<512>* links_base_chan_5,
+	const ap_uint<512>* links_base_chan_6,
+	const ap_uint<512>* links_base_chan_7,
+#endif
+#if N_CHANNEL >= 16
+	const ap_uint<512>* links_base_chan_8,
+	const ap_uint<512>* links_base_chan_9,
+	const ap_uint<512>* links_base_chan_10,
+	const ap_uint<512>* links_base_chan_11,
+	const ap_uint<512>* links_base_chan_12,
+	const ap_uint<512>* links_base_chan_13,
+	const ap_uint<512>* links_base_chan_14,
+	const ap_uint<512>* links_base_chan_15,
+#endif
+	ap_uint<8> channel_id
+) {
+#pragma HLS inline
+	switch (channel_id) {
+		case 0:
+			return links_base_chan_0;
+#if N_CHANNEL >= 2
+		case 1:
+			return links_base_chan_1;
+#endif
+#if N_CHANNEL >= 4
+		case 2:
+			return links_base_chan_2;
+		case 3:
+			return links_base_chan_3;
+#endif
+#if N_CHANNEL >= 8
+		case 4:
+			return links_base_chan_4;
+		case 5:
+			return links_base_chan_5;
+		case 6:
+			return links_base_chan_6;
+		case 7:
+			return links_base_chan_7;
+#endif
+#if N_CHANNEL >= 16
+		case 8:
+			return links_base_chan_8;
+		case 9:
+			return links_base_chan_9;
+		case 10:
+			return links_base_chan_10;
+		case 11:
+			return links_base_chan_11;
+		case 12:
+			return links_base_chan_12;
+		case 13:
+			return links_base_chan_13;
+		case 14:
+			return links_base_chan_14;
+		case 15:
+			return links_base_chan_15;
+#endif
+	}
+	return links_base_chan_0;
+}
+
+// 512-bit words fetched per node: the populated link words (packed) or all of them (original),
+//   followed by the words of the neighbor codes of the num_links links
+inline int fetched_link_AXI_num(
+	const int num_links,
+	const int link_AXI_num_stride,
+	const int link_layout,
+	const int neighbor_codes
+) {
+#pragma HLS inline
+	int link_AXI_num = link_layout == LINK_LAYOUT_PACKED? 1 + num_links / INT_PER_AXI : link_AXI_num_stride;
+	int code_AXI_num = neighbor_codes == NEIGHBOR_CODES_PQ? (num_links + pq_codes_per_AXI - 1) / pq_codes_per_AXI : 0;
+	return link_AXI_num + code_AXI_num;
+}
+
 void fetch_neighbor_ids(
 	// in initialization
 	const int max_link_num_base,
+	const int link_layout,
+	const int neighbor_codes,
 	// in runtime (should from DRAM)
 		const ap_uint<512>* links_base_chan_0,
 #if N_CHANNEL >= 2
@@ -154,6 +281,8 @@ void fetch_neighbor_ids(
 	// in runtime (stream)
 	hls::stream<int>& s_query_batch_size, // -1: stop
 	hls::stream<cand_t>& s_top_candidates,
+	hls::stream<int>& s_prefetch_candidates,
+	hls::stream<int>& s_hot_node_ids, // the hot node list at kernel start, ends with -1
 	hls::stream<int>& s_finish_query_in,
 
 	// out (stream)
@@ -161,13 +290,99 @@ void fetch_neighbor_ids(
 	hls::stream<int>& s_finish_query_out
 ) {
 
-	const int AXI_num_per_base_link = max_link_num_base % INT_PER_AXI == 0? 
-		1 + max_link_num_base / INT_PER_AXI : 2 + max_link_num_base / INT_PER_AXI; // 4 = int size, 64 = 512 bit
+	const int link_AXI_num_stride = link_layout == LINK_LAYOUT_PACKED? 
+		1 + max_link_num_base / INT_PER_AXI : // (1 + max_link_num_base) ints, rounded up to 512 bit
+		(max_link_num_base % INT_PER_AXI == 0? 
+		1 + max_link_num_base / INT_PER_AXI : 2 + max_link_num_base / INT_PER_AXI); // 4 = int size, 64 = 512 bit
+	// the neighbor codes of max_link_num_base links follow the link words
+	const int AXI_num_per_base_link_stride = link_AXI_num_stride + (neighbor_codes == NEIGHBOR_CODES_PQ? 
+		(max_link_num_base + pq_codes_per_AXI - 1) / pq_codes_per_AXI : 0);
 	bool first_s_query_batch_size = true;
 
-	const int max_buffer_size = 32 + 1; // supporting max of 32 * INT_PER_AXI (16) = 512 edges per node
+	const int max_buffer_size = hardware_link_buffer_AXI_num;
 			ap_uint<512> local_links_buffer[max_buffer_size]; 
 #pragma HLS bind_storage variable=local_links_buffer type=RAM_2P impl=BRAM
+
+	// staged links of the prefetched nodes, replaced round-robin; a slot is freed once its node is popped
+	ap_uint<512> prefetch_links_buffer[max_prefetch_candidates][max_buffer_size];
+#pragma HLS array_partition variable=prefetch_links_buffer dim=1 complete
+#pragma HLS bind_storage variable=prefetch_links_buffer type=RAM_2P impl=BRAM
+	int prefetch_node_ids[max_prefetch_candidates];
+#pragma HLS array_partition variable=prefetch_node_ids complete
+	int prefetch_AXI_num[max_prefetch_candidates];
+#pragma HLS array_partition variable=prefetch_AXI_num complete
+	bool prefetch_valid[max_prefetch_candidates];
+#pragma HLS array_partition variable=prefetch_valid complete
+	for (int s = 0; s < max_prefetch_candidates; s++) {
+	#pragma HLS unroll
+		prefetch_valid[s] = false;
+	}
+	int prefetch_next_slot = 0;
+
+	// links of the hot nodes, loaded before the first query
+	const int hot_link_cache_size = N_CHANNEL * hardware_hot_nodes_per_channel;
+	ap_uint<512> hot_links[hot_link_cache_size * hot_node_link_AXI_num];
+#pragma HLS bind_storage variable=hot_links type=RAM_2P impl=URAM
+	int hot_link_node_ids[hot_link_cache_size];
+	int hot_link_AXI_num[hot_link_cache_size];
+	for (int s = 0; s < hot_link_cache_size; s++) {
+	#pragma HLS pipeline II=1
+		hot_link_node_ids[s] = -1;
+	}
+	while (true) {
+		int node_id = s_hot_node_ids.read();
+		if (node_id == -1) {
+			break;
+		}
+		ap_uint<32> node_id_ap = node_id;
+		ap_uint<8> channel_id = get_channel_id(node_id_ap);
+		ap_uint<32> in_channel_node_id = get_in_channel_node_id(node_id_ap);
+		int hot_slot = channel_id * hardware_hot_nodes_per_channel + get_hot_node_slot(in_channel_node_id);
+		if (hot_link_node_ids[hot_slot] == -1) {
+			const ap_uint<512>* links_base_selected_channel = select_links_base(
+				links_base_chan_0,
+#if N_CHANNEL >= 2
+				links_base_chan_1,
+#endif
+#if N_CHANNEL >= 4
+				links_base_chan_2,
+				links_base_chan_3,
+#endif
+#if N_CHANNEL >= 8
+				links_base_chan_4,
+				links_base_chan_5,
+				links_base_chan_6,
+				links_base_chan_7,
+#endif
+#if N_CHANNEL >= 16
+				links_base_chan_8,
+				links_base_chan_9,
+				links_base_chan_10,
+				links_base_chan_11,
+				links_base_chan_12,
+				links_base_chan_13,
+				links_base_chan_14,
+				links_base_chan_15,
+#endif
+				channel_id);
+			ap_uint<64> start_addr = in_channel_node_id * AXI_num_per_base_link_stride;
+			// as the DRAM path, only the fetched words are cached (the populated ones in the packed layout),
+			//   a node with more than hot_node_link_AXI_num words stays in DRAM
+			ap_uint<512> reg_first = links_base_selected_channel[start_addr];
+			ap_uint<32> links_num_ap = reg_first.range(31, 0);
+			int num_links = links_num_ap;
+			num_links = num_links < max_link_num_base? num_links : max_link_num_base;
+			int AXI_num_per_base_link = fetched_link_AXI_num(num_links, link_AXI_num_stride, link_layout, neighbor_codes);
+			if (AXI_num_per_base_link <= hot_node_link_AXI_num) {
+				for (int i = 0; i < AXI_num_per_base_link; i++) {
+				#pragma HLS pipeline II=1
+					hot_links[hot_slot * hot_node_link_AXI_num + i] = links_base_selected_channel[start_addr + i];
+				}
+				hot_link_AXI_num[hot_slot] = AXI_num_per_base_link;
+				hot_link_node_ids[hot_slot] = node_id;
+			}
+		}
+	}
 	
 	while (true) {
 
@@ -186,93 +401,125 @@ void fetch_neighbor_ids(
 
 				// check query finish
 				if (!s_finish_query_in.empty() && s_top_candidates.empty()) {
+					// the scheduler sends all hints of the query before its finish signal
+					while (!s_prefetch_candidates.empty()) {
+						s_prefetch_candidates.read();
+					}
+					for (int s = 0; s < max_prefetch_candidates; s++) {
+					#pragma HLS unroll
+						prefetch_valid[s] = false;
+					}
 					s_finish_query_out.write(s_finish_query_in.read());
 					break;
-				} else if (!s_top_candidates.empty()) {
-					// receive task
-					cand_t reg_cand = s_top_candidates.read();
-					int node_id = reg_cand.node_id;
+				} else if (!s_top_candidates.empty() || !s_prefetch_candidates.empty()) {
+					// receive task, prefetch hints only take the otherwise idle cycles
+					bool is_prefetch = s_top_candidates.empty();
+					int node_id;
+					int level_id;
+					if (!is_prefetch) {
+						cand_t reg_cand = s_top_candidates.read();
+						node_id = reg_cand.node_id;
+						level_id = reg_cand.level_id;
+					} else {
+						node_id = s_prefetch_candidates.read();
+						level_id = 0;
+					}
 					ap_uint<32> node_id_ap = node_id;
-					int level_id = reg_cand.level_id;
 					// bool send_node_itself = false;
 
-#if N_CHANNEL == 1
-					ap_uint<8> channel_id = 0;
-					ap_uint<32> in_channel_node_id = node_id_ap;
-#else
-					ap_uint<8> channel_id = node_id_ap.range(CHANNEL_ADDR_BITS - 1, 0);
-					ap_uint<32> in_channel_node_id = node_id_ap >> CHANNEL_ADDR_BITS;
-#endif
+					int staged_slot = -1;
+					for (int s = 0; s < max_prefetch_candidates; s++) {
+					#pragma HLS unroll
+						if (prefetch_valid[s] && prefetch_node_ids[s] == node_id) {
+							staged_slot = s;
+						}
+					}
+
+					ap_uint<8> channel_id = get_channel_id(node_id_ap);
+					ap_uint<32> in_channel_node_id = get_in_channel_node_id(node_id_ap);
+					int hot_slot = channel_id * hardware_hot_nodes_per_channel + get_hot_node_slot(in_channel_node_id);
+					bool is_hot = hot_link_node_ids[hot_slot] == node_id;
 
-					const ap_uint<512>* links_base_selected_channel;
-					switch (channel_id) {
-						case 0:
-							links_base_selected_channel = links_base_chan_0;
-							break;
+					int prefetch_slot = prefetch_next_slot;
+					if (is_prefetch && staged_slot == -1 && !is_hot) {
+						prefetch_next_slot = prefetch_next_slot == max_prefetch_candidates - 1? 0 : prefetch_next_slot + 1;
+					}
+
+					const ap_uint<512>* links_base_selected_channel = select_links_base(
+						links_base_chan_0,
 #if N_CHANNEL >= 2
-						case 1:
-							links_base_selected_channel = links_base_chan_1;
-							break;
+						links_base_chan_1,
 #endif
 #if N_CHANNEL >= 4
-						case 2:
-							links_base_selected_channel = links_base_chan_2;
-							break;
-						case 3:
-							links_base_selected_channel = links_base_chan_3;
-							break;
+						links_base_chan_2,
+						links_base_chan_3,
 #endif
 #if N_CHANNEL >= 8
-						case 4:
-							links_base_selected_channel = links_base_chan_4;
-							break;
-						case 5:
-							links_base_selected_channel = links_base_chan_5;
-							break;
-						case 6:
-							links_base_selected_channel = links_base_chan_6;
-							break;
-						case 7:
-							links_base_selected_channel = links_base_chan_7;
-							break;
+						links_base_chan_4,
+						links_base_chan_5,
+						links_base_chan_6,
+						links_base_chan_7,
 #endif
 #if N_CHANNEL >= 16
-						case 8:
-							links_base_selected_channel = links_base_chan_8;
-							break;
-						case 9:
-							links_base_selected_channel = links_base_chan_9;
-							break;
-						case 10:
-							links_base_selected_channel = links_base_chan_10;
-							break;
-						case 11:
-							links_base_selected_channel = links_base_chan_11;
-							break;
-						case 12:
-							links_base_selected_channel = links_base_chan_12;
-							break;
-						case 13:
-							links_base_selected_channel = links_base_chan_13;
-							break;
-						case 14:
-							links_base_selected_channel = links_base_chan_14;
-							break;
-						case 15:
-							links_base_selected_channel = links_base_chan_15;
-							break;
+						links_base_chan_8,
+						links_base_chan_9,
+						links_base_chan_10,
+						links_base_chan_11,
+						links_base_chan_12,
+						links_base_chan_13,
+						links_base_chan_14,
+						links_base_chan_15,
 #endif
-					}
+						channel_id);
 
 					ap_uint<64> start_addr;
-					if (level_id == 0) { // base layer
-						start_addr = in_channel_node_id * AXI_num_per_base_link;
-						// first 64-byte = header (4 byte num links + 60 byte padding)
-						// then we have the links (4 byte each, total number = max_link_num)
-						for (int i = 0; i < AXI_num_per_base_link; i++) {
+					if (staged_slot >= 0) {
+						// popped after its prefetch: no DRAM access, the slot is free again
+						//   (a repeated hint of a staged node needs nothing either)
+						if (!is_prefetch) {
+							for (int i = 0; i < prefetch_AXI_num[staged_slot]; i++) {
+							#pragma HLS pipeline II=1
+								s_neighbor_ids_raw.write(prefetch_links_buffer[staged_slot][i]);
+							}
+							prefetch_valid[staged_slot] = false;
+						}
+					} else if (is_hot) {
+						// cached at kernel start, no DRAM access and nothing to prefetch
+						if (!is_prefetch) {
+							for (int i = 0; i < hot_link_AXI_num[hot_slot]; i++) {
+							#pragma HLS pipeline II=1
+								s_neighbor_ids_raw.write(hot_links[hot_slot * hot_node_link_AXI_num + i]);
+							}
+						}
+					} else if (level_id == 0) { // base layer
+						start_addr = in_channel_node_id * AXI_num_per_base_link_stride;
+						// original: first 64-byte = header (4 byte num links + 60 byte padding)
+						//   then we have the links (4 byte each, total number = max_link_num)
+						// packed: the links follow the 4 byte num links, only the populated words are read
+						// neighbor codes: the codes of the num_links links follow right after, also read
+						ap_uint<512> reg_first = links_base_selected_channel[start_addr];
+						if (is_prefetch) {
+							prefetch_links_buffer[prefetch_slot][0] = reg_first;
+						} else {
+							s_neighbor_ids_raw.write(reg_first);
+						}
+						ap_uint<32> links_num_ap = reg_first.range(31, 0);
+						int num_links = links_num_ap;
+						num_links = num_links < max_link_num_base? num_links : max_link_num_base;
+						int AXI_num_per_base_link = fetched_link_AXI_num(num_links, link_AXI_num_stride, link_layout, neighbor_codes);
+						for (int i = 1; i < AXI_num_per_base_link; i++) {
 						#pragma HLS pipeline II=1
 							ap_uint<512> reg = links_base_selected_channel[start_addr + i];
-							s_neighbor_ids_raw.write(reg);
+							if (is_prefetch) {
+								prefetch_links_buffer[prefetch_slot][i] = reg;
+							} else {
+								s_neighbor_ids_raw.write(reg);
+							}
+						}
+						if (is_prefetch) {
+							prefetch_node_ids[prefetch_slot] = node_id;
+							prefetch_AXI_num[prefetch_slot] = AXI_num_per_base_link;
+							prefetch_valid[prefetch_slot] = true;
 						}
 						// if (is_entry_point) {
 						// 	send_node_itself = true;
@@ -286,12 +533,15 @@ void fetch_neighbor_ids(
 }
 
 void fetch_vectors(
+	// in initialization
+	const int vector_layout,
 	// in runtime (should from DRAM)
 	ap_uint<512>* db_vectors,
 	// in runtime (stream)
 	hls::stream<int>& s_query_batch_size, // -1: stop
 	hls::stream<int>& s_fetch_batch_size,
 	hls::stream<cand_t>& s_fetched_neighbor_ids_replicated,
+	hls::stream<int>& s_hot_node_ids, // the hot nodes of this channel at kernel start, ends with -1
 	hls::stream<int>& s_finish_query_in,
 	
 	// out (stream)
@@ -299,15 +549,39 @@ void fetch_vectors(
 	hls::stream<int>& s_finish_query_out
 ) {
 
-	const int AXI_num_per_vector_and_padding = D % FLOAT_PER_AXI == 0? 
-		D / FLOAT_PER_AXI + 1 : D / FLOAT_PER_AXI + 2; // 16 for D = 512 + visited padding
+	// stride between vectors, + visited padding in the original layout
+	const int AXI_num_per_vector_and_padding = vector_layout == VECTOR_LAYOUT_COMPACT? db_vec_AXI_num : db_vec_AXI_num + 1;
 
-	const int AXI_num_per_vector_only = D % FLOAT_PER_AXI == 0? 
-		D / FLOAT_PER_AXI : D / FLOAT_PER_AXI + 1; // 16 for D = 512
+	const int AXI_num_per_vector_only = db_vec_AXI_num; // 32 for fp32 D = 512, 16 for fp16, 8 for int8
 
 	bool first_s_query_batch_size = true;
 	bool first_iter_s_fetched_neighbor_ids_replicated = true;
 
+	// vectors of the hot nodes, loaded before the first query
+	ap_uint<512> hot_vectors[hardware_hot_nodes_per_channel * db_vec_AXI_num];
+#pragma HLS bind_storage variable=hot_vectors type=RAM_2P impl=URAM
+	int hot_vector_node_ids[hardware_hot_nodes_per_channel];
+	for (int s = 0; s < hardware_hot_nodes_per_channel; s++) {
+	#pragma HLS pipeline II=1
+		hot_vector_node_ids[s] = -1;
+	}
+	while (true) {
+		int node_id = s_hot_node_ids.read();
+		if (node_id == -1) {
+			break;
+		}
+		ap_uint<32> in_channel_node_id = get_in_channel_node_id(node_id);
+		int hot_slot = get_hot_node_slot(in_channel_node_id);
+		if (hot_vector_node_ids[hot_slot] == -1) {
+			int start_addr = in_channel_node_id * AXI_num_per_vector_and_padding;
+			for (int i = 0; i < AXI_num_per_vector_only; i++) {
+			#pragma HLS pipeline II=1
+				hot_vectors[hot_slot * db_vec_AXI_num + i] = db_vectors[start_addr + i];
+			}
+			hot_vector_node_ids[hot_slot] = node_id;
+		}
+	}
+
 	while (true) {
 
 		wait_data_fifo_first_iter<int>(
@@ -337,14 +611,13 @@ void fetch_vectors(
 						// receive task & read vectors
 						cand_t reg_cand = s_fetched_neighbor_ids_replicated.read();
 						int node_id = reg_cand.node_id;
-#if N_CHANNEL == 1
-							ap_uint<32> in_channel_node_id = node_id;
-#else
-							ap_uint<32> in_channel_node_id = node_id >> CHANNEL_ADDR_BITS;
-#endif
+						ap_uint<32> in_channel_node_id = get_in_channel_node_id(node_id);
 						int start_addr = in_channel_node_id * AXI_num_per_vector_and_padding;
+						int hot_slot = get_hot_node_slot(in_channel_node_id);
+						bool is_hot = hot_vector_node_ids[hot_slot] == node_id;
 						for (int i = 0; i < AXI_num_per_vector_only; i++) {
-							ap_uint<512> vector_AXI = db_vectors[start_addr + i];
+							ap_uint<512> vector_AXI = is_hot? 
+								hot_vectors[hot_slot * db_vec_AXI_num + i] : db_vectors[start_addr + i];
 							s_fetched_vectors.write(vector_AXI);
 						}
 					}
@@ -374,8 +647,12 @@ void results_collection(
 	hls::stream<float>& s_out_dists
 ) {
 
-	Priority_queue<result_t, hardware_result_queue_size, Collect_smallest> result_queue(ef);
-	const int sort_swap_round = ef % 2 == 0? ef / 2 : ef / 2 + 1;
+#if RESULT_QUEUE_TYPE == RESULT_QUEUE_BITONIC
+	Bitonic_result_queue<hardware_result_queue_size, bitonic_batch_size> result_queue(ef);
+#else
+	// ef > hardware_result_queue_size: staged in registers, kept in BRAM (see Two_tier_result_queue)
+	Two_tier_result_queue<hardware_result_queue_size, hardware_large_result_queue_size> result_queue(ef);
+#endif
 
 	bool first_s_query_batch_size = true;
 	bool first_iter_s_distances_base_level = true;
@@ -419,17 +696,24 @@ void results_collection(
 
 						if (num_neighbors > 0) {
 						// insert new values but without sorting
-							for (int i = 0; i < num_neighbors; i++) {
+							int num_left = num_neighbors;
+							while (num_left > 0) {
+								// two tiers / bitonic: up to the free staging registers, then merge them into the queue
+								int num_free = result_queue.num_free();
+								int num_insertion = num_left < num_free? num_left : num_free;
+								for (int i = 0; i < num_insertion; i++) {
 	#pragma HLS pipeline II=1
-								result_t reg = s_distances_base_level.read();
-								// if both input & queue element are large_float, then do not insert
-								if (reg.dist < result_queue.queue[0].dist) {
-									result_queue.queue[0] = reg;
-									s_inserted_candidates.write(reg);
-									contain_insertion_this_iter = true;
-									inserted_num_this_iter++;
-									result_queue.compare_swap_array_step_A();
-									result_queue.compare_swap_array_step_B();
+									result_t reg = s_distances_base_level.read();
+									// if both input & queue element are large_float, then do not insert
+									if (result_queue.insert(reg)) {
+										s_inserted_candidates.write(reg);
+										contain_insertion_this_iter = true;
+										inserted_num_this_iter++;
+									}
+								}
+								num_left -= num_insertion;
+								if (result_queue.num_free() == 0) {
+									result_queue.sort();
 								}
 							}
 							s_num_inserted_candidates.write(inserted_num_this_iter);
@@ -440,17 +724,13 @@ void results_collection(
 
 					// sorting
 					if (contain_insertion_this_iter) {
-						for (int i = 0; i < sort_swap_round; i++) {
-	#pragma HLS pipeline II=1
-							result_queue.compare_swap_array_step_A();
-							result_queue.compare_swap_array_step_B();
-						}
+						result_queue.sort();
 					}
 
 					// send out largest dist in the queue:
 					//   if the queue is not full, always consider the candidate
 					//   if the queue is full, only consider the candidate when it is smaller than the largest element in the queue
-					s_largest_result_queue_elements.write(result_queue.queue[0].dist);
+					s_largest_result_queue_elements.write(result_queue.largest());
 
 					// effect_queue_size = effect_queue_size + inserted_num_this_iter < ef? effect_queue_size + inserted_num_this_iter : ef;
 					// int largest_element_position = ef - effect_queue_size;
@@ -461,8 +741,9 @@ void results_collection(
 			// write results back 
 			for (int i = 0; i < ef; i++) {
 	#pragma HLS pipeline II=1
-				s_out_ids.write(result_queue.queue[ef - 1 - i].node_id);
-				s_out_dists.write(result_queue.queue[ef - 1 - i].dist);
+				result_t reg = result_queue.result(i);
+				s_out_ids.write(reg.node_id);
+				s_out_dists.write(reg.dist);
 			}
 		}
 	}
@@ -11,6 +11,7 @@ void bloom_fetch_compute(
 	const int runtime_n_bucket_addr_bits,
 	const ap_uint<32> hash_seed,
 	const int max_bloom_out_burst_size,
+	const int vector_layout,
 
     // in runtime (from DRAM)
     ap_uint<512>* db_vectors,
@@ -20,6 +21,7 @@ void bloom_fetch_compute(
 	hls::stream<ap_uint<512>>& s_query_vectors,
 	hls::stream<int>& s_num_neighbors_base_level,
 	hls::stream<cand_t>& s_fetched_neighbor_ids,
+	hls::stream<int>& s_hot_node_ids,
 	hls::stream<int>& s_finish_query_in,
 
 	// out streams
@@ -98,12 +100,15 @@ void bloom_fetch_compute(
 #pragma HLS stream variable=s_finish_query_fetch_vectors depth=depth_control
 
 	fetch_vectors(
+		// in initialization
+		vector_layout,
 		// in runtime (should from DRAM)
     	db_vectors,
 		// in runtime (stream)
 		s_query_batch_size_replicated[2], 
 		s_num_valid_candidates_burst_replicated[0], 
 		s_valid_candidates_replicated[0], 
+		s_hot_node_ids,
 		s_finish_query_replicate_candidates,
 		
 		// out (stream)
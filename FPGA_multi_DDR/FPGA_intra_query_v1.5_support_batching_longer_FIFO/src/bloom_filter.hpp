@@ -10,6 +10,11 @@ class BloomFilter {
 public:
 
 	ap_uint<512>* buckets;
+#if BLOOM_RESET_MODE == BLOOM_RESET_EPOCH
+	// per 512-bit bucket: the query (epoch) that last wrote it; buckets of older epochs read as empty
+	ap_uint<BLOOM_EPOCH_BITS>* bucket_epochs;
+	ap_uint<BLOOM_EPOCH_BITS> epoch;
+#endif
 	ap_uint<32> num_buckets;
 	ap_uint<32> num_512b_buckets;
 	ap_uint<32> runtime_num_buckets;
@@ -25,6 +30,11 @@ public:
 		ap_uint<512> hash_buckets[num_512b_buckets_int];
 #pragma HLS bind_storage variable=hash_buckets type=RAM_2P impl=BRAM
 		this->buckets = hash_buckets;
+#if BLOOM_RESET_MODE == BLOOM_RESET_EPOCH
+		ap_uint<BLOOM_EPOCH_BITS> hash_bucket_epochs[num_512b_buckets_int];
+#pragma HLS bind_storage variable=hash_bucket_epochs type=RAM_2P impl=LUTRAM
+		this->bucket_epochs = hash_bucket_epochs;
+#endif
 
 		this->runtime_num_buckets = 1 << runtime_n_bucket_addr_bits;
 		int runtime_num_512b_buckets_int = 1 << (runtime_n_bucket_addr_bits - BITS_512_ADDR) > 1? 1 << (runtime_n_bucket_addr_bits - BITS_512_ADDR) : 1;
@@ -34,10 +44,33 @@ public:
 	}
 
 	void reset() {
+#if BLOOM_RESET_MODE == BLOOM_RESET_EPOCH
+		// only the tags: a bucket is valid only if its tag matches the current epoch
+		for (int i = 0; i < this->runtime_num_512b_buckets; i++) {
+#pragma HLS pipeline II=1
+			this->bucket_epochs[i] = 0;
+		}
+		this->epoch = 1;
+#else
 		for (int i = 0; i < this->runtime_num_512b_buckets; i++) {
 #pragma HLS pipeline II=1
 			this->buckets[i] = false;
 		}
+#endif
+	}
+
+	// between two queries: BLOOM_RESET_SWEEP clears all buckets (runtime_num_512b_buckets cycles),
+	//   BLOOM_RESET_EPOCH starts a new epoch, and only sweeps the tags once every 2^BLOOM_EPOCH_BITS - 1 queries
+	void next_query() {
+#if BLOOM_RESET_MODE == BLOOM_RESET_EPOCH
+		if (this->epoch == ap_uint<BLOOM_EPOCH_BITS>(-1)) {
+			reset();
+		} else {
+			this->epoch++;
+		}
+#else
+		reset();
+#endif
 	}
 
 	ap_uint<32> MurmurHash2_KeyLen4 (ap_uint<32> key, ap_uint<32> hash_seed) {
@@ -153,7 +186,7 @@ public:
 						&& all_streams_empty<num_hash_funs, ap_uint<32>>(s_hash_values_per_pe)) {
 						s_finish_out.write(s_finish_in.read());
 						// reset the hash buckets
-						reset();
+						next_query();
 						break;
 					} else if (!s_num_candidates.empty()) {
 						int num_candidates = s_num_candidates.read();
@@ -175,11 +208,23 @@ public:
 								// outer_bucket_id is the bucket ID to the 512-bit bucket array, while inner_bucket_id is the bit ID in the 512-bit bucket
 								ap_uint<32> outer_bucket_id = hash.range(BITS_512_ADDR + this->runtime_num_512b_bucket_addr_bits - 1, BITS_512_ADDR);
 								ap_uint<32> inner_bucket_id = hash.range(BITS_512_ADDR - 1, 0);
+#if BLOOM_RESET_MODE == BLOOM_RESET_EPOCH
+								ap_uint<512> bucket = this->bucket_epochs[outer_bucket_id] == this->epoch? 
+									this->buckets[outer_bucket_id] : ap_uint<512>(0);
+								if (!bucket.range(inner_bucket_id, inner_bucket_id)) {
+									bucket.range(inner_bucket_id, inner_bucket_id) = 1;
+									this->buckets[outer_bucket_id] = bucket;
+									this->bucket_epochs[outer_bucket_id] = this->epoch;
+								} else {
+									bit_match_cnt++;
+								}
+#else
 								if (!this->buckets[outer_bucket_id].range(inner_bucket_id, inner_bucket_id)) {
 									this->buckets[outer_bucket_id].range(inner_bucket_id, inner_bucket_id) = 1;
 								} else {
 									bit_match_cnt++;
 								}
+#endif
 							}
 							if (bit_match_cnt < num_hash_funs) { // does not contain
 								s_valid_candidates.write(cand);
@@ -36,6 +36,49 @@ float aggregation_sum_float_pack(
     return sum;
 }
 
+// fp16 bits to fp32, subnormals are flushed to zero (the host-side encoder never produces them)
+float half_bits_to_float(ap_uint<16> h) {
+#pragma HLS inline
+	ap_uint<32> sign = h.range(15, 15);
+	ap_uint<32> exponent = h.range(14, 10);
+	ap_uint<32> mantissa = h.range(9, 0);
+	ap_uint<32> f;
+	if (exponent == 0) {
+		f = sign << 31;
+	} else if (exponent == 31) {
+		f = (sign << 31) | (ap_uint<32>(0xff) << 23) | (mantissa << 13);
+	} else {
+		f = (sign << 31) | ((exponent + 112) << 23) | (mantissa << 13);
+	}
+	return *((float*) (&f));
+}
+
+// element s of a 512-bit word of a database vector (VECTOR_TYPE in constants.hpp)
+template<const int vector_type>
+float decode_db_element(ap_uint<512> db_vec_reg, int s);
+
+template<>
+float decode_db_element<VECTOR_TYPE_FP32>(ap_uint<512> db_vec_reg, int s) {
+#pragma HLS inline
+	ap_uint<32> db_vec_reg_uint32 = db_vec_reg.range(32 * (s + 1) - 1, 32 * s);
+	return *((float*) (&db_vec_reg_uint32));
+}
+
+template<>
+float decode_db_element<VECTOR_TYPE_FP16>(ap_uint<512> db_vec_reg, int s) {
+#pragma HLS inline
+	ap_uint<16> db_vec_reg_uint16 = db_vec_reg.range(16 * (s + 1) - 1, 16 * s);
+	return half_bits_to_float(db_vec_reg_uint16);
+}
+
+template<>
+float decode_db_element<VECTOR_TYPE_INT8>(ap_uint<512> db_vec_reg, int s) {
+#pragma HLS inline
+	ap_int<8> code = db_vec_reg.range(8 * (s + 1) - 1, 8 * s);
+	return (float) code;
+}
+
+template<const int vector_type>
 void compute_distances_sub_PE_A(
     // in runtime (stream)
 	hls::stream<int>& s_query_batch_size, // -1: stop
@@ -49,10 +92,15 @@ void compute_distances_sub_PE_A(
     hls::stream<int>& s_finish_query_out
 ) {
 
-    const int vec_AXI_num = D % FLOAT_PER_AXI == 0? D / FLOAT_PER_AXI : D / FLOAT_PER_AXI + 1; 
+	// one partial distance per 512-bit word of the database vector, 
+	//   each word holds DB_ELEM_PER_AXI elements (16 x fp32, 32 x fp16, or 64 x int8)
+	const int elem_packs_per_AXI = DB_ELEM_PER_AXI / FLOAT_PER_AXI;
+	const int query_elem_num = db_vec_AXI_num * DB_ELEM_PER_AXI;
 
-    float query_vector[vec_AXI_num * FLOAT_PER_AXI];
-#pragma HLS unroll variable=query_vector factor=float_per_axi
+    float query_vector[query_elem_num];
+#pragma HLS array_partition variable=query_vector cyclic factor=DB_ELEM_PER_AXI
+    float query_weights[query_elem_num]; // int8 only: scale[d]^2
+#pragma HLS array_partition variable=query_weights cyclic factor=DB_ELEM_PER_AXI
 
 	bool first_s_query_batch_size = true;
     bool first_iter_s_query_vectors = true;
@@ -69,17 +117,32 @@ void compute_distances_sub_PE_A(
 
 		for (int qid = 0; qid < query_num; qid++) {
 
-			// read query vector
+			// the query is padded to whole database words, the padded elements are zero in the database vectors
+			for (int i = 0; i < query_elem_num / FLOAT_PER_AXI; i++) {
+			#pragma HLS pipeline II=1
+				for (int j = 0; j < FLOAT_PER_AXI; j++) {
+				#pragma HLS unroll
+					query_vector[i * FLOAT_PER_AXI + j] = 0;
+					query_weights[i * FLOAT_PER_AXI + j] = 1;
+				}
+			}
+
+			// read query vector (and the weights for int8)
 			wait_data_fifo_first_iter<ap_uint<512>>(
-				vec_AXI_num, s_query_vectors, first_iter_s_query_vectors);
-			for (int i = 0; i < vec_AXI_num; i++) {
+				query_AXI_num, s_query_vectors, first_iter_s_query_vectors);
+			for (int i = 0; i < query_AXI_num; i++) {
 			#pragma HLS pipeline II=1
 				ap_uint<512> query_reg = s_query_vectors.read();
+				int offset = i < query_vec_AXI_num? i * FLOAT_PER_AXI : (i - query_vec_AXI_num) * FLOAT_PER_AXI;
 				for (int j = 0; j < FLOAT_PER_AXI; j++) {
 				#pragma HLS unroll
 					ap_uint<32> query_reg_uint32 = query_reg.range(32 * (j + 1) - 1, 32 * j);
 					float query_reg_float = *((float*) (&query_reg_uint32));
-					query_vector[i * FLOAT_PER_AXI + j] = query_reg_float;
+					if (i < query_vec_AXI_num) {
+						query_vector[offset + j] = query_reg_float;
+					} else {
+						query_weights[offset + j] = query_reg_float;
+					}
 				}
 			}
 
@@ -99,21 +162,28 @@ void compute_distances_sub_PE_A(
 						if (s_finish_query_in.empty() && !s_fetch_batch_size_replicated.empty()) {
 							fetch_batch_size += s_fetch_batch_size_replicated.read();
 						}
-						for (int i = 0; i < vec_AXI_num; i++) {
+						for (int i = 0; i < db_vec_AXI_num; i++) {
 
 							// read dist vector
 							ap_uint<512> db_vec_reg = s_fetched_vectors.read();
 							
-							float_pack_t reg_part_dist_packed;
-							for (int s = 0; s < FLOAT_PER_AXI; s++) {
+							float distance_partial = 0;
+							for (int p = 0; p < elem_packs_per_AXI; p++) {
 							#pragma HLS unroll
-								ap_uint<32> db_vec_reg_uint32 = db_vec_reg.range(32 * (s + 1) - 1, 32 * s);
-								float database_vector_partial = *((float*) (&db_vec_reg_uint32));
-								float diff = query_vector[i * FLOAT_PER_AXI + s] - database_vector_partial;
-								reg_part_dist_packed.float_data[s] = diff * diff;
+								float_pack_t reg_part_dist_packed;
+								for (int s = 0; s < FLOAT_PER_AXI; s++) {
+								#pragma HLS unroll
+									int e = p * FLOAT_PER_AXI + s;
+									float database_vector_partial = decode_db_element<vector_type>(db_vec_reg, e);
+									float diff = query_vector[i * DB_ELEM_PER_AXI + e] - database_vector_partial;
+									if (vector_type == VECTOR_TYPE_INT8) {
+										reg_part_dist_packed.float_data[s] = query_weights[i * DB_ELEM_PER_AXI + e] * diff * diff;
+									} else {
+										reg_part_dist_packed.float_data[s] = diff * diff;
+									}
+								}
+								distance_partial += aggregation_sum_float_pack(reg_part_dist_packed);
 							}
-
-							float distance_partial = aggregation_sum_float_pack(reg_part_dist_packed);
 							s_partial_distances.write(distance_partial);
 						}
 					}
@@ -136,7 +206,7 @@ void compute_distances_sub_PE_pack_partial_distances(
     hls::stream<int>& s_finish_query_out
 ) {
 
-    const int vec_AXI_num = D % FLOAT_PER_AXI == 0? D / FLOAT_PER_AXI : D / FLOAT_PER_AXI + 1; 
+    const int vec_AXI_num = db_vec_AXI_num; // one partial distance per database word
     const int packed_partial_dist_num = vec_AXI_num % FLOAT_PER_AXI == 0? vec_AXI_num / FLOAT_PER_AXI : vec_AXI_num / FLOAT_PER_AXI + 1;
 
 	bool first_s_query_batch_size = true;
@@ -207,7 +277,7 @@ void compute_distances_sub_PE_B(
     hls::stream<result_t>& s_distances,
     hls::stream<int>& s_finish_query_out
 ) {
-    const int vec_AXI_num = D % FLOAT_PER_AXI == 0? D / FLOAT_PER_AXI : D / FLOAT_PER_AXI + 1; 
+    const int vec_AXI_num = db_vec_AXI_num; // one partial distance per database word
     const int packed_partial_dist_num = vec_AXI_num % FLOAT_PER_AXI == 0? vec_AXI_num / FLOAT_PER_AXI : vec_AXI_num / FLOAT_PER_AXI + 1;
 
 	bool first_s_query_batch_size = true;
@@ -337,7 +407,7 @@ void compute_distances(
         s_finish_replicate_s_fetch_batch_size
     );
 
-    compute_distances_sub_PE_A(
+    compute_distances_sub_PE_A<VECTOR_TYPE>(
         // in runtime (stream)
 		s_query_batch_size_replicated[1],
         s_query_vectors, 
@@ -10,12 +10,81 @@ const int float_per_axi = FLOAT_PER_AXI;
 // #define D_MAX 1024
 #define D 128
 
+// storage format of the database vectors (hnsw_nsg_to_FPGA --vector_type in vector_search_baselines/FPGA_index_tools,
+//   bits 3 ~ 4 of the layout flags in meta.bin, checked by the host):
+//   fp32 (default), fp16, or int8 with a per-dimension scale and offset: x[d] = scale[d] * code[d] + offset[d].
+//   For int8, the host sends every query transformed to (q[d] - offset[d]) / scale[d], followed by the
+//   per-dimension weights scale[d]^2, such that dist = sum_d weight[d] * (q'[d] - code[d])^2
+#define VECTOR_TYPE_FP32 0
+#define VECTOR_TYPE_FP16 1
+#define VECTOR_TYPE_INT8 2
+#define VECTOR_TYPE VECTOR_TYPE_FP32
+
+#if VECTOR_TYPE == VECTOR_TYPE_FP32
+#define DB_ELEM_PER_AXI 16
+#elif VECTOR_TYPE == VECTOR_TYPE_FP16
+#define DB_ELEM_PER_AXI 32
+#elif VECTOR_TYPE == VECTOR_TYPE_INT8
+#define DB_ELEM_PER_AXI 64
+#endif
+
+// number of 512-bit words per query (fp32, plus the weights for int8) and per database vector (without the visited padding)
+const int query_vec_AXI_num = D % FLOAT_PER_AXI == 0? D / FLOAT_PER_AXI : D / FLOAT_PER_AXI + 1;
+#if VECTOR_TYPE == VECTOR_TYPE_INT8
+const int query_AXI_num = 2 * query_vec_AXI_num;
+#else
+const int query_AXI_num = query_vec_AXI_num;
+#endif
+const int db_vec_AXI_num = D % DB_ELEM_PER_AXI == 0? D / DB_ELEM_PER_AXI : D / DB_ELEM_PER_AXI + 1;
+
+// layout of the database vectors in DRAM (bit 0 of the layout flags in meta.bin, passed as kernel argument):
+//   VECTOR_LAYOUT_PADDED: each vector is followed by a 64-byte visited padding (the original format)
+//   VECTOR_LAYOUT_COMPACT: vectors are contiguous, as the visited tags are kept in the Bloom filters
+#define VECTOR_LAYOUT_PADDED 0
+#define VECTOR_LAYOUT_COMPACT 1
+
+// layout of the base layer links in DRAM (bit 1 of the layout flags in meta.bin, passed as kernel argument):
+//   LINK_LAYOUT_ORIGINAL: 64-byte header (num_links) + max_link_num_base links, all words are fetched
+//   LINK_LAYOUT_PACKED: num_links followed by the links in the same word, only the ceil((num_links + 1) / 16)
+//     populated words are fetched (the node stride is still fixed, but the count is read before the rest)
+#define LINK_LAYOUT_ORIGINAL 0
+#define LINK_LAYOUT_PACKED 1
+
+// neighbor codes in the base layer links (bit 2 of the layout flags in meta.bin, passed as kernel argument):
+//   NEIGHBOR_CODES_PQ: the PQ_M-byte PQ code of each neighbor follows the link words fetched per node, such that
+//   split_tasks_to_channels approximates the distance of each neighbor from the adjacency block alone and only
+//   forwards the neighbors within runtime pq_filter_slack times the largest result to bloom_fetch_compute, which
+//   re-ranks them with the exact distance. The lookup tables (256 centroids x PQ_M subspaces) are computed per
+//   query by compute_pq_lookup_tables (neighbor_codes.hpp) from the codebook (pq_codebook.bin, loaded at kernel
+//   start: centroid k is one row of PQ_M concatenated sub-centroids, laid out like a query). PQ_M is the pq_m of
+//   hnsw_nsg_to_FPGA, up to 16 such that the PQ_M table entries of a centroid fit one 512-bit word.
+#define NEIGHBOR_CODES_NONE 0
+#define NEIGHBOR_CODES_PQ 1
+#define PQ_M 16
+const int pq_num_centroids = 256;
+const int pq_sub_dim = (D + PQ_M - 1) / PQ_M;
+const int pq_codes_per_AXI = BYTE_PER_AXI / PQ_M;
+
+// links (and neighbor codes) words per node in the buffers of fetch_neighbor_ids and split_tasks_to_channels:
+//   up to 512 links, or e.g., max degree 64 with 16-byte neighbor codes (5 link + 16 code words)
+const int hardware_link_buffer_AXI_num = 32 + 1;
+
 // largest 32-bit float: 3.4028237 × 10^38
 const float large_float = 1E+20f; // 1E+20f is large enough for cosine similarity
 
 // max queue sizes
 const int hardware_result_queue_size = 64; // 128;
 const int hardware_candidate_queue_size = 32; // 128;
+// ef > hardware_result_queue_size: BRAM tier of the result queue (Two_tier_result_queue)
+const int hardware_large_result_queue_size = 512;
+
+// result queue of results_collection (priority_queue.hpp, unit_tests/priority_queue for the comparison):
+//   RESULT_QUEUE_TWO_TIER: systolic insertion, ef up to hardware_large_result_queue_size
+//   RESULT_QUEUE_BITONIC: batches of bitonic_batch_size merged by a bitonic network, ef up to hardware_result_queue_size
+#define RESULT_QUEUE_TWO_TIER 0
+#define RESULT_QUEUE_BITONIC 1
+#define RESULT_QUEUE_TYPE RESULT_QUEUE_TWO_TIER
+const int bitonic_batch_size = 16;
 
 // bloom filter setting: https://hur.st/bloomfilter/?n=2500&p=&m=64000&k=4
 const int bloom_num_hash_funs = 3; 
@@ -38,14 +107,44 @@ const int bloom_num_bucket_addr_bits = 4 + 10; // 16 * 1024
 
 const int bloom_num_buckets = 1 << bloom_num_bucket_addr_bits;
 
+// reset of the Bloom filters between queries: BLOOM_RESET_SWEEP clears every 512-bit bucket after each
+//   query (runtime_num_512b_buckets cycles, up to 512), BLOOM_RESET_EPOCH tags each bucket with the epoch
+//   (query) that last wrote it (BLOOM_EPOCH_BITS LUTRAM bits per bucket), such that the buckets of older
+//   epochs read as empty and the next query starts right away; the tags are only swept when the epoch wraps
+#define BLOOM_RESET_SWEEP 0
+#define BLOOM_RESET_EPOCH 1
+#define BLOOM_RESET_MODE BLOOM_RESET_EPOCH
+#define BLOOM_EPOCH_BITS 8
+
+// node ID -> DRAM channel (see get_channel_id in types.hpp):
+//   default: low CHANNEL_ADDR_BITS of the node ID, i.e., node i in channel i % N_CHANNEL
+//   CHANNEL_PLACEMENT_BALANCED: bits [30 : 31 - CHANNEL_ADDR_BITS], the node positions within
+//     the channels are chosen by the index tools (vector_search_baselines/FPGA_index_tools/balance_FPGA_channels)
+// #define CHANNEL_PLACEMENT_BALANCED
+
 // async batch size tracking
 const int hardware_async_batch_size = 64; // to infer BRAM
 
+// speculative link prefetch: after each batch, the scheduler hints up to runtime_num_prefetch_candidates
+//   (kernel argument, 0 = off) current candidate queue heads, whose links are read by fetch_neighbor_ids
+//   into an on-chip staging slot while it is idle; a later pop of a staged node skips the DRAM read
+const int max_prefetch_candidates = 2; // staging slots, each as large as the links buffer of fetch_neighbor_ids
+
+// hot node cache: at kernel start, the links (fetch_neighbor_ids) and vectors (fetch_vectors) of the first
+//   runtime_num_hot_nodes nodes of the host's hot node list (hot_nodes.bin, most frequently fetched first, made
+//   by vector_search_baselines/FPGA_index_tools/profile_hot_nodes) are loaded on chip, and fetches of these
+//   nodes skip DRAM. Per channel, the cache is direct-mapped on the low hot_node_cache_addr_bits of the position
+//   in the channel; a node whose slot is taken by a hotter one stays in DRAM.
+const int hot_node_cache_addr_bits = 8;
+const int hardware_hot_nodes_per_channel = 1 << hot_node_cache_addr_bits;
+const int hot_node_link_AXI_num = 5; // link words per cached node: max degree up to 64 in both link layouts
+
 // debug signals per query
 const int debug_size = 1;
 
 // FIFO depth
 const int depth_network_in = 512; // data FIFOs without wide data types
+const int depth_pq_lookup_tables = 2 * pq_num_centroids; // the tables of the next query are computed during the current one
 
 #if D == 128 // SIFT
 	const int depth_data = 512; // data FIFOs without wide data types
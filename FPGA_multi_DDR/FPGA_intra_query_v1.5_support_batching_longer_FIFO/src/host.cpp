@@ -3,6 +3,9 @@
 #include <cassert>
 
 #include "host.hpp"
+#include "index_loader.hpp"
+#include "upper_layer_search.hpp"
+#include "result_labels.hpp"
 
 #include "constants.hpp"
 // #include "types.hpp"
@@ -31,7 +34,7 @@ std::string concat_dir(std::string dir, std::string filename) {
 
 int main(int argc, char** argv)
 {
-    std::cout << "Usage: ./host <xclbin> <max_cand_per_group (mc)> <max_group_num_in_pipe (mg)> <ef> <graph_type> <dataset> <Max degree (MD)> <batch_size>" << std::endl;
+    std::cout << "Usage: ./host <xclbin> <max_cand_per_group (mc)> <max_group_num_in_pipe (mg)> <ef> <graph_type> <dataset> <Max degree (MD)> <batch_size> <index_load_mode (mmap_populate/mmap/huge_pages)> <index_dir (optional)> <entry_point_mode (upper_layers/meta)> <num_prefetch_candidates (optional, default: 0 = off)> <num_hot_nodes (optional, default: all of hot_nodes.bin)> <pq_filter_slack (optional, default: 1.0)>" << std::endl;
     std::cout << "   Example: ./host xclbin/vadd.hw.xclbin 1 4 64 HNSW SIFT1M 64 10000" << std::endl;
 
     // in init
@@ -53,7 +56,11 @@ int main(int argc, char** argv)
     int ef = 64;
     if (argc > 4) { ef = atoi(argv[arg_cnt++]); }
     std::cout << "ef=" << ef << std::endl;
+#if RESULT_QUEUE_TYPE == RESULT_QUEUE_BITONIC
     assert(ef <= hardware_result_queue_size);
+#else
+    assert(ef <= hardware_large_result_queue_size);
+#endif
 
     std::string graph_type = "HNSW"; // "NSG" or "HNSW"
     if (argc > 5) { graph_type = argv[arg_cnt++]; }
@@ -79,6 +86,12 @@ int main(int argc, char** argv)
     std::cout << "query_batch_size=" << query_batch_size << std::endl;
     assert (query_batch_size <= query_num);
 
+    // "mmap_populate" (default): mmap + MAP_POPULATE; "mmap": lazy mmap; "huge_pages": 2MB pages + pread
+    std::string index_load_mode = "mmap_populate";
+    if (argc > 9) { index_load_mode = argv[arg_cnt++]; }
+    std::cout << "index_load_mode=" << index_load_mode << std::endl;
+    assert (index_load_mode == "mmap_populate" || index_load_mode == "mmap" || index_load_mode == "huge_pages");
+
     int max_bloom_out_burst_size = 16; // according to mem & compute speed test
 #if N_CHANNEL == 1
     int runtime_n_bucket_addr_bits = 8 + 10; // 256K buckets
@@ -97,7 +110,7 @@ int main(int argc, char** argv)
 #endif
     int runtime_n_buckets = 1 << runtime_n_bucket_addr_bits;
     uint32_t hash_seed = 1;
-    assert (ef <= hardware_result_queue_size);
+    assert (ef <= hardware_large_result_queue_size);
 
     std::string index_dir;
 
@@ -147,6 +160,32 @@ int main(int argc, char** argv)
         std::cout << "Unknown graph type\n";
         return -1; 
     }
+    // optional: a different index directory, e.g., produced by the FPGA_index_tools (reordered / channel balanced)
+    if (argc > 10) { index_dir = argv[arg_cnt++]; }
+    std::cout << "index_dir=" << index_dir << std::endl;
+
+    // "upper_layers" (default): per-query entry points from the HNSW upper layers (upper_layer_search.hpp), 
+    //   "meta": the entry point of meta.bin for all queries (always the case for NSG)
+    std::string entry_point_mode = "upper_layers";
+    if (argc > 11) { entry_point_mode = argv[arg_cnt++]; }
+    std::cout << "entry_point_mode=" << entry_point_mode << std::endl;
+    assert (entry_point_mode == "upper_layers" || entry_point_mode == "meta");
+
+    // candidate queue heads whose links are prefetched after each batch (0 = no prefetch); off by default, as
+    //   it only shortens the hops with one group in flight (mg=1) and competes with the pops for the link port
+    //   otherwise (up to 9% slower at mg=2, mc=4 in intra_query_pipeline_model)
+    int num_prefetch_candidates = 0;
+    if (argc > 12) { num_prefetch_candidates = atoi(argv[arg_cnt++]); }
+    std::cout << "num_prefetch_candidates=" << num_prefetch_candidates << std::endl;
+    assert (num_prefetch_candidates >= 0 && num_prefetch_candidates <= max_prefetch_candidates);
+
+    // nodes of hot_nodes.bin in the index directory whose vectors and links are cached on chip (-1: all)
+    int num_hot_nodes = -1;
+    if (argc > 13) { num_hot_nodes = atoi(argv[arg_cnt++]); }
+
+    // indexes with neighbor codes: neighbors within pq_filter_slack x the largest result are evaluated
+    float pq_filter_slack = 1.0;
+    if (argc > 14) { pq_filter_slack = atof(argv[arg_cnt++]); }
 
     std::string dataset_dir;
     std::string fname_query_vectors;
@@ -195,8 +234,8 @@ int main(int argc, char** argv)
     }
 
     // initialization values
-    int max_level; // = 16;
-    int max_link_num_upper; // = 32;
+    int max_level = 0; // HNSW only
+    int max_link_num_upper = 0; // HNSW only
     int max_link_num_base; // = 32;
     int entry_point_id; // = 0;
     int num_db_vec; // = 1000 * 1000;
@@ -210,7 +249,6 @@ int main(int argc, char** argv)
         fread(&entry_point_id, sizeof(int), 1, f_metadata);
         fread(&max_link_num_upper, sizeof(int), 1, f_metadata);
         fread(&max_link_num_base, sizeof(int), 1, f_metadata);
-        fclose(f_metadata);
         std::cout << "num_db_vec=" << num_db_vec << std::endl;
         std::cout << "max_level=" << max_level << std::endl;
         std::cout << "entry_point_id=" << entry_point_id << std::endl;
@@ -220,159 +258,93 @@ int main(int argc, char** argv)
         fread(&num_db_vec, sizeof(int), 1, f_metadata);
         fread(&entry_point_id, sizeof(int), 1, f_metadata);
         fread(&max_link_num_base, sizeof(int), 1, f_metadata);
-        fclose(f_metadata);
         std::cout << "num_db_vec=" << num_db_vec << std::endl;
         std::cout << "entry_point_id=" << entry_point_id << std::endl;
         std::cout << "max_link_num_base=" << max_link_num_base << std::endl;
     }
+    // optional last field, absent in the original format: layout flags (see constants.hpp), 
+    //   bit 0 = VECTOR_LAYOUT_COMPACT, bit 1 = LINK_LAYOUT_PACKED, bit 2 = NEIGHBOR_CODES_PQ, bits 3 ~ 4 = vector type
+    int layout_flags = 0;
+    if (fread(&layout_flags, sizeof(int), 1, f_metadata) != 1) {
+        layout_flags = 0;
+    }
+    fclose(f_metadata);
+    int vector_layout = layout_flags & 1;
+    int link_layout = (layout_flags >> 1) & 1;
+    int neighbor_codes = (layout_flags >> 2) & 1;
+    std::cout << "vector_layout=" << (vector_layout == VECTOR_LAYOUT_COMPACT? "compact" : "padded") << std::endl;
+    std::cout << "link_layout=" << (link_layout == LINK_LAYOUT_PACKED? "packed" : "original") << std::endl;
+    std::cout << "neighbor_codes=" << (neighbor_codes == NEIGHBOR_CODES_PQ? "pq" : "none") << 
+        " pq_filter_slack=" << pq_filter_slack << std::endl;
+    // the vector type the index was converted with (hnsw_nsg_to_FPGA --vector_type) has to be the compiled one
+    int vector_type = (layout_flags >> 3) & 3;
+    if (vector_type != VECTOR_TYPE) {
+        std::cout << "The index stores vector type " << vector_type << ", but the kernel is compiled with VECTOR_TYPE " <<
+            VECTOR_TYPE << " (0 = fp32, 1 = fp16, 2 = int8, see constants.hpp)" << std::endl;
+        exit(1);
+    }
+
+    // the fetched link (and neighbor code) words of a node have to fit the buffers of the kernel
+    int link_AXI_num_stride = link_layout == LINK_LAYOUT_PACKED? 1 + max_link_num_base / 16 : (max_link_num_base + 31) / 16;
+    int code_AXI_num_stride = neighbor_codes == NEIGHBOR_CODES_PQ? (max_link_num_base + pq_codes_per_AXI - 1) / pq_codes_per_AXI : 0;
+    assert (link_AXI_num_stride + code_AXI_num_stride <= hardware_link_buffer_AXI_num);
+
+    // optional hot node list, most frequently fetched first (profile_hot_nodes in vector_search_baselines/FPGA_index_tools)
+    std::string fname_hot_nodes = concat_dir(index_dir, "hot_nodes.bin");
+    long bytes_hot_nodes = GetFileSize(fname_hot_nodes);
+    int num_hot_nodes_in_file = bytes_hot_nodes > 0? bytes_hot_nodes / sizeof(int) : 0;
+    std::vector<int, aligned_allocator<int>> hot_node_ids(num_hot_nodes_in_file > 0? num_hot_nodes_in_file : 1, -1);
+    if (num_hot_nodes_in_file > 0) {
+        FILE* f_hot_nodes = fopen(fname_hot_nodes.c_str(), "rb");
+        fread(hot_node_ids.data(), 1, bytes_hot_nodes, f_hot_nodes);
+        fclose(f_hot_nodes);
+    }
+    if (num_hot_nodes < 0 || num_hot_nodes > num_hot_nodes_in_file) { num_hot_nodes = num_hot_nodes_in_file; }
+#ifdef CHANNEL_PLACEMENT_BALANCED
+    // the list holds the node IDs of the round-robin placement
+    num_hot_nodes = 0;
+#endif
+    std::cout << "num_hot_nodes=" << num_hot_nodes << " (cache: " << hardware_hot_nodes_per_channel << " per channel)" << std::endl;
+
+    // PQ codebook of the neighbor codes (pq_codebook.bin: M, then M x 256 x ceil(d / M) floats), sent as one
+    //   row of the M concatenated sub-centroids per centroid, laid out like a query (see constants.hpp)
+    std::vector<float> pq_centroids;
+    int pq_sub_dim_in_file = 0;
+    if (neighbor_codes == NEIGHBOR_CODES_PQ) {
+        std::string fname_pq_codebook = concat_dir(index_dir, "pq_codebook.bin");
+        FILE* f_pq_codebook = fopen(fname_pq_codebook.c_str(), "rb");
+        int pq_m = 0;
+        if (!f_pq_codebook || fread(&pq_m, sizeof(int), 1, f_pq_codebook) != 1 || pq_m != PQ_M) {
+            std::cout << "NEIGHBOR_CODES_PQ requires " << fname_pq_codebook << " with M = PQ_M (" << PQ_M << ")" << std::endl;
+            exit(1);
+        }
+        pq_sub_dim_in_file = (d + PQ_M - 1) / PQ_M;
+        pq_centroids.resize(PQ_M * pq_num_centroids * pq_sub_dim_in_file);
+        fread(pq_centroids.data(), sizeof(float), pq_centroids.size(), f_pq_codebook);
+        fclose(f_pq_codebook);
+    }
     
     size_t bytes_per_vec = d * sizeof(float);
     size_t bytes_per_db_vec_plus_padding = d % 16 == 0? d * sizeof(float) : (d + 16 - d % 16) * sizeof(float);
 	assert (bytes_per_db_vec_plus_padding % 64 == 0);
 	int d_after_padding = bytes_per_db_vec_plus_padding / sizeof(float);
-    size_t bytes_per_db_vec_plus_padding_plus_visited_padding = d % 16 == 0? d * sizeof(float) + 64 : (d + 16 - d % 16) * sizeof(float) + 64;
+    // database vectors are stored as VECTOR_TYPE (fp32 / fp16 / int8), see constants.hpp
+    size_t bytes_per_db_vec_in_index = vector_layout == VECTOR_LAYOUT_COMPACT? db_vec_AXI_num * 64 : db_vec_AXI_num * 64 + 64;
     size_t bytes_entry_vector = bytes_per_db_vec_plus_padding;
     size_t bytes_entry_point_ids = query_num * sizeof(int);
-    size_t bytes_query_vectors = query_num * bytes_per_db_vec_plus_padding;
+    size_t bytes_query_vectors = query_num * query_AXI_num * 64; // int8: + per-dimension weights
     size_t bytes_out_id = query_num * ef * sizeof(int);
     size_t bytes_out_dist = query_num * ef * sizeof(float);	
     size_t bytes_mem_debug = query_num * 5 * sizeof(int);
 
-#if N_CHANNEL == 1
-    std::string fname_ground_links_chan_0 = concat_dir(index_dir, "ground_links_1_chan_0.bin");
-#elif N_CHANNEL == 2
-    std::string fname_ground_links_chan_0 = concat_dir(index_dir, "ground_links_2_chan_0.bin");
-    std::string fname_ground_links_chan_1 = concat_dir(index_dir, "ground_links_2_chan_1.bin");
-#elif N_CHANNEL == 4
-    std::string fname_ground_links_chan_0 = concat_dir(index_dir, "ground_links_4_chan_0.bin");
-    std::string fname_ground_links_chan_1 = concat_dir(index_dir, "ground_links_4_chan_1.bin");
-    std::string fname_ground_links_chan_2 = concat_dir(index_dir, "ground_links_4_chan_2.bin");
-    std::string fname_ground_links_chan_3 = concat_dir(index_dir, "ground_links_4_chan_3.bin");
-#elif N_CHANNEL == 8
-    std::string fname_ground_links_chan_0 = concat_dir(index_dir, "ground_links_8_chan_0.bin");
-    std::string fname_ground_links_chan_1 = concat_dir(index_dir, "ground_links_8_chan_1.bin");
-    std::string fname_ground_links_chan_2 = concat_dir(index_dir, "ground_links_8_chan_2.bin");
-    std::string fname_ground_links_chan_3 = concat_dir(index_dir, "ground_links_8_chan_3.bin");
-    std::string fname_ground_links_chan_4 = concat_dir(index_dir, "ground_links_8_chan_4.bin");
-    std::string fname_ground_links_chan_5 = concat_dir(index_dir, "ground_links_8_chan_5.bin");
-    std::string fname_ground_links_chan_6 = concat_dir(index_dir, "ground_links_8_chan_6.bin");
-    std::string fname_ground_links_chan_7 = concat_dir(index_dir, "ground_links_8_chan_7.bin");
-#elif N_CHANNEL == 16
-    std::string fname_ground_links_chan_0 = concat_dir(index_dir, "ground_links_16_chan_0.bin");
-    std::string fname_ground_links_chan_1 = concat_dir(index_dir, "ground_links_16_chan_1.bin");
-    std::string fname_ground_links_chan_2 = concat_dir(index_dir, "ground_links_16_chan_2.bin");
-    std::string fname_ground_links_chan_3 = concat_dir(index_dir, "ground_links_16_chan_3.bin");
-    std::string fname_ground_links_chan_4 = concat_dir(index_dir, "ground_links_16_chan_4.bin");
-    std::string fname_ground_links_chan_5 = concat_dir(index_dir, "ground_links_16_chan_5.bin");
-    std::string fname_ground_links_chan_6 = concat_dir(index_dir, "ground_links_16_chan_6.bin");
-    std::string fname_ground_links_chan_7 = concat_dir(index_dir, "ground_links_16_chan_7.bin");
-    std::string fname_ground_links_chan_8 = concat_dir(index_dir, "ground_links_16_chan_8.bin");
-    std::string fname_ground_links_chan_9 = concat_dir(index_dir, "ground_links_16_chan_9.bin");
-    std::string fname_ground_links_chan_10 = concat_dir(index_dir, "ground_links_16_chan_10.bin");
-    std::string fname_ground_links_chan_11 = concat_dir(index_dir, "ground_links_16_chan_11.bin");
-    std::string fname_ground_links_chan_12 = concat_dir(index_dir, "ground_links_16_chan_12.bin");
-    std::string fname_ground_links_chan_13 = concat_dir(index_dir, "ground_links_16_chan_13.bin");
-    std::string fname_ground_links_chan_14 = concat_dir(index_dir, "ground_links_16_chan_14.bin");
-    std::string fname_ground_links_chan_15 = concat_dir(index_dir, "ground_links_16_chan_15.bin");
-#endif
-
-    std::string fname_ground_labels = concat_dir(index_dir, "ground_labels.bin");
-
-#if N_CHANNEL == 1
-    std::string fname_ground_vectors_chan_0 = concat_dir(index_dir, "ground_vectors_1_chan_0.bin");
-#elif N_CHANNEL == 2
-    std::string fname_ground_vectors_chan_0 = concat_dir(index_dir, "ground_vectors_2_chan_0.bin");
-    std::string fname_ground_vectors_chan_1 = concat_dir(index_dir, "ground_vectors_2_chan_1.bin");
-#elif N_CHANNEL == 4
-    std::string fname_ground_vectors_chan_0 = concat_dir(index_dir, "ground_vectors_4_chan_0.bin");
-    std::string fname_ground_vectors_chan_1 = concat_dir(index_dir, "ground_vectors_4_chan_1.bin");
-    std::string fname_ground_vectors_chan_2 = concat_dir(index_dir, "ground_vectors_4_chan_2.bin");
-    std::string fname_ground_vectors_chan_3 = concat_dir(index_dir, "ground_vectors_4_chan_3.bin");
-#elif N_CHANNEL == 8
-    std::string fname_ground_vectors_chan_0 = concat_dir(index_dir, "ground_vectors_8_chan_0.bin");
-    std::string fname_ground_vectors_chan_1 = concat_dir(index_dir, "ground_vectors_8_chan_1.bin");
-    std::string fname_ground_vectors_chan_2 = concat_dir(index_dir, "ground_vectors_8_chan_2.bin");
-    std::string fname_ground_vectors_chan_3 = concat_dir(index_dir, "ground_vectors_8_chan_3.bin");
-    std::string fname_ground_vectors_chan_4 = concat_dir(index_dir, "ground_vectors_8_chan_4.bin");
-    std::string fname_ground_vectors_chan_5 = concat_dir(index_dir, "ground_vectors_8_chan_5.bin");
-    std::string fname_ground_vectors_chan_6 = concat_dir(index_dir, "ground_vectors_8_chan_6.bin");
-    std::string fname_ground_vectors_chan_7 = concat_dir(index_dir, "ground_vectors_8_chan_7.bin");
-#elif N_CHANNEL == 16
-    std::string fname_ground_vectors_chan_0 = concat_dir(index_dir, "ground_vectors_16_chan_0.bin");
-    std::string fname_ground_vectors_chan_1 = concat_dir(index_dir, "ground_vectors_16_chan_1.bin");
-    std::string fname_ground_vectors_chan_2 = concat_dir(index_dir, "ground_vectors_16_chan_2.bin");
-    std::string fname_ground_vectors_chan_3 = concat_dir(index_dir, "ground_vectors_16_chan_3.bin");
-    std::string fname_ground_vectors_chan_4 = concat_dir(index_dir, "ground_vectors_16_chan_4.bin");
-    std::string fname_ground_vectors_chan_5 = concat_dir(index_dir, "ground_vectors_16_chan_5.bin");
-    std::string fname_ground_vectors_chan_6 = concat_dir(index_dir, "ground_vectors_16_chan_6.bin");
-    std::string fname_ground_vectors_chan_7 = concat_dir(index_dir, "ground_vectors_16_chan_7.bin");
-    std::string fname_ground_vectors_chan_8 = concat_dir(index_dir, "ground_vectors_16_chan_8.bin");
-    std::string fname_ground_vectors_chan_9 = concat_dir(index_dir, "ground_vectors_16_chan_9.bin");
-    std::string fname_ground_vectors_chan_10 = concat_dir(index_dir, "ground_vectors_16_chan_10.bin");
-    std::string fname_ground_vectors_chan_11 = concat_dir(index_dir, "ground_vectors_16_chan_11.bin");
-    std::string fname_ground_vectors_chan_12 = concat_dir(index_dir, "ground_vectors_16_chan_12.bin");
-    std::string fname_ground_vectors_chan_13 = concat_dir(index_dir, "ground_vectors_16_chan_13.bin");
-    std::string fname_ground_vectors_chan_14 = concat_dir(index_dir, "ground_vectors_16_chan_14.bin");
-    std::string fname_ground_vectors_chan_15 = concat_dir(index_dir, "ground_vectors_16_chan_15.bin");
-#endif
-
-    FILE* f_ground_links_chan_0 = fopen(fname_ground_links_chan_0.c_str(), "rb");
-#if N_CHANNEL >= 2
-    FILE* f_ground_links_chan_1 = fopen(fname_ground_links_chan_1.c_str(), "rb");
-#endif
-#if N_CHANNEL >= 3
-    FILE* f_ground_links_chan_2 = fopen(fname_ground_links_chan_2.c_str(), "rb");
-#endif
-#if N_CHANNEL >= 4
-    FILE* f_ground_links_chan_3 = fopen(fname_ground_links_chan_3.c_str(), "rb");
-#endif
-#if N_CHANNEL >= 8
-    FILE* f_ground_links_chan_4 = fopen(fname_ground_links_chan_4.c_str(), "rb");
-    FILE* f_ground_links_chan_5 = fopen(fname_ground_links_chan_5.c_str(), "rb");
-    FILE* f_ground_links_chan_6 = fopen(fname_ground_links_chan_6.c_str(), "rb");
-    FILE* f_ground_links_chan_7 = fopen(fname_ground_links_chan_7.c_str(), "rb");
-#endif
-#if N_CHANNEL >= 16
-    FILE* f_ground_links_chan_8 = fopen(fname_ground_links_chan_8.c_str(), "rb");
-    FILE* f_ground_links_chan_9 = fopen(fname_ground_links_chan_9.c_str(), "rb");
-    FILE* f_ground_links_chan_10 = fopen(fname_ground_links_chan_10.c_str(), "rb");
-    FILE* f_ground_links_chan_11 = fopen(fname_ground_links_chan_11.c_str(), "rb");
-    FILE* f_ground_links_chan_12 = fopen(fname_ground_links_chan_12.c_str(), "rb");
-    FILE* f_ground_links_chan_13 = fopen(fname_ground_links_chan_13.c_str(), "rb");
-    FILE* f_ground_links_chan_14 = fopen(fname_ground_links_chan_14.c_str(), "rb");
-    FILE* f_ground_links_chan_15 = fopen(fname_ground_links_chan_15.c_str(), "rb");
-#endif
+    std::vector<std::string> fnames_ground_vectors = IndexLoader::channel_fnames(index_dir, "ground_vectors", N_CHANNEL);
+    std::vector<std::string> fnames_ground_links = IndexLoader::channel_fnames(index_dir, "ground_links", N_CHANNEL);
 
-    FILE* f_ground_labels;
-    if (graph_type == "HNSW") {
-        f_ground_labels = fopen(fname_ground_labels.c_str(), "rb");
-    }
-
-    FILE* f_ground_vectors_chan_0 = fopen(fname_ground_vectors_chan_0.c_str(), "rb");
-#if N_CHANNEL >= 2
-    FILE* f_ground_vectors_chan_1 = fopen(fname_ground_vectors_chan_1.c_str(), "rb");
-#endif
-#if N_CHANNEL >= 3
-    FILE* f_ground_vectors_chan_2 = fopen(fname_ground_vectors_chan_2.c_str(), "rb");
-#endif
-#if N_CHANNEL >= 4
-    FILE* f_ground_vectors_chan_3 = fopen(fname_ground_vectors_chan_3.c_str(), "rb");
-#endif
-#if N_CHANNEL >= 8
-    FILE* f_ground_vectors_chan_4 = fopen(fname_ground_vectors_chan_4.c_str(), "rb");
-    FILE* f_ground_vectors_chan_5 = fopen(fname_ground_vectors_chan_5.c_str(), "rb");
-    FILE* f_ground_vectors_chan_6 = fopen(fname_ground_vectors_chan_6.c_str(), "rb");
-    FILE* f_ground_vectors_chan_7 = fopen(fname_ground_vectors_chan_7.c_str(), "rb");
-#endif
-#if N_CHANNEL >= 16
-    FILE* f_ground_vectors_chan_8 = fopen(fname_ground_vectors_chan_8.c_str(), "rb");
-    FILE* f_ground_vectors_chan_9 = fopen(fname_ground_vectors_chan_9.c_str(), "rb");
-    FILE* f_ground_vectors_chan_10 = fopen(fname_ground_vectors_chan_10.c_str(), "rb");
-    FILE* f_ground_vectors_chan_11 = fopen(fname_ground_vectors_chan_11.c_str(), "rb");
-    FILE* f_ground_vectors_chan_12 = fopen(fname_ground_vectors_chan_12.c_str(), "rb");
-    FILE* f_ground_vectors_chan_13 = fopen(fname_ground_vectors_chan_13.c_str(), "rb");
-    FILE* f_ground_vectors_chan_14 = fopen(fname_ground_vectors_chan_14.c_str(), "rb");
-    FILE* f_ground_vectors_chan_15 = fopen(fname_ground_vectors_chan_15.c_str(), "rb");
+    // node ID -> label: ground_labels.bin, or channel_placement_N.bin of a channel-balanced index
+#ifdef CHANNEL_PLACEMENT_BALANCED
+    ResultLabels result_labels(index_dir, graph_type, N_CHANNEL, CHANNEL_ADDR_BITS, /* balanced_placement */ true);
+#else
+    ResultLabels result_labels(index_dir, graph_type, N_CHANNEL, CHANNEL_ADDR_BITS, /* balanced_placement */ false);
 #endif
 
 FILE* f_query_vectors = fopen(fname_query_vectors.c_str(), "rb");
@@ -380,137 +352,16 @@ FILE* f_gt_vec_ID = fopen(fname_gt_vec_ID.c_str(), "rb");
 FILE* f_gt_dist = fopen(fname_gt_dist.c_str(), "rb");
 
 // get file size
-size_t bytes_db_vectors_chan_0 = GetFileSize(fname_ground_vectors_chan_0);
-#if N_CHANNEL >= 2
-    size_t bytes_db_vectors_chan_1 = GetFileSize(fname_ground_vectors_chan_1);
-#endif
-#if N_CHANNEL >= 4
-    size_t bytes_db_vectors_chan_2 = GetFileSize(fname_ground_vectors_chan_2);
-    size_t bytes_db_vectors_chan_3 = GetFileSize(fname_ground_vectors_chan_3);
-#endif
-#if N_CHANNEL >= 8
-    size_t bytes_db_vectors_chan_4 = GetFileSize(fname_ground_vectors_chan_4);
-    size_t bytes_db_vectors_chan_5 = GetFileSize(fname_ground_vectors_chan_5);
-    size_t bytes_db_vectors_chan_6 = GetFileSize(fname_ground_vectors_chan_6);
-    size_t bytes_db_vectors_chan_7 = GetFileSize(fname_ground_vectors_chan_7);
-#endif
-#if N_CHANNEL >= 16
-    size_t bytes_db_vectors_chan_8 = GetFileSize(fname_ground_vectors_chan_8);
-    size_t bytes_db_vectors_chan_9 = GetFileSize(fname_ground_vectors_chan_9);
-    size_t bytes_db_vectors_chan_10 = GetFileSize(fname_ground_vectors_chan_10);
-    size_t bytes_db_vectors_chan_11 = GetFileSize(fname_ground_vectors_chan_11);
-    size_t bytes_db_vectors_chan_12 = GetFileSize(fname_ground_vectors_chan_12);
-    size_t bytes_db_vectors_chan_13 = GetFileSize(fname_ground_vectors_chan_13);
-    size_t bytes_db_vectors_chan_14 = GetFileSize(fname_ground_vectors_chan_14);
-    size_t bytes_db_vectors_chan_15 = GetFileSize(fname_ground_vectors_chan_15);
-#endif
-    
-    size_t bytes_links_base_chan_0 = GetFileSize(fname_ground_links_chan_0);
-#if N_CHANNEL >= 2
-    size_t bytes_links_base_chan_1 = GetFileSize(fname_ground_links_chan_1);
-#endif
-    #if N_CHANNEL >= 4
-    size_t bytes_links_base_chan_2 = GetFileSize(fname_ground_links_chan_2);
-    size_t bytes_links_base_chan_3 = GetFileSize(fname_ground_links_chan_3);
-#endif
-#if N_CHANNEL >= 8
-    size_t bytes_links_base_chan_4 = GetFileSize(fname_ground_links_chan_4);
-    size_t bytes_links_base_chan_5 = GetFileSize(fname_ground_links_chan_5);
-    size_t bytes_links_base_chan_6 = GetFileSize(fname_ground_links_chan_6);
-    size_t bytes_links_base_chan_7 = GetFileSize(fname_ground_links_chan_7);
-#endif
-#if N_CHANNEL >= 16
-    size_t bytes_links_base_chan_8 = GetFileSize(fname_ground_links_chan_8);
-    size_t bytes_links_base_chan_9 = GetFileSize(fname_ground_links_chan_9);
-    size_t bytes_links_base_chan_10 = GetFileSize(fname_ground_links_chan_10);
-    size_t bytes_links_base_chan_11 = GetFileSize(fname_ground_links_chan_11);
-    size_t bytes_links_base_chan_12 = GetFileSize(fname_ground_links_chan_12);
-    size_t bytes_links_base_chan_13 = GetFileSize(fname_ground_links_chan_13);
-    size_t bytes_links_base_chan_14 = GetFileSize(fname_ground_links_chan_14);
-    size_t bytes_links_base_chan_15 = GetFileSize(fname_ground_links_chan_15);
-#endif
-    size_t bytes_labels_base;
-    if (graph_type == "HNSW") {
-        bytes_labels_base = GetFileSize(fname_ground_labels); // int = 4 bytes
-    }
     size_t raw_query_vectors_size = GetFileSize(fname_query_vectors);
     size_t raw_gt_vec_ID_size = GetFileSize(fname_gt_vec_ID);
     size_t raw_gt_dist_size = GetFileSize(fname_gt_dist);
-    std::cout << "bytes_db_vectors_chan_0=" << bytes_db_vectors_chan_0 << std::endl;
-    std::cout << "bytes_links_base_chan_0=" << bytes_links_base_chan_0 << std::endl;
     std::cout << "raw_query_vectors_size=" << raw_query_vectors_size << std::endl;
-    size_t bytes_total_db_vectors = bytes_db_vectors_chan_0
-#if N_CHANNEL >= 2
-    + bytes_db_vectors_chan_1
-#endif
-#if N_CHANNEL >= 4
-    + bytes_db_vectors_chan_2 + bytes_db_vectors_chan_3
-#endif
-#if N_CHANNEL >= 8
-    + bytes_db_vectors_chan_4 + bytes_db_vectors_chan_5 + bytes_db_vectors_chan_6 + bytes_db_vectors_chan_7
-#endif
-#if N_CHANNEL >= 16
-    + bytes_db_vectors_chan_8 + bytes_db_vectors_chan_9 + bytes_db_vectors_chan_10 + bytes_db_vectors_chan_11
-    + bytes_db_vectors_chan_12 + bytes_db_vectors_chan_13 + bytes_db_vectors_chan_14 + bytes_db_vectors_chan_15
-#endif
-    ;
-    assert(bytes_per_db_vec_plus_padding_plus_visited_padding * num_db_vec == bytes_total_db_vectors);
 
     // input vecs
     std::vector<int, aligned_allocator<int>> entry_point_ids(bytes_entry_point_ids / sizeof(int));
     std::vector<float, aligned_allocator<float>> query_vectors(bytes_query_vectors / sizeof(float));
+    std::vector<float, aligned_allocator<float>> pq_codebook(pq_num_centroids * d_after_padding, 0);
 
-    // db vec
-    std::vector<float, aligned_allocator<float>> db_vectors_chan_0(bytes_db_vectors_chan_0 / sizeof(float));
-#if N_CHANNEL >= 2
-    std::vector<float, aligned_allocator<float>> db_vectors_chan_1(bytes_db_vectors_chan_1 / sizeof(float));
-#endif
-#if N_CHANNEL >= 4
-    std::vector<float, aligned_allocator<float>> db_vectors_chan_2(bytes_db_vectors_chan_2 / sizeof(float));
-    std::vector<float, aligned_allocator<float>> db_vectors_chan_3(bytes_db_vectors_chan_3 / sizeof(float));
-#endif
-#if N_CHANNEL >= 8
-    std::vector<float, aligned_allocator<float>> db_vectors_chan_4(bytes_db_vectors_chan_4 / sizeof(float));
-    std::vector<float, aligned_allocator<float>> db_vectors_chan_5(bytes_db_vectors_chan_5 / sizeof(float));
-    std::vector<float, aligned_allocator<float>> db_vectors_chan_6(bytes_db_vectors_chan_6 / sizeof(float));
-    std::vector<float, aligned_allocator<float>> db_vectors_chan_7(bytes_db_vectors_chan_7 / sizeof(float));
-#endif
-#if N_CHANNEL >= 16
-    std::vector<float, aligned_allocator<float>> db_vectors_chan_8(bytes_db_vectors_chan_8 / sizeof(float));
-    std::vector<float, aligned_allocator<float>> db_vectors_chan_9(bytes_db_vectors_chan_9 / sizeof(float));
-    std::vector<float, aligned_allocator<float>> db_vectors_chan_10(bytes_db_vectors_chan_10 / sizeof(float));
-    std::vector<float, aligned_allocator<float>> db_vectors_chan_11(bytes_db_vectors_chan_11 / sizeof(float));
-    std::vector<float, aligned_allocator<float>> db_vectors_chan_12(bytes_db_vectors_chan_12 / sizeof(float));
-    std::vector<float, aligned_allocator<float>> db_vectors_chan_13(bytes_db_vectors_chan_13 / sizeof(float));
-    std::vector<float, aligned_allocator<float>> db_vectors_chan_14(bytes_db_vectors_chan_14 / sizeof(float));
-    std::vector<float, aligned_allocator<float>> db_vectors_chan_15(bytes_db_vectors_chan_15 / sizeof(float));
-#endif
-    
-    // links
-    std::vector<int, aligned_allocator<int>> links_base_chan_0(bytes_links_base_chan_0 / sizeof(int));
-#if N_CHANNEL >= 2
-    std::vector<int, aligned_allocator<int>> links_base_chan_1(bytes_links_base_chan_1 / sizeof(int));
-#endif
-#if N_CHANNEL >= 4
-    std::vector<int, aligned_allocator<int>> links_base_chan_2(bytes_links_base_chan_2 / sizeof(int));
-    std::vector<int, aligned_allocator<int>> links_base_chan_3(bytes_links_base_chan_3 / sizeof(int));
-#endif
-#if N_CHANNEL >= 8
-    std::vector<int, aligned_allocator<int>> links_base_chan_4(bytes_links_base_chan_4 / sizeof(int));
-    std::vector<int, aligned_allocator<int>> links_base_chan_5(bytes_links_base_chan_5 / sizeof(int));
-    std::vector<int, aligned_allocator<int>> links_base_chan_6(bytes_links_base_chan_6 / sizeof(int));
-    std::vector<int, aligned_allocator<int>> links_base_chan_7(bytes_links_base_chan_7 / sizeof(int));
-#endif
-#if N_CHANNEL >= 16
-    std::vector<int, aligned_allocator<int>> links_base_chan_8(bytes_links_base_chan_8 / sizeof(int));
-    std::vector<int, aligned_allocator<int>> links_base_chan_9(bytes_links_base_chan_9 / sizeof(int));
-    std::vector<int, aligned_allocator<int>> links_base_chan_10(bytes_links_base_chan_10 / sizeof(int));
-    std::vector<int, aligned_allocator<int>> links_base_chan_11(bytes_links_base_chan_11 / sizeof(int));
-    std::vector<int, aligned_allocator<int>> links_base_chan_12(bytes_links_base_chan_12 / sizeof(int));
-    std::vector<int, aligned_allocator<int>> links_base_chan_13(bytes_links_base_chan_13 / sizeof(int));
-    std::vector<int, aligned_allocator<int>> links_base_chan_14(bytes_links_base_chan_14 / sizeof(int));
-    std::vector<int, aligned_allocator<int>> links_base_chan_15(bytes_links_base_chan_15 / sizeof(int));
-#endif
     
     // output
     std::vector<int, aligned_allocator<int>> out_id(bytes_out_id / sizeof(int));
@@ -518,10 +369,6 @@ size_t bytes_db_vectors_chan_0 = GetFileSize(fname_ground_vectors_chan_0);
     std::vector<int, aligned_allocator<int>> mem_debug(bytes_mem_debug / sizeof(int));
 
     // intermediate buffer for queries, and ground truth
-    std::vector<int> labels_base;
-    if (graph_type == "HNSW") {
-        labels_base.resize(bytes_labels_base / sizeof(int));
-    }
 	// init query vectors as zeros (there will be paddings in some cases for unusual d)
     std::vector<char> raw_query_vectors(raw_query_vectors_size / sizeof(char));
 	memset(raw_query_vectors.data(), 0, raw_query_vectors_size);
@@ -533,96 +380,34 @@ size_t bytes_db_vectors_chan_0 = GetFileSize(fname_ground_vectors_chan_0);
     std::vector<float> gt_dist(query_num * max_topK);
 
     // read data from file
-    std::cout << "Reading database vectors from file...\n";
-    fread(db_vectors_chan_0.data(), 1, bytes_db_vectors_chan_0, f_ground_vectors_chan_0);
-    fclose(f_ground_vectors_chan_0);
-#if N_CHANNEL >= 2
-    fread(db_vectors_chan_1.data(), 1, bytes_db_vectors_chan_1, f_ground_vectors_chan_1);
-    fclose(f_ground_vectors_chan_1);
-#endif
-#if N_CHANNEL >= 4
-    fread(db_vectors_chan_2.data(), 1, bytes_db_vectors_chan_2, f_ground_vectors_chan_2);
-    fclose(f_ground_vectors_chan_2);
-    fread(db_vectors_chan_3.data(), 1, bytes_db_vectors_chan_3, f_ground_vectors_chan_3);
-    fclose(f_ground_vectors_chan_3);
-#endif
-#if N_CHANNEL >= 8
-    fread(db_vectors_chan_4.data(), 1, bytes_db_vectors_chan_4, f_ground_vectors_chan_4);
-    fclose(f_ground_vectors_chan_4);
-    fread(db_vectors_chan_5.data(), 1, bytes_db_vectors_chan_5, f_ground_vectors_chan_5);
-    fclose(f_ground_vectors_chan_5);
-    fread(db_vectors_chan_6.data(), 1, bytes_db_vectors_chan_6, f_ground_vectors_chan_6);
-    fclose(f_ground_vectors_chan_6);
-    fread(db_vectors_chan_7.data(), 1, bytes_db_vectors_chan_7, f_ground_vectors_chan_7);
-    fclose(f_ground_vectors_chan_7);
-#endif
-#if N_CHANNEL >= 16
-    fread(db_vectors_chan_8.data(), 1, bytes_db_vectors_chan_8, f_ground_vectors_chan_8);
-    fclose(f_ground_vectors_chan_8);
-    fread(db_vectors_chan_9.data(), 1, bytes_db_vectors_chan_9, f_ground_vectors_chan_9);
-    fclose(f_ground_vectors_chan_9);
-    fread(db_vectors_chan_10.data(), 1, bytes_db_vectors_chan_10, f_ground_vectors_chan_10);
-    fclose(f_ground_vectors_chan_10);
-    fread(db_vectors_chan_11.data(), 1, bytes_db_vectors_chan_11, f_ground_vectors_chan_11);
-    fclose(f_ground_vectors_chan_11);
-    fread(db_vectors_chan_12.data(), 1, bytes_db_vectors_chan_12, f_ground_vectors_chan_12);
-    fclose(f_ground_vectors_chan_12);
-    fread(db_vectors_chan_13.data(), 1, bytes_db_vectors_chan_13, f_ground_vectors_chan_13);
-    fclose(f_ground_vectors_chan_13);
-    fread(db_vectors_chan_14.data(), 1, bytes_db_vectors_chan_14, f_ground_vectors_chan_14);
-    fclose(f_ground_vectors_chan_14);
-    fread(db_vectors_chan_15.data(), 1, bytes_db_vectors_chan_15, f_ground_vectors_chan_15);
-    fclose(f_ground_vectors_chan_15);
-#endif
-
-
-    std::cout << "Reading base links from file...\n";
-    fread(links_base_chan_0.data(), 1, bytes_links_base_chan_0, f_ground_links_chan_0);
-    fclose(f_ground_links_chan_0);
-#if N_CHANNEL >= 2
-    fread(links_base_chan_1.data(), 1, bytes_links_base_chan_1, f_ground_links_chan_1);
-    fclose(f_ground_links_chan_1);
-#endif
-#if N_CHANNEL >= 4
-    fread(links_base_chan_2.data(), 1, bytes_links_base_chan_2, f_ground_links_chan_2);
-    fclose(f_ground_links_chan_2);
-    fread(links_base_chan_3.data(), 1, bytes_links_base_chan_3, f_ground_links_chan_3);
-    fclose(f_ground_links_chan_3);
-#endif
-#if N_CHANNEL >= 8
-    fread(links_base_chan_4.data(), 1, bytes_links_base_chan_4, f_ground_links_chan_4);
-    fclose(f_ground_links_chan_4);
-    fread(links_base_chan_5.data(), 1, bytes_links_base_chan_5, f_ground_links_chan_5);
-    fclose(f_ground_links_chan_5);
-    fread(links_base_chan_6.data(), 1, bytes_links_base_chan_6, f_ground_links_chan_6);
-    fclose(f_ground_links_chan_6);
-    fread(links_base_chan_7.data(), 1, bytes_links_base_chan_7, f_ground_links_chan_7);
-    fclose(f_ground_links_chan_7);
-#endif
-#if N_CHANNEL >= 16
-    fread(links_base_chan_8.data(), 1, bytes_links_base_chan_8, f_ground_links_chan_8);
-    fclose(f_ground_links_chan_8);
-    fread(links_base_chan_9.data(), 1, bytes_links_base_chan_9, f_ground_links_chan_9);
-    fclose(f_ground_links_chan_9);
-    fread(links_base_chan_10.data(), 1, bytes_links_base_chan_10, f_ground_links_chan_10);
-    fclose(f_ground_links_chan_10);
-    fread(links_base_chan_11.data(), 1, bytes_links_base_chan_11, f_ground_links_chan_11);
-    fclose(f_ground_links_chan_11);
-    fread(links_base_chan_12.data(), 1, bytes_links_base_chan_12, f_ground_links_chan_12);
-    fclose(f_ground_links_chan_12);
-    fread(links_base_chan_13.data(), 1, bytes_links_base_chan_13, f_ground_links_chan_13);
-    fclose(f_ground_links_chan_13);
-    fread(links_base_chan_14.data(), 1, bytes_links_base_chan_14, f_ground_links_chan_14);
-    fclose(f_ground_links_chan_14);
-    fread(links_base_chan_15.data(), 1, bytes_links_base_chan_15, f_ground_links_chan_15);
-    fclose(f_ground_links_chan_15);
-#endif
+    std::cout << "Loading database vectors and base links (" << index_load_mode << ")...\n";
+    auto start_load = std::chrono::high_resolution_clock::now();
+    IndexLoader index_loader(/* populate */ index_load_mode != "mmap", /* huge_pages */ index_load_mode == "huge_pages");
+    index_loader.load(fnames_ground_vectors, fnames_ground_links);
+    auto end_load = std::chrono::high_resolution_clock::now();
+    std::cout << "Index loading time: " << 
+        std::chrono::duration_cast<std::chrono::milliseconds>(end_load - start_load).count() << " ms" << std::endl;
+    for (int c = 0; c < N_CHANNEL; c++) {
+        std::cout << "bytes_db_vectors_chan_" << c << "=" << index_loader.db_vectors[c].bytes << 
+            "\tbytes_links_base_chan_" << c << "=" << index_loader.links_base[c].bytes << std::endl;
+    }
+    assert(bytes_per_db_vec_in_index * num_db_vec == index_loader.total_db_vectors_bytes());
+
+    UpperLayerSearch upper_layer_search(num_db_vec, max_level, entry_point_id, max_link_num_upper);
+    bool use_upper_layers = false;
+    if (graph_type == "HNSW" && entry_point_mode == "upper_layers") {
+#if VECTOR_TYPE == VECTOR_TYPE_FP32 && !defined(CHANNEL_PLACEMENT_BALANCED)
+        std::vector<const char*> db_vectors_per_channel;
+        for (int c = 0; c < N_CHANNEL; c++) { db_vectors_per_channel.push_back((const char*) index_loader.db_vectors[c].ptr); }
+        use_upper_layers = upper_layer_search.load(index_dir, db_vectors_per_channel, bytes_per_db_vec_in_index, d);
+#endif
+        if (!use_upper_layers) {
+            std::cout << "No upper layers found (or not fp32 / round-robin placement), " << 
+                "using the entry point of meta.bin for all queries" << std::endl;
+        }
+    }
 
     std::cout << "Reading queries and ground truths from file...\n";
-    if (graph_type == "HNSW") {
-        fread(labels_base.data(), 1, bytes_labels_base, f_ground_labels);
-        fclose(f_ground_labels);
-    }
     fread(raw_query_vectors.data(), 1, raw_query_vectors_size, f_query_vectors);
     fclose(f_query_vectors);
     fread(raw_gt_vec_ID.data(), 1, raw_gt_vec_ID_size, f_gt_vec_ID);
@@ -707,6 +492,45 @@ size_t bytes_db_vectors_chan_0 = GetFileSize(fname_ground_vectors_chan_0);
         exit(1);
     }
 
+    std::vector<float> scale_offset; // int8 only
+#if VECTOR_TYPE == VECTOR_TYPE_INT8
+    // int8 vectors: x[d] = scale[d] * code[d] + offset[d], send (q[d] - offset[d]) / scale[d] followed by
+    //   the weights scale[d]^2 per query; the queries are expanded in place from the last one
+    {
+        std::string fname_quantization = concat_dir(index_dir, "vector_quantization.bin");
+        if (GetFileSize(fname_quantization) != (long) (2 * d * sizeof(float))) {
+            std::cout << "VECTOR_TYPE_INT8 requires " << fname_quantization << std::endl;
+            exit(1);
+        }
+        scale_offset.resize(2 * d);
+        FILE* f_quantization = fopen(fname_quantization.c_str(), "rb");
+        fread(scale_offset.data(), sizeof(float), 2 * d, f_quantization);
+        fclose(f_quantization);
+        std::vector<float> q(d);
+        for (int qid = query_num_after_offset - 1; qid >= 0; qid--) {
+            memcpy(q.data(), &query_vectors[qid * d_after_padding], d * sizeof(float));
+            float* out = &query_vectors[qid * 2 * d_after_padding];
+            memset(out, 0, 2 * d_after_padding * sizeof(float));
+            for (int i = 0; i < d; i++) {
+                out[i] = (q[i] - scale_offset[d + i]) / scale_offset[i];
+                out[d_after_padding + i] = scale_offset[i] * scale_offset[i];
+            }
+        }
+    }
+#endif
+
+    // the centroids are transformed like the queries for int8, such that the weights apply to both
+    for (int k = 0; k < pq_num_centroids && neighbor_codes == NEIGHBOR_CODES_PQ; k++) {
+        for (int i = 0; i < PQ_M * pq_sub_dim_in_file && i < d_after_padding; i++) {
+            int m = i / pq_sub_dim_in_file;
+            float c = pq_centroids[(m * pq_num_centroids + k) * pq_sub_dim_in_file + i % pq_sub_dim_in_file];
+            if (!scale_offset.empty() && i < d) {
+                c = (c - scale_offset[d + i]) / scale_offset[i];
+            }
+            pq_codebook[k * d_after_padding + i] = c;
+        }
+    }
+
     for (int qid = 0; qid < query_num_after_offset; qid++) {
         entry_point_ids[qid] = entry_point_id;
     }
@@ -745,93 +569,23 @@ size_t bytes_db_vectors_chan_0 = GetFileSize(fname_ground_vectors_chan_0);
             bytes_entry_point_ids, entry_point_ids.data(), &err));
     OCL_CHECK(err, cl::Buffer buffer_query_vectors (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
             bytes_query_vectors, query_vectors.data(), &err));
+    OCL_CHECK(err, cl::Buffer buffer_hot_node_ids (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
+            hot_node_ids.size() * sizeof(int), hot_node_ids.data(), &err));
+    OCL_CHECK(err, cl::Buffer buffer_pq_codebook (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
+            pq_codebook.size() * sizeof(float), pq_codebook.data(), &err));
             
-    OCL_CHECK(err, cl::Buffer buffer_links_base_chan_0 (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
-        bytes_links_base_chan_0, links_base_chan_0.data(), &err));
-
-#if N_CHANNEL >= 2
-    OCL_CHECK(err, cl::Buffer buffer_links_base_chan_1 (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
-        bytes_links_base_chan_1, links_base_chan_1.data(), &err));
-#endif
-
-#if N_CHANNEL >= 4
-    OCL_CHECK(err, cl::Buffer buffer_links_base_chan_2 (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
-        bytes_links_base_chan_2, links_base_chan_2.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_links_base_chan_3 (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
-        bytes_links_base_chan_3, links_base_chan_3.data(), &err));
-#endif
-
-#if N_CHANNEL >= 8
-    OCL_CHECK(err, cl::Buffer buffer_links_base_chan_4 (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
-        bytes_links_base_chan_4, links_base_chan_4.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_links_base_chan_5 (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
-        bytes_links_base_chan_5, links_base_chan_5.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_links_base_chan_6 (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
-        bytes_links_base_chan_6, links_base_chan_6.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_links_base_chan_7 (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
-        bytes_links_base_chan_7, links_base_chan_7.data(), &err));
-#endif
-
-#if N_CHANNEL >= 16
-    OCL_CHECK(err, cl::Buffer buffer_links_base_chan_8 (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
-        bytes_links_base_chan_8, links_base_chan_8.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_links_base_chan_9 (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
-        bytes_links_base_chan_9, links_base_chan_9.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_links_base_chan_10 (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
-        bytes_links_base_chan_10, links_base_chan_10.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_links_base_chan_11 (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
-        bytes_links_base_chan_11, links_base_chan_11.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_links_base_chan_12 (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
-        bytes_links_base_chan_12, links_base_chan_12.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_links_base_chan_13 (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
-        bytes_links_base_chan_13, links_base_chan_13.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_links_base_chan_14 (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
-        bytes_links_base_chan_14, links_base_chan_14.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_links_base_chan_15 (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
-        bytes_links_base_chan_15, links_base_chan_15.data(), &err));
-#endif
+    std::vector<cl::Buffer> buffer_links_base(N_CHANNEL);
+    for (int c = 0; c < N_CHANNEL; c++) {
+        OCL_CHECK(err, buffer_links_base[c] = cl::Buffer(context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
+            index_loader.links_base[c].bytes, index_loader.links_base[c].ptr, &err));
+    }
 
     // in & out (db vec is mixed with visited list)
-    OCL_CHECK(err, cl::Buffer buffer_db_vectors_chan_0 (context,CL_MEM_USE_HOST_PTR,	
-            bytes_db_vectors_chan_0, db_vectors_chan_0.data(), &err));
-#if N_CHANNEL >= 2
-    OCL_CHECK(err, cl::Buffer buffer_db_vectors_chan_1 (context,CL_MEM_USE_HOST_PTR,	
-            bytes_db_vectors_chan_1, db_vectors_chan_1.data(), &err));
-#endif
-#if N_CHANNEL >= 4
-    OCL_CHECK(err, cl::Buffer buffer_db_vectors_chan_2 (context,CL_MEM_USE_HOST_PTR,	
-            bytes_db_vectors_chan_2, db_vectors_chan_2.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_db_vectors_chan_3 (context,CL_MEM_USE_HOST_PTR,	
-            bytes_db_vectors_chan_3, db_vectors_chan_3.data(), &err));
-#endif
-#if N_CHANNEL >= 8
-    OCL_CHECK(err, cl::Buffer buffer_db_vectors_chan_4 (context,CL_MEM_USE_HOST_PTR,	
-            bytes_db_vectors_chan_4, db_vectors_chan_4.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_db_vectors_chan_5 (context,CL_MEM_USE_HOST_PTR,	
-            bytes_db_vectors_chan_5, db_vectors_chan_5.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_db_vectors_chan_6 (context,CL_MEM_USE_HOST_PTR,	
-            bytes_db_vectors_chan_6, db_vectors_chan_6.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_db_vectors_chan_7 (context,CL_MEM_USE_HOST_PTR,	
-            bytes_db_vectors_chan_7, db_vectors_chan_7.data(), &err));
-#endif
-#if N_CHANNEL >= 16
-    OCL_CHECK(err, cl::Buffer buffer_db_vectors_chan_8 (context,CL_MEM_USE_HOST_PTR,	
-            bytes_db_vectors_chan_8, db_vectors_chan_8.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_db_vectors_chan_9 (context,CL_MEM_USE_HOST_PTR,	
-            bytes_db_vectors_chan_9, db_vectors_chan_9.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_db_vectors_chan_10 (context,CL_MEM_USE_HOST_PTR,	
-            bytes_db_vectors_chan_10, db_vectors_chan_10.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_db_vectors_chan_11 (context,CL_MEM_USE_HOST_PTR,	
-            bytes_db_vectors_chan_11, db_vectors_chan_11.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_db_vectors_chan_12 (context,CL_MEM_USE_HOST_PTR,	
-            bytes_db_vectors_chan_12, db_vectors_chan_12.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_db_vectors_chan_13 (context,CL_MEM_USE_HOST_PTR,	
-            bytes_db_vectors_chan_13, db_vectors_chan_13.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_db_vectors_chan_14 (context,CL_MEM_USE_HOST_PTR,	
-            bytes_db_vectors_chan_14, db_vectors_chan_14.data(), &err));
-    OCL_CHECK(err, cl::Buffer buffer_db_vectors_chan_15 (context,CL_MEM_USE_HOST_PTR,	
-            bytes_db_vectors_chan_15, db_vectors_chan_15.data(), &err));
-#endif
+    std::vector<cl::Buffer> buffer_db_vectors(N_CHANNEL);
+    for (int c = 0; c < N_CHANNEL; c++) {
+        OCL_CHECK(err, buffer_db_vectors[c] = cl::Buffer(context,CL_MEM_USE_HOST_PTR,
+            index_loader.db_vectors[c].bytes, index_loader.db_vectors[c].ptr, &err));
+    }
 
     // out
     OCL_CHECK(err, cl::Buffer buffer_out_id (context,CL_MEM_USE_HOST_PTR,// | CL_MEM_WRITE_ONLY,
@@ -855,121 +609,47 @@ size_t bytes_db_vectors_chan_0 = GetFileSize(fname_ground_vectors_chan_0);
     OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, int(max_bloom_out_burst_size)));
     // OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, int(d)));
     OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, int(max_link_num_base)));
+    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, int(vector_layout)));
+    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, int(link_layout)));
+    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, int(num_prefetch_candidates)));
+    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, int(num_hot_nodes)));
+    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, int(neighbor_codes)));
+    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, float(pq_filter_slack)));
 
     OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_entry_point_ids));
     OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_query_vectors));
+    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_hot_node_ids));
+    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_pq_codebook));
 
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_db_vectors_chan_0));
-#if N_CHANNEL >= 2
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_db_vectors_chan_1));
-#endif
-#if N_CHANNEL >= 4
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_db_vectors_chan_2));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_db_vectors_chan_3));
-#endif
-#if N_CHANNEL >= 8
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_db_vectors_chan_4));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_db_vectors_chan_5));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_db_vectors_chan_6));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_db_vectors_chan_7));
-#endif
-#if N_CHANNEL >= 16
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_db_vectors_chan_8));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_db_vectors_chan_9));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_db_vectors_chan_10));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_db_vectors_chan_11));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_db_vectors_chan_12));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_db_vectors_chan_13));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_db_vectors_chan_14));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_db_vectors_chan_15));
-#endif
-
-
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_links_base_chan_0));
-#if N_CHANNEL >= 2
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_links_base_chan_1));
-#endif
-#if N_CHANNEL >= 4
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_links_base_chan_2));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_links_base_chan_3));
-#endif
-#if N_CHANNEL >= 8
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_links_base_chan_4));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_links_base_chan_5));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_links_base_chan_6));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_links_base_chan_7));
-#endif
-#if N_CHANNEL >= 16
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_links_base_chan_8));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_links_base_chan_9));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_links_base_chan_10));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_links_base_chan_11));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_links_base_chan_12));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_links_base_chan_13));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_links_base_chan_14));
-    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_links_base_chan_15));
-#endif
+    for (int c = 0; c < N_CHANNEL; c++) {
+        OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_db_vectors[c]));
+    }
+    for (int c = 0; c < N_CHANNEL; c++) {
+        OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_links_base[c]));
+    }
 
     OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_out_id));
     OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_out_dist));
     OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_mem_debug));
 
-    // Copy input data to device global memory
-    OCL_CHECK(err, err = q.enqueueMigrateMemObjects({
-        // in
-        buffer_entry_point_ids,
-        buffer_query_vectors,
-        buffer_links_base_chan_0,
-#if N_CHANNEL >= 2
-        buffer_links_base_chan_1,
-#endif
-#if N_CHANNEL >= 4
-        buffer_links_base_chan_2,
-        buffer_links_base_chan_3,
-#endif
-#if N_CHANNEL >= 8
-        buffer_links_base_chan_4,
-        buffer_links_base_chan_5,
-        buffer_links_base_chan_6,
-        buffer_links_base_chan_7,
-#endif
-#if N_CHANNEL >= 16
-        buffer_links_base_chan_8,
-        buffer_links_base_chan_9,
-        buffer_links_base_chan_10,
-        buffer_links_base_chan_11,
-        buffer_links_base_chan_12,
-        buffer_links_base_chan_13,
-        buffer_links_base_chan_14,
-        buffer_links_base_chan_15,
-#endif
-        // in & out
-
-        buffer_db_vectors_chan_0
-#if N_CHANNEL >= 2
-        , buffer_db_vectors_chan_1
-#endif
-#if N_CHANNEL >= 4
-        , buffer_db_vectors_chan_2,
-        buffer_db_vectors_chan_3
-#endif
-#if N_CHANNEL >= 8
-        , buffer_db_vectors_chan_4,
-        buffer_db_vectors_chan_5,
-        buffer_db_vectors_chan_6,
-        buffer_db_vectors_chan_7
-#endif
-#if N_CHANNEL >= 16
-        , buffer_db_vectors_chan_8,
-        buffer_db_vectors_chan_9,
-        buffer_db_vectors_chan_10,
-        buffer_db_vectors_chan_11,
-        buffer_db_vectors_chan_12,
-        buffer_db_vectors_chan_13,
-        buffer_db_vectors_chan_14,
-        buffer_db_vectors_chan_15
-#endif
-        },0/* 0 means from host*/));
+    // Copy input data to device global memory; the entry points are migrated last, as they are 
+    //   computed on the host while the index is migrated
+    std::vector<cl::Memory> buffers_in = {buffer_query_vectors, buffer_hot_node_ids, buffer_pq_codebook};
+    buffers_in.insert(buffers_in.end(), buffer_links_base.begin(), buffer_links_base.end());
+    // in & out
+    buffers_in.insert(buffers_in.end(), buffer_db_vectors.begin(), buffer_db_vectors.end());
+    OCL_CHECK(err, err = q.enqueueMigrateMemObjects(buffers_in, 0/* 0 means from host*/));
+    OCL_CHECK(err, err = q.flush());
+
+    if (use_upper_layers) {
+        auto start_upper = std::chrono::high_resolution_clock::now();
+        upper_layer_search.search(query_vectors.data(), query_num_after_offset, d_after_padding, entry_point_ids.data());
+        auto end_upper = std::chrono::high_resolution_clock::now();
+        std::cout << "Upper layer search (overlapped with the index migration): " << 
+            std::chrono::duration_cast<std::chrono::milliseconds>(end_upper - start_upper).count() << " ms, " <<
+            "average #hops on upper layers=" << upper_layer_search.average_hops << std::endl;
+    }
+    OCL_CHECK(err, err = q.enqueueMigrateMemObjects({buffer_entry_point_ids}, 0/* 0 means from host*/));
 
     std::cout << "Launching kernel...\n";
     // Launch the Kernel
@@ -987,11 +667,7 @@ size_t bytes_db_vectors_chan_0 = GetFileSize(fname_ground_vectors_chan_0);
     std::cout << "Duration (including memcpy out): " << duration << " sec" << std::endl; 
 
     // Translate physical node IDs to real label IDs
-    if (graph_type == "HNSW") {
-        for (int i = 0; i < query_num * ef; i++) {
-            out_id[i] = labels_base[out_id[i]];
-        }
-    }
+    result_labels.translate(out_id.data(), query_num * ef);
 
 #ifdef DEBUG
     // print out the debug signals (each 4 byte):
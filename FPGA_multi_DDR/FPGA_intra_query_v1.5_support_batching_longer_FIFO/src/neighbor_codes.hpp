@@ -0,0 +1,126 @@
+#pragma once
+
+#include "types.hpp"
+#include "utils.hpp"
+
+// Per query lookup tables of the neighbor codes (NEIGHBOR_CODES_PQ in constants.hpp):
+//   lut[k][m] = sum of weight[d] * (q[d] - centroid_k[d])^2 over the dimensions d of subspace m,
+//   sent as one 512-bit word per centroid k (the PQ_M floats of the subspaces) to split_tasks_to_channels.
+//   The weights are the int8 scales of the query (constants.hpp), 1 otherwise.
+void compute_pq_lookup_tables(
+	// in initialization
+	const int neighbor_codes,
+
+	// in streams
+	hls::stream<int>& s_query_batch_size, // -1: stop
+	hls::stream<ap_uint<512>>& s_pq_codebook, // pq_num_centroids * query_vec_AXI_num words at kernel start
+	hls::stream<ap_uint<512>>& s_query_vectors,
+
+	// out streams
+	hls::stream<ap_uint<512>>& s_pq_lookup_tables
+) {
+
+	bool first_s_query_batch_size = true;
+
+	ap_uint<512> codebook[pq_num_centroids * query_vec_AXI_num];
+#pragma HLS bind_storage variable=codebook type=RAM_2P impl=BRAM
+
+	const int query_elem_num = query_vec_AXI_num * FLOAT_PER_AXI;
+	float query[query_elem_num];
+#pragma HLS array_partition variable=query cyclic factor=float_per_axi
+	float query_weights[query_elem_num];
+#pragma HLS array_partition variable=query_weights cyclic factor=float_per_axi
+
+	float lut[pq_num_centroids][PQ_M];
+#pragma HLS array_partition variable=lut dim=2 complete
+
+	if (neighbor_codes == NEIGHBOR_CODES_PQ) {
+		for (int i = 0; i < pq_num_centroids * query_vec_AXI_num; i++) {
+		#pragma HLS pipeline II=1
+			codebook[i] = s_pq_codebook.read();
+		}
+	}
+
+	while (true) {
+
+		wait_data_fifo_first_iter<int>(
+			1, s_query_batch_size, first_s_query_batch_size);
+		int query_num = s_query_batch_size.read();
+		if (query_num == -1) {
+			break;
+		}
+		if (neighbor_codes != NEIGHBOR_CODES_PQ) {
+			continue;
+		}
+
+		for (int qid = 0; qid < query_num; qid++) {
+
+			// read query vector (and the weights for int8)
+			for (int i = 0; i < query_AXI_num; i++) {
+			#pragma HLS pipeline II=1
+				ap_uint<512> query_reg = s_query_vectors.read();
+				int offset = (i % query_vec_AXI_num) * FLOAT_PER_AXI;
+				for (int j = 0; j < FLOAT_PER_AXI; j++) {
+				#pragma HLS unroll
+					ap_uint<32> query_reg_uint32 = query_reg.range(32 * (j + 1) - 1, 32 * j);
+					float query_reg_float = *((float*) (&query_reg_uint32));
+					if (i < query_vec_AXI_num) {
+						query[offset + j] = query_reg_float;
+						query_weights[offset + j] = 1;
+					} else {
+						query_weights[offset + j] = query_reg_float;
+					}
+				}
+			}
+
+			for (int k = 0; k < pq_num_centroids; k++) {
+			#pragma HLS pipeline II=1
+				for (int m = 0; m < PQ_M; m++) {
+				#pragma HLS unroll
+					lut[k][m] = 0;
+				}
+			}
+
+			// word-major, such that consecutive iterations update different centroids
+			for (int w = 0; w < query_vec_AXI_num; w++) {
+				for (int k = 0; k < pq_num_centroids; k++) {
+				#pragma HLS pipeline II=1
+				#pragma HLS dependence variable=lut inter false
+					ap_uint<512> centroid_reg = codebook[k * query_vec_AXI_num + w];
+					float part_dist[FLOAT_PER_AXI];
+#pragma HLS array_partition variable=part_dist complete
+					for (int j = 0; j < FLOAT_PER_AXI; j++) {
+					#pragma HLS unroll
+						ap_uint<32> centroid_reg_uint32 = centroid_reg.range(32 * (j + 1) - 1, 32 * j);
+						float diff = query[w * FLOAT_PER_AXI + j] - *((float*) (&centroid_reg_uint32));
+						part_dist[j] = query_weights[w * FLOAT_PER_AXI + j] * diff * diff;
+					}
+					// the dimensions of a word span up to a few subspaces; the padding dimensions (>= PQ_M * pq_sub_dim) add 0
+					for (int m = 0; m < PQ_M; m++) {
+					#pragma HLS unroll
+						float sum = 0;
+						for (int j = 0; j < FLOAT_PER_AXI; j++) {
+						#pragma HLS unroll
+							if ((w * FLOAT_PER_AXI + j) / pq_sub_dim == m) {
+								sum += part_dist[j];
+							}
+						}
+						lut[k][m] += sum;
+					}
+				}
+			}
+
+			for (int k = 0; k < pq_num_centroids; k++) {
+			#pragma HLS pipeline II=1
+				ap_uint<512> lut_reg = 0;
+				for (int m = 0; m < PQ_M; m++) {
+				#pragma HLS unroll
+					float lut_float = lut[k][m];
+					ap_uint<32> lut_uint32 = *((ap_uint<32>*) (&lut_float));
+					lut_reg.range(32 * (m + 1) - 1, 32 * m) = lut_uint32;
+				}
+				s_pq_lookup_tables.write(lut_reg);
+			}
+		}
+	}
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+// ResultLabels: translate the node IDs returned by the kernel into labels (the IDs of the ground truth).
+//
+// Two index placements (see constants.hpp):
+//   round-robin (default): ground_labels.bin maps node ID -> label; HNSW indexes always have it,
+//     NSG indexes only once reordered (reorder_FPGA_index), otherwise the node IDs are the labels.
+//   CHANNEL_PLACEMENT_BALANCED: the node IDs encode the channel in bits [30 : 31 - channel_addr_bits]
+//     and the position within the channel below; channel_placement_N.bin (balance_FPGA_channels) stores
+//     the N node counts per channel, then the labels of each channel in position order. It already maps
+//     to labels, so ground_labels.bin is not used (and not written by balance_FPGA_channels).
+//
+// Empty result slots (-1) are kept as they are. Missing or inconsistent files exit, as the host does.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+class ResultLabels {
+
+public:
+
+    ResultLabels(std::string index_dir, const std::string& graph_type, int n_channel, int channel_addr_bits,
+        bool balanced_placement) : balanced_placement(balanced_placement), channel_addr_bits(channel_addr_bits) {
+
+        if (index_dir.back() != '/') { index_dir += '/'; }
+
+        if (balanced_placement) {
+            std::string fname = index_dir + "channel_placement_" + std::to_string(n_channel) + ".bin";
+            if (!read_ints(fname, labels) || (int) labels.size() < n_channel) {
+                std::cout << "CHANNEL_PLACEMENT_BALANCED requires " << fname << std::endl;
+                exit(1);
+            }
+            size_t start = n_channel;
+            for (int c = 0; c < n_channel; c++) {
+                channel_start.push_back(start);
+                channel_node_num.push_back(labels[c]);
+                start += labels[c];
+            }
+            if (start != labels.size()) {
+                std::cout << fname << ": the node counts per channel do not match the file size" << std::endl;
+                exit(1);
+            }
+        } else {
+            std::string fname = index_dir + "ground_labels.bin";
+            struct stat stat_buf;
+            if (stat(fname.c_str(), &stat_buf) == 0 && stat_buf.st_size > 0) {
+                if (!read_ints(fname, labels)) {
+                    std::cout << "Failed to read " << fname << std::endl;
+                    exit(1);
+                }
+            } else if (graph_type == "HNSW") {
+                std::cout << "HNSW indexes require " << fname << " (internal ID -> label)" << std::endl;
+                exit(1);
+            }
+        }
+    }
+
+    // ids: e.g., out_id of all queries (query_num x ef)
+    void translate(int* ids, size_t num) const {
+        if (balanced_placement) {
+            const int pos_bits = 31 - channel_addr_bits;
+            const int pos_mask = 0x7fffffff >> channel_addr_bits;
+            for (size_t i = 0; i < num; i++) {
+                if (ids[i] < 0) { continue; } // empty result slot
+                int c = ids[i] >> pos_bits;
+                int pos = ids[i] & pos_mask;
+                if (c >= (int) channel_node_num.size() || pos >= channel_node_num[c]) {
+                    std::cout << "Result node ID " << ids[i] << " (channel " << c << ", position " << pos << ") out of range" << std::endl;
+                    exit(1);
+                }
+                ids[i] = labels[channel_start[c] + pos];
+            }
+        } else if (!labels.empty()) {
+            for (size_t i = 0; i < num; i++) {
+                if (ids[i] < 0) { continue; }
+                if ((size_t) ids[i] >= labels.size()) {
+                    std::cout << "Result node ID " << ids[i] << " out of range of ground_labels.bin" << std::endl;
+                    exit(1);
+                }
+                ids[i] = labels[ids[i]];
+            }
+        }
+    }
+
+private:
+
+    bool balanced_placement;
+    int channel_addr_bits;
+    std::vector<int> labels; // ground_labels.bin, or the whole channel_placement_N.bin
+    std::vector<size_t> channel_start; // balanced: offset of the labels of each channel in labels
+    std::vector<int> channel_node_num;
+
+    static bool read_ints(const std::string& fname, std::vector<int>& out) {
+        struct stat stat_buf;
+        if (stat(fname.c_str(), &stat_buf) != 0 || stat_buf.st_size <= 0 || stat_buf.st_size % sizeof(int) != 0) { return false; }
+        out.resize(stat_buf.st_size / sizeof(int));
+        FILE* f = fopen(fname.c_str(), "rb");
+        if (!f) { return false; }
+        size_t n = fread(out.data(), sizeof(int), out.size(), f);
+        fclose(f);
+        return n == out.size();
+    }
+};
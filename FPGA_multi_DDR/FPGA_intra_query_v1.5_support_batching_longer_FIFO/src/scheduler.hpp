@@ -6,6 +6,7 @@ void task_scheduler(
 	const int candidate_queue_runtime_size,
 	const int max_cand_batch_size, 
 	const int max_async_stage_num,
+	const int runtime_num_prefetch_candidates, // 0 ~ max_prefetch_candidates
 
 	// in streams
 	hls::stream<int>& s_query_batch_size, // -1: stop
@@ -22,13 +23,14 @@ void task_scheduler(
 	// hls::stream<result_t>& s_entry_point_base_level,
 	hls::stream<int>& s_cand_batch_size, 
 	hls::stream<cand_t>& s_top_candidates,
+	hls::stream<int>& s_prefetch_candidates, // hints only, dropped if the FIFO is full
 	hls::stream<int>& s_debug_signals,
 	hls::stream<int>& s_finish_query_out
 ) {
 
 	
 	// similar to hsnwlin function `searchKnn`: https://github.com/nmslib/hnswlib/blob/master/hnswlib/hnswalg.h#L1271
-	const int vec_AXI_num = D % FLOAT_PER_AXI == 0? D / FLOAT_PER_AXI : D / FLOAT_PER_AXI + 1; 
+	const int vec_AXI_num = query_AXI_num; // including the int8 weights
 	bool first_s_query_batch_size = true;
 	bool first_s_query_vectors = true;
 	bool first_s_entry_point_ids = true;
@@ -135,6 +137,18 @@ void task_scheduler(
 							}
 						}
 
+						// hint the next queue heads to fetch_neighbor_ids, which stages their links while waiting for
+						//   the next batch; wrong guesses are simply never used
+						for (int pid = 0; pid < max_prefetch_candidates; pid++) {
+						#pragma HLS unroll
+							if (pid < runtime_num_prefetch_candidates && pid < candidate_queue_runtime_size) {
+								result_t head = candidate_queue.queue[smallest_element_position - pid];
+								if (head.dist <= threshold && head.dist < large_float) {
+									s_prefetch_candidates.write_nb(head.node_id);
+								}
+							}
+						}
+
 						// reset next num batch to receive
 						recv_channels_left = N_CHANNEL;
 
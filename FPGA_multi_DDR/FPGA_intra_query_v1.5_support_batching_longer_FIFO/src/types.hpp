@@ -18,4 +18,34 @@ typedef struct {
 	float dist;
 } result_t;
 
-enum Order { Collect_smallest, Collect_largest };
\ No newline at end of file
+enum Order { Collect_smallest, Collect_largest };
+
+// DRAM channel of a node
+inline ap_uint<8> get_channel_id(ap_uint<32> node_id) {
+#pragma HLS inline
+#if N_CHANNEL == 1
+	return 0;
+#elif defined(CHANNEL_PLACEMENT_BALANCED)
+	return node_id.range(30, 31 - CHANNEL_ADDR_BITS);
+#else
+	return node_id.range(CHANNEL_ADDR_BITS - 1, 0);
+#endif
+}
+
+// position of a node within its DRAM channel
+inline ap_uint<32> get_in_channel_node_id(ap_uint<32> node_id) {
+#pragma HLS inline
+#if N_CHANNEL == 1
+	return node_id;
+#elif defined(CHANNEL_PLACEMENT_BALANCED)
+	return node_id.range(30 - CHANNEL_ADDR_BITS, 0);
+#else
+	return node_id >> CHANNEL_ADDR_BITS;
+#endif
+}
+
+// slot of a node in the hot node caches of its channel
+inline int get_hot_node_slot(ap_uint<32> in_channel_node_id) {
+#pragma HLS inline
+	return in_channel_node_id.range(hot_node_cache_addr_bits - 1, 0);
+}
@@ -393,13 +393,21 @@ void split_s_distances(
 // split bloom-fetch-compute tasks to different channels based on node ids
 //   Merging multiple candidate batches into ONE!
 //   Note: cannot handle case where output per channel of multi-batches > FIFO size
+// With neighbor codes (NEIGHBOR_CODES_PQ), a neighbor is only sent if its approximate distance is within
+//   pq_filter_slack times the largest result known so far (one per batch from results_collection, the latest
+//   one that has arrived is used, large_float before the first); the rest are never fetched nor marked visited.
 void split_tasks_to_channels(
 		const int max_link_num_base,
+		const int link_layout,
+		const int neighbor_codes,
+		const float pq_filter_slack,
 
 		// in streams
 		hls::stream<int>& s_query_batch_size, // -1: stop
 		hls::stream<int>& s_cand_batch_size,
 		hls::stream<ap_uint<512>>& s_neighbor_ids_raw,
+		hls::stream<ap_uint<512>>& s_pq_lookup_tables,
+		hls::stream<float>& s_largest_result_queue_elements,
 		hls::stream<int>& s_finish_query_in,
 
 		// out streams
@@ -411,17 +419,22 @@ void split_tasks_to_channels(
 	bool first_s_query_batch_size = true;
 	bool first_iter_s_num_neighbors_base_level = true;
 	bool first_iter_s_fetched_neighbor_ids = true;
+	bool first_iter_s_pq_lookup_tables = true;
 
 	int node_count_per_channel[N_CHANNEL];
 #pragma HLS array_partition variable=node_count_per_channel complete
 	
-	const int AXI_num_per_base_link = max_link_num_base % INT_PER_AXI == 0? 
+	const int AXI_num_per_base_link_original = max_link_num_base % INT_PER_AXI == 0? 
 		1 + max_link_num_base / INT_PER_AXI : 2 + max_link_num_base / INT_PER_AXI; // 4 = int size, 64 = 512 bit
+	const int first_link_slot = link_layout == LINK_LAYOUT_PACKED? 1 : INT_PER_AXI;
 
-	const int max_buffer_size = 32 + 1; // supporting max of 32 * INT_PER_AXI (16) = 512 edges per node
+	const int max_buffer_size = hardware_link_buffer_AXI_num;
 			ap_uint<512> local_links_buffer[max_buffer_size]; 
 #pragma HLS bind_storage variable=local_links_buffer type=RAM_2P impl=BRAM
 
+	float pq_lut[PQ_M][pq_num_centroids];
+#pragma HLS array_partition variable=pq_lut dim=1 complete
+
 	while (true) {
 
 		wait_data_fifo_first_iter<int>(
@@ -432,14 +445,44 @@ void split_tasks_to_channels(
 		}
 
 		for (int qid = 0; qid < query_num; qid++) {
+
+			if (neighbor_codes == NEIGHBOR_CODES_PQ) {
+				wait_data_fifo_first_iter<ap_uint<512>>(
+					pq_num_centroids, s_pq_lookup_tables, first_iter_s_pq_lookup_tables);
+				for (int k = 0; k < pq_num_centroids; k++) {
+				#pragma HLS pipeline II=1
+					ap_uint<512> lut_reg = s_pq_lookup_tables.read();
+					for (int m = 0; m < PQ_M; m++) {
+					#pragma HLS unroll
+						ap_uint<32> lut_uint32 = lut_reg.range(32 * (m + 1) - 1, 32 * m);
+						pq_lut[m][k] = *((float*) (&lut_uint32));
+					}
+				}
+			}
+			float pq_threshold = large_float;
+			int num_batches = 0;
+			int num_thresholds_read = 0;
+
 			while (true) {
 				// check query finish
 				if (!s_finish_query_in.empty() && s_cand_batch_size.empty()
 					&& s_neighbor_ids_raw.empty()) {
+					// one largest result per batch, the ones not used yet must be consumed
+					for (int i = num_thresholds_read; i < num_batches; i++) {
+						s_largest_result_queue_elements.read();
+					}
 					s_finish_query_out.write(s_finish_query_in.read());
 					break;
 				} else if (!s_cand_batch_size.empty()) {
 
+					// the latest largest result of the previous batches
+					while (!s_largest_result_queue_elements.empty()) {
+						float largest_result_queue_elements = s_largest_result_queue_elements.read();
+						pq_threshold = pq_filter_slack * largest_result_queue_elements;
+						num_thresholds_read++;
+					}
+					num_batches++;
+
 					// reset counters
 					for (int i = 0; i < N_CHANNEL; i++) {
 					#pragma HLS UNROLL
@@ -453,30 +496,47 @@ void split_tasks_to_channels(
 
 					// each round can contain multiple batches
 					for (int bid = 0; bid < cand_batch_size; bid++) {
-						for (int i = 0; i < AXI_num_per_base_link; i++) {
+						// the number of words per node follows fetch_neighbor_ids
+						local_links_buffer[0] = s_neighbor_ids_raw.read();
+						ap_uint<32> links_num_ap = local_links_buffer[0].range(31, 0);
+						int num_links = links_num_ap;
+						num_links = num_links < max_link_num_base? num_links : max_link_num_base;
+						int link_AXI_num = link_layout == LINK_LAYOUT_PACKED? 
+							1 + num_links / INT_PER_AXI : AXI_num_per_base_link_original;
+						int AXI_num_per_base_link = link_AXI_num + (neighbor_codes == NEIGHBOR_CODES_PQ? 
+							(num_links + pq_codes_per_AXI - 1) / pq_codes_per_AXI : 0);
+						for (int i = 1; i < AXI_num_per_base_link; i++) {
 						#pragma HLS pipeline II=1
 							ap_uint<512> reg = s_neighbor_ids_raw.read();
 							local_links_buffer[i] = reg;
 						}
 
-						ap_uint<32> links_num_ap = local_links_buffer[0].range(31, 0);
-						int num_links = links_num_ap;
-
 						// process each node's laber
-						for (int i = 0; i < AXI_num_per_base_link - 1; i++) { // first one is the num_links
-							for (int j = 0; j < INT_PER_AXI && i * INT_PER_AXI + j < num_links; j++) {
-							#pragma HLS pipeline II=1
-								ap_uint<32> link_ap = local_links_buffer[i + 1].range(32 * (j + 1) - 1, 32 * j);
-								int link = link_ap;
+						for (int i = 0; i < num_links; i++) { // the links start after num_links
+						#pragma HLS pipeline II=1
+							int slot = first_link_slot + i;
+							int j = slot % INT_PER_AXI;
+							ap_uint<32> link_ap = local_links_buffer[slot / INT_PER_AXI].range(32 * (j + 1) - 1, 32 * j);
+							int link = link_ap;
+							bool pass = true;
+							if (neighbor_codes == NEIGHBOR_CODES_PQ) {
+								// the code of link i: PQ_M bytes, the codes of a word do not cross it
+								ap_uint<512> code_reg = local_links_buffer[link_AXI_num + i / pq_codes_per_AXI];
+								int code_offset = 8 * PQ_M * (i % pq_codes_per_AXI);
+								float approx_dist = 0;
+								for (int m = 0; m < PQ_M; m++) {
+								#pragma HLS unroll
+									ap_uint<8> code = code_reg.range(code_offset + 8 * m + 7, code_offset + 8 * m);
+									approx_dist += pq_lut[m][code];
+								}
+								pass = approx_dist <= pq_threshold;
+							}
+							if (pass) {
 								cand_t fetched_neighbor_ids;
 								fetched_neighbor_ids.node_id = link;
 								fetched_neighbor_ids.level_id = 0; // hard-code to 0, support only base layer
 								ap_uint<32> node_id_ap = link;
-#if N_CHANNEL == 1
-								ap_uint<8> channel_id = 0;
-#else
-								ap_uint<8> channel_id = node_id_ap.range(CHANNEL_ADDR_BITS - 1, 0);
-#endif
+								ap_uint<8> channel_id = get_channel_id(node_id_ap);
 								s_fetched_neighbor_ids_per_channel[channel_id].write(fetched_neighbor_ids);
 								node_count_per_channel[channel_id]++;
 							}
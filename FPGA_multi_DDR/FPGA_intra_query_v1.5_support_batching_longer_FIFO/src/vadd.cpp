@@ -3,6 +3,7 @@
 #include "compute.hpp"
 #include "constants.hpp"
 #include "DRAM_utils.hpp"
+#include "neighbor_codes.hpp"
 #include "scheduler.hpp"
 #include "types.hpp"
 #include "utils.hpp"
@@ -21,10 +22,18 @@ void vadd(
 	const ap_uint<32> hash_seed,
 	const int max_bloom_out_burst_size,
 	const int max_link_num_base,
+	const int vector_layout, // VECTOR_LAYOUT_PADDED / VECTOR_LAYOUT_COMPACT (meta.bin)
+	const int link_layout, // LINK_LAYOUT_ORIGINAL / LINK_LAYOUT_PACKED (meta.bin)
+	const int runtime_num_prefetch_candidates, // 0 (off) ~ max_prefetch_candidates
+	const int runtime_num_hot_nodes, // 0 ~ N_CHANNEL * hardware_hot_nodes_per_channel
+	const int neighbor_codes, // NEIGHBOR_CODES_NONE / NEIGHBOR_CODES_PQ (meta.bin)
+	const float pq_filter_slack, // neighbors within pq_filter_slack x the largest result are evaluated
 
     // in runtime (from DRAM)
 	const int* entry_point_ids,
 	const ap_uint<512>* query_vectors,
+	const int* hot_node_ids,
+	const ap_uint<512>* pq_codebook, // pq_num_centroids * query_vec_AXI_num words, NEIGHBOR_CODES_PQ only
     ap_uint<512>* db_vectors_chan_0, 
 #if N_CHANNEL >= 2
 	ap_uint<512>* db_vectors_chan_1,
@@ -94,6 +103,8 @@ void vadd(
 // in runtime (from DRAM)
 #pragma HLS INTERFACE m_axi port=entry_point_ids latency=32 num_read_outstanding=4 max_read_burst_length=16  num_write_outstanding=1 max_write_burst_length=2  offset=slave bundle=gmem0
 #pragma HLS INTERFACE m_axi port=query_vectors latency=32 num_read_outstanding=4 max_read_burst_length=16  num_write_outstanding=1 max_write_burst_length=2  offset=slave bundle=gmem0
+#pragma HLS INTERFACE m_axi port=hot_node_ids latency=32 num_read_outstanding=4 max_read_burst_length=16  num_write_outstanding=1 max_write_burst_length=2  offset=slave bundle=gmem0
+#pragma HLS INTERFACE m_axi port=pq_codebook latency=32 num_read_outstanding=4 max_read_burst_length=16  num_write_outstanding=1 max_write_burst_length=2  offset=slave bundle=gmem0
 #pragma HLS INTERFACE m_axi port=mem_debug latency=32 num_read_outstanding=1 max_read_burst_length=2  num_write_outstanding=8 max_write_burst_length=16 offset=slave bundle=gmem10 // cannot share gmem with out as they are different PEs
 
 // If the port is a read-only port, then set the num_write_outstanding=1 and max_write_burst_length=2 to conserve memory resources. For write-only ports, set the num_read_outstanding=1 and max_read_burst_length=2.
@@ -168,6 +179,21 @@ void vadd(
 	hls::stream<int> s_finish_batch;
 #pragma HLS stream variable=s_finish_batch depth=depth_control
 
+	hls::stream<int> s_hot_node_ids; // hot node list, for the link cache
+#pragma HLS stream variable=s_hot_node_ids depth=depth_control
+
+	hls::stream<int> s_hot_node_ids_per_channel[N_CHANNEL]; // hot node list, for the vector caches
+#pragma HLS stream variable=s_hot_node_ids_per_channel depth=depth_control
+
+	hls::stream<ap_uint<512>> s_pq_codebook; // at kernel start, for the lookup tables of the neighbor codes
+#pragma HLS stream variable=s_pq_codebook depth=depth_query_vectors
+
+	hls::stream<ap_uint<512>> s_query_vectors_pq; // for the lookup tables of the neighbor codes
+#pragma HLS stream variable=s_query_vectors_pq depth=depth_query_vectors
+
+	hls::stream<ap_uint<512>> s_pq_lookup_tables;
+#pragma HLS stream variable=s_pq_lookup_tables depth=depth_pq_lookup_tables
+
     hls::stream<int> s_finish_query_task_scheduler; // finish the current query
 #pragma HLS stream variable=s_finish_query_task_scheduler depth=depth_control
 
@@ -186,6 +212,9 @@ void vadd(
     hls::stream<cand_t> s_top_candidates; // current top candidates
 #pragma HLS stream variable=s_top_candidates depth=depth_data
 
+	hls::stream<int> s_prefetch_candidates; // likely next top candidates
+#pragma HLS stream variable=s_prefetch_candidates depth=depth_control
+
 	hls::stream<int> s_num_inserted_candidates;
 #pragma HLS stream variable=s_num_inserted_candidates depth=depth_control
 
@@ -204,7 +233,7 @@ void vadd(
 	hls::stream<int> s_debug_signals;
 #pragma HLS stream variable=s_debug_signals depth=depth_control
 
-	const int rep_factor_s_largest_result_queue_elements = 1 + N_CHANNEL;
+	const int rep_factor_s_largest_result_queue_elements = 2 + N_CHANNEL; // scheduler, filters, split_tasks_to_channels
 	hls::stream<float> s_largest_result_queue_elements_replicated[rep_factor_s_largest_result_queue_elements];
 #pragma HLS stream variable=s_largest_result_queue_elements_replicated depth=depth_control		
 
@@ -218,20 +247,28 @@ void vadd(
 		// in initialization
 		query_num,
 		query_batch_size,
+		runtime_num_hot_nodes,
+		neighbor_codes,
 		// in DRAM
 		entry_point_ids,
 		query_vectors,
+		hot_node_ids,
+		pq_codebook,
 		// in stream
 		s_finish_batch,
 
 		// out streams
 		s_query_batch_size,
 		s_query_vectors_in,
-		s_entry_point_ids
+		s_entry_point_ids,
+		s_hot_node_ids,
+		s_hot_node_ids_per_channel,
+		s_pq_codebook,
+		s_query_vectors_pq
 	);
 
 	// replicate s_query_batch_size to multiple streams
-	const int replicate_factor_s_query_batch_size = 2 * N_CHANNEL + 9;
+	const int replicate_factor_s_query_batch_size = 2 * N_CHANNEL + 10;
 	hls::stream<int> s_query_batch_size_replicated[replicate_factor_s_query_batch_size];
 #pragma HLS stream variable=s_query_batch_size_replicated depth=depth_control
 
@@ -245,6 +282,7 @@ void vadd(
 		candidate_queue_runtime_size,
 		max_cand_batch_size,
 		max_async_stage_num,
+		runtime_num_prefetch_candidates,
 
 		// in streams
 		s_query_batch_size_replicated[0],
@@ -261,6 +299,7 @@ void vadd(
 		// s_entry_point_base_level,
 		s_cand_batch_size,
 		s_top_candidates,
+		s_prefetch_candidates,
 		s_debug_signals,
 		s_finish_query_task_scheduler
 	);
@@ -275,8 +314,22 @@ void vadd(
     hls::stream<int> s_finish_query_fetch_neighbor_ids; // finish all queries
 #pragma HLS stream variable=s_finish_query_fetch_neighbor_ids depth=depth_control
 
+	compute_pq_lookup_tables(
+		neighbor_codes,
+
+		// in streams
+		s_query_batch_size_replicated[2 * N_CHANNEL + 9],
+		s_pq_codebook,
+		s_query_vectors_pq,
+
+		// out streams
+		s_pq_lookup_tables
+	);
+
 	fetch_neighbor_ids(
 		max_link_num_base,
+		link_layout,
+		neighbor_codes,
 		// in runtime (should from DRAM)
     	links_base_chan_0,
 #if N_CHANNEL >= 2
@@ -305,6 +358,8 @@ void vadd(
 		// in runtime (stream)
 		s_query_batch_size_replicated[1],
 		s_top_candidates,
+		s_prefetch_candidates,
+		s_hot_node_ids,
 		s_finish_query_task_scheduler,
 
 		// out (stream)
@@ -323,11 +378,16 @@ void vadd(
 
 	split_tasks_to_channels(
 		max_link_num_base,
+		link_layout,
+		neighbor_codes,
+		pq_filter_slack,
 
 		// in streams
 		s_query_batch_size_replicated[2],
 		s_cand_batch_size,
 		s_neighbor_ids_raw,
+		s_pq_lookup_tables,
+		s_largest_result_queue_elements_replicated[1 + N_CHANNEL],
 		s_finish_query_fetch_neighbor_ids,
 
 		// out streams
@@ -363,6 +423,7 @@ void vadd(
 		runtime_n_bucket_addr_bits,
 		hash_seed,
 		max_bloom_out_burst_size,
+		vector_layout,
 
 		// in runtime (from DRAM)
 		db_vectors_chan_0,
@@ -372,6 +433,7 @@ void vadd(
 		s_query_vectors_replicated[0],
 		s_num_neighbors_base_level_per_channel[0],
 		s_fetched_neighbor_ids_per_channel[0],
+		s_hot_node_ids_per_channel[0],
 		s_finish_query_split_tasks_to_channels_replicated[0],
 
 		// out streams
@@ -385,6 +447,7 @@ void vadd(
 		runtime_n_bucket_addr_bits,
 		hash_seed,
 		max_bloom_out_burst_size,
+		vector_layout,
 
 		// in runtime (from DRAM)
 		db_vectors_chan_1,
@@ -394,6 +457,7 @@ void vadd(
 		s_query_vectors_replicated[1],
 		s_num_neighbors_base_level_per_channel[1],
 		s_fetched_neighbor_ids_per_channel[1],
+		s_hot_node_ids_per_channel[1],
 		s_finish_query_split_tasks_to_channels_replicated[1],
 
 		// out streams
@@ -408,6 +472,7 @@ void vadd(
 		runtime_n_bucket_addr_bits,
 		hash_seed,
 		max_bloom_out_burst_size,
+		vector_layout,
 
 		// in runtime (from DRAM)
 		db_vectors_chan_2,
@@ -417,6 +482,7 @@ void vadd(
 		s_query_vectors_replicated[2],
 		s_num_neighbors_base_level_per_channel[2],
 		s_fetched_neighbor_ids_per_channel[2],
+		s_hot_node_ids_per_channel[2],
 		s_finish_query_split_tasks_to_channels_replicated[2],
 
 		// out streams
@@ -429,6 +495,7 @@ void vadd(
 		runtime_n_bucket_addr_bits,
 		hash_seed,
 		max_bloom_out_burst_size,
+		vector_layout,
 
 		// in runtime (from DRAM)
 		db_vectors_chan_3,
@@ -438,6 +505,7 @@ void vadd(
 		s_query_vectors_replicated[3],
 		s_num_neighbors_base_level_per_channel[3],
 		s_fetched_neighbor_ids_per_channel[3],
+		s_hot_node_ids_per_channel[3],
 		s_finish_query_split_tasks_to_channels_replicated[3],
 
 		// out streams
@@ -452,6 +520,7 @@ void vadd(
 		runtime_n_bucket_addr_bits,
 		hash_seed,
 		max_bloom_out_burst_size,
+		vector_layout,
 		
 		// in runtime (from DRAM)
 		db_vectors_chan_4,
@@ -461,6 +530,7 @@ void vadd(
 		s_query_vectors_replicated[4],
 		s_num_neighbors_base_level_per_channel[4],
 		s_fetched_neighbor_ids_per_channel[4],
+		s_hot_node_ids_per_channel[4],
 		s_finish_query_split_tasks_to_channels_replicated[4],
 
 		// out streams
@@ -474,6 +544,7 @@ void vadd(
 		runtime_n_bucket_addr_bits,
 		hash_seed,
 		max_bloom_out_burst_size,
+		vector_layout,
 
 		// in runtime (from DRAM)
 		db_vectors_chan_5,
@@ -483,6 +554,7 @@ void vadd(
 		s_query_vectors_replicated[5],
 		s_num_neighbors_base_level_per_channel[5],
 		s_fetched_neighbor_ids_per_channel[5],
+		s_hot_node_ids_per_channel[5],
 		s_finish_query_split_tasks_to_channels_replicated[5],
 
 		// out streams
@@ -496,6 +568,7 @@ void vadd(
 		runtime_n_bucket_addr_bits,
 		hash_seed,
 		max_bloom_out_burst_size,
+		vector_layout,
 
 		// in runtime (from DRAM)
 		db_vectors_chan_6,
@@ -505,6 +578,7 @@ void vadd(
 		s_query_vectors_replicated[6],
 		s_num_neighbors_base_level_per_channel[6],
 		s_fetched_neighbor_ids_per_channel[6],
+		s_hot_node_ids_per_channel[6],
 		s_finish_query_split_tasks_to_channels_replicated[6],
 
 		// out streams
@@ -517,6 +591,7 @@ void vadd(
 		runtime_n_bucket_addr_bits,
 		hash_seed,
 		max_bloom_out_burst_size,
+		vector_layout,
 
 		// in runtime (from DRAM)
 		db_vectors_chan_7,
@@ -526,6 +601,7 @@ void vadd(
 		s_query_vectors_replicated[7],
 		s_num_neighbors_base_level_per_channel[7],
 		s_fetched_neighbor_ids_per_channel[7],
+		s_hot_node_ids_per_channel[7],
 		s_finish_query_split_tasks_to_channels_replicated[7],
 
 		// out streams
@@ -540,6 +616,7 @@ void vadd(
 		runtime_n_bucket_addr_bits,
 		hash_seed,
 		max_bloom_out_burst_size,
+		vector_layout,
 
 		// in runtime (from DRAM)
 		db_vectors_chan_8,
@@ -549,6 +626,7 @@ void vadd(
 		s_query_vectors_replicated[8],
 		s_num_neighbors_base_level_per_channel[8],
 		s_fetched_neighbor_ids_per_channel[8],
+		s_hot_node_ids_per_channel[8],
 		s_finish_query_split_tasks_to_channels_replicated[8],
 
 		// out streams
@@ -562,6 +640,7 @@ void vadd(
 		runtime_n_bucket_addr_bits,
 		hash_seed,
 		max_bloom_out_burst_size,
+		vector_layout,
 
 		// in runtime (from DRAM)
 		db_vectors_chan_9,
@@ -571,6 +650,7 @@ void vadd(
 		s_query_vectors_replicated[9],
 		s_num_neighbors_base_level_per_channel[9],
 		s_fetched_neighbor_ids_per_channel[9],
+		s_hot_node_ids_per_channel[9],
 		s_finish_query_split_tasks_to_channels_replicated[9],
 
 		// out streams
@@ -584,6 +664,7 @@ void vadd(
 		runtime_n_bucket_addr_bits,
 		hash_seed,
 		max_bloom_out_burst_size,
+		vector_layout,
 		
 		// in runtime (from DRAM)
 		db_vectors_chan_10,
@@ -593,6 +674,7 @@ void vadd(
 		s_query_vectors_replicated[10],
 		s_num_neighbors_base_level_per_channel[10],
 		s_fetched_neighbor_ids_per_channel[10],
+		s_hot_node_ids_per_channel[10],
 		s_finish_query_split_tasks_to_channels_replicated[10],
 
 		// out streams
@@ -606,6 +688,7 @@ void vadd(
 		runtime_n_bucket_addr_bits,
 		hash_seed,
 		max_bloom_out_burst_size,
+		vector_layout,
 
 		// in runtime (from DRAM)
 		db_vectors_chan_11,
@@ -615,6 +698,7 @@ void vadd(
 		s_query_vectors_replicated[11],
 		s_num_neighbors_base_level_per_channel[11],
 		s_fetched_neighbor_ids_per_channel[11],
+		s_hot_node_ids_per_channel[11],
 		s_finish_query_split_tasks_to_channels_replicated[11],
 
 		// out streams
@@ -628,6 +712,7 @@ void vadd(
 		runtime_n_bucket_addr_bits,
 		hash_seed,
 		max_bloom_out_burst_size,
+		vector_layout,
 
 		// in runtime (from DRAM)
 		db_vectors_chan_12,
@@ -637,6 +722,7 @@ void vadd(
 		s_query_vectors_replicated[12],
 		s_num_neighbors_base_level_per_channel[12],
 		s_fetched_neighbor_ids_per_channel[12],
+		s_hot_node_ids_per_channel[12],
 		s_finish_query_split_tasks_to_channels_replicated[12],
 
 		// out streams
@@ -650,6 +736,7 @@ void vadd(
 		runtime_n_bucket_addr_bits,
 		hash_seed,
 		max_bloom_out_burst_size,
+		vector_layout,
 
 		// in runtime (from DRAM)
 		db_vectors_chan_13,
@@ -659,6 +746,7 @@ void vadd(
 		s_query_vectors_replicated[13],
 		s_num_neighbors_base_level_per_channel[13],
 		s_fetched_neighbor_ids_per_channel[13],
+		s_hot_node_ids_per_channel[13],
 		s_finish_query_split_tasks_to_channels_replicated[13],
 
 		// out streams
@@ -672,6 +760,7 @@ void vadd(
 		runtime_n_bucket_addr_bits,
 		hash_seed,
 		max_bloom_out_burst_size,
+		vector_layout,
 
 		// in runtime (from DRAM)
 		db_vectors_chan_14,
@@ -681,6 +770,7 @@ void vadd(
 		s_query_vectors_replicated[14],
 		s_num_neighbors_base_level_per_channel[14],
 		s_fetched_neighbor_ids_per_channel[14],
+		s_hot_node_ids_per_channel[14],
 		s_finish_query_split_tasks_to_channels_replicated[14],
 
 		// out streams
@@ -694,6 +784,7 @@ void vadd(
 		runtime_n_bucket_addr_bits,
 		hash_seed,
 		max_bloom_out_burst_size,
+		vector_layout,
 
 		// in runtime (from DRAM)
 		db_vectors_chan_15,
@@ -703,6 +794,7 @@ void vadd(
 		s_query_vectors_replicated[15],
 		s_num_neighbors_base_level_per_channel[15],
 		s_fetched_neighbor_ids_per_channel[15],
+		s_hot_node_ids_per_channel[15],
 		s_finish_query_split_tasks_to_channels_replicated[15],
 
 		// out streams
@@ -0,0 +1,485 @@
+#pragma once
+
+#include "types.hpp"
+#include "priority_queue.hpp"
+
+
+void read_queries(
+	// in initialization
+	const int query_num, 
+	const int query_batch_size,
+
+    // in runtime (from DRAM)
+	const int* entry_point_ids,
+	const ap_uint<512>* query_vectors,
+
+	// in streams
+	hls::stream<int>& s_finish_batch,
+
+	// out streams
+	hls::stream<int>& s_query_batch_size,
+	hls::stream<ap_uint<512>>& s_query_vectors_in,
+	hls::stream<int>& s_entry_point_ids
+) {
+
+	const int vec_AXI_num = query_AXI_num; // including the int8 weights
+
+	int remained_query_num = query_num;
+	int processed_query_num = 0;
+
+	// send out queries batch by batch
+	while (remained_query_num > 0) {
+		int current_query_batch_size = remained_query_num > query_batch_size? query_batch_size : remained_query_num;
+		s_query_batch_size.write(current_query_batch_size);
+		for (int i = 0; i < current_query_batch_size; i++) {
+			int qid = processed_query_num + i;
+			for (int j = 0; j < vec_AXI_num; j++) {
+			#pragma HLS pipeline II=1
+				ap_uint<512> query_vector_AXI = query_vectors[qid * vec_AXI_num + j];
+				s_query_vectors_in.write(query_vector_AXI);
+			}
+			s_entry_point_ids.write(entry_point_ids[qid]);
+		}
+		remained_query_num -= query_batch_size;
+		processed_query_num += query_batch_size;
+
+		while (s_finish_batch.empty()) {}
+		int finish_batch = s_finish_batch.read();
+	}
+
+	// write finish all 
+	s_query_batch_size.write(-1);
+}
+
+void write_results(
+	// in initialization
+	const int ef,
+	// in runtime (stream)
+	hls::stream<int>& s_query_batch_size, // -1: stop
+	hls::stream<int>& s_finished_query_ids, // the queries finish in any order
+	hls::stream<int>& s_out_ids,
+	hls::stream<float>& s_out_dists,
+	hls::stream<int>& s_debug_signals,
+
+	// out streams
+	hls::stream<int>& s_finish_batch,
+
+	// out (DRAM)
+    int* out_id,
+	float* out_dist,
+	int* mem_debug
+) {
+
+	bool first_s_query_batch_size = true;
+	bool first_iter_s_finished_query_ids = true;
+	bool first_iter_s_out_ids;
+	bool first_iter_s_out_dists;
+	bool first_iter_s_debug_signals;
+
+	while (true) {
+
+		wait_data_fifo_first_iter<int>(
+			1, s_query_batch_size, first_s_query_batch_size);
+		int query_num = s_query_batch_size.read();
+		if (query_num == -1) {
+			break;
+		}
+
+		int remained_query_num = query_num;
+
+		while (remained_query_num > 0) {
+
+			wait_data_fifo_first_iter<int>(
+				1, s_finished_query_ids, first_iter_s_finished_query_ids);
+			int qid = s_finished_query_ids.read();
+
+			wait_data_fifo_first_iter<int>(
+				ef, s_out_ids, first_iter_s_out_ids);
+			wait_data_fifo_first_iter<float>(
+				ef, s_out_dists, first_iter_s_out_dists);
+
+			// use two loops to infer burst per loop
+			for (int i = 0; i < ef; i++) {
+			#pragma HLS pipeline II=1
+				int start_addr = qid * ef + i;
+				out_id[start_addr] = s_out_ids.read();
+			}
+
+			for (int i = 0; i < ef; i++) {
+			#pragma HLS pipeline II=1
+				int start_addr = qid * ef + i;
+				out_dist[start_addr] = s_out_dists.read();
+			}
+
+			wait_data_fifo_first_iter<int>(
+				debug_size, s_debug_signals, first_iter_s_debug_signals);
+
+			for (int i = 0; i < debug_size; i++) {
+			#pragma HLS pipeline II=1
+				int start_addr = qid * debug_size + i;
+				mem_debug[start_addr] = s_debug_signals.read();
+			}
+			remained_query_num--;
+		}
+		// finish processing this entire batch
+		s_finish_batch.write(1);
+	}
+}
+
+void fetch_neighbor_ids(
+	// in initialization
+	const int max_link_num_base,
+	const int link_layout,
+	const int channel_group_bits,
+	const int index_channel_bits,
+	// in runtime (should from DRAM)
+		const ap_uint<512>* links_base_chan_0,
+#if N_CHANNEL >= 2
+		const ap_uint<512>* links_base_chan_1,
+#endif
+#if N_CHANNEL >= 4
+		const ap_uint<512>* links_base_chan_2,
+		const ap_uint<512>* links_base_chan_3,
+#endif
+#if N_CHANNEL >= 8
+		const ap_uint<512>* links_base_chan_4,
+		const ap_uint<512>* links_base_chan_5,
+		const ap_uint<512>* links_base_chan_6,
+		const ap_uint<512>* links_base_chan_7,
+#endif
+#if N_CHANNEL >= 16
+		const ap_uint<512>* links_base_chan_8,
+		const ap_uint<512>* links_base_chan_9,
+		const ap_uint<512>* links_base_chan_10,
+		const ap_uint<512>* links_base_chan_11,
+		const ap_uint<512>* links_base_chan_12,
+		const ap_uint<512>* links_base_chan_13,
+		const ap_uint<512>* links_base_chan_14,
+		const ap_uint<512>* links_base_chan_15,
+#endif
+	// in runtime (stream)
+	hls::stream<int>& s_query_batch_size, // -1: stop
+	hls::stream<cand_t>& s_top_candidates,
+	hls::stream<int>& s_finish_query_in,
+
+	// out (stream)
+	hls::stream<ap_uint<512>>& s_neighbor_ids_raw,
+	hls::stream<int>& s_finish_query_out
+) {
+
+	const int AXI_num_per_base_link_stride = link_layout == LINK_LAYOUT_PACKED? 
+		1 + max_link_num_base / INT_PER_AXI : // (1 + max_link_num_base) ints, rounded up to 512 bit
+		(max_link_num_base % INT_PER_AXI == 0? 
+		1 + max_link_num_base / INT_PER_AXI : 2 + max_link_num_base / INT_PER_AXI); // 4 = int size, 64 = 512 bit
+	bool first_s_query_batch_size = true;
+
+	const int max_buffer_size = 32 + 1; // supporting max of 32 * INT_PER_AXI (16) = 512 edges per node
+			ap_uint<512> local_links_buffer[max_buffer_size]; 
+#pragma HLS bind_storage variable=local_links_buffer type=RAM_2P impl=BRAM
+	
+	while (true) {
+
+		wait_data_fifo_first_iter<int>(
+			1, s_query_batch_size, first_s_query_batch_size);
+		int query_num = s_query_batch_size.read();
+		if (query_num == -1) {
+			break;
+		}
+
+		// the queries of a batch finish in any order, one finish signal (context ID) each
+		int finished_query_num = 0;
+		while (finished_query_num < query_num) {
+			// check query finish
+			if (!s_finish_query_in.empty()) {
+				s_finish_query_out.write(s_finish_query_in.read());
+				finished_query_num++;
+			} else if (!s_top_candidates.empty()) {
+				// receive task
+				cand_t reg_cand = s_top_candidates.read();
+				int node_id = reg_cand.node_id;
+				ap_uint<32> node_id_ap = node_id;
+				int level_id = reg_cand.level_id;
+				// bool send_node_itself = false;
+
+				ap_uint<8> channel_id = get_channel_id(node_id_ap, reg_cand.ctx_id, channel_group_bits);
+				ap_uint<32> in_channel_node_id = get_in_channel_node_id(node_id_ap, index_channel_bits);
+
+				const ap_uint<512>* links_base_selected_channel;
+				switch (channel_id) {
+					case 0:
+						links_base_selected_channel = links_base_chan_0;
+						break;
+#if N_CHANNEL >= 2
+					case 1:
+						links_base_selected_channel = links_base_chan_1;
+						break;
+#endif
+#if N_CHANNEL >= 4
+					case 2:
+						links_base_selected_channel = links_base_chan_2;
+						break;
+					case 3:
+						links_base_selected_channel = links_base_chan_3;
+						break;
+#endif
+#if N_CHANNEL >= 8
+					case 4:
+						links_base_selected_channel = links_base_chan_4;
+						break;
+					case 5:
+						links_base_selected_channel = links_base_chan_5;
+						break;
+					case 6:
+						links_base_selected_channel = links_base_chan_6;
+						break;
+					case 7:
+						links_base_selected_channel = links_base_chan_7;
+						break;
+#endif
+#if N_CHANNEL >= 16
+					case 8:
+						links_base_selected_channel = links_base_chan_8;
+						break;
+					case 9:
+						links_base_selected_channel = links_base_chan_9;
+						break;
+					case 10:
+						links_base_selected_channel = links_base_chan_10;
+						break;
+					case 11:
+						links_base_selected_channel = links_base_chan_11;
+						break;
+					case 12:
+						links_base_selected_channel = links_base_chan_12;
+						break;
+					case 13:
+						links_base_selected_channel = links_base_chan_13;
+						break;
+					case 14:
+						links_base_selected_channel = links_base_chan_14;
+						break;
+					case 15:
+						links_base_selected_channel = links_base_chan_15;
+						break;
+#endif
+				}
+
+				ap_uint<64> start_addr;
+				if (level_id == 0) { // base layer
+					start_addr = in_channel_node_id * AXI_num_per_base_link_stride;
+					// original: first 64-byte = header (4 byte num links + 60 byte padding)
+					//   then we have the links (4 byte each, total number = max_link_num)
+					// packed: the links follow the 4 byte num links, only the populated words are read
+					ap_uint<512> reg_first = links_base_selected_channel[start_addr];
+					s_neighbor_ids_raw.write(reg_first);
+					ap_uint<32> links_num_ap = reg_first.range(31, 0);
+					int num_links = links_num_ap;
+					num_links = num_links < max_link_num_base? num_links : max_link_num_base;
+					int AXI_num_per_base_link = link_layout == LINK_LAYOUT_PACKED? 
+						1 + num_links / INT_PER_AXI : AXI_num_per_base_link_stride;
+					for (int i = 1; i < AXI_num_per_base_link; i++) {
+					#pragma HLS pipeline II=1
+						ap_uint<512> reg = links_base_selected_channel[start_addr + i];
+						s_neighbor_ids_raw.write(reg);
+					}
+					// if (is_entry_point) {
+					// 	send_node_itself = true;
+					// 	is_entry_point = false;
+					// }
+				} 
+			}
+		}
+	}
+}
+
+void fetch_vectors(
+	// in initialization
+	const int vector_layout,
+	const int index_channel_bits,
+	// in runtime (should from DRAM)
+	ap_uint<512>* db_vectors,
+	// in runtime (stream)
+	hls::stream<int>& s_query_batch_size, // -1: stop
+	hls::stream<int>& s_fetch_batch_size,
+	hls::stream<cand_t>& s_fetched_neighbor_ids_replicated,
+	hls::stream<int>& s_finish_query_in,
+	
+	// out (stream)
+	hls::stream<ap_uint<512>>& s_fetched_vectors,
+	hls::stream<int>& s_finish_query_out
+) {
+
+	// stride between vectors, + visited padding in the original layout
+	const int AXI_num_per_vector_and_padding = vector_layout == VECTOR_LAYOUT_COMPACT? db_vec_AXI_num : db_vec_AXI_num + 1;
+
+	const int AXI_num_per_vector_only = db_vec_AXI_num; // 32 for fp32 D = 512, 16 for fp16, 8 for int8
+
+	bool first_s_query_batch_size = true;
+	bool first_iter_s_fetched_neighbor_ids_replicated = true;
+
+	while (true) {
+
+		wait_data_fifo_first_iter<int>(
+			1, s_query_batch_size, first_s_query_batch_size);
+		int query_num = s_query_batch_size.read();
+		if (query_num == -1) {
+			break;
+		}
+
+		// the queries of a batch finish in any order, one finish signal (context ID) each
+		int finished_query_num = 0;
+		while (finished_query_num < query_num) {
+			// check query finish
+			if (!s_finish_query_in.empty()) {
+				s_finish_query_out.write(s_finish_query_in.read());
+				finished_query_num++;
+			} else if (!s_fetch_batch_size.empty()) {
+				int fetch_batch_size = s_fetch_batch_size.read();
+				wait_data_fifo_first_iter<cand_t>(
+					fetch_batch_size, s_fetched_neighbor_ids_replicated, first_iter_s_fetched_neighbor_ids_replicated);
+				
+				for (int bid = 0; bid < fetch_batch_size; bid++) {
+				#pragma HLS pipeline // put the pipeline here so hopefully Vitis can handle prefetching automatically
+					if (s_finish_query_in.empty() && !s_fetch_batch_size.empty()) {
+						// no need to check wait_data_fifo_first_iter, because if this loop is executed, then first iter already passed
+						fetch_batch_size += s_fetch_batch_size.read();
+					}
+					// receive task & read vectors
+					cand_t reg_cand = s_fetched_neighbor_ids_replicated.read();
+					int node_id = reg_cand.node_id;
+					ap_uint<32> in_channel_node_id = get_in_channel_node_id(node_id, index_channel_bits);
+					int start_addr = in_channel_node_id * AXI_num_per_vector_and_padding;
+					for (int i = 0; i < AXI_num_per_vector_only; i++) {
+						ap_uint<512> vector_AXI = db_vectors[start_addr + i];
+						s_fetched_vectors.write(vector_AXI);
+					}
+				}
+			}
+		}
+	}
+}
+
+// one result queue per query context: the context of each candidate batch comes from the task scheduler
+//   (s_cand_batch_ctx_ids, in the order of the batches), and the results of a context are written out when
+//   its finish signal arrives, i.e., after its last batch
+void results_collection(
+	// in (initialization)
+	const int ef,
+	// in runtime (stream)
+	hls::stream<int>& s_query_batch_size, // -1: stop
+	hls::stream<int>& s_cand_batch_ctx_ids,
+	hls::stream<int>& s_num_neighbors_base_level,
+	hls::stream<result_t>& s_distances_base_level,
+	hls::stream<int>& s_finish_query_in,
+
+	// out (stream)
+	hls::stream<result_t>& s_inserted_candidates,
+	hls::stream<int>& s_num_inserted_candidates,
+	hls::stream<result_t>& s_largest_result_queue_elements, // dist: largest result, ctx_id: context
+	hls::stream<int>& s_finish_query_out,
+	hls::stream<int>& s_out_ids,
+	hls::stream<float>& s_out_dists
+) {
+
+#if RESULT_QUEUE_TYPE == RESULT_QUEUE_BITONIC
+	Bitonic_result_queue<hardware_result_queue_size, bitonic_batch_size> result_queues[NUM_QUERY_CONTEXTS];
+#else
+	// ef > hardware_result_queue_size: staged in registers, kept in BRAM (see Two_tier_result_queue)
+	Two_tier_result_queue<hardware_result_queue_size, hardware_large_result_queue_size> result_queues[NUM_QUERY_CONTEXTS];
+#endif
+#pragma HLS array_partition variable=result_queues complete
+	for (int c = 0; c < NUM_QUERY_CONTEXTS; c++) {
+		result_queues[c].init(ef); // reset content to large_float
+	}
+
+	bool first_s_query_batch_size = true;
+	bool first_iter_s_cand_batch_ctx_ids = true;
+	bool first_iter_s_distances_base_level = true;
+
+	while (true) {
+
+		wait_data_fifo_first_iter<int>(
+			1, s_query_batch_size, first_s_query_batch_size);
+		int query_num = s_query_batch_size.read();
+		if (query_num == -1) {
+			break;
+		}
+
+		// the queries of a batch finish in any order, one finish signal (context ID) each
+		int finished_query_num = 0;
+		while (finished_query_num < query_num) {
+			// check query finish
+			if (!s_finish_query_in.empty()) {
+				int ctx_id = s_finish_query_in.read();
+
+				// write results back 
+				for (int i = 0; i < ef; i++) {
+		#pragma HLS pipeline II=1
+					result_t reg = result_queues[ctx_id].result(i);
+					s_out_ids.write(reg.node_id);
+					s_out_dists.write(reg.dist);
+				}
+				result_queues[ctx_id].reset_queue(); // for the next query of this context
+
+				s_finish_query_out.write(ctx_id);
+				finished_query_num++;
+			} else if (!s_num_neighbors_base_level.empty()) {
+
+				wait_data_fifo_first_iter<int>(
+					1, s_cand_batch_ctx_ids, first_iter_s_cand_batch_ctx_ids);
+				int ctx_id = s_cand_batch_ctx_ids.read();
+
+				bool contain_insertion_this_iter = false;
+				for (int bid = 0; bid < N_CHANNEL; bid++) {
+					int num_neighbors = s_num_neighbors_base_level.read();
+					wait_data_fifo_first_iter<result_t>(
+						num_neighbors, s_distances_base_level, first_iter_s_distances_base_level);
+
+					int inserted_num_this_iter = 0;
+
+					if (num_neighbors > 0) {
+					// insert new values but without sorting
+						int num_left = num_neighbors;
+						while (num_left > 0) {
+							// two tiers / bitonic: up to the free staging registers, then merge them into the queue
+							int num_free = result_queues[ctx_id].num_free();
+							int num_insertion = num_left < num_free? num_left : num_free;
+							for (int i = 0; i < num_insertion; i++) {
+#pragma HLS pipeline II=1
+								result_t reg = s_distances_base_level.read();
+								// if both input & queue element are large_float, then do not insert
+								if (result_queues[ctx_id].insert(reg)) {
+									s_inserted_candidates.write(reg);
+									contain_insertion_this_iter = true;
+									inserted_num_this_iter++;
+								}
+							}
+							num_left -= num_insertion;
+							if (result_queues[ctx_id].num_free() == 0) {
+								result_queues[ctx_id].sort();
+							}
+						}
+						s_num_inserted_candidates.write(inserted_num_this_iter);
+					} else { // num_neighbors == 0
+						s_num_inserted_candidates.write(0);
+					}
+				}
+
+				// sorting
+				if (contain_insertion_this_iter) {
+					result_queues[ctx_id].sort();
+				}
+
+				// send out largest dist in the queue of this context:
+				//   if the queue is not full, always consider the candidate
+				//   if the queue is full, only consider the candidate when it is smaller than the largest element in the queue
+				result_t reg_largest;
+				reg_largest.node_id = -1;
+				reg_largest.level_id = -1;
+				reg_largest.dist = result_queues[ctx_id].largest();
+				reg_largest.ctx_id = ctx_id;
+				s_largest_result_queue_elements.write(reg_largest);
+			}
+		}
+	}
+}
@@ -0,0 +1,470 @@
+#pragma once
+
+#include "types.hpp"
+#include "utils.hpp"
+
+typedef struct {
+    float float_data[FLOAT_PER_AXI];
+} float_pack_t;
+
+float aggregation_sum_float_pack(
+    float_pack_t in) {
+// #pragma HLS inline // inline and latency are conflicting
+#pragma HLS latency max=1
+
+    // manual specification of adder tree is better than HLS inference (all 16 elements in a single line of code)
+
+    float sum_l0_0 = in.float_data[0] + in.float_data[1];
+    float sum_l0_1 = in.float_data[2] + in.float_data[3];
+    float sum_l0_2 = in.float_data[4] + in.float_data[5];
+    float sum_l0_3 = in.float_data[6] + in.float_data[7];
+    float sum_l0_4 = in.float_data[8] + in.float_data[9];
+    float sum_l0_5 = in.float_data[10] + in.float_data[11];
+    float sum_l0_6 = in.float_data[12] + in.float_data[13];
+    float sum_l0_7 = in.float_data[14] + in.float_data[15];
+
+    float sum_l1_0 = sum_l0_0 + sum_l0_1;
+    float sum_l1_1 = sum_l0_2 + sum_l0_3;
+    float sum_l1_2 = sum_l0_4 + sum_l0_5;
+    float sum_l1_3 = sum_l0_6 + sum_l0_7;
+
+    float sum_l2_0 = sum_l1_0 + sum_l1_1;
+    float sum_l2_1 = sum_l1_2 + sum_l1_3;
+
+    float sum = sum_l2_0 + sum_l2_1;
+
+    return sum;
+}
+
+// fp16 bits to fp32, subnormals are flushed to zero (the host-side encoder never produces them)
+float half_bits_to_float(ap_uint<16> h) {
+#pragma HLS inline
+	ap_uint<32> sign = h.range(15, 15);
+	ap_uint<32> exponent = h.range(14, 10);
+	ap_uint<32> mantissa = h.range(9, 0);
+	ap_uint<32> f;
+	if (exponent == 0) {
+		f = sign << 31;
+	} else if (exponent == 31) {
+		f = (sign << 31) | (ap_uint<32>(0xff) << 23) | (mantissa << 13);
+	} else {
+		f = (sign << 31) | ((exponent + 112) << 23) | (mantissa << 13);
+	}
+	return *((float*) (&f));
+}
+
+// element s of a 512-bit word of a database vector (VECTOR_TYPE in constants.hpp)
+template<const int vector_type>
+float decode_db_element(ap_uint<512> db_vec_reg, int s);
+
+template<>
+float decode_db_element<VECTOR_TYPE_FP32>(ap_uint<512> db_vec_reg, int s) {
+#pragma HLS inline
+	ap_uint<32> db_vec_reg_uint32 = db_vec_reg.range(32 * (s + 1) - 1, 32 * s);
+	return *((float*) (&db_vec_reg_uint32));
+}
+
+template<>
+float decode_db_element<VECTOR_TYPE_FP16>(ap_uint<512> db_vec_reg, int s) {
+#pragma HLS inline
+	ap_uint<16> db_vec_reg_uint16 = db_vec_reg.range(16 * (s + 1) - 1, 16 * s);
+	return half_bits_to_float(db_vec_reg_uint16);
+}
+
+template<>
+float decode_db_element<VECTOR_TYPE_INT8>(ap_uint<512> db_vec_reg, int s) {
+#pragma HLS inline
+	ap_int<8> code = db_vec_reg.range(8 * (s + 1) - 1, 8 * s);
+	return (float) code;
+}
+
+template<const int vector_type>
+void compute_distances_sub_PE_A(
+    // in runtime (stream)
+	hls::stream<int>& s_query_batch_size, // -1: stop
+    hls::stream<ap_uint<512>>& s_query_vectors, 
+    hls::stream<int>& s_fetch_batch_size_replicated,
+    hls::stream<ap_uint<512>>& s_fetched_vectors,
+    hls::stream<cand_t>& s_fetched_neighbor_ids_replicated,
+    hls::stream<int>& s_finish_query_in,
+    
+    // out (stream)
+    hls::stream<float>& s_partial_distances,
+    hls::stream<cand_t>& s_fetched_neighbor_ids_forwarded, // to sub_PE_B
+    hls::stream<int>& s_finish_query_out
+) {
+
+	// one partial distance per 512-bit word of the database vector, 
+	//   each word holds DB_ELEM_PER_AXI elements (16 x fp32, 32 x fp16, or 64 x int8)
+	const int elem_packs_per_AXI = DB_ELEM_PER_AXI / FLOAT_PER_AXI;
+	const int query_elem_num = db_vec_AXI_num * DB_ELEM_PER_AXI;
+
+	// one query vector per context, selected by the context ID of each fetched vector
+    float query_vector[NUM_QUERY_CONTEXTS][query_elem_num];
+#pragma HLS array_partition variable=query_vector dim=1 complete
+#pragma HLS array_partition variable=query_vector dim=2 cyclic factor=DB_ELEM_PER_AXI
+    float query_weights[NUM_QUERY_CONTEXTS][query_elem_num]; // int8 only: scale[d]^2
+#pragma HLS array_partition variable=query_weights dim=1 complete
+#pragma HLS array_partition variable=query_weights dim=2 cyclic factor=DB_ELEM_PER_AXI
+
+	bool first_s_query_batch_size = true;
+    bool first_iter_s_query_vectors = true;
+	bool first_iter_s_fetched_vectors = true;
+	bool first_iter_s_fetched_neighbor_ids_replicated = true;
+
+	while (true) {
+
+		wait_data_fifo_first_iter<int>(
+			1, s_query_batch_size, first_s_query_batch_size);
+		int query_num = s_query_batch_size.read();
+		if (query_num == -1) {
+			break;
+		}
+
+		// the queries of a batch finish in any order, one finish signal (context ID) each
+		int finished_query_num = 0;
+		while (finished_query_num < query_num) {
+
+			// a new query: a header word with the context ID, followed by the query vector (and the weights for int8);
+			//   the scheduler sends it directly when the query starts, thus before its first candidates pass the
+			//   neighbor fetching and the Bloom filter on their way here. The batch size FIFO is sampled first, such
+			//   that the header of any query in a batch seen here is seen below (in hardware, both are sampled in
+			//   the same cycle anyway; in C simulation, the threads may write in between)
+			bool batch_ready = !s_fetch_batch_size_replicated.empty();
+			if (!s_query_vectors.empty()) {
+				ap_uint<512> query_header = s_query_vectors.read();
+				ap_uint<QUERY_CONTEXT_ID_BITS> ctx_id = query_header.range(QUERY_CONTEXT_ID_BITS - 1, 0);
+
+				// the query is padded to whole database words, the padded elements are zero in the database vectors
+				for (int i = 0; i < query_elem_num / FLOAT_PER_AXI; i++) {
+				#pragma HLS pipeline II=1
+					for (int j = 0; j < FLOAT_PER_AXI; j++) {
+					#pragma HLS unroll
+						query_vector[ctx_id][i * FLOAT_PER_AXI + j] = 0;
+						query_weights[ctx_id][i * FLOAT_PER_AXI + j] = 1;
+					}
+				}
+
+				wait_data_fifo_first_iter<ap_uint<512>>(
+					query_AXI_num, s_query_vectors, first_iter_s_query_vectors);
+				for (int i = 0; i < query_AXI_num; i++) {
+				#pragma HLS pipeline II=1
+					ap_uint<512> query_reg = s_query_vectors.read();
+					int offset = i < query_vec_AXI_num? i * FLOAT_PER_AXI : (i - query_vec_AXI_num) * FLOAT_PER_AXI;
+					for (int j = 0; j < FLOAT_PER_AXI; j++) {
+					#pragma HLS unroll
+						ap_uint<32> query_reg_uint32 = query_reg.range(32 * (j + 1) - 1, 32 * j);
+						float query_reg_float = *((float*) (&query_reg_uint32));
+						if (i < query_vec_AXI_num) {
+							query_vector[ctx_id][offset + j] = query_reg_float;
+						} else {
+							query_weights[ctx_id][offset + j] = query_reg_float;
+						}
+					}
+				}
+			} else if (!s_finish_query_in.empty()) {
+				s_finish_query_out.write(s_finish_query_in.read());
+				finished_query_num++;
+			} else if (batch_ready) {
+
+				int fetch_batch_size = s_fetch_batch_size_replicated.read();
+				wait_data_fifo_first_iter<ap_uint<512>>(
+					fetch_batch_size, s_fetched_vectors, first_iter_s_fetched_vectors);
+				wait_data_fifo_first_iter<cand_t>(
+					fetch_batch_size, s_fetched_neighbor_ids_replicated, first_iter_s_fetched_neighbor_ids_replicated);
+
+				for (int b = 0; b < fetch_batch_size; b++) {
+				#pragma HLS pipeline
+					// a pending query vector stops the merging as well: the merged batch could hold the first
+					//   candidates of that query, which must not be computed before its context is loaded above
+					if (!s_fetch_batch_size_replicated.empty() && s_query_vectors.empty() && s_finish_query_in.empty()) {
+						fetch_batch_size += s_fetch_batch_size_replicated.read();
+					}
+					cand_t reg_cand = s_fetched_neighbor_ids_replicated.read();
+					s_fetched_neighbor_ids_forwarded.write(reg_cand);
+					ap_uint<QUERY_CONTEXT_ID_BITS> ctx_id = reg_cand.ctx_id;
+					for (int i = 0; i < db_vec_AXI_num; i++) {
+
+						// read dist vector
+						ap_uint<512> db_vec_reg = s_fetched_vectors.read();
+						
+						float distance_partial = 0;
+						for (int p = 0; p < elem_packs_per_AXI; p++) {
+						#pragma HLS unroll
+							float_pack_t reg_part_dist_packed;
+							for (int s = 0; s < FLOAT_PER_AXI; s++) {
+							#pragma HLS unroll
+								int e = p * FLOAT_PER_AXI + s;
+								float database_vector_partial = decode_db_element<vector_type>(db_vec_reg, e);
+								float diff = query_vector[ctx_id][i * DB_ELEM_PER_AXI + e] - database_vector_partial;
+								if (vector_type == VECTOR_TYPE_INT8) {
+									reg_part_dist_packed.float_data[s] = query_weights[ctx_id][i * DB_ELEM_PER_AXI + e] * diff * diff;
+								} else {
+									reg_part_dist_packed.float_data[s] = diff * diff;
+								}
+							}
+							distance_partial += aggregation_sum_float_pack(reg_part_dist_packed);
+						}
+						s_partial_distances.write(distance_partial);
+					}
+				}
+			}
+		}
+	}
+}
+
+
+void compute_distances_sub_PE_pack_partial_distances(
+    // in runtime (stream)
+	hls::stream<int>& s_query_batch_size, // -1: stop
+    hls::stream<int>& s_fetch_batch_size_replicated,
+    hls::stream<float>& s_partial_distances,
+    hls::stream<int>& s_finish_query_in,
+    
+    // out (stream)
+    hls::stream<float_pack_t> &s_partial_distances_packed,
+    hls::stream<int>& s_finish_query_out
+) {
+
+    const int vec_AXI_num = db_vec_AXI_num; // one partial distance per database word
+    const int packed_partial_dist_num = vec_AXI_num % FLOAT_PER_AXI == 0? vec_AXI_num / FLOAT_PER_AXI : vec_AXI_num / FLOAT_PER_AXI + 1;
+
+	bool first_s_query_batch_size = true;
+	bool first_iter_s_partial_distances = true;
+	
+	while (true) {
+
+		wait_data_fifo_first_iter<int>(
+			1, s_query_batch_size, first_s_query_batch_size);
+		int query_num = s_query_batch_size.read();
+		if (query_num == -1) {
+			break;
+		}
+
+		// the queries of a batch finish in any order, one finish signal (context ID) each
+		int finished_query_num = 0;
+		while (finished_query_num < query_num) {
+				
+			if (!s_finish_query_in.empty()) {
+				s_finish_query_out.write(s_finish_query_in.read());
+				finished_query_num++;
+			} else if (!s_fetch_batch_size_replicated.empty()) {
+
+				float_pack_t reg_packed_dist;
+				int fetch_batch_size = s_fetch_batch_size_replicated.read();
+				wait_data_fifo_first_iter<float>(
+					fetch_batch_size, s_partial_distances, first_iter_s_partial_distances);
+
+				for (int b = 0; b < fetch_batch_size; b++) {
+#pragma HLS pipeline
+					if (s_finish_query_in.empty() && !s_fetch_batch_size_replicated.empty()) {
+						fetch_batch_size += s_fetch_batch_size_replicated.read();
+					}
+
+					for (int j = 0; j < packed_partial_dist_num; j++) {
+						for (int i = 0; i < FLOAT_PER_AXI && j * FLOAT_PER_AXI + i < vec_AXI_num; i++) {
+							if (i == 0) {
+								reg_packed_dist.float_data[0] = s_partial_distances.read();
+								for (int k = 1; k < FLOAT_PER_AXI; k++) {
+								#pragma HLS unroll
+									reg_packed_dist.float_data[k] = 0;
+								}
+							} else {
+								// read dist vector
+								reg_packed_dist.float_data[i] = s_partial_distances.read();
+							}
+							if (i == FLOAT_PER_AXI - 1 || j * FLOAT_PER_AXI + i == vec_AXI_num - 1) {
+								s_partial_distances_packed.write(reg_packed_dist);
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+void compute_distances_sub_PE_B(
+    // in runtime (stream)
+	hls::stream<int>& s_query_batch_size, // -1: stop
+    hls::stream<int>& s_fetch_batch_size_replicated,
+    hls::stream<float_pack_t> &s_partial_distances_packed,
+    hls::stream<cand_t>& s_fetched_neighbor_ids_replicated,
+    hls::stream<int>& s_finish_query_in,
+    
+    // out (stream)
+    hls::stream<result_t>& s_distances,
+    hls::stream<int>& s_finish_query_out
+) {
+    const int vec_AXI_num = db_vec_AXI_num; // one partial distance per database word
+    const int packed_partial_dist_num = vec_AXI_num % FLOAT_PER_AXI == 0? vec_AXI_num / FLOAT_PER_AXI : vec_AXI_num / FLOAT_PER_AXI + 1;
+
+	bool first_s_query_batch_size = true;
+	bool first_iter_s_partial_distances_packed = true;
+	bool first_iter_s_fetched_neighbor_ids_replicated = true;
+
+	while (true) {
+
+		wait_data_fifo_first_iter<int>(
+			1, s_query_batch_size, first_s_query_batch_size);
+		int query_num = s_query_batch_size.read();
+		if (query_num == -1) {
+			break;
+		}
+
+		// the queries of a batch finish in any order, one finish signal (context ID) each
+		int finished_query_num = 0;
+		while (finished_query_num < query_num) {
+				
+			if (!s_finish_query_in.empty()) {
+				s_finish_query_out.write(s_finish_query_in.read());
+				finished_query_num++;
+			} else if (!s_fetch_batch_size_replicated.empty()) {
+
+				float final_dist = 0;
+				int fetch_batch_size = s_fetch_batch_size_replicated.read();
+
+				wait_data_fifo_first_iter<float_pack_t>(
+					fetch_batch_size, s_partial_distances_packed, first_iter_s_partial_distances_packed);
+				wait_data_fifo_first_iter<cand_t>(
+					fetch_batch_size, s_fetched_neighbor_ids_replicated, first_iter_s_fetched_neighbor_ids_replicated);
+
+				// Note: having read and reset dist operations in the first cycle, although fine in unit test,
+				//   somehow led to deadlock when integrating the entire accelerator, so I rerwite the code to 
+				//   only load data in the final cycle. The original code that let to deadlock:
+				// if (i == 0) {
+				// 	final_dist = 0;
+				// 	reg_cand = s_fetched_neighbor_ids_replicated.read();
+				// 	valid = s_fetch_valid.read();
+				// }
+
+				for (int b = 0; b < fetch_batch_size; b++) {
+#pragma HLS pipeline
+
+					if (s_finish_query_in.empty() && !s_fetch_batch_size_replicated.empty()) {
+						fetch_batch_size += s_fetch_batch_size_replicated.read();
+					}
+
+					for (int i = 0; i < packed_partial_dist_num; i++) {
+						float old_dist = final_dist;
+						// read dist vector
+						float_pack_t reg_part_dist_packed = s_partial_distances_packed.read();
+						// aggregation sum
+						float aggreg_dist = aggregation_sum_float_pack(reg_part_dist_packed);
+						float cand_dist = old_dist + aggreg_dist;
+						final_dist = i == 0? aggreg_dist : cand_dist;
+						if (i == packed_partial_dist_num - 1) {
+							cand_t reg_cand = s_fetched_neighbor_ids_replicated.read();
+							result_t out;
+							out.node_id = reg_cand.node_id;
+							out.level_id = reg_cand.level_id;
+							out.ctx_id = reg_cand.ctx_id;
+							out.dist = final_dist;
+							s_distances.write(out);
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+
+void compute_distances(
+    // in runtime (stream)
+	hls::stream<int>& s_query_batch_size, // -1: stop
+    hls::stream<ap_uint<512>>& s_query_vectors, 
+    hls::stream<int>& s_fetch_batch_size,
+    hls::stream<ap_uint<512>>& s_fetched_vectors,
+    hls::stream<cand_t>& s_fetched_neighbor_ids_replicated,
+    hls::stream<int>& s_finish_query_in,
+    
+    // out (stream)
+    hls::stream<result_t>& s_distances,
+    hls::stream<int>& s_finish_query_out
+) {
+#pragma HLS dataflow
+
+    const int replication_factor = 3;
+
+    hls::stream<int> s_fetch_batch_size_replicated[replication_factor];
+#pragma HLS stream variable=s_fetch_batch_size_replicated depth=depth_control
+
+    hls::stream<int> s_finish_replicate_s_fetch_batch_size; // finish all queries
+#pragma HLS stream variable=s_finish_replicate_s_fetch_batch_size depth=depth_control
+
+    hls::stream<int> s_finish_query_fetch_sub_PE_A; // finish all queries
+#pragma HLS stream variable=s_finish_query_fetch_sub_PE_A depth=depth_control
+    
+    hls::stream<int> s_finish_query_fetch_sub_PE_pack_partial_distances; // finish all queries
+#pragma HLS stream variable=s_finish_query_fetch_sub_PE_pack_partial_distances depth=depth_control
+    
+    hls::stream<float> s_partial_distances; 
+#pragma HLS stream variable=s_partial_distances depth=depth_data
+
+    hls::stream<float_pack_t> s_partial_distances_packed; 
+#pragma HLS stream variable=s_partial_distances_packed depth=depth_data
+
+    hls::stream<cand_t> s_fetched_neighbor_ids_forwarded; // sub_PE_A selects the query by the context ID, sub_PE_B outputs the node ID
+#pragma HLS stream variable=s_fetched_neighbor_ids_forwarded depth=depth_data
+
+	// replicate s_query_batch_size to multiple streams
+	const int replicate_factor_s_query_batch_size = 4;
+	hls::stream<int> s_query_batch_size_replicated[replicate_factor_s_query_batch_size];
+#pragma HLS stream variable=s_query_batch_size_replicated depth=depth_control
+
+	replicate_s_query_batch_size<replicate_factor_s_query_batch_size>(
+		s_query_batch_size,
+		s_query_batch_size_replicated
+	);
+
+    replicate_s_control<replication_factor, int>(
+		s_query_batch_size_replicated[0],
+        s_fetch_batch_size,
+        s_finish_query_in,
+        
+        // out (stream)
+        s_fetch_batch_size_replicated,
+        s_finish_replicate_s_fetch_batch_size
+    );
+
+    compute_distances_sub_PE_A<VECTOR_TYPE>(
+        // in runtime (stream)
+		s_query_batch_size_replicated[1],
+        s_query_vectors, 
+        s_fetch_batch_size_replicated[0],
+        s_fetched_vectors,
+        s_fetched_neighbor_ids_replicated,
+        s_finish_replicate_s_fetch_batch_size,
+        
+        // out (stream)
+        s_partial_distances,
+        s_fetched_neighbor_ids_forwarded,
+        s_finish_query_fetch_sub_PE_A
+    );
+
+    compute_distances_sub_PE_pack_partial_distances(
+        // in runtime (stream)
+		s_query_batch_size_replicated[2],
+        s_fetch_batch_size_replicated[1],
+        s_partial_distances,
+        s_finish_query_fetch_sub_PE_A,
+        
+        // out (stream)
+        s_partial_distances_packed,
+        s_finish_query_fetch_sub_PE_pack_partial_distances
+    );
+
+    compute_distances_sub_PE_B(
+        // in runtime (stream)
+		s_query_batch_size_replicated[3],
+        s_fetch_batch_size_replicated[2],
+        s_partial_distances_packed,
+        s_fetched_neighbor_ids_forwarded,
+        s_finish_query_fetch_sub_PE_pack_partial_distances,
+        
+        // out (stream)
+        s_distances,
+        s_finish_query_out
+    );
+}
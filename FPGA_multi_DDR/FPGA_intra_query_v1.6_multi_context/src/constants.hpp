@@ -0,0 +1,156 @@
+#pragma once
+
+#define N_CHANNEL 4 // has to be 2^n
+
+#define FLOAT_PER_AXI 16 // 512 bit / 32 bit = 16
+#define INT_PER_AXI 16
+#define BYTE_PER_AXI 64
+const int float_per_axi = FLOAT_PER_AXI;
+
+// #define D_MAX 1024
+#define D 128
+
+// storage format of the database vectors (hnsw_nsg_to_FPGA --vector_type in vector_search_baselines/FPGA_index_tools,
+//   bits 3 ~ 4 of the layout flags in meta.bin, checked by the host):
+//   fp32 (default), fp16, or int8 with a per-dimension scale and offset: x[d] = scale[d] * code[d] + offset[d].
+//   For int8, the host sends every query transformed to (q[d] - offset[d]) / scale[d], followed by the
+//   per-dimension weights scale[d]^2, such that dist = sum_d weight[d] * (q'[d] - code[d])^2
+#define VECTOR_TYPE_FP32 0
+#define VECTOR_TYPE_FP16 1
+#define VECTOR_TYPE_INT8 2
+#define VECTOR_TYPE VECTOR_TYPE_FP32
+
+#if VECTOR_TYPE == VECTOR_TYPE_FP32
+#define DB_ELEM_PER_AXI 16
+#elif VECTOR_TYPE == VECTOR_TYPE_FP16
+#define DB_ELEM_PER_AXI 32
+#elif VECTOR_TYPE == VECTOR_TYPE_INT8
+#define DB_ELEM_PER_AXI 64
+#endif
+
+// number of 512-bit words per query (fp32, plus the weights for int8) and per database vector (without the visited padding)
+const int query_vec_AXI_num = D % FLOAT_PER_AXI == 0? D / FLOAT_PER_AXI : D / FLOAT_PER_AXI + 1;
+#if VECTOR_TYPE == VECTOR_TYPE_INT8
+const int query_AXI_num = 2 * query_vec_AXI_num;
+#else
+const int query_AXI_num = query_vec_AXI_num;
+#endif
+const int db_vec_AXI_num = D % DB_ELEM_PER_AXI == 0? D / DB_ELEM_PER_AXI : D / DB_ELEM_PER_AXI + 1;
+
+// layout of the database vectors in DRAM (bit 0 of the layout flags in meta.bin, passed as kernel argument):
+//   VECTOR_LAYOUT_PADDED: each vector is followed by a 64-byte visited padding (the original format)
+//   VECTOR_LAYOUT_COMPACT: vectors are contiguous, as the visited tags are kept in the Bloom filters
+#define VECTOR_LAYOUT_PADDED 0
+#define VECTOR_LAYOUT_COMPACT 1
+
+// layout of the base layer links in DRAM (bit 1 of the layout flags in meta.bin, passed as kernel argument):
+//   LINK_LAYOUT_ORIGINAL: 64-byte header (num_links) + max_link_num_base links, all words are fetched
+//   LINK_LAYOUT_PACKED: num_links followed by the links in the same word, only the ceil((num_links + 1) / 16)
+//     populated words are fetched (the node stride is still fixed, but the count is read before the rest)
+#define LINK_LAYOUT_ORIGINAL 0
+#define LINK_LAYOUT_PACKED 1
+
+// largest 32-bit float: 3.4028237 × 10^38
+const float large_float = 1E+20f; // 1E+20f is large enough for cosine similarity
+
+// max queue sizes
+const int hardware_result_queue_size = 64; // 128;
+const int hardware_candidate_queue_size = 32; // 128;
+// ef > hardware_result_queue_size: BRAM tier of the result queue (Two_tier_result_queue)
+const int hardware_large_result_queue_size = 512;
+
+// result queue of results_collection (priority_queue.hpp, unit_tests/priority_queue for the comparison):
+//   RESULT_QUEUE_TWO_TIER: systolic insertion, ef up to hardware_large_result_queue_size
+//   RESULT_QUEUE_BITONIC: batches of bitonic_batch_size merged by a bitonic network, ef up to hardware_result_queue_size
+#define RESULT_QUEUE_TWO_TIER 0
+#define RESULT_QUEUE_BITONIC 1
+#define RESULT_QUEUE_TYPE RESULT_QUEUE_TWO_TIER
+const int bitonic_batch_size = 16;
+
+// queries in flight: each query context has its own candidate queue (task_scheduler), Bloom filters and query
+//   vector copies (bloom_fetch_compute), threshold (filter_computed_distances), and result queue (results_collection),
+//   the candidates and results carry their context ID, and the task scheduler starts the next query of the batch
+//   in a free context instead of waiting for the pipeline to drain; the kernel argument runtime_num_query_contexts
+//   (1 ~ NUM_QUERY_CONTEXTS) selects how many contexts are used
+#define NUM_QUERY_CONTEXTS 4 // 2 ~ 4
+#define QUERY_CONTEXT_ID_BITS 2
+// candidate batches on the fly of all contexts, up to NUM_QUERY_CONTEXTS * max_async_stage_num
+const int hardware_max_batches_in_flight = 64;
+
+// bloom filter setting: https://hur.st/bloomfilter/?n=2500&p=&m=64000&k=4
+const int bloom_num_hash_funs = 3; 
+#if N_CHANNEL == 1
+const int bloom_num_bucket_addr_bits = 8 + 10; // 256 * 1024
+#define CHANNEL_ADDR_BITS 0
+#elif N_CHANNEL == 2
+const int bloom_num_bucket_addr_bits = 7 + 10; // 128 * 1024
+#define CHANNEL_ADDR_BITS 1
+#elif N_CHANNEL == 4
+const int bloom_num_bucket_addr_bits = 6 + 10; // 64 * 1024
+#define CHANNEL_ADDR_BITS 2
+#elif N_CHANNEL == 8
+const int bloom_num_bucket_addr_bits = 5 + 10; // 32 * 1024
+#define CHANNEL_ADDR_BITS 3
+#elif N_CHANNEL == 16
+const int bloom_num_bucket_addr_bits = 4 + 10; // 16 * 1024
+#define CHANNEL_ADDR_BITS 4
+#endif
+
+const int bloom_num_buckets = 1 << bloom_num_bucket_addr_bits;
+
+// reset of the Bloom filters between queries: BLOOM_RESET_SWEEP clears every 512-bit bucket after each
+//   query (runtime_num_512b_buckets cycles, up to 512), BLOOM_RESET_EPOCH tags each bucket with the epoch
+//   (query) that last wrote it (BLOOM_EPOCH_BITS LUTRAM bits per bucket), such that the buckets of older
+//   epochs read as empty and the next query starts right away; the tags are only swept when the epoch wraps
+#define BLOOM_RESET_SWEEP 0
+#define BLOOM_RESET_EPOCH 1
+#define BLOOM_RESET_MODE BLOOM_RESET_EPOCH
+#define BLOOM_EPOCH_BITS 8
+
+// node ID -> DRAM channel (see get_channel_id in types.hpp):
+//   default: low CHANNEL_ADDR_BITS of the node ID, i.e., node i in channel i % N_CHANNEL
+//   CHANNEL_PLACEMENT_BALANCED: bits [30 : 31 - CHANNEL_ADDR_BITS], the node positions within
+//     the channels are chosen by the index tools (vector_search_baselines/FPGA_index_tools/balance_FPGA_channels)
+// #define CHANNEL_PLACEMENT_BALANCED
+
+// channel groups (runtime, default placement only): the N_CHANNEL channels form N_CHANNEL / 2^channel_group_bits 
+//   groups, each serving its queries alone (query context i uses group i % group number) with the graph sharded 
+//   by the low channel_group_bits of the node ID, i.e., 1 group = intra-query, N_CHANNEL groups = inter-query.
+//   Each channel holds the index files of 2^index_channel_bits channels (file = channel % 2^index_channel_bits), 
+//   where index_channel_bits <= channel_group_bits: the 1-channel index in every channel serves any grouping
+
+// async batch size tracking
+const int hardware_async_batch_size = 64; // to infer BRAM
+
+// debug signals per query
+const int debug_size = 1;
+
+// FIFO depth
+const int depth_network_in = 512; // data FIFOs without wide data types
+
+#if D == 128 // SIFT
+	const int depth_data = 512; // data FIFOs without wide data types
+	const int depth_control = 16;
+	const int depth_fetched_vectors = 512; // 512-bit width to memory
+	const int depth_query_vectors = 128; // 512-bit width to memory
+#elif D == 384 // SBERT
+	const int depth_data = 512; // data FIFOs without wide data types
+	const int depth_control = 16;
+	const int depth_fetched_vectors = 512; // 512-bit width to memory
+	const int depth_query_vectors = 128; // 512-bit width to memory
+#elif D == 96 // Deep
+	const int depth_data = 512; // data FIFOs without wide data types
+	const int depth_control = 16;
+	const int depth_fetched_vectors = 512; // 512-bit width to memory
+	const int depth_query_vectors = 128; // 512-bit width to memory
+#elif D == 100 // SPACEV
+	const int depth_data = 512; // data FIFOs without wide data types
+	const int depth_control = 16;
+	const int depth_fetched_vectors = 512; // 512-bit width to memory
+	const int depth_query_vectors = 128; // 512-bit width to memory
+#else
+	const int depth_data = 512; // data FIFOs without wide data types
+	const int depth_control = 16;
+	const int depth_fetched_vectors = 512; // 512-bit width to memory
+	const int depth_query_vectors = 128; // 512-bit width to memory
+#endif
\ No newline at end of file
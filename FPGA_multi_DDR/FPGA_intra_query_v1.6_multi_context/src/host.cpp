@@ -0,0 +1,730 @@
+#include <stdint.h>
+#include <chrono>
+#include <cassert>
+
+#include "host.hpp"
+#include "index_loader.hpp"
+#include "upper_layer_search.hpp"
+#include "result_labels.hpp"
+
+#include "constants.hpp"
+// #include "types.hpp"
+// Wenqi: seems 2022.1 somehow does not support linking ap_uint.h to host?
+// #include "ap_uint.h"
+
+#include <sys/stat.h>
+
+#define DEBUG
+
+long GetFileSize(std::string filename)
+{
+    struct stat stat_buf;
+    int rc = stat(filename.c_str(), &stat_buf);
+    return rc == 0 ? stat_buf.st_size : -1;
+}
+
+// channel groups for a batch size: small batches are latency-bound, thus all channels serve each query (1 group);
+//   larger batches are throughput-bound, thus as many groups as the query contexts can keep busy, i.e., the
+//   largest power of 2 dividing both N_CHANNEL and num_query_contexts (the contexts take the groups in turn)
+int choose_num_channel_groups(int query_batch_size, int num_query_contexts) {
+    if (query_batch_size <= num_query_contexts) {
+        return 1;
+    }
+    int num_channel_groups = 1;
+    while (N_CHANNEL % (2 * num_channel_groups) == 0 && num_query_contexts % (2 * num_channel_groups) == 0) {
+        num_channel_groups *= 2;
+    }
+    return num_channel_groups;
+}
+
+// concat dir
+std::string concat_dir(std::string dir, std::string filename) {
+    if (dir.back() == '/') {
+        return dir + filename;
+    } else {
+        return dir + "/" + filename;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::cout << "Usage: ./host <xclbin> <max_cand_per_group (mc)> <max_group_num_in_pipe (mg)> <ef> <graph_type> <dataset> <Max degree (MD)> <batch_size> <index_load_mode (mmap_populate/mmap/huge_pages)> <index_dir (optional)> <entry_point_mode (upper_layers/meta)> <num_query_contexts (1 ~ NUM_QUERY_CONTEXTS)> <num_channel_groups (1/2/.../N_CHANNEL/auto)>" << std::endl;
+    std::cout << "   Example: ./host xclbin/vadd.hw.xclbin 1 4 64 HNSW SIFT1M 64 10000" << std::endl;
+
+    // in init
+    int d = D;
+    int query_num = 10000;
+    int query_offset = 0; // starting from query x
+    int query_num_after_offset = query_num + query_offset > 10000? 10000 - query_offset : query_num;
+    int candidate_queue_runtime_size = hardware_candidate_queue_size;
+       
+    int arg_cnt = 2;
+    int max_cand_per_group = 1;
+    if (argc > 2) { max_cand_per_group = atoi(argv[arg_cnt++]); } 
+    std::cout << "max_cand_per_group=" << max_cand_per_group << std::endl;
+
+    int max_group_num_in_pipe = 4;
+    if (argc > 3) { max_group_num_in_pipe = atoi(argv[arg_cnt++]); } 
+    std::cout << "max_group_num_in_pipe=" << max_group_num_in_pipe << std::endl;
+
+    int ef = 64;
+    if (argc > 4) { ef = atoi(argv[arg_cnt++]); }
+    std::cout << "ef=" << ef << std::endl;
+#if RESULT_QUEUE_TYPE == RESULT_QUEUE_BITONIC
+    assert(ef <= hardware_result_queue_size);
+#else
+    assert(ef <= hardware_large_result_queue_size);
+#endif
+
+    std::string graph_type = "HNSW"; // "NSG" or "HNSW"
+    if (argc > 5) { graph_type = argv[arg_cnt++]; }
+    std::cout << "graph_type=" << graph_type << std::endl;
+    assert (graph_type == "NSG" || graph_type == "HNSW");
+
+    std::string dataset = "SIFT1M"; // "SIFT1M" or "SIFT10M" or "Deep1M" or "Deep10M" or "GLOVE" or "SBERT1M"
+    if (argc > 6) { dataset = argv[arg_cnt++]; }
+    std::cout << "dataset=" << dataset << std::endl;
+    if (dataset == "SIFT1M" || dataset == "SIFT10M") {assert (d == 128);}
+    else if (dataset == "Deep1M" || dataset == "Deep10M") {assert (d == 96);}
+    else if (dataset == "GLOVE") {assert (d == 300);}
+    else if (dataset == "SBERT1M") {assert (d == 384);}
+    else if (dataset == "SPACEV1M" || dataset == "SPACEV10M") {assert (d == 100);}
+    else {std::cout << "Unknown dataset\n"; return -1;}
+
+    int MD = 64;
+    if (argc > 7) { MD = atoi(argv[arg_cnt++]); }
+    std::cout << "MD (max degree)=" << MD << std::endl;
+
+    int query_batch_size = 10000;
+    if (argc > 8) { query_batch_size = atoi(argv[arg_cnt++]); }
+    std::cout << "query_batch_size=" << query_batch_size << std::endl;
+    assert (query_batch_size <= query_num);
+
+    // "mmap_populate" (default): mmap + MAP_POPULATE; "mmap": lazy mmap; "huge_pages": 2MB pages + pread
+    std::string index_load_mode = "mmap_populate";
+    if (argc > 9) { index_load_mode = argv[arg_cnt++]; }
+    std::cout << "index_load_mode=" << index_load_mode << std::endl;
+    assert (index_load_mode == "mmap_populate" || index_load_mode == "mmap" || index_load_mode == "huge_pages");
+
+    int max_bloom_out_burst_size = 16; // according to mem & compute speed test
+#if N_CHANNEL == 1
+    int runtime_n_bucket_addr_bits = 8 + 10; // 256K buckets
+#endif
+#if N_CHANNEL == 2
+    int runtime_n_bucket_addr_bits = 7 + 10; 
+#endif
+#if N_CHANNEL == 4
+    int runtime_n_bucket_addr_bits = 6 + 10;
+#endif
+#if N_CHANNEL == 8
+    int runtime_n_bucket_addr_bits = 5 + 10;
+#endif
+#if N_CHANNEL == 16
+    int runtime_n_bucket_addr_bits = 4 + 10;
+#endif
+    int runtime_n_buckets = 1 << runtime_n_bucket_addr_bits;
+    uint32_t hash_seed = 1;
+    assert (ef <= hardware_large_result_queue_size);
+
+    std::string index_dir;
+
+    if (graph_type == "HNSW") {
+        if (dataset == "SIFT1M") {
+            index_dir = "/mnt/scratch/wenqi/hnsw_experiments/data/FPGA_hnsw/SIFT1M_MD" + std::to_string(MD);
+        } else if (dataset == "SIFT10M") {
+            index_dir = "/mnt/scratch/wenqi/hnsw_experiments/data/FPGA_hnsw/SIFT10M_MD" + std::to_string(MD);
+        } else if (dataset == "Deep1M") {
+            index_dir = "/mnt/scratch/wenqi/hnsw_experiments/data/FPGA_hnsw/Deep1M_MD" + std::to_string(MD);
+        } else if (dataset == "Deep10M") {
+            index_dir = "/mnt/scratch/wenqi/hnsw_experiments/data/FPGA_hnsw/Deep10M_MD" + std::to_string(MD);
+        } else if (dataset == "GLOVE") {
+            index_dir = "/mnt/scratch/wenqi/hnsw_experiments/data/FPGA_hnsw/GLOVE_MD" + std::to_string(MD);
+        } else if (dataset == "SBERT1M") {
+            index_dir = "/mnt/scratch/wenqi/hnsw_experiments/data/FPGA_hnsw/SBERT1M_MD" + std::to_string(MD);
+        } else if (dataset == "SPACEV1M") {
+            index_dir = "/mnt/scratch/wenqi/hnsw_experiments/data/FPGA_hnsw/SPACEV1M_MD" + std::to_string(MD);
+        } else if (dataset == "SPACEV10M") {
+            index_dir = "/mnt/scratch/wenqi/hnsw_experiments/data/FPGA_hnsw/SPACEV10M_MD" + std::to_string(MD);
+        } else {
+            std::cout << "Unknown dataset\n";
+            return -1;
+        }
+    } else if (graph_type == "NSG") {
+        if (dataset == "SIFT1M") {
+            index_dir = "/mnt/scratch/wenqi/hnsw_experiments/data/FPGA_NSG/SIFT1M_MD" + std::to_string(MD);
+        } else if (dataset == "SIFT10M") {
+            index_dir = "/mnt/scratch/wenqi/hnsw_experiments/data/FPGA_NSG/SIFT10M_MD" + std::to_string(MD);
+        } else if (dataset == "Deep1M") {
+            index_dir = "/mnt/scratch/wenqi/hnsw_experiments/data/FPGA_NSG/Deep1M_MD" + std::to_string(MD);
+        } else if (dataset == "Deep10M") {
+            index_dir = "/mnt/scratch/wenqi/hnsw_experiments/data/FPGA_NSG/Deep10M_MD" + std::to_string(MD);
+        } else if (dataset == "GLOVE") {
+            index_dir = "/mnt/scratch/wenqi/hnsw_experiments/data/FPGA_NSG/GLOVE_MD" + std::to_string(MD);
+        } else if (dataset == "SBERT1M") {
+            index_dir = "/mnt/scratch/wenqi/hnsw_experiments/data/FPGA_NSG/SBERT1M_MD" + std::to_string(MD);
+        } else if (dataset == "SPACEV1M") {
+            index_dir = "/mnt/scratch/wenqi/hnsw_experiments/data/FPGA_NSG/SPACEV1M_MD" + std::to_string(MD);
+        } else if (dataset == "SPACEV10M") {
+            index_dir = "/mnt/scratch/wenqi/hnsw_experiments/data/FPGA_NSG/SPACEV10M_MD" + std::to_string(MD);
+        }  else {
+            std::cout << "Unknown dataset\n";
+            return -1;
+        }
+    } else {
+        std::cout << "Unknown graph type\n";
+        return -1; 
+    }
+    // optional: a different index directory, e.g., produced by the FPGA_index_tools (reordered / channel balanced)
+    if (argc > 10) { index_dir = argv[arg_cnt++]; }
+    std::cout << "index_dir=" << index_dir << std::endl;
+
+    // "upper_layers" (default): per-query entry points from the HNSW upper layers (upper_layer_search.hpp), 
+    //   "meta": the entry point of meta.bin for all queries (always the case for NSG)
+    std::string entry_point_mode = "upper_layers";
+    if (argc > 11) { entry_point_mode = argv[arg_cnt++]; }
+    std::cout << "entry_point_mode=" << entry_point_mode << std::endl;
+    assert (entry_point_mode == "upper_layers" || entry_point_mode == "meta");
+
+    // queries searched at the same time by the kernel, each in its own context
+    int num_query_contexts = NUM_QUERY_CONTEXTS;
+    if (argc > 12) { num_query_contexts = atoi(argv[arg_cnt++]); }
+    std::cout << "num_query_contexts=" << num_query_contexts << std::endl;
+    assert (num_query_contexts >= 1 && num_query_contexts <= NUM_QUERY_CONTEXTS);
+    assert (num_query_contexts * max_group_num_in_pipe <= hardware_max_batches_in_flight);
+
+    // channel groups, each searching its own queries over N_CHANNEL / num_channel_groups channels (see constants.hpp), 
+    //   "auto": chosen by the batch size (choose_num_channel_groups)
+    std::string num_channel_groups_str = "1";
+    if (argc > 13) { num_channel_groups_str = argv[arg_cnt++]; }
+    int num_channel_groups = num_channel_groups_str == "auto"? 
+        choose_num_channel_groups(query_batch_size, num_query_contexts) : atoi(num_channel_groups_str.c_str());
+    std::cout << "num_channel_groups=" << num_channel_groups << std::endl;
+    assert (num_channel_groups >= 1 && num_channel_groups <= N_CHANNEL && N_CHANNEL % num_channel_groups == 0);
+    assert (num_query_contexts % num_channel_groups == 0); // the contexts take the groups in turn
+#ifdef CHANNEL_PLACEMENT_BALANCED
+    assert (num_channel_groups == 1);
+#endif
+    int channels_per_group = N_CHANNEL / num_channel_groups;
+    int channel_group_bits = 0;
+    while ((1 << channel_group_bits) < channels_per_group) { channel_group_bits++; }
+
+    std::string dataset_dir;
+    std::string fname_query_vectors;
+    std::string fname_gt_vec_ID;
+    std::string fname_gt_dist;
+    if (dataset == "SIFT1M" || dataset == "SIFT10M") {
+        dataset_dir = "/mnt/scratch/wenqi/Faiss_experiments/bigann";
+        fname_query_vectors = concat_dir(dataset_dir, "bigann_query.bvecs");
+        if (dataset == "SIFT1M") {
+            fname_gt_vec_ID = concat_dir(dataset_dir, "gnd/idx_1M.ivecs");
+            fname_gt_dist = concat_dir(dataset_dir, "gnd/dis_1M.fvecs");
+        } else if (dataset == "SIFT10M") {
+            fname_gt_vec_ID = concat_dir(dataset_dir, "gnd/idx_10M.ivecs");
+            fname_gt_dist = concat_dir(dataset_dir, "gnd/dis_10M.fvecs");
+        }
+    } else if (dataset == "Deep1M" || dataset == "Deep10M") {
+        dataset_dir = "/mnt/scratch/wenqi/Faiss_experiments/deep1b";
+        fname_query_vectors = concat_dir(dataset_dir, "query.public.10K.fbin");
+        if (dataset == "Deep1M") {
+            fname_gt_vec_ID = concat_dir(dataset_dir, "gt_idx_1M.ibin");
+            fname_gt_dist = concat_dir(dataset_dir, "gt_dis_1M.fbin");
+        } else if (dataset == "Deep10M") {
+            fname_gt_vec_ID = concat_dir(dataset_dir, "gt_idx_10M.ibin");
+            fname_gt_dist = concat_dir(dataset_dir, "gt_dis_10M.fbin");
+        }
+    } else if (dataset == "GLOVE") {
+        dataset_dir = "/mnt/scratch/wenqi/Faiss_experiments/GLOVE_840B_300d";
+        fname_query_vectors = concat_dir(dataset_dir, "query_10K.fbin");
+        fname_gt_vec_ID = concat_dir(dataset_dir, "gt_idx_1M.ibin");
+        fname_gt_dist = concat_dir(dataset_dir, "gt_dis_1M.fbin");
+    } else if (dataset == "SBERT1M") {
+        dataset_dir = "/mnt/scratch/wenqi/Faiss_experiments/sbert";
+        fname_query_vectors = concat_dir(dataset_dir, "query_10K.fvecs");
+        fname_gt_vec_ID = concat_dir(dataset_dir, "gt_idx_1M.ibin");
+        fname_gt_dist = concat_dir(dataset_dir, "gt_dis_1M.fbin");
+    } else if (dataset == "SPACEV1M" || dataset == "SPACEV10M") {
+        dataset_dir = "/mnt/scratch/wenqi/Faiss_experiments/SPACEV";
+        fname_query_vectors = concat_dir(dataset_dir, "query_10K.bin");
+        if (dataset == "SPACEV1M") {
+            fname_gt_vec_ID = concat_dir(dataset_dir, "gt_idx_1M.ibin");
+            fname_gt_dist = concat_dir(dataset_dir, "gt_dis_1M.fbin");
+        } else if (dataset == "SPACEV10M") {
+            fname_gt_vec_ID = concat_dir(dataset_dir, "gt_idx_10M.ibin");
+            fname_gt_dist = concat_dir(dataset_dir, "gt_dis_10M.fbin");
+        }
+    }
+
+    // initialization values
+    int max_level = 0; // HNSW only
+    int max_link_num_upper = 0; // HNSW only
+    int max_link_num_base; // = 32;
+    int entry_point_id; // = 0;
+    int num_db_vec; // = 1000 * 1000;
+
+    // load metadata from file 
+    //  cur_element_count, maxlevel_, enterpoint_node_, maxM_, maxM0_
+    FILE* f_metadata = fopen(concat_dir(index_dir, "meta.bin").c_str(), "rb");
+    if (graph_type == "HNSW") {
+        fread(&num_db_vec, sizeof(int), 1, f_metadata);
+        fread(&max_level, sizeof(int), 1, f_metadata);
+        fread(&entry_point_id, sizeof(int), 1, f_metadata);
+        fread(&max_link_num_upper, sizeof(int), 1, f_metadata);
+        fread(&max_link_num_base, sizeof(int), 1, f_metadata);
+        std::cout << "num_db_vec=" << num_db_vec << std::endl;
+        std::cout << "max_level=" << max_level << std::endl;
+        std::cout << "entry_point_id=" << entry_point_id << std::endl;
+        std::cout << "max_link_num_upper=" << max_link_num_upper << std::endl;
+        std::cout << "max_link_num_base=" << max_link_num_base << std::endl;
+    } else if (graph_type == "NSG") {
+        fread(&num_db_vec, sizeof(int), 1, f_metadata);
+        fread(&entry_point_id, sizeof(int), 1, f_metadata);
+        fread(&max_link_num_base, sizeof(int), 1, f_metadata);
+        std::cout << "num_db_vec=" << num_db_vec << std::endl;
+        std::cout << "entry_point_id=" << entry_point_id << std::endl;
+        std::cout << "max_link_num_base=" << max_link_num_base << std::endl;
+    }
+    // optional last field, absent in the original format: layout flags (see constants.hpp), 
+    //   bit 0 = VECTOR_LAYOUT_COMPACT, bit 1 = LINK_LAYOUT_PACKED, bits 3 ~ 4 = vector type
+    int layout_flags = 0;
+    if (fread(&layout_flags, sizeof(int), 1, f_metadata) != 1) {
+        layout_flags = 0;
+    }
+    fclose(f_metadata);
+    int vector_layout = layout_flags & 1;
+    int link_layout = (layout_flags >> 1) & 1;
+    std::cout << "vector_layout=" << (vector_layout == VECTOR_LAYOUT_COMPACT? "compact" : "padded") << std::endl;
+    std::cout << "link_layout=" << (link_layout == LINK_LAYOUT_PACKED? "packed" : "original") << std::endl;
+    if ((layout_flags >> 2) & 1) {
+        // the neighbor codes in the links (bit 2) change the node stride, only FPGA_intra_query_v1.5 reads them
+        std::cout << "Indexes with neighbor codes are not supported by this kernel" << std::endl;
+        exit(1);
+    }
+    // the vector type the index was converted with (hnsw_nsg_to_FPGA --vector_type) has to be the compiled one
+    int vector_type = (layout_flags >> 3) & 3;
+    if (vector_type != VECTOR_TYPE) {
+        std::cout << "The index stores vector type " << vector_type << ", but the kernel is compiled with VECTOR_TYPE " <<
+            VECTOR_TYPE << " (0 = fp32, 1 = fp16, 2 = int8, see constants.hpp)" << std::endl;
+        exit(1);
+    }
+    
+    size_t bytes_per_vec = d * sizeof(float);
+    size_t bytes_per_db_vec_plus_padding = d % 16 == 0? d * sizeof(float) : (d + 16 - d % 16) * sizeof(float);
+	assert (bytes_per_db_vec_plus_padding % 64 == 0);
+	int d_after_padding = bytes_per_db_vec_plus_padding / sizeof(float);
+    // database vectors are stored as VECTOR_TYPE (fp32 / fp16 / int8), see constants.hpp
+    size_t bytes_per_db_vec_in_index = vector_layout == VECTOR_LAYOUT_COMPACT? db_vec_AXI_num * 64 : db_vec_AXI_num * 64 + 64;
+    size_t bytes_entry_vector = bytes_per_db_vec_plus_padding;
+    size_t bytes_entry_point_ids = query_num * sizeof(int);
+    size_t bytes_query_vectors = query_num * query_AXI_num * 64; // int8: + per-dimension weights
+    size_t bytes_out_id = query_num * ef * sizeof(int);
+    size_t bytes_out_dist = query_num * ef * sizeof(float);	
+    size_t bytes_mem_debug = query_num * 5 * sizeof(int);
+
+    // each group holds the entire graph: the index of channels_per_group channels if present, otherwise the 
+    //   1-channel index (which serves any grouping), channel c loads the file c % index_channels
+    int index_channels = channels_per_group;
+    if (channels_per_group > 1 && 
+        GetFileSize(IndexLoader::channel_fnames(index_dir, "ground_vectors", channels_per_group)[0]) <= 0) {
+        index_channels = 1;
+    }
+    int index_channel_bits = 0;
+    while ((1 << index_channel_bits) < index_channels) { index_channel_bits++; }
+    std::cout << "index_channels=" << index_channels << std::endl;
+    std::vector<std::string> fnames_ground_vectors;
+    std::vector<std::string> fnames_ground_links;
+    for (int c = 0; c < N_CHANNEL; c++) {
+        fnames_ground_vectors.push_back(IndexLoader::channel_fnames(index_dir, "ground_vectors", index_channels)[c % index_channels]);
+        fnames_ground_links.push_back(IndexLoader::channel_fnames(index_dir, "ground_links", index_channels)[c % index_channels]);
+    }
+
+    // node ID -> label: ground_labels.bin, or channel_placement_N.bin of a channel-balanced index
+#ifdef CHANNEL_PLACEMENT_BALANCED
+    ResultLabels result_labels(index_dir, graph_type, N_CHANNEL, CHANNEL_ADDR_BITS, /* balanced_placement */ true);
+#else
+    ResultLabels result_labels(index_dir, graph_type, N_CHANNEL, CHANNEL_ADDR_BITS, /* balanced_placement */ false);
+#endif
+
+FILE* f_query_vectors = fopen(fname_query_vectors.c_str(), "rb");
+FILE* f_gt_vec_ID = fopen(fname_gt_vec_ID.c_str(), "rb");
+FILE* f_gt_dist = fopen(fname_gt_dist.c_str(), "rb");
+
+// get file size
+    size_t raw_query_vectors_size = GetFileSize(fname_query_vectors);
+    size_t raw_gt_vec_ID_size = GetFileSize(fname_gt_vec_ID);
+    size_t raw_gt_dist_size = GetFileSize(fname_gt_dist);
+    std::cout << "raw_query_vectors_size=" << raw_query_vectors_size << std::endl;
+
+    // input vecs
+    std::vector<int, aligned_allocator<int>> entry_point_ids(bytes_entry_point_ids / sizeof(int));
+    std::vector<float, aligned_allocator<float>> query_vectors(bytes_query_vectors / sizeof(float));
+
+    
+    // output
+    std::vector<int, aligned_allocator<int>> out_id(bytes_out_id / sizeof(int));
+    std::vector<float, aligned_allocator<float>> out_dist(bytes_out_dist / sizeof(float));
+    std::vector<int, aligned_allocator<int>> mem_debug(bytes_mem_debug / sizeof(int));
+
+    // intermediate buffer for queries, and ground truth
+	// init query vectors as zeros (there will be paddings in some cases for unusual d)
+    std::vector<char> raw_query_vectors(raw_query_vectors_size / sizeof(char));
+	memset(raw_query_vectors.data(), 0, raw_query_vectors_size);
+    std::vector<int> raw_gt_vec_ID(raw_gt_vec_ID_size / sizeof(int));
+    std::vector<float> raw_gt_dist(raw_gt_dist_size / sizeof(float));
+
+    int max_topK = 100; // cutting ground truth to with only 100 top queries
+    std::vector<int> gt_vec_ID(query_num * max_topK);
+    std::vector<float> gt_dist(query_num * max_topK);
+
+    // read data from file
+    std::cout << "Loading database vectors and base links (" << index_load_mode << ")...\n";
+    auto start_load = std::chrono::high_resolution_clock::now();
+    IndexLoader index_loader(/* populate */ index_load_mode != "mmap", /* huge_pages */ index_load_mode == "huge_pages");
+    index_loader.load(fnames_ground_vectors, fnames_ground_links);
+    auto end_load = std::chrono::high_resolution_clock::now();
+    std::cout << "Index loading time: " << 
+        std::chrono::duration_cast<std::chrono::milliseconds>(end_load - start_load).count() << " ms" << std::endl;
+    for (int c = 0; c < N_CHANNEL; c++) {
+        std::cout << "bytes_db_vectors_chan_" << c << "=" << index_loader.db_vectors[c].bytes << 
+            "\tbytes_links_base_chan_" << c << "=" << index_loader.links_base[c].bytes << std::endl;
+    }
+    assert(bytes_per_db_vec_in_index * num_db_vec * (N_CHANNEL / index_channels) == index_loader.total_db_vectors_bytes());
+
+    UpperLayerSearch upper_layer_search(num_db_vec, max_level, entry_point_id, max_link_num_upper);
+    bool use_upper_layers = false;
+    if (graph_type == "HNSW" && entry_point_mode == "upper_layers") {
+#if VECTOR_TYPE == VECTOR_TYPE_FP32 && !defined(CHANNEL_PLACEMENT_BALANCED)
+        std::vector<const char*> db_vectors_per_channel;
+        for (int c = 0; c < index_channels; c++) { db_vectors_per_channel.push_back((const char*) index_loader.db_vectors[c].ptr); }
+        use_upper_layers = upper_layer_search.load(index_dir, db_vectors_per_channel, bytes_per_db_vec_in_index, d);
+#endif
+        if (!use_upper_layers) {
+            std::cout << "No upper layers found (or not fp32 / round-robin placement), " << 
+                "using the entry point of meta.bin for all queries" << std::endl;
+        }
+    }
+
+    std::cout << "Reading queries and ground truths from file...\n";
+    fread(raw_query_vectors.data(), 1, raw_query_vectors_size, f_query_vectors);
+    fclose(f_query_vectors);
+    fread(raw_gt_vec_ID.data(), 1, raw_gt_vec_ID_size, f_gt_vec_ID);
+    fclose(f_gt_vec_ID);
+    fread(raw_gt_dist.data(), 1, raw_gt_dist_size, f_gt_dist);
+    fclose(f_gt_dist);
+    
+    if (dataset == "SIFT1M" || dataset == "SIFT10M") {
+        size_t len_per_query = 4 + d;
+        // conversion from uint8 to float
+        for (int qid = 0; qid < query_num_after_offset; qid++) {
+            for (int i = 0; i < d; i++) {
+                query_vectors[qid * d + i] = (float) raw_query_vectors[(qid + query_offset) * len_per_query + 4 + i];
+            }
+        }
+        // ground truth = 4-byte ID + 1000 * 4-byte ID + 1000 or 4-byte distances
+        size_t len_per_gt = 1001;
+        for (int qid = 0; qid < query_num_after_offset; qid++) {
+            for (int i = 0; i < max_topK; i++) {
+                gt_vec_ID[qid * max_topK + i] = raw_gt_vec_ID[(qid + query_offset) * len_per_gt + 1 + i];
+                gt_dist[qid * max_topK + i] = raw_gt_dist[(qid + query_offset) * len_per_gt + 1 + i];
+            }
+        }
+    } else if (dataset == "Deep1M" || dataset == "Deep10M" || dataset == "GLOVE") {
+        // queries: fbin, ground truth: ibin, first 8 bytes are num vec & dim
+        size_t len_per_query = d * sizeof(float);
+        size_t offset_bytes = 8; // first 8 bytes are num vec & dim
+        for (int qid = 0; qid < query_num_after_offset; qid++) {
+            memcpy(&query_vectors[qid * d], &raw_query_vectors[(qid + query_offset) * len_per_query + offset_bytes], len_per_query);
+        }
+        size_t len_per_gt = 1000;
+        size_t offset = 2; // first 8 bytes are num vec & dim
+        for (int qid = 0; qid < query_num_after_offset; qid++) {
+            for (int i = 0; i < max_topK; i++) {
+                gt_vec_ID[qid * max_topK + i] = raw_gt_vec_ID[(qid + query_offset) * len_per_gt + offset + i];
+                gt_dist[qid * max_topK + i] = raw_gt_dist[(qid + query_offset) * len_per_gt + offset + i];
+            }
+        }
+    } else if (dataset == "SPACEV1M" || dataset == "SPACEV10M") {
+        // queries: fbin, ground truth: ibin, first 8 bytes are num vec & dim
+        size_t len_per_query = d * sizeof(char);
+        size_t offset_bytes = 8; // first 8 bytes are num vec & dim
+
+		// raw query vectors are in int8 format, need to convert to flow format for query_vectors
+        for (int qid = 0; qid < query_num_after_offset; qid++) {
+			for (int i = 0; i < d; i++) {
+				// first load as unsigned int, thus reducing offset of 128 between int8 and uint8
+				float val = (float) raw_query_vectors[(qid + query_offset) * len_per_query + offset_bytes + i];
+				query_vectors[qid * d_after_padding + i] = val;
+			}
+        }
+		// print out first query (include padding):
+		// std::cout << "First query: ";
+		// for (int i = 0; i < d_after_padding; i++) {
+		// 	std::cout << query_vectors[i] << " ";
+		// }
+        size_t len_per_gt = 1000;
+        size_t offset = 2; // first 8 bytes are num vec & dim
+        for (int qid = 0; qid < query_num_after_offset; qid++) {
+            for (int i = 0; i < max_topK; i++) {
+                gt_vec_ID[qid * max_topK + i] = raw_gt_vec_ID[(qid + query_offset) * len_per_gt + offset + i];
+                gt_dist[qid * max_topK + i] = raw_gt_dist[(qid + query_offset) * len_per_gt + offset + i];
+            }
+        }
+    } else if (dataset == "SBERT1M") {
+        // queries: raw bin, ground truth: ibin, first 8 bytes are num vec & dim
+        size_t len_per_query = d * sizeof(float);
+        size_t offset_bytes = 0; // raw bin
+        for (int qid = 0; qid < query_num_after_offset; qid++) {
+            memcpy(&query_vectors[qid * d], &raw_query_vectors[(qid + query_offset) * len_per_query + offset_bytes], len_per_query);
+        }
+        size_t len_per_gt = 1000;
+        size_t offset = 2; // first 8 bytes are num vec & dim
+        for (int qid = 0; qid < query_num_after_offset; qid++) {
+            for (int i = 0; i < max_topK; i++) {
+                gt_vec_ID[qid * max_topK + i] = raw_gt_vec_ID[(qid + query_offset) * len_per_gt + offset + i];
+                gt_dist[qid * max_topK + i] = raw_gt_dist[(qid + query_offset) * len_per_gt + offset + i];
+            }
+        }
+    } else {
+        std::cout << "Unsupported dataset\n";
+        exit(1);
+    }
+
+#if VECTOR_TYPE == VECTOR_TYPE_INT8
+    // int8 vectors: x[d] = scale[d] * code[d] + offset[d], send (q[d] - offset[d]) / scale[d] followed by
+    //   the weights scale[d]^2 per query; the queries are expanded in place from the last one
+    {
+        std::string fname_quantization = concat_dir(index_dir, "vector_quantization.bin");
+        if (GetFileSize(fname_quantization) != (long) (2 * d * sizeof(float))) {
+            std::cout << "VECTOR_TYPE_INT8 requires " << fname_quantization << std::endl;
+            exit(1);
+        }
+        std::vector<float> scale_offset(2 * d);
+        FILE* f_quantization = fopen(fname_quantization.c_str(), "rb");
+        fread(scale_offset.data(), sizeof(float), 2 * d, f_quantization);
+        fclose(f_quantization);
+        std::vector<float> q(d);
+        for (int qid = query_num_after_offset - 1; qid >= 0; qid--) {
+            memcpy(q.data(), &query_vectors[qid * d_after_padding], d * sizeof(float));
+            float* out = &query_vectors[qid * 2 * d_after_padding];
+            memset(out, 0, 2 * d_after_padding * sizeof(float));
+            for (int i = 0; i < d; i++) {
+                out[i] = (q[i] - scale_offset[d + i]) / scale_offset[i];
+                out[d_after_padding + i] = scale_offset[i] * scale_offset[i];
+            }
+        }
+    }
+#endif
+
+    for (int qid = 0; qid < query_num_after_offset; qid++) {
+        entry_point_ids[qid] = entry_point_id;
+    }
+
+// OPENCL HOST CODE AREA START
+
+    cl_int err;
+    // Allocate Memory in Host Memory
+    // When creating a buffer with user pointer (CL_MEM_USE_HOST_PTR), under the hood user ptr 
+    // is used if it is properly aligned. when not aligned, runtime had no choice but to create
+    // its own host side buffer. So it is recommended to use this allocator if user wish to
+    // create buffer using CL_MEM_USE_HOST_PTR to align user buffer to page boundary. It will 
+    // ensure that user buffer is used when user create Buffer/Mem object with CL_MEM_USE_HOST_PTR 
+
+    std::vector<cl::Device> devices = get_devices();
+    cl::Device device = devices[0];
+    std::string device_name = device.getInfo<CL_DEVICE_NAME>();
+    std::cout << "Found Device=" << device_name.c_str() << std::endl;
+
+    //Creating Context and Command Queue for selected device
+    cl::Context context(device);
+    cl::CommandQueue q(context, device);
+
+    // Import XCLBIN
+    xclbin_file_name = argv[1];
+    cl::Program::Binaries vadd_bins = import_binary_file();
+
+    // Program and Kernel
+    devices.resize(1);
+    cl::Program program(context, devices, vadd_bins);
+    cl::Kernel krnl_vector_add(program, "vadd");
+
+    std::cout << "Finish loading bitstream...\n";
+    // in 
+    OCL_CHECK(err, cl::Buffer buffer_entry_point_ids (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
+            bytes_entry_point_ids, entry_point_ids.data(), &err));
+    OCL_CHECK(err, cl::Buffer buffer_query_vectors (context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
+            bytes_query_vectors, query_vectors.data(), &err));
+            
+    std::vector<cl::Buffer> buffer_links_base(N_CHANNEL);
+    for (int c = 0; c < N_CHANNEL; c++) {
+        OCL_CHECK(err, buffer_links_base[c] = cl::Buffer(context,CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
+            index_loader.links_base[c].bytes, index_loader.links_base[c].ptr, &err));
+    }
+
+    // in & out (db vec is mixed with visited list)
+    std::vector<cl::Buffer> buffer_db_vectors(N_CHANNEL);
+    for (int c = 0; c < N_CHANNEL; c++) {
+        OCL_CHECK(err, buffer_db_vectors[c] = cl::Buffer(context,CL_MEM_USE_HOST_PTR,
+            index_loader.db_vectors[c].bytes, index_loader.db_vectors[c].ptr, &err));
+    }
+
+    // out
+    OCL_CHECK(err, cl::Buffer buffer_out_id (context,CL_MEM_USE_HOST_PTR,// | CL_MEM_WRITE_ONLY,
+            bytes_out_id, out_id.data(), &err));
+    OCL_CHECK(err, cl::Buffer buffer_out_dist (context,CL_MEM_USE_HOST_PTR,// | CL_MEM_WRITE_ONLY,
+            bytes_out_dist, out_dist.data(), &err));
+    OCL_CHECK(err, cl::Buffer buffer_mem_debug (context,CL_MEM_USE_HOST_PTR,// | CL_MEM_WRITE_ONLY,
+            bytes_mem_debug, mem_debug.data(), &err));
+
+    std::cout << "Finish allocate buffer...\n";
+
+    int arg_counter = 0;    
+    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, int(query_num)));
+    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, int(query_batch_size)));
+    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, int(ef)));
+    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, int(candidate_queue_runtime_size)));
+    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, int(max_cand_per_group)));
+    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, int(max_group_num_in_pipe)));
+    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, int(runtime_n_bucket_addr_bits)));
+    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, int(hash_seed)));
+    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, int(max_bloom_out_burst_size)));
+    // OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, int(d)));
+    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, int(max_link_num_base)));
+    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, int(vector_layout)));
+    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, int(link_layout)));
+    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, int(num_query_contexts)));
+    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, int(channel_group_bits)));
+    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, int(index_channel_bits)));
+
+    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_entry_point_ids));
+    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_query_vectors));
+
+    for (int c = 0; c < N_CHANNEL; c++) {
+        OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_db_vectors[c]));
+    }
+    for (int c = 0; c < N_CHANNEL; c++) {
+        OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_links_base[c]));
+    }
+
+    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_out_id));
+    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_out_dist));
+    OCL_CHECK(err, err = krnl_vector_add.setArg(arg_counter++, buffer_mem_debug));
+
+    // Copy input data to device global memory; the entry points are migrated last, as they are 
+    //   computed on the host while the index is migrated
+    std::vector<cl::Memory> buffers_in = {buffer_query_vectors};
+    buffers_in.insert(buffers_in.end(), buffer_links_base.begin(), buffer_links_base.end());
+    // in & out
+    buffers_in.insert(buffers_in.end(), buffer_db_vectors.begin(), buffer_db_vectors.end());
+    OCL_CHECK(err, err = q.enqueueMigrateMemObjects(buffers_in, 0/* 0 means from host*/));
+    OCL_CHECK(err, err = q.flush());
+
+    if (use_upper_layers) {
+        auto start_upper = std::chrono::high_resolution_clock::now();
+        upper_layer_search.search(query_vectors.data(), query_num_after_offset, d_after_padding, entry_point_ids.data());
+        auto end_upper = std::chrono::high_resolution_clock::now();
+        std::cout << "Upper layer search (overlapped with the index migration): " << 
+            std::chrono::duration_cast<std::chrono::milliseconds>(end_upper - start_upper).count() << " ms, " <<
+            "average #hops on upper layers=" << upper_layer_search.average_hops << std::endl;
+    }
+    OCL_CHECK(err, err = q.enqueueMigrateMemObjects({buffer_entry_point_ids}, 0/* 0 means from host*/));
+
+    std::cout << "Launching kernel...\n";
+    // Launch the Kernel
+    auto start = std::chrono::high_resolution_clock::now();
+    OCL_CHECK(err, err = q.enqueueTask(krnl_vector_add));
+
+    // Copy Result from Device Global Memory to Host Local Memory
+    OCL_CHECK(err, err = q.enqueueMigrateMemObjects({
+        buffer_out_id, buffer_out_dist, buffer_mem_debug}, CL_MIGRATE_MEM_OBJECT_HOST));
+    q.finish();
+
+    auto end = std::chrono::high_resolution_clock::now();
+    double duration = (std::chrono::duration_cast<std::chrono::milliseconds>(end-start).count() / 1000.0);
+
+    std::cout << "Duration (including memcpy out): " << duration << " sec" << std::endl; 
+
+    // Translate physical node IDs to real label IDs
+    result_labels.translate(out_id.data(), query_num * ef);
+
+#ifdef DEBUG
+    // print out the debug signals (each 4 byte):
+
+    // debug signals (each 4 byte): 
+    //   0: number of hops in base layer (number of pop operations)
+    int print_qnum = 10 < query_num? 10 : query_num;
+    for (int i = 0; i < print_qnum; i++) {
+        std::cout << "query " << i << "\t#hops (base layer) =" << mem_debug[i * debug_size];
+        if (gt_vec_ID[i * max_topK] != out_id[i * ef]) {
+                std::cout << "Mismatch ";
+        }    
+        std::cout << "gt ID: " << gt_vec_ID[i * max_topK] << "\tgt dist: " << gt_dist[i * max_topK] 
+			<< "\thw ID: " << out_id[i * ef] << "\thw dist: " << out_dist[i * ef] <<   std::endl;
+    }
+#endif
+
+    // verify top-1 result
+    std::cout << "Verifying top-1 and top-10 result...\n";
+    int top1_correct_count = 0;
+    int top10_correct_count = 0;
+    int k = 1;
+
+    int dist_match_id_mismatch_cnt = 0;
+
+    for (int qid = 0; qid < query_num_after_offset; qid++) {
+
+        k = 1;
+        for (int i = 0; i < k; i++) {
+            int gt = gt_vec_ID[qid * max_topK];
+            // float gt_dist_cur = gt_dist[qid * max_topK];
+            int hw_id = out_id[qid * ef];
+            // float hw_dist = out_dist[qid * ef];
+            
+            if (hw_id == gt) {
+                top1_correct_count++;
+            } else if (out_dist[qid * ef] == gt_dist[qid * max_topK]) {
+                std::cout << "qid = " << qid << " Distance is the same" << " hw dist: " << out_dist[qid * ef] << " gt dist: " << gt_dist[qid * max_topK] <<
+                    "hw id: " << hw_id << " gt id: " << gt << std::endl; 
+                dist_match_id_mismatch_cnt++;
+            }
+        }
+
+        // Check top-10 recall
+        k = 10;
+        for (int i = 0; i < k; i++) {
+            int gt = gt_vec_ID[qid * max_topK + i];
+            // check if it matches any top-10 ground truth
+            for (int j = 0; j < k; j++) {
+                int hw_id = out_id[qid * ef + j];
+                if (hw_id == gt) {
+                    top10_correct_count++;
+                    break;
+                }
+            }
+        }
+    }
+
+    // Print recall
+    std::cout << "Recall@1=" << (float) top1_correct_count / query_num_after_offset << std::endl;
+    std::cout << "Recall@10=" << (float) top10_correct_count / (query_num_after_offset * 10) << std::endl;
+
+    std::cout << "Dist match id mismatch count=" << dist_match_id_mismatch_cnt << std::endl;
+
+    // count avg #hops on base layer
+    if (debug_size == 2) {
+        int total_hops = 0;
+        int total_visited_nodes = 0;
+        for (int i = 0; i < query_num_after_offset; i++) {
+            total_hops += mem_debug[2 * i];
+            total_visited_nodes += mem_debug[2 * i + 1];
+        }
+        std::cout << "Average #hops on base layer=" << (float) total_hops / query_num_after_offset << std::endl;
+        std::cout << "Average #visited nodes=" << (float) total_visited_nodes / query_num_after_offset << std::endl;
+    } else if (debug_size == 1) {
+        int total_hops = 0;
+        for (int i = 0; i < query_num_after_offset; i++) {
+            total_hops += mem_debug[i];
+        }
+        std::cout << "Average #hops on base layer=" << (float) total_hops / query_num_after_offset << std::endl;
+    }
+
+    return  0;
+}
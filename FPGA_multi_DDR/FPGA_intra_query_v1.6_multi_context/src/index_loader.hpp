@@ -0,0 +1,165 @@
+#pragma once
+
+// IndexLoader: map the per-channel graph index files (ground_vectors_N_chan_i.bin
+//   and ground_links_N_chan_i.bin) into page-aligned host memory, one thread per file.
+//
+// The returned pointers are page-aligned, thus can be passed directly to
+//   cl::Buffer with CL_MEM_USE_HOST_PTR without XRT allocating a shadow copy.
+//
+// Two loading modes:
+//   mmap (default): MAP_PRIVATE file mapping, optionally with MAP_POPULATE such that
+//     the page faults are taken inside the loader threads instead of during migration.
+//     MAP_PRIVATE is copy-on-write, such that no write into the buffers can reach the
+//     index files on disk. The kernels only read them: the visited tags are kept in the
+//     Bloom filters, and the compact layout has no visited padding after the vectors.
+//   huge pages: anonymous MAP_HUGETLB mapping (2MB pages) filled by pread, falling
+//     back to transparent huge pages (madvise) if no huge pages are reserved.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <iostream>
+
+struct MappedFile {
+    std::string fname;
+    void* ptr = nullptr;
+    size_t bytes = 0; // file size
+    size_t bytes_mapped = 0; // mapping size, rounded up to pages
+};
+
+class IndexLoader {
+
+public:
+
+    bool populate; // MAP_POPULATE (ignored in huge page mode, where pages are always filled)
+    bool huge_pages;
+
+    // one per channel, in channel order
+    std::vector<MappedFile> db_vectors;
+    std::vector<MappedFile> links_base;
+
+    IndexLoader(bool populate = true, bool huge_pages = false) :
+        populate(populate), huge_pages(huge_pages) {}
+
+    ~IndexLoader() {
+        for (auto& f : db_vectors) { unmap(f); }
+        for (auto& f : links_base) { unmap(f); }
+    }
+
+    IndexLoader(const IndexLoader&) = delete;
+    IndexLoader& operator=(const IndexLoader&) = delete;
+
+    // Per-channel file names, e.g., ground_vectors_4_chan_0.bin ... ground_vectors_4_chan_3.bin
+    //   replicate = true: every channel gets ground_vectors_1_chan_0.bin (inter-query parallel)
+    static std::vector<std::string> channel_fnames(
+        std::string index_dir, std::string prefix, int n_channel, bool replicate = false) {
+
+        if (index_dir.back() != '/') { index_dir += '/'; }
+        std::vector<std::string> fnames(n_channel);
+        for (int c = 0; c < n_channel; c++) {
+            if (replicate) {
+                fnames[c] = index_dir + prefix + "_1_chan_0.bin";
+            } else {
+                fnames[c] = index_dir + prefix + "_" + std::to_string(n_channel) + "_chan_" + std::to_string(c) + ".bin";
+            }
+        }
+        return fnames;
+    }
+
+    // Load all channels in parallel; exit on failure as the host programs do for OCL errors
+    void load(const std::vector<std::string>& fnames_db_vectors, const std::vector<std::string>& fnames_links_base) {
+
+        db_vectors.resize(fnames_db_vectors.size());
+        links_base.resize(fnames_links_base.size());
+        for (size_t c = 0; c < fnames_db_vectors.size(); c++) { db_vectors[c].fname = fnames_db_vectors[c]; }
+        for (size_t c = 0; c < fnames_links_base.size(); c++) { links_base[c].fname = fnames_links_base[c]; }
+
+        std::vector<std::thread> threads;
+        std::vector<int> success(db_vectors.size() + links_base.size(), 0);
+        int tid = 0;
+        for (auto& f : db_vectors) { threads.emplace_back([this, &f, &success, tid] { success[tid] = map(f); }); tid++; }
+        for (auto& f : links_base) { threads.emplace_back([this, &f, &success, tid] { success[tid] = map(f); }); tid++; }
+        for (auto& t : threads) { t.join(); }
+
+        for (size_t i = 0; i < success.size(); i++) {
+            if (!success[i]) {
+                std::cout << "IndexLoader: failed to load " <<
+                    (i < db_vectors.size()? db_vectors[i].fname : links_base[i - db_vectors.size()].fname) << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    size_t total_db_vectors_bytes() const {
+        size_t total = 0;
+        for (auto& f : db_vectors) { total += f.bytes; }
+        return total;
+    }
+
+private:
+
+    static size_t round_up(size_t bytes, size_t align) {
+        return (bytes + align - 1) / align * align;
+    }
+
+    int map(MappedFile& f) {
+
+        int fd = open(f.fname.c_str(), O_RDONLY);
+        if (fd < 0) { perror(f.fname.c_str()); return 0; }
+        struct stat stat_buf;
+        if (fstat(fd, &stat_buf) != 0 || stat_buf.st_size == 0) { close(fd); return 0; }
+        f.bytes = stat_buf.st_size;
+
+        int ret = huge_pages? map_huge(f, fd) : map_file(f, fd);
+        close(fd); // the mapping keeps its own reference to the file
+        return ret;
+    }
+
+    int map_file(MappedFile& f, int fd) {
+
+        f.bytes_mapped = round_up(f.bytes, sysconf(_SC_PAGESIZE));
+        int flags = MAP_PRIVATE;
+        if (populate) { flags |= MAP_POPULATE; }
+        void* ptr = mmap(nullptr, f.bytes_mapped, PROT_READ | PROT_WRITE, flags, fd, 0);
+        if (ptr == MAP_FAILED) { perror("mmap"); return 0; }
+        madvise(ptr, f.bytes_mapped, MADV_WILLNEED);
+        f.ptr = ptr;
+        return 1;
+    }
+
+    int map_huge(MappedFile& f, int fd) {
+
+        const size_t huge_page_size = 2 * 1024 * 1024;
+        f.bytes_mapped = round_up(f.bytes, huge_page_size);
+        void* ptr = mmap(nullptr, f.bytes_mapped, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (ptr == MAP_FAILED) {
+            // no reserved huge pages (/proc/sys/vm/nr_hugepages), try transparent huge pages
+            ptr = mmap(nullptr, f.bytes_mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (ptr == MAP_FAILED) { perror("mmap"); return 0; }
+            madvise(ptr, f.bytes_mapped, MADV_HUGEPAGE);
+        }
+        f.ptr = ptr;
+
+        size_t total_read_bytes = 0;
+        while (total_read_bytes < f.bytes) {
+            ssize_t read_bytes = pread(fd, (char*) ptr + total_read_bytes, f.bytes - total_read_bytes, total_read_bytes);
+            if (read_bytes <= 0) { perror("pread"); return 0; }
+            total_read_bytes += read_bytes;
+        }
+        return 1;
+    }
+
+    static void unmap(MappedFile& f) {
+        if (f.ptr) { munmap(f.ptr, f.bytes_mapped); }
+        f.ptr = nullptr;
+    }
+};
@@ -0,0 +1,211 @@
+#pragma once
+
+#include "types.hpp"
+
+// Up to runtime_num_query_contexts queries are searched at the same time, each in its own context 
+//   (candidate queue, on-the-fly batch count), such that the batches of one query fill the pipeline bubbles 
+//   of the others. A context is reused only after its finish signal (context ID) has returned from the 
+//   pipeline, thus the PEs can keep the per-context state without checking for in-flight data.
+void task_scheduler(
+	const int candidate_queue_runtime_size,
+	const int max_cand_batch_size, 
+	const int max_async_stage_num,
+	const int runtime_num_query_contexts, // 1 ~ NUM_QUERY_CONTEXTS
+
+	// in streams
+	hls::stream<int>& s_query_batch_size, // -1: stop
+	hls::stream<ap_uint<512>>& s_query_vectors_in,	
+	hls::stream<int>& s_entry_point_ids, 
+	hls::stream<int>& s_num_inserted_candidates,
+	hls::stream<result_t>& s_inserted_candidates,
+	hls::stream<result_t>& s_largest_result_queue_elements, // dist + context ID
+	hls::stream<int>& s_finish_query_in,
+
+	// out streams
+	hls::stream<ap_uint<512>> (&s_query_vectors_replicated)[N_CHANNEL],
+	hls::stream<int>& s_cand_batch_size, 
+	hls::stream<int> (&s_cand_batch_ctx_ids)[2], // 0: split_tasks_to_channels, 1: results_collection
+	hls::stream<cand_t>& s_top_candidates,
+	hls::stream<int>& s_debug_signals,
+	hls::stream<int>& s_finished_query_ids, // to write_results
+	hls::stream<int>& s_finish_query_out
+) {
+
+	
+	// similar to hsnwlin function `searchKnn`: https://github.com/nmslib/hnswlib/blob/master/hnswlib/hnswalg.h#L1271
+	const int vec_AXI_num = query_AXI_num; // including the int8 weights
+	bool first_s_query_batch_size = true;
+	bool first_s_query_vectors = true;
+	bool first_s_entry_point_ids = true;
+	bool first_iter_s_inserted_candidates = true;
+	bool first_iter_s_largest_result_queue_elements = true;
+
+	Priority_queue<result_t, hardware_candidate_queue_size, Collect_smallest> candidate_queues[NUM_QUERY_CONTEXTS];
+#pragma HLS array_partition variable=candidate_queues complete
+	for (int c = 0; c < NUM_QUERY_CONTEXTS; c++) {
+	#pragma HLS unroll
+		candidate_queues[c].init(candidate_queue_runtime_size);
+	}
+
+	// per-context state
+	bool context_busy[NUM_QUERY_CONTEXTS];
+#pragma HLS array_partition variable=context_busy complete
+	int on_the_fly_async_stage_num[NUM_QUERY_CONTEXTS];
+#pragma HLS array_partition variable=on_the_fly_async_stage_num complete
+	int query_ids[NUM_QUERY_CONTEXTS];
+#pragma HLS array_partition variable=query_ids complete
+	int debug_hops_base_layer[NUM_QUERY_CONTEXTS];
+#pragma HLS array_partition variable=debug_hops_base_layer complete
+
+	// the batches return in the order they are issued, regardless of the context
+	int batch_ctx_ids[hardware_max_batches_in_flight];
+	int batch_head = 0; // oldest batch on the fly
+	int batch_tail = 0; // next batch to issue
+
+	int processed_query_num = 0; // across batches, the position of the results in DRAM
+
+	while (true) {
+
+		wait_data_fifo_first_iter<int>(
+			1, s_query_batch_size, first_s_query_batch_size);
+		int query_num = s_query_batch_size.read();
+		if (query_num == -1) {
+			break;
+		}
+
+		for (int c = 0; c < NUM_QUERY_CONTEXTS; c++) {
+		#pragma HLS unroll
+			context_busy[c] = false;
+		}
+		int busy_context_num = 0;
+		int started_query_num = 0;
+		int finished_query_num = 0;
+
+		// regardless of batch size, pull one time from each channel
+		int recv_channels_left = N_CHANNEL;
+
+		while (finished_query_num < query_num) {
+
+			if (!s_finish_query_in.empty()) {
+				// the finish signal has passed all PEs: the context can be reused
+				int ctx_id = s_finish_query_in.read();
+				context_busy[ctx_id] = false;
+				busy_context_num--;
+				finished_query_num++;
+			} else if (started_query_num < query_num && busy_context_num < runtime_num_query_contexts) {
+
+				int ctx_id = 0;
+				for (int c = NUM_QUERY_CONTEXTS - 1; c >= 0; c--) {
+				#pragma HLS unroll
+					if (c < runtime_num_query_contexts && !context_busy[c]) {
+						ctx_id = c;
+					}
+				}
+				context_busy[ctx_id] = true;
+				busy_context_num++;
+
+				// send out query vector, after a header word with the context ID
+				ap_uint<512> query_header = 0;
+				query_header.range(31, 0) = ctx_id;
+				for (int cid = 0; cid < N_CHANNEL; cid++) {
+				#pragma HLS unroll
+					s_query_vectors_replicated[cid].write(query_header);
+				}
+				wait_data_fifo_first_iter<ap_uint<512>>(
+					1, s_query_vectors_in, first_s_query_vectors);
+				for (int i = 0; i < vec_AXI_num; i++) {
+				#pragma HLS pipeline II=1
+					ap_uint<512> query_vector_AXI = s_query_vectors_in.read();
+					for (int cid = 0; cid < N_CHANNEL; cid++) {
+					#pragma HLS unroll
+						s_query_vectors_replicated[cid].write(query_vector_AXI);
+					}
+				}
+
+				// search base layer
+				candidate_queues[ctx_id].reset_queue(); // reset content to large_float
+				// first task
+				wait_data_fifo_first_iter<int>(
+					1, s_entry_point_ids, first_s_entry_point_ids);
+				int entry_point_id = s_entry_point_ids.read();
+				s_top_candidates.write({entry_point_id, 0, ctx_id});
+				s_cand_batch_size.write(1);
+				s_cand_batch_ctx_ids[0].write(ctx_id);
+				s_cand_batch_ctx_ids[1].write(ctx_id);
+				batch_ctx_ids[batch_tail] = ctx_id;
+				batch_tail = batch_tail == hardware_max_batches_in_flight - 1? 0 : batch_tail + 1;
+
+				// Note: entry point must not be sent to the result queue: if the entry point
+				//   is close to the query, the neighbors of entry point will be inserted into the queue, which will then search entry,
+				//   adding entry to the result immediately will lead to visit tag mismatch as entry can be inserted twice into the result queue
+
+				on_the_fly_async_stage_num[ctx_id] = 1;
+				debug_hops_base_layer[ctx_id] = 1;
+				query_ids[ctx_id] = processed_query_num + started_query_num;
+				started_query_num++;
+
+			} else if (!s_num_inserted_candidates.empty()) { // each channel send a number, regardless of per-iter batch size
+
+				int ctx_id = batch_ctx_ids[batch_head];
+
+				int num_insertion = s_num_inserted_candidates.read();
+				wait_data_fifo_first_iter<result_t>(
+					num_insertion, s_inserted_candidates, first_iter_s_inserted_candidates);
+				// insert new values
+				candidate_queues[ctx_id].insert_only(num_insertion, s_inserted_candidates);
+				recv_channels_left--; // always loading the latest-sent batch 
+				
+				// if all last batch of candidates are consumed, sort & pop top candidate
+				if (recv_channels_left == 0) {
+					// finish a on-the-fly batch, shift the batch_size in the array
+					batch_head = batch_head == hardware_max_batches_in_flight - 1? 0 : batch_head + 1;
+					on_the_fly_async_stage_num[ctx_id]--;
+					candidate_queues[ctx_id].sort();
+
+					// two stop condition: 1. smallest candidate distance > largest result queue element; 
+					//  2. candidate queue is empty (which also means the first condition is satisfied), so only need to check (1)
+					wait_data_fifo_first_iter<result_t>(
+						1, s_largest_result_queue_elements, first_iter_s_largest_result_queue_elements);
+					float threshold = s_largest_result_queue_elements.read().dist; // of the same context as the batch
+					const int smallest_element_position = candidate_queue_runtime_size - 1;
+					
+					// send tasks until filling the pipeline
+					for (int oid = on_the_fly_async_stage_num[ctx_id]; oid < max_async_stage_num; oid++) {
+						int current_cand_batch_size = 0;
+						for (int bid = 0; bid < max_cand_batch_size; bid++) {
+							if (candidate_queues[ctx_id].queue[smallest_element_position].dist <= threshold &&
+								candidate_queues[ctx_id].queue[smallest_element_position].dist < large_float) {
+								candidate_queues[ctx_id].pop_top(s_top_candidates);
+								debug_hops_base_layer[ctx_id]++;
+								current_cand_batch_size++;
+							} else {
+								break;
+							}
+						}
+						if (current_cand_batch_size == 0) {
+							break;
+						} else { // current_cand_batch_size > 0
+							s_cand_batch_size.write(current_cand_batch_size);
+							s_cand_batch_ctx_ids[0].write(ctx_id);
+							s_cand_batch_ctx_ids[1].write(ctx_id);
+							batch_ctx_ids[batch_tail] = ctx_id;
+							batch_tail = batch_tail == hardware_max_batches_in_flight - 1? 0 : batch_tail + 1;
+							on_the_fly_async_stage_num[ctx_id]++;
+						}
+					}
+
+					// reset next num batch to receive
+					recv_channels_left = N_CHANNEL;
+
+					// the query is done: nothing in the pipeline even after candidate popping	
+					if (on_the_fly_async_stage_num[ctx_id] == 0) {
+						s_finish_query_out.write(ctx_id);
+						s_finished_query_ids.write(query_ids[ctx_id]);
+						s_debug_signals.write(debug_hops_base_layer[ctx_id]);
+					}
+				}
+			}
+		}
+		processed_query_num += query_num;
+	}
+}
\ No newline at end of file
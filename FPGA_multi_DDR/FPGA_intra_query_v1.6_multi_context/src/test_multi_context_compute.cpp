@@ -0,0 +1,282 @@
+// C-simulation testbench of compute_distances_sub_PE_A with overlapping query contexts, against the
+//   single-query compute_distances_sub_PE_A of FPGA_intra_query_v1.5 (no FPGA / XRT needed).
+//
+// The PE runs in its own thread, as in the dataflow region, between a driver thread that plays the task
+//   scheduler / vector fetching and a thread that collects the partial distances. For 2 ~ NUM_QUERY_CONTEXTS
+//   contexts, the driver starts the queries of a batch in free contexts (reused once their finish signal has
+//   passed the PE), sends batches of random candidates of the busy contexts, and starts a new query while
+//   the PE is inside a batch whose merge would take in the new query's first candidates. The distance of
+//   every candidate has to be bit-exact the one v1.5 computes for its query alone.
+//
+// Usage: ./test_multi_context_compute (see the Makefile: the hls::stream of Vitis HLS has to be thread-safe)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <ap_int.h>
+#include <hls_stream.h>
+#include "hls_burst_maxi.h"
+
+// both versions in their own namespace, as they share the names of their types and functions (the macros of
+//   their constants.hpp are the same), which would otherwise be found by argument-dependent lookup
+namespace v1_6 {
+#include "compute.hpp"
+}
+namespace v1_5 {
+#include "../../FPGA_intra_query_v1.5_support_batching_longer_FIFO/src/compute.hpp"
+}
+using namespace v1_6;
+
+const int num_db_vectors = 256;
+const int num_queries_per_batch = 12;
+
+int num_failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cout << "FAILED: " << what << std::endl;
+        num_failures++;
+    }
+}
+
+ap_uint<512> random_float_word(std::mt19937& rng, float lo, float hi) {
+    std::uniform_real_distribution<float> dist(lo, hi);
+    ap_uint<512> word = 0;
+    for (int j = 0; j < FLOAT_PER_AXI; j++) {
+        float f = dist(rng);
+        ap_uint<32> bits = *((uint32_t*) &f);
+        word.range(32 * (j + 1) - 1, 32 * j) = bits;
+    }
+    return word;
+}
+
+// a database word of VECTOR_TYPE with finite elements
+ap_uint<512> random_db_word(std::mt19937& rng) {
+#if VECTOR_TYPE == VECTOR_TYPE_FP32
+    return random_float_word(rng, -4, 4);
+#elif VECTOR_TYPE == VECTOR_TYPE_FP16
+    ap_uint<512> word = 0;
+    for (int j = 0; j < 32; j++) {
+        ap_uint<16> bits = ((rng() & 1) << 15) | ((10 + rng() % 8) << 10) | (rng() & 0x3ff); // +-2^-5 ~ 2^3
+        word.range(16 * (j + 1) - 1, 16 * j) = bits;
+    }
+    return word;
+#else
+    ap_uint<512> word = 0;
+    for (int j = 0; j < 64; j++) {
+        ap_uint<8> bits = rng() & 0xff;
+        word.range(8 * (j + 1) - 1, 8 * j) = bits;
+    }
+    return word;
+#endif
+}
+
+struct Query {
+    std::vector<ap_uint<512>> words; // query_AXI_num: the vector (and the int8 weights)
+    std::vector<int> nodes; // candidates, in the order they are sent
+};
+
+std::vector<Query> make_queries(std::mt19937& rng, int num_queries) {
+    std::vector<Query> queries(num_queries);
+    for (Query& q : queries) {
+        for (int i = 0; i < query_AXI_num; i++) {
+            // int8: the weights (scale^2) are positive
+            q.words.push_back(i < query_vec_AXI_num? random_float_word(rng, -4, 4) : random_float_word(rng, 0.01, 1));
+        }
+        int num_nodes = 3 + rng() % 20;
+        for (int n = 0; n < num_nodes; n++) { q.nodes.push_back(rng() % num_db_vectors); }
+    }
+    return queries;
+}
+
+// the distances of the v1.5 PE, one query per kernel batch, all candidates in one fetch batch
+std::vector<float> reference_distances(const Query& q, const std::vector<std::vector<ap_uint<512>>>& db) {
+    hls::stream<int> s_query_batch_size;
+    hls::stream<ap_uint<512>> s_query_vectors;
+    hls::stream<int> s_fetch_batch_size;
+    hls::stream<ap_uint<512>> s_fetched_vectors;
+    hls::stream<int> s_finish_query_in;
+    hls::stream<float> s_partial_distances;
+    hls::stream<int> s_finish_query_out;
+
+    s_query_batch_size.write(1);
+    for (const ap_uint<512>& w : q.words) { s_query_vectors.write(w); }
+    s_fetch_batch_size.write(q.nodes.size());
+    for (int node : q.nodes) {
+        for (const ap_uint<512>& w : db[node]) { s_fetched_vectors.write(w); }
+    }
+    s_finish_query_in.write(0);
+    s_query_batch_size.write(-1);
+    v1_5::compute_distances_sub_PE_A<VECTOR_TYPE>(
+        s_query_batch_size, s_query_vectors, s_fetch_batch_size, s_fetched_vectors, s_finish_query_in,
+        s_partial_distances, s_finish_query_out);
+
+    std::vector<float> dists;
+    for (size_t n = 0; n < q.nodes.size(); n++) {
+        float dist = 0;
+        for (int i = 0; i < db_vec_AXI_num; i++) { dist += s_partial_distances.read(); }
+        dists.push_back(dist);
+    }
+    s_finish_query_out.read();
+    return dists;
+}
+
+void test_contexts(int num_contexts, unsigned seed) {
+
+    std::mt19937 rng(seed);
+    std::vector<std::vector<ap_uint<512>>> db(num_db_vectors);
+    for (auto& vec : db) {
+        for (int i = 0; i < db_vec_AXI_num; i++) { vec.push_back(random_db_word(rng)); }
+    }
+    std::vector<Query> queries = make_queries(rng, num_queries_per_batch);
+    std::vector<std::vector<float>> expected;
+    for (const Query& q : queries) { expected.push_back(reference_distances(q, db)); }
+
+    hls::stream<int> s_query_batch_size;
+    hls::stream<ap_uint<512>> s_query_vectors;
+    hls::stream<int> s_fetch_batch_size;
+    hls::stream<ap_uint<512>> s_fetched_vectors;
+    hls::stream<cand_t> s_fetched_neighbor_ids;
+    hls::stream<int> s_finish_query_in;
+    hls::stream<float> s_partial_distances;
+    hls::stream<cand_t> s_fetched_neighbor_ids_forwarded;
+    hls::stream<int> s_finish_query_out;
+
+    std::thread pe([&] {
+        compute_distances_sub_PE_A<VECTOR_TYPE>(
+            s_query_batch_size, s_query_vectors, s_fetch_batch_size, s_fetched_vectors, s_fetched_neighbor_ids,
+            s_finish_query_in, s_partial_distances, s_fetched_neighbor_ids_forwarded, s_finish_query_out);
+    });
+
+    // the driver records the query and candidate index of every candidate in the order it is sent,
+    //   which is the order of the PE's outputs
+    struct Sent { int qid; int cand; };
+    std::vector<Sent> sent;
+    std::atomic<size_t> num_sent{0};
+    std::atomic<size_t> num_received{0};
+    std::atomic<int> context_done[NUM_QUERY_CONTEXTS];
+    for (int c = 0; c < NUM_QUERY_CONTEXTS; c++) { context_done[c] = 0; }
+    sent.reserve(num_queries_per_batch * 32);
+
+    std::thread collector([&] {
+        int finished_query_num = 0;
+        while (finished_query_num < num_queries_per_batch || num_received < num_sent) {
+            if (!s_finish_query_out.empty()) {
+                context_done[s_finish_query_out.read()]++;
+                finished_query_num++;
+            } else if (!s_fetched_neighbor_ids_forwarded.empty()) {
+                cand_t cand = s_fetched_neighbor_ids_forwarded.read();
+                float dist = 0;
+                for (int i = 0; i < db_vec_AXI_num; i++) { dist += s_partial_distances.read(); }
+                const Sent& s = sent[num_received];
+                check(cand.node_id == queries[s.qid].nodes[s.cand], "forwarded candidate order");
+                check(dist == expected[s.qid][s.cand], std::to_string(num_contexts) + " contexts: distance of query " +
+                    std::to_string(s.qid) + " candidate " + std::to_string(s.cand) + " is " + std::to_string(dist) +
+                    ", v1.5: " + std::to_string(expected[s.qid][s.cand]));
+                num_received++;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    auto start_query = [&](int ctx, int qid) {
+        ap_uint<512> query_header = 0;
+        query_header.range(31, 0) = ctx;
+        s_query_vectors.write(query_header);
+        for (const ap_uint<512>& w : queries[qid].words) { s_query_vectors.write(w); }
+    };
+    auto send_cand = [&](int ctx, int qid, int cand) {
+        sent.push_back({qid, cand});
+        num_sent++;
+        cand_t reg = {queries[qid].nodes[cand], 0, ctx};
+        s_fetched_neighbor_ids.write(reg);
+        for (const ap_uint<512>& w : db[queries[qid].nodes[cand]]) { s_fetched_vectors.write(w); }
+    };
+    auto wait_received = [&](size_t n) { while (num_received < n) { std::this_thread::yield(); } };
+
+    int ctx_qid[NUM_QUERY_CONTEXTS]; // -1: free
+    int ctx_next_cand[NUM_QUERY_CONTEXTS];
+    int ctx_finishes_expected[NUM_QUERY_CONTEXTS] = {0};
+    for (int c = 0; c < NUM_QUERY_CONTEXTS; c++) { ctx_qid[c] = -1; }
+    int next_qid = 0;
+    int num_overlapped_starts = 0;
+
+    s_query_batch_size.write(num_queries_per_batch);
+    while (true) {
+        int free_ctx = -1;
+        std::vector<int> busy;
+        for (int c = 0; c < num_contexts; c++) {
+            if (ctx_qid[c] >= 0) { busy.push_back(c); }
+            else if (free_ctx < 0 && context_done[c] == ctx_finishes_expected[c]) { free_ctx = c; }
+        }
+        if (busy.empty() && next_qid == num_queries_per_batch) { break; }
+
+        if (free_ctx >= 0 && next_qid < num_queries_per_batch) {
+            int qid = next_qid++;
+            // start the query in the middle of a 3-candidate batch of a busy context: once the PE has computed
+            //   the first candidate, the new query and its first batch arrive before the other two candidates
+            int a = -1;
+            for (int c : busy) {
+                if (queries[ctx_qid[c]].nodes.size() - ctx_next_cand[c] >= 3) { a = c; break; }
+            }
+            if (a >= 0) {
+                s_fetch_batch_size.write(3);
+                send_cand(a, ctx_qid[a], ctx_next_cand[a]++);
+                wait_received(num_sent);
+                start_query(free_ctx, qid);
+                s_fetch_batch_size.write(1);
+                send_cand(a, ctx_qid[a], ctx_next_cand[a]++);
+                send_cand(a, ctx_qid[a], ctx_next_cand[a]++);
+                send_cand(free_ctx, qid, 0);
+                ctx_next_cand[free_ctx] = 1;
+                num_overlapped_starts++;
+            } else {
+                start_query(free_ctx, qid);
+                ctx_next_cand[free_ctx] = 0;
+            }
+            ctx_qid[free_ctx] = qid;
+        } else if (!busy.empty()) {
+            int c = busy[rng() % busy.size()];
+            int qid = ctx_qid[c];
+            int left = queries[qid].nodes.size() - ctx_next_cand[c];
+            if (left == 0) {
+                // as the scheduler, which finishes a query once all its batches have returned
+                wait_received(num_sent);
+                s_finish_query_in.write(c);
+                ctx_finishes_expected[c]++;
+                ctx_qid[c] = -1;
+            } else {
+                int batch_size = std::min(left, 1 + (int) (rng() % 4));
+                s_fetch_batch_size.write(batch_size);
+                for (int b = 0; b < batch_size; b++) { send_cand(c, qid, ctx_next_cand[c]++); }
+            }
+        } else {
+            std::this_thread::yield(); // wait for a context to be free again
+        }
+    }
+    s_query_batch_size.write(-1);
+    collector.join();
+    pe.join();
+
+    check(num_received == num_sent, std::to_string(num_contexts) + " contexts: all candidates computed");
+    std::cout << num_contexts << " contexts: " << num_sent << " candidates of " << num_queries_per_batch <<
+        " queries, " << num_overlapped_starts << " queries started within a batch of another" << std::endl;
+}
+
+int main(int argc, char const *argv[]) {
+
+    for (int num_contexts = 2; num_contexts <= NUM_QUERY_CONTEXTS; num_contexts++) {
+        for (unsigned seed = 0; seed < 4; seed++) { test_contexts(num_contexts, 100 * num_contexts + seed); }
+    }
+
+    std::cout << (num_failures == 0? "All multi-context compute tests passed" : "Multi-context compute tests FAILED") << std::endl;
+    return num_failures == 0? 0 : 1;
+}
@@ -0,0 +1,134 @@
+// Host-side test of the result ID translation (result_labels.hpp), no FPGA / XRT needed.
+//
+// Usage: ./test_result_labels [<4-channel index dir of balance_FPGA_channels>]
+//   Without arguments, synthetic round-robin and channel-balanced 4-channel indexes are tested;
+//   with an index of balance_FPGA_channels --num_channels 4, every node ID of every channel is
+//   translated, and the labels have to be distinct and in range.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "result_labels.hpp"
+
+const int n_channel = 4;
+const int channel_addr_bits = 2;
+
+int num_failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cout << "FAILED: " << what << std::endl;
+        num_failures++;
+    }
+}
+
+void write_ints(const std::string& fname, const std::vector<int>& data) {
+    FILE* f = fopen(fname.c_str(), "wb");
+    if (!f || fwrite(data.data(), sizeof(int), data.size(), f) != data.size()) {
+        std::cout << "Cannot write " << fname << std::endl;
+        exit(1);
+    }
+    fclose(f);
+}
+
+int encode(int channel, int pos) {
+    return (channel << (31 - channel_addr_bits)) | pos;
+}
+
+// the node IDs of all channels of a channel_placement_N.bin, in file order
+std::vector<int> all_node_ids(const std::vector<int>& channel_placement) {
+    std::vector<int> ids;
+    for (int c = 0; c < n_channel; c++) {
+        for (int pos = 0; pos < channel_placement[c]; pos++) { ids.push_back(encode(c, pos)); }
+    }
+    return ids;
+}
+
+void test_balanced(const std::string& dir) {
+    // 10 nodes: 3 / 2 / 3 / 2 per channel, labels in position order
+    std::vector<int> channel_placement = {3, 2, 3, 2,  7, 0, 4,  9, 2,  5, 1, 8,  3, 6};
+    write_ints(dir + "/channel_placement_4.bin", channel_placement);
+
+    // balance_FPGA_channels writes no ground_labels.bin
+    ResultLabels result_labels(dir, "HNSW", n_channel, channel_addr_bits, true);
+    std::vector<int> ids = all_node_ids(channel_placement);
+    ids.push_back(-1);
+    result_labels.translate(ids.data(), ids.size());
+    std::vector<int> expected(channel_placement.begin() + n_channel, channel_placement.end());
+    expected.push_back(-1);
+    check(ids == expected, "balanced placement without ground_labels.bin");
+
+    // a ground_labels.bin left in the directory must not be applied on top
+    write_ints(dir + "/ground_labels.bin", std::vector<int>(10, 123));
+    ResultLabels result_labels_stale(dir, "HNSW", n_channel, channel_addr_bits, true);
+    ids = all_node_ids(channel_placement);
+    ids.push_back(-1);
+    result_labels_stale.translate(ids.data(), ids.size());
+    check(ids == expected, "balanced placement ignores ground_labels.bin");
+
+    unlink((dir + "/ground_labels.bin").c_str());
+    unlink((dir + "/channel_placement_4.bin").c_str());
+}
+
+void test_round_robin(const std::string& dir) {
+    // NSG without labels: the node IDs are the labels
+    ResultLabels identity(dir, "NSG", n_channel, channel_addr_bits, false);
+    std::vector<int> ids = {0, 5, 3, -1};
+    identity.translate(ids.data(), ids.size());
+    check(ids == std::vector<int>({0, 5, 3, -1}), "round-robin placement without ground_labels.bin");
+
+    std::vector<int> labels = {40, 41, 42, 43, 44, 45};
+    write_ints(dir + "/ground_labels.bin", labels);
+    ResultLabels result_labels(dir, "HNSW", n_channel, channel_addr_bits, false);
+    result_labels.translate(ids.data(), ids.size());
+    check(ids == std::vector<int>({40, 45, 43, -1}), "round-robin placement with ground_labels.bin");
+    unlink((dir + "/ground_labels.bin").c_str());
+}
+
+void test_index(const std::string& index_dir) {
+    std::vector<int> channel_placement;
+    FILE* f = fopen((index_dir + "/channel_placement_4.bin").c_str(), "rb");
+    if (!f) {
+        std::cout << "No channel_placement_4.bin in " << index_dir << std::endl;
+        exit(1);
+    }
+    int value;
+    while (fread(&value, sizeof(int), 1, f) == 1) { channel_placement.push_back(value); }
+    fclose(f);
+
+    ResultLabels result_labels(index_dir, "HNSW", n_channel, channel_addr_bits, true);
+    std::vector<int> ids = all_node_ids(channel_placement);
+    int num_nodes = ids.size();
+    result_labels.translate(ids.data(), ids.size());
+    std::vector<bool> seen(num_nodes, false);
+    bool distinct_in_range = true;
+    for (int label : ids) {
+        if (label < 0 || label >= num_nodes || seen[label]) { distinct_in_range = false; break; }
+        seen[label] = true;
+    }
+    check(distinct_in_range, "labels of " + index_dir + " are distinct and in range");
+    std::cout << "Translated " << num_nodes << " node IDs of " << index_dir << std::endl;
+}
+
+int main(int argc, char const *argv[]) {
+
+    char dir_template[] = "/tmp/test_result_labels_XXXXXX";
+    char* dir = mkdtemp(dir_template);
+    if (!dir) {
+        std::cout << "Cannot create a temporary directory" << std::endl;
+        return 1;
+    }
+    test_balanced(dir);
+    test_round_robin(dir);
+    rmdir(dir);
+
+    if (argc > 1) { test_index(argv[1]); }
+
+    std::cout << (num_failures == 0? "All result label tests passed" : "Result label tests FAILED") << std::endl;
+    return num_failures == 0? 0 : 1;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <ap_int.h>
+#include <hls_stream.h>
+#include "hls_burst_maxi.h"
+
+#include "constants.hpp"
+
+// candidate type
+// ctx_id: the query context (0 ~ NUM_QUERY_CONTEXTS - 1) the candidate / result belongs to
+typedef struct {
+    int node_id;
+    int level_id;
+    ap_uint<QUERY_CONTEXT_ID_BITS> ctx_id;
+} cand_t;
+
+typedef struct {
+	int node_id;
+    int level_id;
+	float dist;
+    ap_uint<QUERY_CONTEXT_ID_BITS> ctx_id;
+} result_t;
+
+enum Order { Collect_smallest, Collect_largest };
+
+// DRAM channel of a node, for a query of the given context: the channels form groups of 
+//   2^channel_group_bits channels (see constants.hpp), the contexts take the groups in turn
+inline ap_uint<8> get_channel_id(ap_uint<32> node_id, ap_uint<QUERY_CONTEXT_ID_BITS> ctx_id, const int channel_group_bits) {
+#pragma HLS inline
+#if N_CHANNEL == 1
+	return 0;
+#elif defined(CHANNEL_PLACEMENT_BALANCED)
+	return node_id.range(30, 31 - CHANNEL_ADDR_BITS);
+#else
+	ap_uint<8> num_channel_groups_mask = (N_CHANNEL >> channel_group_bits) - 1;
+	ap_uint<8> group_id = ctx_id & num_channel_groups_mask;
+	ap_uint<8> channel_in_group_mask = (1 << channel_group_bits) - 1;
+	return (group_id << channel_group_bits) | (node_id & channel_in_group_mask);
+#endif
+}
+
+// position of a node within its DRAM channel, index_channel_bits: log2 of the channel number of the index files
+inline ap_uint<32> get_in_channel_node_id(ap_uint<32> node_id, const int index_channel_bits) {
+#pragma HLS inline
+#if N_CHANNEL == 1
+	return node_id;
+#elif defined(CHANNEL_PLACEMENT_BALANCED)
+	return node_id.range(30 - CHANNEL_ADDR_BITS, 0);
+#else
+	return node_id >> index_channel_bits;
+#endif
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+// UpperLayerSearch: the greedy descent of HNSW through the upper layers (levels max_level ~ 1) on
+//   the host, such that the kernel, which only searches the base layer, starts every query from
+//   the node closest to it on level 1 (entry_point_ids) rather than from the global entry point.
+//
+// The upper layers are read from upper_links.bin / upper_links_pointers.bin (see
+//   vector_search_baselines/FPGA_index_tools/FPGA_index_format.hpp), the vectors from the
+//   ground_vectors files as already loaded for the kernel (IndexLoader), where node i is stored in
+//   channel i % n_vector_channels at position i / n_vector_channels. The upper layers are small
+//   (~1/M of the nodes), thus the descent costs a few tens of distance computations per query,
+//   which run on several threads while the index is migrated to the device.
+//
+// NSG indexes and indexes without the upper layer files (e.g., channel-balanced ones) are not
+//   supported: load() returns false and the caller keeps the entry point of meta.bin.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+class UpperLayerSearch {
+
+public:
+
+    // average number of greedy steps over the upper layers of the last search()
+    float average_hops = 0;
+
+    UpperLayerSearch(int num_db_vec, int max_level, int entry_point_id, int max_link_num_upper) :
+        num_db_vec(num_db_vec), max_level(max_level), entry_point_id(entry_point_id),
+        max_link_num_upper(max_link_num_upper) {
+
+        // per level: 64B header (num_links) + links padded to 64B
+        bytes_per_level = 64 + (max_link_num_upper * sizeof(int) + 63) / 64 * 64;
+    }
+
+    // db_vectors: one pointer per channel file; bytes_per_db_vec_in_index: record size in these files
+    bool load(const std::string& index_dir, const std::vector<const char*>& db_vectors,
+        size_t bytes_per_db_vec_in_index, int d) {
+
+        this->db_vectors = db_vectors;
+        this->bytes_per_db_vec_in_index = bytes_per_db_vec_in_index;
+        this->d = d;
+        if (max_level < 1) { return false; }
+
+        std::string dir = index_dir.back() == '/'? index_dir : index_dir + '/';
+        if (!read_file(dir + "upper_links_pointers.bin", upper_links_pointers_raw) ||
+            !read_file(dir + "upper_links.bin", upper_links)) {
+            return false;
+        }
+        if (upper_links_pointers_raw.size() != (size_t) num_db_vec * sizeof(uint64_t)) {
+            std::cout << "UpperLayerSearch: upper_links_pointers.bin does not match num_db_vec" << std::endl;
+            return false;
+        }
+        upper_links_pointers = (const uint64_t*) upper_links_pointers_raw.data();
+        return true;
+    }
+
+    // queries: query_num x query_stride floats; entry_point_ids: output, one per query
+    void search(const float* queries, int query_num, int query_stride, int* entry_point_ids,
+        int num_threads = std::thread::hardware_concurrency()) {
+
+        if (num_threads < 1) { num_threads = 1; }
+        std::atomic<int> next_query(0);
+        std::atomic<long> total_hops(0);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < num_threads; t++) {
+            threads.emplace_back([&] {
+                long hops = 0;
+                while (true) {
+                    int qid = next_query.fetch_add(1);
+                    if (qid >= query_num) { break; }
+                    entry_point_ids[qid] = greedy_descent(queries + (size_t) qid * query_stride, hops);
+                }
+                total_hops += hops;
+            });
+        }
+        for (auto& t : threads) { t.join(); }
+        average_hops = query_num > 0? (float) total_hops / query_num : 0;
+    }
+
+private:
+
+    int num_db_vec;
+    int max_level;
+    int entry_point_id;
+    int max_link_num_upper;
+    size_t bytes_per_level;
+
+    std::vector<const char*> db_vectors;
+    size_t bytes_per_db_vec_in_index = 0;
+    int d = 0;
+
+    std::vector<char> upper_links_pointers_raw;
+    const uint64_t* upper_links_pointers = nullptr;
+    std::vector<char> upper_links;
+
+    static bool read_file(const std::string& fname, std::vector<char>& out) {
+        struct stat stat_buf;
+        if (stat(fname.c_str(), &stat_buf) != 0 || stat_buf.st_size == 0) { return false; }
+        out.resize(stat_buf.st_size);
+        FILE* f = fopen(fname.c_str(), "rb");
+        if (!f) { return false; }
+        size_t bytes_read = fread(out.data(), 1, out.size(), f);
+        fclose(f);
+        return bytes_read == out.size();
+    }
+
+    const float* vector(int node_id) const {
+        int n_channels = db_vectors.size();
+        return (const float*) (db_vectors[node_id % n_channels] + (size_t) (node_id / n_channels) * bytes_per_db_vec_in_index);
+    }
+
+    // number of upper levels of a node
+    int num_levels(int node_id) const {
+        uint64_t end = node_id + 1 < num_db_vec? upper_links_pointers[node_id + 1] : upper_links.size();
+        return (end - upper_links_pointers[node_id]) / bytes_per_level;
+    }
+
+    float l2_sqr(const float* a, const float* b) const {
+        float dist = 0;
+        int i = 0;
+#if defined(__AVX2__)
+        __m256 sum = _mm256_setzero_ps();
+        for (; i + 8 <= d; i += 8) {
+            __m256 diff = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(diff, diff));
+        }
+        float lanes[8];
+        _mm256_storeu_ps(lanes, sum);
+        for (int l = 0; l < 8; l++) { dist += lanes[l]; }
+#endif
+        for (; i < d; i++) {
+            float diff = a[i] - b[i];
+            dist += diff * diff;
+        }
+        return dist;
+    }
+
+    int greedy_descent(const float* query, long& hops) const {
+        int cur = entry_point_id;
+        float cur_dist = l2_sqr(query, vector(cur));
+        for (int level = max_level; level > 0; level--) {
+            bool changed = true;
+            while (changed) {
+                changed = false;
+                if (num_levels(cur) < level) { break; } // only for inconsistent files
+                const char* level_links = upper_links.data() + upper_links_pointers[cur] + (level - 1) * bytes_per_level;
+                int num_links = *(const int*) level_links;
+                if (num_links > max_link_num_upper) { num_links = max_link_num_upper; }
+                const int* links = (const int*) (level_links + 64);
+                for (int i = 0; i < num_links; i++) {
+                    if (links[i] < 0 || links[i] >= num_db_vec) { continue; }
+                    float dist = l2_sqr(query, vector(links[i]));
+                    if (dist < cur_dist) {
+                        cur_dist = dist;
+                        cur = links[i];
+                        changed = true;
+                    }
+                }
+                hops++;
+            }
+        }
+        return cur;
+    }
+};
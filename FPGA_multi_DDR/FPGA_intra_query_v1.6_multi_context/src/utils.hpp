@@ -0,0 +1,587 @@
+#pragma once
+
+#include "types.hpp"
+
+// wait until data ready and read, please be careful
+//   about the using of this function as it can slow down the performance
+template<typename T>
+inline T block_read(hls::stream<T>& s) {
+#pragma HLS inline
+
+    while (s.empty()) {}
+    return s.read();
+}
+
+template <const int rep_factor, typename T>
+bool all_streams_empty(
+	// in (stream)
+	hls::stream<T> (&s_input)[rep_factor]
+) {
+#pragma HLS inline
+
+	bool all_empty = true;
+	for (int i = 0; i < rep_factor; i++) {
+		if (!s_input[i].empty()) {
+			all_empty = false;
+		}
+	}
+	return all_empty;
+}
+
+template <const int rep_factor, typename T>
+bool all_streams_ready(
+	// in (stream)
+	hls::stream<T> (&s_input)[rep_factor]
+) {
+#pragma HLS inline
+
+	bool all_ready = true;
+	for (int i = 0; i < rep_factor; i++) {
+		if (s_input[i].empty()) {
+			all_ready = false;
+		}
+	}
+	return all_ready;
+}
+
+// in the first iteration, wait for the first data to arrive
+template<typename s_data_t>
+void wait_data_fifo_first_iter(
+	int read_iter,
+	hls::stream<s_data_t>& s_data,
+	bool& first_iter_s_data
+) {
+#pragma HLS inline
+
+	if (first_iter_s_data && read_iter > 0) {
+		while (s_data.empty()) {}
+		first_iter_s_data = false;
+	}
+}
+
+// in the first iteration, wait for the first data to arrive (a group of FIFOs)
+template<const int rep_factor, typename s_data_t>
+void wait_data_fifo_group_first_iter(
+	int read_iter,
+	hls::stream<s_data_t> (&s_data)[rep_factor],
+	bool& first_iter_s_data
+) {
+#pragma HLS inline
+
+	if (first_iter_s_data && read_iter > 0) {
+		while (!all_streams_ready<rep_factor, s_data_t>(s_data)) {}
+		first_iter_s_data = false;
+	}
+}
+
+template <const int rep_factor>
+void replicate_s_query_batch_size(
+	// in (stream)
+	hls::stream<int>& s_query_batch_size_in, // -1: stop
+	// out stream
+	hls::stream<int> (&s_query_batch_size_out)[rep_factor]
+) {
+
+	bool first_s_query_batch_size = true;
+
+	bool stop_all = false;
+	while (!stop_all) {
+		wait_data_fifo_first_iter<int>(
+			1, s_query_batch_size_in, first_s_query_batch_size);
+		int query_num = s_query_batch_size_in.read();
+
+		// even if -1, send out to stop all
+		for (int i = 0; i < rep_factor; i++) {
+		#pragma HLS UNROLL
+			s_query_batch_size_out[i].write(query_num);
+		}
+
+		if (query_num == -1) {
+			stop_all = true;
+		}
+	}
+}
+
+template <const int rep_factor, typename s_control_t>
+void replicate_s_control(
+	// in (stream)
+	hls::stream<int>& s_query_batch_size, // -1: stop
+	hls::stream<s_control_t>& s_control, // must not be s_query_batch_size
+	hls::stream<int>& s_finish_query_in,
+	
+	// out (stream)
+	hls::stream<s_control_t> (&s_control_replicated)[rep_factor], 
+	hls::stream<int>& s_finish_query_out
+) {
+
+	bool first_s_query_batch_size = true;
+	
+	while (true) {
+
+		wait_data_fifo_first_iter<int>(
+			1, s_query_batch_size, first_s_query_batch_size);
+		int query_num = s_query_batch_size.read();
+		if (query_num == -1) {
+			break;
+		}
+
+		// the queries of a batch finish in any order, one finish signal (context ID) each
+		int finished_query_num = 0;
+		while (finished_query_num < query_num) {
+			// check query finish
+			if (!s_finish_query_in.empty()) {
+				s_finish_query_out.write(s_finish_query_in.read());
+				finished_query_num++;
+			} else if (!s_control.empty()) {
+				// receive task
+				s_control_t reg_control = s_control.read();
+				for (int i = 0; i < rep_factor; i++) {
+				#pragma HLS UNROLL
+					s_control_replicated[i].write(reg_control);
+				}
+			}
+		}
+	}
+}
+
+template <const int rep_factor, typename s_data_t>
+void replicate_s_read_iter_and_s_data(
+	// in (stream)
+	hls::stream<int>& s_query_batch_size, // -1: stop
+	hls::stream<int>& s_read_iter,
+	hls::stream<s_data_t>& s_data,
+	hls::stream<int>& s_finish_query_in,
+	
+	// out (stream)
+	hls::stream<int> (&s_read_iter_replicated)[rep_factor], 
+	hls::stream<s_data_t> (&s_data_replicated)[rep_factor],
+	hls::stream<int>& s_finish_query_out
+) {
+	
+	bool first_s_query_batch_size = true;
+	bool first_iter_s_data = true;
+
+	while (true) {
+
+		wait_data_fifo_first_iter<int>(
+			1, s_query_batch_size, first_s_query_batch_size);
+		int query_num = s_query_batch_size.read();
+		if (query_num == -1) {
+			break;
+		}
+
+		// the queries of a batch finish in any order, one finish signal (context ID) each
+		int finished_query_num = 0;
+		while (finished_query_num < query_num) {
+			// check query finish
+			if (!s_finish_query_in.empty()) {
+				s_finish_query_out.write(s_finish_query_in.read());
+				finished_query_num++;
+			} else if (!s_read_iter.empty()) {
+				// receive task
+				int read_iter = s_read_iter.read();
+				wait_data_fifo_first_iter<s_data_t>(read_iter, s_data, first_iter_s_data);
+				for (int i = 0; i < rep_factor; i++) {
+				#pragma HLS UNROLL
+					s_read_iter_replicated[i].write(read_iter);
+				}
+				for (int j = 0; j < read_iter; j++) {
+				#pragma HLS pipeline II=1
+					s_data_t reg_data = s_data.read();
+					for (int i = 0; i < rep_factor; i++) {
+					#pragma HLS UNROLL
+						s_data_replicated[i].write(reg_data);
+					}
+				}
+			}
+		}
+	}
+}
+
+template <const int rep_factor>
+void replicate_s_finish(
+	// in (stream)
+	hls::stream<int>& s_query_batch_size, // -1: stop
+	hls::stream<int>& s_finish_query_in,
+	
+	// out (stream)
+	hls::stream<int> (&s_finish_query_out_replicated)[rep_factor]
+) {
+	
+	bool first_s_query_batch_size = true;
+	
+	while (true) {
+
+		wait_data_fifo_first_iter<int>(
+			1, s_query_batch_size, first_s_query_batch_size);
+		int query_num = s_query_batch_size.read();
+		if (query_num == -1) {
+			break;
+		}
+
+		for (int qid = 0; qid < query_num; qid++) {
+			while (true) {
+				// check query finish
+				if (!s_finish_query_in.empty()) {
+					int finish = s_finish_query_in.read();
+					for (int i = 0; i < rep_factor; i++) {
+					#pragma HLS UNROLL
+						s_finish_query_out_replicated[i].write(finish);
+					}
+					break;
+				} 
+			}
+		}
+	}
+}
+
+template <const int rep_factor>
+void gather_s_finish(
+	// in (stream)
+	hls::stream<int>& s_query_batch_size, // -1: stop
+	hls::stream<int> (&s_finish_query_in_replicated)[rep_factor],
+	
+	// out (stream)
+	hls::stream<int>& s_finish_query_out
+) {
+	bool first_s_query_batch_size = true;	
+	
+	while (true) {
+
+		wait_data_fifo_first_iter<int>(
+			1, s_query_batch_size, first_s_query_batch_size);
+		int query_num = s_query_batch_size.read();
+		if (query_num == -1) {
+			break;
+		}
+
+		for (int qid = 0; qid < query_num; qid++) {
+			// wait for all finish signals arrive, read them
+			int finish[rep_factor];
+#pragma HLS bind_storage variable=finish type=RAM_2P impl=BRAM
+
+			for (int i = 0; i < rep_factor; i++) {
+				while (true) {
+					if (!s_finish_query_in_replicated[i].empty()) {
+						finish[i] = s_finish_query_in_replicated[i].read();
+						break;
+					}
+				}
+			}
+			// send out
+			s_finish_query_out.write(finish[0]);
+		}
+	}
+}
+
+// thresholds: the largest result of each context as of the latest candidate batch (results_collection sends one
+//   per batch, tagged with the context), updated whenever they arrive rather than waiting for the previous batch of
+//   the same context, such that the batches of other contexts are not held up; a stale threshold only filters less
+void filter_computed_distances(
+	// in stream
+	hls::stream<int>& s_query_batch_size, // -1: stop
+	hls::stream<int>& s_num_valid_candidates_base_level_total, 
+	hls::stream<result_t>& s_largest_result_queue_elements, 
+	hls::stream<result_t>& s_distances_base_level,
+	hls::stream<int>& s_finish_query_in,
+
+	// out stream
+	hls::stream<int>& s_num_valid_candidates_base_level_filtered, 
+	hls::stream<result_t> &s_distances_base_filtered,
+	hls::stream<int>& s_finish_query_out
+) {
+
+	bool first_s_query_batch_size = true;
+	bool first_iter_s_distances_base_level = true;
+
+	float thresholds[NUM_QUERY_CONTEXTS];
+#pragma HLS array_partition variable=thresholds complete
+
+	while (true) {
+
+		wait_data_fifo_first_iter<int>(
+			1, s_query_batch_size, first_s_query_batch_size);
+		int query_num = s_query_batch_size.read();
+		if (query_num == -1) {
+			break;
+		}
+
+		for (int c = 0; c < NUM_QUERY_CONTEXTS; c++) {
+		#pragma HLS unroll
+			thresholds[c] = large_float;
+		}
+		int num_batches = 0; // each returns one threshold
+		int num_thresholds = 0;
+
+		// the queries of a batch finish in any order, one finish signal (context ID) each
+		int finished_query_num = 0;
+		while (finished_query_num < query_num) {
+			// thresholds first: the last ones of a query are sent before the scheduler finishes it
+			if (!s_largest_result_queue_elements.empty()) {
+				result_t reg_largest = s_largest_result_queue_elements.read();
+				thresholds[reg_largest.ctx_id] = reg_largest.dist;
+				num_thresholds++;
+			} else if (!s_finish_query_in.empty()) {
+				int ctx_id = s_finish_query_in.read();
+				thresholds[ctx_id] = large_float; // the next query of this context
+				s_finish_query_out.write(ctx_id);
+				finished_query_num++;
+			} else if (!s_num_valid_candidates_base_level_total.empty()) {
+				// receive task
+				int num_valid_candidates_base_level_total = s_num_valid_candidates_base_level_total.read();
+				num_batches++;
+
+				wait_data_fifo_first_iter<result_t>(
+					num_valid_candidates_base_level_total, s_distances_base_level, first_iter_s_distances_base_level);
+
+				int valid_cnt = 0;
+				for (int i = 0; i < num_valid_candidates_base_level_total; i++) {
+					result_t reg_out = s_distances_base_level.read();
+					if (reg_out.dist < thresholds[reg_out.ctx_id]) {
+						s_distances_base_filtered.write(reg_out);
+						valid_cnt++;
+					}
+				}
+				s_num_valid_candidates_base_level_filtered.write(valid_cnt);
+			}
+		}
+
+		// Note: the thresholds of the last batches must be consumed
+		while (num_thresholds < num_batches) {
+			s_largest_result_queue_elements.read();
+			num_thresholds++;
+		}
+	}
+}
+
+
+// Send only upper-level results to results collection; replicate to other levels
+void split_s_distances(
+	// in runtime (stream)
+	hls::stream<int>& s_query_batch_size, // -1: stop
+	hls::stream<result_t>& s_distances_filtered,
+	hls::stream<int>& s_finish_query_in,
+
+	// out (stream)
+	hls::stream<result_t> &s_distances_upper_levels,
+	hls::stream<result_t> &s_distances_base_level,
+	hls::stream<int>& s_finish_query_out
+) {
+
+	bool first_s_query_batch_size = true;
+
+	while (true) {
+
+		wait_data_fifo_first_iter<int>(
+			1, s_query_batch_size, first_s_query_batch_size);
+		int query_num = s_query_batch_size.read();
+		if (query_num == -1) {
+			break;
+		}
+		
+		// the queries of a batch finish in any order, one finish signal (context ID) each
+		int finished_query_num = 0;
+		while (finished_query_num < query_num) {
+			// check query finish
+			if (!s_finish_query_in.empty()) {
+				s_finish_query_out.write(s_finish_query_in.read());
+				finished_query_num++;
+			} else if (!s_distances_filtered.empty()) {
+				// receive task
+				result_t reg_out = s_distances_filtered.read();
+				if (reg_out.level_id == 0) {
+					s_distances_base_level.write(reg_out);
+				} else {
+					s_distances_upper_levels.write(reg_out);
+				}
+			}
+		}
+	}
+}
+
+
+// split bloom-fetch-compute tasks to different channels based on node ids
+//   Merging multiple candidate batches into ONE!
+//   Note: cannot handle case where output per channel of multi-batches > FIFO size
+void split_tasks_to_channels(
+		const int max_link_num_base,
+		const int link_layout,
+		const int channel_group_bits,
+
+		// in streams
+		hls::stream<int>& s_query_batch_size, // -1: stop
+		hls::stream<int>& s_cand_batch_size,
+		hls::stream<int>& s_cand_batch_ctx_ids,
+		hls::stream<ap_uint<512>>& s_neighbor_ids_raw,
+		hls::stream<int>& s_finish_query_in,
+
+		// out streams
+		hls::stream<int> (&s_num_neighbors_base_level_per_channel)[N_CHANNEL],
+		hls::stream<cand_t> (&s_fetched_neighbor_ids_per_channel)[N_CHANNEL],
+		hls::stream<int>& s_finish_query_out
+	) {
+
+	bool first_s_query_batch_size = true;
+	bool first_iter_s_num_neighbors_base_level = true;
+	bool first_iter_s_fetched_neighbor_ids = true;
+	bool first_iter_s_cand_batch_ctx_ids = true;
+
+	int node_count_per_channel[N_CHANNEL];
+#pragma HLS array_partition variable=node_count_per_channel complete
+	
+	const int AXI_num_per_base_link_original = max_link_num_base % INT_PER_AXI == 0? 
+		1 + max_link_num_base / INT_PER_AXI : 2 + max_link_num_base / INT_PER_AXI; // 4 = int size, 64 = 512 bit
+	const int first_link_slot = link_layout == LINK_LAYOUT_PACKED? 1 : INT_PER_AXI;
+
+	const int max_buffer_size = 32 + 1; // supporting max of 32 * INT_PER_AXI (16) = 512 edges per node
+			ap_uint<512> local_links_buffer[max_buffer_size]; 
+#pragma HLS bind_storage variable=local_links_buffer type=RAM_2P impl=BRAM
+
+	while (true) {
+
+		wait_data_fifo_first_iter<int>(
+			1, s_query_batch_size, first_s_query_batch_size);
+		int query_num = s_query_batch_size.read();
+		if (query_num == -1) {
+			break;
+		}
+
+		// the queries of a batch finish in any order, one finish signal (context ID) each
+		int finished_query_num = 0;
+		while (finished_query_num < query_num) {
+			// check query finish
+			if (!s_finish_query_in.empty()) {
+				s_finish_query_out.write(s_finish_query_in.read());
+				finished_query_num++;
+			} else if (!s_cand_batch_size.empty()) {
+
+				// reset counters
+				for (int i = 0; i < N_CHANNEL; i++) {
+				#pragma HLS UNROLL
+					node_count_per_channel[i] = 0;
+				}
+
+				// receive task
+				int cand_batch_size = s_cand_batch_size.read();
+				wait_data_fifo_first_iter<int>(
+					1, s_cand_batch_ctx_ids, first_iter_s_cand_batch_ctx_ids);
+				ap_uint<QUERY_CONTEXT_ID_BITS> ctx_id = s_cand_batch_ctx_ids.read(); // all candidates of a batch are of one context
+				wait_data_fifo_first_iter<ap_uint<512>>(
+					cand_batch_size, s_neighbor_ids_raw, first_iter_s_num_neighbors_base_level);
+
+				// each round can contain multiple batches
+				for (int bid = 0; bid < cand_batch_size; bid++) {
+					// the number of words per node follows fetch_neighbor_ids
+					local_links_buffer[0] = s_neighbor_ids_raw.read();
+					ap_uint<32> links_num_ap = local_links_buffer[0].range(31, 0);
+					int num_links = links_num_ap;
+					num_links = num_links < max_link_num_base? num_links : max_link_num_base;
+					int AXI_num_per_base_link = link_layout == LINK_LAYOUT_PACKED? 
+						1 + num_links / INT_PER_AXI : AXI_num_per_base_link_original;
+					for (int i = 1; i < AXI_num_per_base_link; i++) {
+					#pragma HLS pipeline II=1
+						ap_uint<512> reg = s_neighbor_ids_raw.read();
+						local_links_buffer[i] = reg;
+					}
+
+					// process each node's laber
+					for (int i = 0; i < num_links; i++) { // the links start after num_links
+					#pragma HLS pipeline II=1
+						int slot = first_link_slot + i;
+						int j = slot % INT_PER_AXI;
+						ap_uint<32> link_ap = local_links_buffer[slot / INT_PER_AXI].range(32 * (j + 1) - 1, 32 * j);
+						int link = link_ap;
+						cand_t fetched_neighbor_ids;
+						fetched_neighbor_ids.node_id = link;
+						fetched_neighbor_ids.level_id = 0; // hard-code to 0, support only base layer
+						fetched_neighbor_ids.ctx_id = ctx_id;
+						ap_uint<32> node_id_ap = link;
+						ap_uint<8> channel_id = get_channel_id(node_id_ap, ctx_id, channel_group_bits);
+						s_fetched_neighbor_ids_per_channel[channel_id].write(fetched_neighbor_ids);
+						node_count_per_channel[channel_id]++;
+					}
+				}
+
+				// merge multiple cand batches into one
+				for (int channel_id = 0; channel_id < N_CHANNEL; channel_id++) {
+				#pragma HLS UNROLL
+					s_num_neighbors_base_level_per_channel[channel_id].write(node_count_per_channel[channel_id]);
+				}
+			}
+		}
+	}
+}
+
+void gather_distances_from_channels(
+		hls::stream<int>& s_query_batch_size, // -1: stop
+		hls::stream<int> (&s_num_valid_candidates_base_level_total_per_channel)[N_CHANNEL],
+		hls::stream<result_t> (&s_distances_base_level_per_channel)[N_CHANNEL],
+		hls::stream<int>& s_finish_query_in,
+
+		hls::stream<int>& s_num_valid_candidates_base_level_total, // write once per channel
+		hls::stream<result_t>& s_distances_base_level,
+		hls::stream<int>& s_finish_query_out
+	) {
+
+	bool first_s_query_batch_size = true;
+	bool first_iter_s_distances_base_level_per_channel[N_CHANNEL];
+	for (int i = 0; i < N_CHANNEL; i++) {
+		first_iter_s_distances_base_level_per_channel[i] = true;
+	}
+	bool visited_channel[N_CHANNEL];
+
+	while (true) {
+
+		wait_data_fifo_first_iter<int>(
+			1, s_query_batch_size, first_s_query_batch_size);
+		int query_num = s_query_batch_size.read();
+		if (query_num == -1) {
+			break;
+		}
+		
+		// the queries of a batch finish in any order, one finish signal (context ID) each
+		int finished_query_num = 0;
+		while (finished_query_num < query_num) {
+			// check query finish
+			if (!s_finish_query_in.empty()) {
+				s_finish_query_out.write(s_finish_query_in.read());
+				finished_query_num++;
+			} else if (!all_streams_empty<N_CHANNEL, int>(s_num_valid_candidates_base_level_total_per_channel)) {
+
+				// start a round of pulling data of each channel
+				for (int i = 0; i < N_CHANNEL; i++) {
+					visited_channel[i] = false;
+				}
+				bool stop = false;
+
+				// loop over each channel once and forward the data
+				while (!stop) {
+					for (int channel_id = 0; channel_id < N_CHANNEL; channel_id++) {
+						if (!visited_channel[channel_id] && !s_num_valid_candidates_base_level_total_per_channel[channel_id].empty()) {
+							int num_valid_candidates_base_level_total_per_channel = 
+								s_num_valid_candidates_base_level_total_per_channel[channel_id].read();
+							visited_channel[channel_id] = true;
+							wait_data_fifo_first_iter<result_t>(
+								num_valid_candidates_base_level_total_per_channel, s_distances_base_level_per_channel[channel_id], 
+								first_iter_s_distances_base_level_per_channel[channel_id]);
+							s_num_valid_candidates_base_level_total.write(num_valid_candidates_base_level_total_per_channel);
+							for (int i = 0; i < num_valid_candidates_base_level_total_per_channel; i++) {
+							#pragma HLS pipeline II=1
+								result_t reg = s_distances_base_level_per_channel[channel_id].read();
+								s_distances_base_level.write(reg);
+							}
+						}
+					}
+
+					// stop if all channels are visited
+					stop = true;
+					for (int i = 0; i < N_CHANNEL; i++) {
+						if (!visited_channel[i]) {
+							stop = false;
+						}
+					}
+				}
+			}
+		}
+	}
+}
\ No newline at end of file
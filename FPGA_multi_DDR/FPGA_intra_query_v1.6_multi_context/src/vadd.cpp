@@ -0,0 +1,1072 @@
+#include "bloom_filter.hpp"
+#include "bloom_fetch_compute.hpp"
+#include "compute.hpp"
+#include "constants.hpp"
+#include "DRAM_utils.hpp"
+#include "scheduler.hpp"
+#include "types.hpp"
+#include "utils.hpp"
+
+extern "C" {
+
+void vadd(  
+	// in initialization
+	const int query_num,
+	const int query_batch_size, 
+	const int ef, // size of the result priority queue
+	const int candidate_queue_runtime_size, 
+	const int max_cand_batch_size, 
+	const int max_async_stage_num,
+	const int runtime_n_bucket_addr_bits,
+	const ap_uint<32> hash_seed,
+	const int max_bloom_out_burst_size,
+	const int max_link_num_base,
+	const int vector_layout, // VECTOR_LAYOUT_PADDED / VECTOR_LAYOUT_COMPACT (meta.bin)
+	const int link_layout, // LINK_LAYOUT_ORIGINAL / LINK_LAYOUT_PACKED (meta.bin)
+	const int runtime_num_query_contexts, // queries in flight, 1 ~ NUM_QUERY_CONTEXTS
+	const int runtime_channel_group_bits, // log2 of the channels per group, CHANNEL_ADDR_BITS: one group
+	const int runtime_index_channel_bits, // log2 of the channel number of the index files, <= runtime_channel_group_bits
+
+    // in runtime (from DRAM)
+	const int* entry_point_ids,
+	const ap_uint<512>* query_vectors,
+    ap_uint<512>* db_vectors_chan_0, 
+#if N_CHANNEL >= 2
+	ap_uint<512>* db_vectors_chan_1,
+#endif
+#if N_CHANNEL >= 4
+	ap_uint<512>* db_vectors_chan_2,
+	ap_uint<512>* db_vectors_chan_3,
+#endif
+#if N_CHANNEL >= 8
+	ap_uint<512>* db_vectors_chan_4,
+	ap_uint<512>* db_vectors_chan_5,
+	ap_uint<512>* db_vectors_chan_6,
+	ap_uint<512>* db_vectors_chan_7,
+#endif
+#if N_CHANNEL >= 16
+	ap_uint<512>* db_vectors_chan_8,
+	ap_uint<512>* db_vectors_chan_9,
+	ap_uint<512>* db_vectors_chan_10,
+	ap_uint<512>* db_vectors_chan_11,
+	ap_uint<512>* db_vectors_chan_12,
+	ap_uint<512>* db_vectors_chan_13,
+	ap_uint<512>* db_vectors_chan_14,
+	ap_uint<512>* db_vectors_chan_15,
+#endif
+
+    const ap_uint<512>* links_base_chan_0,
+#if N_CHANNEL >= 2
+	const ap_uint<512>* links_base_chan_1,
+#endif
+#if N_CHANNEL >= 4
+	const ap_uint<512>* links_base_chan_2,
+	const ap_uint<512>* links_base_chan_3,
+#endif
+#if N_CHANNEL >= 8
+	const ap_uint<512>* links_base_chan_4,
+	const ap_uint<512>* links_base_chan_5,
+	const ap_uint<512>* links_base_chan_6,
+	const ap_uint<512>* links_base_chan_7,
+#endif
+#if N_CHANNEL >= 16
+	const ap_uint<512>* links_base_chan_8,
+	const ap_uint<512>* links_base_chan_9,
+	const ap_uint<512>* links_base_chan_10,
+	const ap_uint<512>* links_base_chan_11,
+	const ap_uint<512>* links_base_chan_12,
+	const ap_uint<512>* links_base_chan_13,
+	const ap_uint<512>* links_base_chan_14,
+	const ap_uint<512>* links_base_chan_15,
+#endif
+
+    // out
+    int* out_id,
+	float* out_dist,
+
+	// debug signals (each 4 byte): 
+	//   0: bottom layer entry node id, 
+	//   1: number of hops in upper layers 
+	//   2: number of read vectors in upper layers
+	//   3: number of hops in base layer (number of pop operations)
+	//   4: number of valid read vectors in base layer
+	int* mem_debug
+    )
+{
+// Share the same AXI interface with several control signals (but they are not allowed in same dataflow)
+//    https://docs.xilinx.com/r/en-US/ug1399-vitis-hls/Controlling-AXI4-Burst-Behavior
+
+// in runtime (from DRAM)
+#pragma HLS INTERFACE m_axi port=entry_point_ids latency=32 num_read_outstanding=4 max_read_burst_length=16  num_write_outstanding=1 max_write_burst_length=2  offset=slave bundle=gmem0
+#pragma HLS INTERFACE m_axi port=query_vectors latency=32 num_read_outstanding=4 max_read_burst_length=16  num_write_outstanding=1 max_write_burst_length=2  offset=slave bundle=gmem0
+#pragma HLS INTERFACE m_axi port=mem_debug latency=32 num_read_outstanding=1 max_read_burst_length=2  num_write_outstanding=8 max_write_burst_length=16 offset=slave bundle=gmem10 // cannot share gmem with out as they are different PEs
+
+// If the port is a read-only port, then set the num_write_outstanding=1 and max_write_burst_length=2 to conserve memory resources. For write-only ports, set the num_read_outstanding=1 and max_read_burst_length=2.
+// https://docs.xilinx.com/r/2022.1-English/ug1399-vitis-hls/pragma-HLS-interface
+
+#pragma HLS INTERFACE m_axi port=db_vectors_chan_0 latency=64 num_read_outstanding=64  num_write_outstanding=1 max_write_burst_length=2 offset=slave bundle=gmemdb_vectors0
+#if N_CHANNEL >= 2
+#pragma HLS INTERFACE m_axi port=db_vectors_chan_1 latency=64 num_read_outstanding=64  num_write_outstanding=1 max_write_burst_length=2 offset=slave bundle=gmemdb_vectors1
+#endif
+#if N_CHANNEL >= 4
+#pragma HLS INTERFACE m_axi port=db_vectors_chan_2 latency=64 num_read_outstanding=64  num_write_outstanding=1 max_write_burst_length=2 offset=slave bundle=gmemdb_vectors2
+#pragma HLS INTERFACE m_axi port=db_vectors_chan_3 latency=64 num_read_outstanding=64  num_write_outstanding=1 max_write_burst_length=2 offset=slave bundle=gmemdb_vectors3
+#endif
+#if N_CHANNEL >= 8
+#pragma HLS INTERFACE m_axi port=db_vectors_chan_4 latency=64 num_read_outstanding=64  num_write_outstanding=1 max_write_burst_length=2 offset=slave bundle=gmemdb_vectors4
+#pragma HLS INTERFACE m_axi port=db_vectors_chan_5 latency=64 num_read_outstanding=64  num_write_outstanding=1 max_write_burst_length=2 offset=slave bundle=gmemdb_vectors5
+#pragma HLS INTERFACE m_axi port=db_vectors_chan_6 latency=64 num_read_outstanding=64  num_write_outstanding=1 max_write_burst_length=2 offset=slave bundle=gmemdb_vectors6
+#pragma HLS INTERFACE m_axi port=db_vectors_chan_7 latency=64 num_read_outstanding=64  num_write_outstanding=1 max_write_burst_length=2 offset=slave bundle=gmemdb_vectors7
+#endif
+#if N_CHANNEL >= 16
+#pragma HLS INTERFACE m_axi port=db_vectors_chan_8 latency=64 num_read_outstanding=64  num_write_outstanding=1 max_write_burst_length=2 offset=slave bundle=gmemdb_vectors8
+#pragma HLS INTERFACE m_axi port=db_vectors_chan_9 latency=64 num_read_outstanding=64  num_write_outstanding=1 max_write_burst_length=2 offset=slave bundle=gmemdb_vectors9
+#pragma HLS INTERFACE m_axi port=db_vectors_chan_10 latency=64 num_read_outstanding=64  num_write_outstanding=1 max_write_burst_length=2 offset=slave bundle=gmemdb_vectors10
+#pragma HLS INTERFACE m_axi port=db_vectors_chan_11 latency=64 num_read_outstanding=64  num_write_outstanding=1 max_write_burst_length=2 offset=slave bundle=gmemdb_vectors11
+#pragma HLS INTERFACE m_axi port=db_vectors_chan_12 latency=64 num_read_outstanding=64  num_write_outstanding=1 max_write_burst_length=2 offset=slave bundle=gmemdb_vectors12
+#pragma HLS INTERFACE m_axi port=db_vectors_chan_13 latency=64 num_read_outstanding=64  num_write_outstanding=1 max_write_burst_length=2 offset=slave bundle=gmemdb_vectors13
+#pragma HLS INTERFACE m_axi port=db_vectors_chan_14 latency=64 num_read_outstanding=64  num_write_outstanding=1 max_write_burst_length=2 offset=slave bundle=gmemdb_vectors14
+#pragma HLS INTERFACE m_axi port=db_vectors_chan_15 latency=64 num_read_outstanding=64  num_write_outstanding=1 max_write_burst_length=2 offset=slave bundle=gmemdb_vectors15
+#endif
+
+#pragma HLS INTERFACE m_axi port=links_base_chan_0 latency=32 num_read_outstanding=16  num_write_outstanding=1 max_write_burst_length=2 offset=slave bundle=gmemlinks_base0
+#if N_CHANNEL >= 2
+#pragma HLS INTERFACE m_axi port=links_base_chan_1 latency=32 num_read_outstanding=16  num_write_outstanding=1 max_write_burst_length=2 offset=slave bundle=gmemlinks_base1
+#endif
+#if N_CHANNEL >= 4
+#pragma HLS INTERFACE m_axi port=links_base_chan_2 latency=32 num_read_outstanding=16  num_write_outstanding=1 max_write_burst_length=2 offset=slave bundle=gmemlinks_base2
+#pragma HLS INTERFACE m_axi port=links_base_chan_3 latency=32 num_read_outstanding=16  num_write_outstanding=1 max_write_burst_length=2 offset=slave bundle=gmemlinks_base3
+#endif
+#if N_CHANNEL >= 8
+#pragma HLS INTERFACE m_axi port=links_base_chan_4 latency=32 num_read_outstanding=16  num_write_outstanding=1 max_write_burst_length=2 offset=slave bundle=gmemlinks_base4
+#pragma HLS INTERFACE m_axi port=links_base_chan_5 latency=32 num_read_outstanding=16  num_write_outstanding=1 max_write_burst_length=2 offset=slave bundle=gmemlinks_base5
+#pragma HLS INTERFACE m_axi port=links_base_chan_6 latency=32 num_read_outstanding=16  num_write_outstanding=1 max_write_burst_length=2 offset=slave bundle=gmemlinks_base6
+#pragma HLS INTERFACE m_axi port=links_base_chan_7 latency=32 num_read_outstanding=16  num_write_outstanding=1 max_write_burst_length=2 offset=slave bundle=gmemlinks_base7
+#endif
+#if N_CHANNEL >= 16
+#pragma HLS INTERFACE m_axi port=links_base_chan_8 latency=32 num_read_outstanding=16  num_write_outstanding=1 max_write_burst_length=2 offset=slave bundle=gmemlinks_base8
+#pragma HLS INTERFACE m_axi port=links_base_chan_9 latency=32 num_read_outstanding=16  num_write_outstanding=1 max_write_burst_length=2 offset=slave bundle=gmemlinks_base9
+#pragma HLS INTERFACE m_axi port=links_base_chan_10 latency=32 num_read_outstanding=16  num_write_outstanding=1 max_write_burst_length=2 offset=slave bundle=gmemlinks_base10
+#pragma HLS INTERFACE m_axi port=links_base_chan_11 latency=32 num_read_outstanding=16  num_write_outstanding=1 max_write_burst_length=2 offset=slave bundle=gmemlinks_base11
+#pragma HLS INTERFACE m_axi port=links_base_chan_12 latency=32 num_read_outstanding=16  num_write_outstanding=1 max_write_burst_length=2 offset=slave bundle=gmemlinks_base12
+#pragma HLS INTERFACE m_axi port=links_base_chan_13 latency=32 num_read_outstanding=16  num_write_outstanding=1 max_write_burst_length=2 offset=slave bundle=gmemlinks_base13
+#pragma HLS INTERFACE m_axi port=links_base_chan_14 latency=32 num_read_outstanding=16  num_write_outstanding=1 max_write_burst_length=2 offset=slave bundle=gmemlinks_base14
+#pragma HLS INTERFACE m_axi port=links_base_chan_15 latency=32 num_read_outstanding=16  num_write_outstanding=1 max_write_burst_length=2 offset=slave bundle=gmemlinks_base15
+#endif
+
+
+// out
+#pragma HLS INTERFACE m_axi port=out_id latency=32 num_read_outstanding=1 max_read_burst_length=2  num_write_outstanding=8 max_write_burst_length=16 offset=slave bundle=gmem9
+#pragma HLS INTERFACE m_axi port=out_dist latency=32 num_read_outstanding=1 max_read_burst_length=2  num_write_outstanding=8 max_write_burst_length=16 offset=slave bundle=gmem9
+
+#pragma HLS dataflow
+
+	hls::stream<int> s_query_batch_size;
+#pragma HLS stream variable=s_query_batch_size depth=depth_control
+
+	hls::stream<ap_uint<512>> s_query_vectors_in;
+#pragma HLS stream variable=s_query_vectors_in depth=depth_query_vectors
+
+	hls::stream<int> s_entry_point_ids;
+#pragma HLS stream variable=s_entry_point_ids depth=depth_control
+
+	hls::stream<int> s_finish_batch;
+#pragma HLS stream variable=s_finish_batch depth=depth_control
+
+    hls::stream<int> s_finish_query_task_scheduler; // finish the current query
+#pragma HLS stream variable=s_finish_query_task_scheduler depth=depth_control
+
+    hls::stream<int> s_finish_query_results_collection; // finish all queries
+#pragma HLS stream variable=s_finish_query_results_collection depth=depth_control
+	
+	hls::stream<ap_uint<512>> s_query_vectors_replicated[N_CHANNEL];
+#pragma HLS stream variable=s_query_vectors_replicated depth=depth_query_vectors
+
+// 	hls::stream<result_t> s_entry_point_base_level;
+// #pragma HLS stream variable=s_entry_point_base_level depth=depth_control
+
+	hls::stream<int> s_cand_batch_size;
+#pragma HLS stream variable=s_cand_batch_size depth=depth_control
+
+	hls::stream<int> s_cand_batch_ctx_ids[2]; // context of each candidate batch, 0: split_tasks_to_channels, 1: results_collection
+#pragma HLS stream variable=s_cand_batch_ctx_ids depth=depth_data
+
+	hls::stream<int> s_finished_query_ids; // the queries finish in any order
+#pragma HLS stream variable=s_finished_query_ids depth=depth_control
+
+    hls::stream<cand_t> s_top_candidates; // current top candidates
+#pragma HLS stream variable=s_top_candidates depth=depth_data
+
+	hls::stream<int> s_num_inserted_candidates;
+#pragma HLS stream variable=s_num_inserted_candidates depth=depth_control
+
+	hls::stream<result_t> s_inserted_candidates;
+#pragma HLS stream variable=s_inserted_candidates depth=depth_data
+
+	hls::stream<int> s_num_valid_candidates_base_level_total;
+#pragma HLS stream variable=s_num_valid_candidates_base_level_total depth=depth_control
+
+	hls::stream<result_t> s_distances_base_level;
+#pragma HLS stream variable=s_distances_base_level depth=depth_data
+
+	hls::stream<result_t> s_largest_result_queue_elements;
+#pragma HLS stream variable=s_largest_result_queue_elements depth=depth_control	
+
+	hls::stream<int> s_debug_signals;
+#pragma HLS stream variable=s_debug_signals depth=depth_control
+
+	const int rep_factor_s_largest_result_queue_elements = 1 + N_CHANNEL;
+	hls::stream<result_t> s_largest_result_queue_elements_replicated[rep_factor_s_largest_result_queue_elements];
+#pragma HLS stream variable=s_largest_result_queue_elements_replicated depth=depth_control		
+
+// 	hls::stream<int> s_debug_num_vec_base_layer;
+// #pragma HLS stream variable=s_debug_num_vec_base_layer depth=depth_control
+
+	hls::stream<int> s_finish_query_replicate_s_largest_result_queue_elements;
+#pragma HLS stream variable=s_finish_query_replicate_s_largest_result_queue_elements depth=depth_control
+
+	read_queries(
+		// in initialization
+		query_num,
+		query_batch_size,
+		// in DRAM
+		entry_point_ids,
+		query_vectors,
+		// in stream
+		s_finish_batch,
+
+		// out streams
+		s_query_batch_size,
+		s_query_vectors_in,
+		s_entry_point_ids
+	);
+
+	// replicate s_query_batch_size to multiple streams
+	const int replicate_factor_s_query_batch_size = 2 * N_CHANNEL + 9;
+	hls::stream<int> s_query_batch_size_replicated[replicate_factor_s_query_batch_size];
+#pragma HLS stream variable=s_query_batch_size_replicated depth=depth_control
+
+	replicate_s_query_batch_size<replicate_factor_s_query_batch_size>(
+		s_query_batch_size,
+		s_query_batch_size_replicated
+	);
+
+	// controls the traversal and maintains the candidate queue
+	task_scheduler(
+		candidate_queue_runtime_size,
+		max_cand_batch_size,
+		max_async_stage_num,
+		runtime_num_query_contexts,
+
+		// in streams
+		s_query_batch_size_replicated[0],
+		s_query_vectors_in,	
+		s_entry_point_ids, 
+		s_num_inserted_candidates,
+		s_inserted_candidates,
+		s_largest_result_queue_elements_replicated[0],
+		s_finish_query_replicate_s_largest_result_queue_elements,
+		
+		// out streams
+		s_query_vectors_replicated,
+		s_cand_batch_size,
+		s_cand_batch_ctx_ids,
+		s_top_candidates,
+		s_debug_signals,
+		s_finished_query_ids,
+		s_finish_query_task_scheduler
+	);
+
+
+	hls::stream<int> s_fetch_batch_size;
+#pragma HLS stream variable=s_fetch_batch_size depth=depth_control
+
+    hls::stream<ap_uint<512>> s_neighbor_ids_raw;
+#pragma HLS stream variable=s_neighbor_ids_raw depth=depth_data
+
+    hls::stream<int> s_finish_query_fetch_neighbor_ids; // finish all queries
+#pragma HLS stream variable=s_finish_query_fetch_neighbor_ids depth=depth_control
+
+	fetch_neighbor_ids(
+		max_link_num_base,
+		link_layout,
+		runtime_channel_group_bits,
+		runtime_index_channel_bits,
+		// in runtime (should from DRAM)
+    	links_base_chan_0,
+#if N_CHANNEL >= 2
+		links_base_chan_1,
+#endif
+#if N_CHANNEL >= 4
+		links_base_chan_2,
+		links_base_chan_3,
+#endif
+#if N_CHANNEL >= 8
+		links_base_chan_4,
+		links_base_chan_5,
+		links_base_chan_6,
+		links_base_chan_7,
+#endif
+#if N_CHANNEL >= 16
+		links_base_chan_8,
+		links_base_chan_9,
+		links_base_chan_10,
+		links_base_chan_11,
+		links_base_chan_12,
+		links_base_chan_13,
+		links_base_chan_14,
+		links_base_chan_15,
+#endif
+		// in runtime (stream)
+		s_query_batch_size_replicated[1],
+		s_top_candidates,
+		s_finish_query_task_scheduler,
+
+		// out (stream)
+		s_neighbor_ids_raw,
+		s_finish_query_fetch_neighbor_ids
+	);
+
+    hls::stream<int> s_num_neighbors_base_level_per_channel[N_CHANNEL]; // number of neighbors of the current candidate
+#pragma HLS stream variable=s_num_neighbors_base_level_per_channel depth=depth_control
+
+	hls::stream<cand_t> s_fetched_neighbor_ids_per_channel[N_CHANNEL]; 
+#pragma HLS stream variable=s_fetched_neighbor_ids_per_channel depth=depth_data
+
+    hls::stream<int> s_finish_query_split_tasks_to_channels; // finish all queries
+#pragma HLS stream variable=s_finish_query_split_tasks_to_channels depth=depth_control
+
+	split_tasks_to_channels(
+		max_link_num_base,
+		link_layout,
+		runtime_channel_group_bits,
+
+		// in streams
+		s_query_batch_size_replicated[2],
+		s_cand_batch_size,
+		s_cand_batch_ctx_ids[0],
+		s_neighbor_ids_raw,
+		s_finish_query_fetch_neighbor_ids,
+
+		// out streams
+		s_num_neighbors_base_level_per_channel,
+		s_fetched_neighbor_ids_per_channel,
+		s_finish_query_split_tasks_to_channels
+	);
+
+    hls::stream<int> s_finish_query_split_tasks_to_channels_replicated[N_CHANNEL]; // finish all queries
+#pragma HLS stream variable=s_finish_query_split_tasks_to_channels_replicated depth=depth_control
+
+	replicate_s_finish<N_CHANNEL>(
+		s_query_batch_size_replicated[3],
+		s_finish_query_split_tasks_to_channels,
+		s_finish_query_split_tasks_to_channels_replicated
+	);
+
+	hls::stream<int> s_num_valid_candidates_base_level_total_per_channel[N_CHANNEL];
+#pragma HLS stream variable=s_num_valid_candidates_base_level_total_per_channel depth=depth_control
+
+	hls::stream<result_t> s_distances_base_level_per_channel[N_CHANNEL];
+#pragma HLS stream variable=s_distances_base_level_per_channel depth=depth_data
+
+    hls::stream<int> s_finish_query_bloom_fetch_compute_per_channel[N_CHANNEL]; // finish all queries
+#pragma HLS stream variable=s_finish_query_bloom_fetch_compute_per_channel depth=depth_control
+
+
+	// using loop unrolling for bloom_fetch_compute can lead to compilation error
+	//   due to failed dataflow checking in HLS, when using inline pragma for bloom_fetch_compute
+
+	bloom_fetch_compute(
+		// in initialization
+		runtime_n_bucket_addr_bits,
+		hash_seed,
+		max_bloom_out_burst_size,
+		vector_layout,
+		runtime_index_channel_bits,
+
+		// in runtime (from DRAM)
+		db_vectors_chan_0,
+
+		// in streams
+		s_query_batch_size_replicated[0 + 4],
+		s_query_vectors_replicated[0],
+		s_num_neighbors_base_level_per_channel[0],
+		s_fetched_neighbor_ids_per_channel[0],
+		s_finish_query_split_tasks_to_channels_replicated[0],
+
+		// out streams
+		s_num_valid_candidates_base_level_total_per_channel[0],
+		s_distances_base_level_per_channel[0],
+		s_finish_query_bloom_fetch_compute_per_channel[0]
+	);
+	#if N_CHANNEL >= 2
+	bloom_fetch_compute(
+		// in initialization
+		runtime_n_bucket_addr_bits,
+		hash_seed,
+		max_bloom_out_burst_size,
+		vector_layout,
+		runtime_index_channel_bits,
+
+		// in runtime (from DRAM)
+		db_vectors_chan_1,
+
+		// in streams
+		s_query_batch_size_replicated[1 + 4],
+		s_query_vectors_replicated[1],
+		s_num_neighbors_base_level_per_channel[1],
+		s_fetched_neighbor_ids_per_channel[1],
+		s_finish_query_split_tasks_to_channels_replicated[1],
+
+		// out streams
+		s_num_valid_candidates_base_level_total_per_channel[1],
+		s_distances_base_level_per_channel[1],
+		s_finish_query_bloom_fetch_compute_per_channel[1]
+	);
+	#endif
+	#if N_CHANNEL >= 4
+	bloom_fetch_compute(
+		// in initialization
+		runtime_n_bucket_addr_bits,
+		hash_seed,
+		max_bloom_out_burst_size,
+		vector_layout,
+		runtime_index_channel_bits,
+
+		// in runtime (from DRAM)
+		db_vectors_chan_2,
+
+		// in streams
+		s_query_batch_size_replicated[2 + 4],
+		s_query_vectors_replicated[2],
+		s_num_neighbors_base_level_per_channel[2],
+		s_fetched_neighbor_ids_per_channel[2],
+		s_finish_query_split_tasks_to_channels_replicated[2],
+
+		// out streams
+		s_num_valid_candidates_base_level_total_per_channel[2],
+		s_distances_base_level_per_channel[2],
+		s_finish_query_bloom_fetch_compute_per_channel[2]
+	);
+	bloom_fetch_compute(
+		// in initialization
+		runtime_n_bucket_addr_bits,
+		hash_seed,
+		max_bloom_out_burst_size,
+		vector_layout,
+		runtime_index_channel_bits,
+
+		// in runtime (from DRAM)
+		db_vectors_chan_3,
+
+		// in streams
+		s_query_batch_size_replicated[3 + 4],
+		s_query_vectors_replicated[3],
+		s_num_neighbors_base_level_per_channel[3],
+		s_fetched_neighbor_ids_per_channel[3],
+		s_finish_query_split_tasks_to_channels_replicated[3],
+
+		// out streams
+		s_num_valid_candidates_base_level_total_per_channel[3],
+		s_distances_base_level_per_channel[3],
+		s_finish_query_bloom_fetch_compute_per_channel[3]
+	);
+	#endif
+	#if N_CHANNEL >= 8
+	bloom_fetch_compute(
+		// in initialization
+		runtime_n_bucket_addr_bits,
+		hash_seed,
+		max_bloom_out_burst_size,
+		vector_layout,
+		runtime_index_channel_bits,
+		
+		// in runtime (from DRAM)
+		db_vectors_chan_4,
+
+		// in streams
+		s_query_batch_size_replicated[4 + 4],
+		s_query_vectors_replicated[4],
+		s_num_neighbors_base_level_per_channel[4],
+		s_fetched_neighbor_ids_per_channel[4],
+		s_finish_query_split_tasks_to_channels_replicated[4],
+
+		// out streams
+		s_num_valid_candidates_base_level_total_per_channel[4],
+		s_distances_base_level_per_channel[4],
+		s_finish_query_bloom_fetch_compute_per_channel[4]
+	);
+
+	bloom_fetch_compute(
+		// in initialization
+		runtime_n_bucket_addr_bits,
+		hash_seed,
+		max_bloom_out_burst_size,
+		vector_layout,
+		runtime_index_channel_bits,
+
+		// in runtime (from DRAM)
+		db_vectors_chan_5,
+
+		// in streams
+		s_query_batch_size_replicated[5 + 4],
+		s_query_vectors_replicated[5],
+		s_num_neighbors_base_level_per_channel[5],
+		s_fetched_neighbor_ids_per_channel[5],
+		s_finish_query_split_tasks_to_channels_replicated[5],
+
+		// out streams
+		s_num_valid_candidates_base_level_total_per_channel[5],
+		s_distances_base_level_per_channel[5],
+		s_finish_query_bloom_fetch_compute_per_channel[5]
+	);
+
+	bloom_fetch_compute(
+		// in initialization
+		runtime_n_bucket_addr_bits,
+		hash_seed,
+		max_bloom_out_burst_size,
+		vector_layout,
+		runtime_index_channel_bits,
+
+		// in runtime (from DRAM)
+		db_vectors_chan_6,
+
+		// in streams
+		s_query_batch_size_replicated[6 + 4],
+		s_query_vectors_replicated[6],
+		s_num_neighbors_base_level_per_channel[6],
+		s_fetched_neighbor_ids_per_channel[6],
+		s_finish_query_split_tasks_to_channels_replicated[6],
+
+		// out streams
+		s_num_valid_candidates_base_level_total_per_channel[6],
+		s_distances_base_level_per_channel[6],
+		s_finish_query_bloom_fetch_compute_per_channel[6]
+	);
+	bloom_fetch_compute(
+		// in initialization
+		runtime_n_bucket_addr_bits,
+		hash_seed,
+		max_bloom_out_burst_size,
+		vector_layout,
+		runtime_index_channel_bits,
+
+		// in runtime (from DRAM)
+		db_vectors_chan_7,
+
+		// in streams
+		s_query_batch_size_replicated[7 + 4],
+		s_query_vectors_replicated[7],
+		s_num_neighbors_base_level_per_channel[7],
+		s_fetched_neighbor_ids_per_channel[7],
+		s_finish_query_split_tasks_to_channels_replicated[7],
+
+		// out streams
+		s_num_valid_candidates_base_level_total_per_channel[7],
+		s_distances_base_level_per_channel[7],
+		s_finish_query_bloom_fetch_compute_per_channel[7]
+	);
+	#endif
+	#if N_CHANNEL >= 16
+	bloom_fetch_compute(
+		// in initialization
+		runtime_n_bucket_addr_bits,
+		hash_seed,
+		max_bloom_out_burst_size,
+		vector_layout,
+		runtime_index_channel_bits,
+
+		// in runtime (from DRAM)
+		db_vectors_chan_8,
+
+		// in streams
+		s_query_batch_size_replicated[8 + 4],
+		s_query_vectors_replicated[8],
+		s_num_neighbors_base_level_per_channel[8],
+		s_fetched_neighbor_ids_per_channel[8],
+		s_finish_query_split_tasks_to_channels_replicated[8],
+
+		// out streams
+		s_num_valid_candidates_base_level_total_per_channel[8],
+		s_distances_base_level_per_channel[8],
+		s_finish_query_bloom_fetch_compute_per_channel[8]
+	);
+
+	bloom_fetch_compute(
+		// in initialization
+		runtime_n_bucket_addr_bits,
+		hash_seed,
+		max_bloom_out_burst_size,
+		vector_layout,
+		runtime_index_channel_bits,
+
+		// in runtime (from DRAM)
+		db_vectors_chan_9,
+
+		// in streams
+		s_query_batch_size_replicated[9 + 4],
+		s_query_vectors_replicated[9],
+		s_num_neighbors_base_level_per_channel[9],
+		s_fetched_neighbor_ids_per_channel[9],
+		s_finish_query_split_tasks_to_channels_replicated[9],
+
+		// out streams
+		s_num_valid_candidates_base_level_total_per_channel[9],
+		s_distances_base_level_per_channel[9],
+		s_finish_query_bloom_fetch_compute_per_channel[9]
+	);
+
+	bloom_fetch_compute(
+		// in initialization
+		runtime_n_bucket_addr_bits,
+		hash_seed,
+		max_bloom_out_burst_size,
+		vector_layout,
+		runtime_index_channel_bits,
+		
+		// in runtime (from DRAM)
+		db_vectors_chan_10,
+
+		// in streams
+		s_query_batch_size_replicated[10 + 4],
+		s_query_vectors_replicated[10],
+		s_num_neighbors_base_level_per_channel[10],
+		s_fetched_neighbor_ids_per_channel[10],
+		s_finish_query_split_tasks_to_channels_replicated[10],
+
+		// out streams
+		s_num_valid_candidates_base_level_total_per_channel[10],
+		s_distances_base_level_per_channel[10],
+		s_finish_query_bloom_fetch_compute_per_channel[10]
+	);
+
+	bloom_fetch_compute(
+		// in initialization
+		runtime_n_bucket_addr_bits,
+		hash_seed,
+		max_bloom_out_burst_size,
+		vector_layout,
+		runtime_index_channel_bits,
+
+		// in runtime (from DRAM)
+		db_vectors_chan_11,
+
+		// in streams
+		s_query_batch_size_replicated[11 + 4],
+		s_query_vectors_replicated[11],
+		s_num_neighbors_base_level_per_channel[11],
+		s_fetched_neighbor_ids_per_channel[11],
+		s_finish_query_split_tasks_to_channels_replicated[11],
+
+		// out streams
+		s_num_valid_candidates_base_level_total_per_channel[11],
+		s_distances_base_level_per_channel[11],
+		s_finish_query_bloom_fetch_compute_per_channel[11]
+	);
+
+	bloom_fetch_compute(
+		// in initialization
+		runtime_n_bucket_addr_bits,
+		hash_seed,
+		max_bloom_out_burst_size,
+		vector_layout,
+		runtime_index_channel_bits,
+
+		// in runtime (from DRAM)
+		db_vectors_chan_12,
+
+		// in streams
+		s_query_batch_size_replicated[12 + 4],
+		s_query_vectors_replicated[12],
+		s_num_neighbors_base_level_per_channel[12],
+		s_fetched_neighbor_ids_per_channel[12],
+		s_finish_query_split_tasks_to_channels_replicated[12],
+
+		// out streams
+		s_num_valid_candidates_base_level_total_per_channel[12],
+		s_distances_base_level_per_channel[12],
+		s_finish_query_bloom_fetch_compute_per_channel[12]
+	);
+
+	bloom_fetch_compute(
+		// in initialization
+		runtime_n_bucket_addr_bits,
+		hash_seed,
+		max_bloom_out_burst_size,
+		vector_layout,
+		runtime_index_channel_bits,
+
+		// in runtime (from DRAM)
+		db_vectors_chan_13,
+
+		// in streams
+		s_query_batch_size_replicated[13 + 4],
+		s_query_vectors_replicated[13],
+		s_num_neighbors_base_level_per_channel[13],
+		s_fetched_neighbor_ids_per_channel[13],
+		s_finish_query_split_tasks_to_channels_replicated[13],
+
+		// out streams
+		s_num_valid_candidates_base_level_total_per_channel[13],
+		s_distances_base_level_per_channel[13],
+		s_finish_query_bloom_fetch_compute_per_channel[13]
+	);
+
+	bloom_fetch_compute(
+		// in initialization
+		runtime_n_bucket_addr_bits,
+		hash_seed,
+		max_bloom_out_burst_size,
+		vector_layout,
+		runtime_index_channel_bits,
+
+		// in runtime (from DRAM)
+		db_vectors_chan_14,
+
+		// in streams
+		s_query_batch_size_replicated[14 + 4],
+		s_query_vectors_replicated[14],
+		s_num_neighbors_base_level_per_channel[14],
+		s_fetched_neighbor_ids_per_channel[14],
+		s_finish_query_split_tasks_to_channels_replicated[14],
+
+		// out streams
+		s_num_valid_candidates_base_level_total_per_channel[14],
+		s_distances_base_level_per_channel[14],
+		s_finish_query_bloom_fetch_compute_per_channel[14]
+	);
+
+	bloom_fetch_compute(
+		// in initialization
+		runtime_n_bucket_addr_bits,
+		hash_seed,
+		max_bloom_out_burst_size,
+		vector_layout,
+		runtime_index_channel_bits,
+
+		// in runtime (from DRAM)
+		db_vectors_chan_15,
+
+		// in streams
+		s_query_batch_size_replicated[15 + 4],
+		s_query_vectors_replicated[15],
+		s_num_neighbors_base_level_per_channel[15],
+		s_fetched_neighbor_ids_per_channel[15],
+		s_finish_query_split_tasks_to_channels_replicated[15],
+
+		// out streams
+		s_num_valid_candidates_base_level_total_per_channel[15],
+		s_distances_base_level_per_channel[15],
+		s_finish_query_bloom_fetch_compute_per_channel[15]
+	);
+	#endif
+
+	hls::stream<int> s_num_valid_candidates_base_level_filtered_per_channel[N_CHANNEL];
+#pragma HLS stream variable=s_num_valid_candidates_base_level_filtered_per_channel depth=depth_control
+
+	hls::stream<result_t> s_distances_base_filtered_per_channel[N_CHANNEL];
+#pragma HLS stream variable=s_distances_base_filtered_per_channel depth=depth_data
+
+    hls::stream<int> s_finish_filter_computed_distances_per_channel[N_CHANNEL]; // finish all queries
+#pragma HLS stream variable=s_finish_filter_computed_distances_per_channel depth=depth_control	
+
+filter_computed_distances(
+    // in stream
+    s_query_batch_size_replicated[0 + N_CHANNEL + 4],
+    s_num_valid_candidates_base_level_total_per_channel[0],
+    s_largest_result_queue_elements_replicated[0 + 1],
+    s_distances_base_level_per_channel[0],
+    s_finish_query_bloom_fetch_compute_per_channel[0],
+
+    // out stream
+    s_num_valid_candidates_base_level_filtered_per_channel[0],
+    s_distances_base_filtered_per_channel[0],
+    s_finish_filter_computed_distances_per_channel[0]
+);
+#if N_CHANNEL >= 2
+filter_computed_distances(
+    // in stream
+    s_query_batch_size_replicated[1 + N_CHANNEL + 4],
+    s_num_valid_candidates_base_level_total_per_channel[1],
+    s_largest_result_queue_elements_replicated[1 + 1],
+    s_distances_base_level_per_channel[1],
+    s_finish_query_bloom_fetch_compute_per_channel[1],
+
+    // out stream
+    s_num_valid_candidates_base_level_filtered_per_channel[1],
+    s_distances_base_filtered_per_channel[1],
+    s_finish_filter_computed_distances_per_channel[1]
+);
+#endif
+#if N_CHANNEL >= 4
+filter_computed_distances(
+    // in stream
+    s_query_batch_size_replicated[2 + N_CHANNEL + 4],
+    s_num_valid_candidates_base_level_total_per_channel[2],
+    s_largest_result_queue_elements_replicated[2 + 1],
+    s_distances_base_level_per_channel[2],
+    s_finish_query_bloom_fetch_compute_per_channel[2],
+
+    // out stream
+    s_num_valid_candidates_base_level_filtered_per_channel[2],
+    s_distances_base_filtered_per_channel[2],
+    s_finish_filter_computed_distances_per_channel[2]
+);
+filter_computed_distances(
+    // in stream
+    s_query_batch_size_replicated[3 + N_CHANNEL + 4],
+    s_num_valid_candidates_base_level_total_per_channel[3],
+    s_largest_result_queue_elements_replicated[3 + 1],
+    s_distances_base_level_per_channel[3],
+    s_finish_query_bloom_fetch_compute_per_channel[3],
+
+    // out stream
+    s_num_valid_candidates_base_level_filtered_per_channel[3],
+    s_distances_base_filtered_per_channel[3],
+    s_finish_filter_computed_distances_per_channel[3]
+);
+#endif
+#if N_CHANNEL >= 8
+filter_computed_distances(
+    // in stream
+    s_query_batch_size_replicated[4 + N_CHANNEL + 4],
+    s_num_valid_candidates_base_level_total_per_channel[4],
+    s_largest_result_queue_elements_replicated[4 + 1],
+    s_distances_base_level_per_channel[4],
+    s_finish_query_bloom_fetch_compute_per_channel[4],
+
+    // out stream
+    s_num_valid_candidates_base_level_filtered_per_channel[4],
+    s_distances_base_filtered_per_channel[4],
+    s_finish_filter_computed_distances_per_channel[4]
+);
+filter_computed_distances(
+    // in stream
+    s_query_batch_size_replicated[5 + N_CHANNEL + 4],
+    s_num_valid_candidates_base_level_total_per_channel[5],
+    s_largest_result_queue_elements_replicated[5 + 1],
+    s_distances_base_level_per_channel[5],
+    s_finish_query_bloom_fetch_compute_per_channel[5],
+
+    // out stream
+    s_num_valid_candidates_base_level_filtered_per_channel[5],
+    s_distances_base_filtered_per_channel[5],
+    s_finish_filter_computed_distances_per_channel[5]
+);
+filter_computed_distances(
+    // in stream
+    s_query_batch_size_replicated[6 + N_CHANNEL + 4],
+    s_num_valid_candidates_base_level_total_per_channel[6],
+    s_largest_result_queue_elements_replicated[6 + 1],
+    s_distances_base_level_per_channel[6],
+    s_finish_query_bloom_fetch_compute_per_channel[6],
+
+    // out stream
+    s_num_valid_candidates_base_level_filtered_per_channel[6],
+    s_distances_base_filtered_per_channel[6],
+    s_finish_filter_computed_distances_per_channel[6]
+);
+filter_computed_distances(
+    // in stream
+    s_query_batch_size_replicated[7 + N_CHANNEL + 4],
+    s_num_valid_candidates_base_level_total_per_channel[7],
+    s_largest_result_queue_elements_replicated[7 + 1],
+    s_distances_base_level_per_channel[7],
+    s_finish_query_bloom_fetch_compute_per_channel[7],
+
+    // out stream
+    s_num_valid_candidates_base_level_filtered_per_channel[7],
+    s_distances_base_filtered_per_channel[7],
+    s_finish_filter_computed_distances_per_channel[7]
+);
+#endif
+#if N_CHANNEL >= 16
+filter_computed_distances(
+    // in stream
+    s_query_batch_size_replicated[8 + N_CHANNEL + 4],
+    s_num_valid_candidates_base_level_total_per_channel[8],
+    s_largest_result_queue_elements_replicated[8 + 1],
+    s_distances_base_level_per_channel[8],
+    s_finish_query_bloom_fetch_compute_per_channel[8],
+
+    // out stream
+    s_num_valid_candidates_base_level_filtered_per_channel[8],
+    s_distances_base_filtered_per_channel[8],
+    s_finish_filter_computed_distances_per_channel[8]
+);
+filter_computed_distances(
+    // in stream
+    s_query_batch_size_replicated[9 + N_CHANNEL + 4],
+    s_num_valid_candidates_base_level_total_per_channel[9],
+    s_largest_result_queue_elements_replicated[9 + 1],
+    s_distances_base_level_per_channel[9],
+    s_finish_query_bloom_fetch_compute_per_channel[9],
+
+    // out stream
+    s_num_valid_candidates_base_level_filtered_per_channel[9],
+    s_distances_base_filtered_per_channel[9],
+    s_finish_filter_computed_distances_per_channel[9]
+);
+filter_computed_distances(
+    // in stream
+    s_query_batch_size_replicated[10 + N_CHANNEL + 4],
+    s_num_valid_candidates_base_level_total_per_channel[10],
+    s_largest_result_queue_elements_replicated[10 + 1],
+    s_distances_base_level_per_channel[10],
+    s_finish_query_bloom_fetch_compute_per_channel[10],
+
+    // out stream
+    s_num_valid_candidates_base_level_filtered_per_channel[10],
+    s_distances_base_filtered_per_channel[10],
+    s_finish_filter_computed_distances_per_channel[10]
+);
+filter_computed_distances(
+    // in stream
+    s_query_batch_size_replicated[11 + N_CHANNEL + 4],
+    s_num_valid_candidates_base_level_total_per_channel[11],
+    s_largest_result_queue_elements_replicated[11 + 1],
+    s_distances_base_level_per_channel[11],
+    s_finish_query_bloom_fetch_compute_per_channel[11],
+
+    // out stream
+    s_num_valid_candidates_base_level_filtered_per_channel[11],
+    s_distances_base_filtered_per_channel[11],
+    s_finish_filter_computed_distances_per_channel[11]
+);
+filter_computed_distances(
+    // in stream
+    s_query_batch_size_replicated[12 + N_CHANNEL + 4],
+    s_num_valid_candidates_base_level_total_per_channel[12],
+    s_largest_result_queue_elements_replicated[12 + 1],
+    s_distances_base_level_per_channel[12],
+    s_finish_query_bloom_fetch_compute_per_channel[12],
+
+    // out stream
+    s_num_valid_candidates_base_level_filtered_per_channel[12],
+    s_distances_base_filtered_per_channel[12],
+    s_finish_filter_computed_distances_per_channel[12]
+);
+filter_computed_distances(
+    // in stream
+    s_query_batch_size_replicated[13 + N_CHANNEL + 4],
+    s_num_valid_candidates_base_level_total_per_channel[13],
+    s_largest_result_queue_elements_replicated[13 + 1],
+    s_distances_base_level_per_channel[13],
+    s_finish_query_bloom_fetch_compute_per_channel[13],
+
+    // out stream
+    s_num_valid_candidates_base_level_filtered_per_channel[13],
+    s_distances_base_filtered_per_channel[13],
+    s_finish_filter_computed_distances_per_channel[13]
+);
+filter_computed_distances(
+    // in stream
+    s_query_batch_size_replicated[14 + N_CHANNEL + 4],
+    s_num_valid_candidates_base_level_total_per_channel[14],
+    s_largest_result_queue_elements_replicated[14 + 1],
+    s_distances_base_level_per_channel[14],
+    s_finish_query_bloom_fetch_compute_per_channel[14],
+
+    // out stream
+    s_num_valid_candidates_base_level_filtered_per_channel[14],
+    s_distances_base_filtered_per_channel[14],
+    s_finish_filter_computed_distances_per_channel[14]
+);
+filter_computed_distances(
+    // in stream
+    s_query_batch_size_replicated[15 + N_CHANNEL + 4],
+    s_num_valid_candidates_base_level_total_per_channel[15],
+    s_largest_result_queue_elements_replicated[15 + 1],
+    s_distances_base_level_per_channel[15],
+    s_finish_query_bloom_fetch_compute_per_channel[15],
+
+    // out stream
+    s_num_valid_candidates_base_level_filtered_per_channel[15],
+    s_distances_base_filtered_per_channel[15],
+    s_finish_filter_computed_distances_per_channel[15]
+);
+#endif
+
+    hls::stream<int> s_finish_query_filter_computed_distances; // finish all queries
+#pragma HLS stream variable=s_finish_query_filter_computed_distances depth=depth_control
+
+	gather_s_finish<N_CHANNEL>(
+    	s_query_batch_size_replicated[2 * N_CHANNEL + 4],
+		s_finish_filter_computed_distances_per_channel,
+		s_finish_query_filter_computed_distances
+	);
+
+    hls::stream<int> s_finish_gather_distances_from_channels; // finish all queries
+#pragma HLS stream variable=s_finish_gather_distances_from_channels depth=depth_control
+
+	gather_distances_from_channels(
+    	s_query_batch_size_replicated[2 * N_CHANNEL + 5],
+		s_num_valid_candidates_base_level_filtered_per_channel,
+		s_distances_base_filtered_per_channel,
+		s_finish_query_filter_computed_distances,
+
+		s_num_valid_candidates_base_level_total,
+		s_distances_base_level,
+		s_finish_gather_distances_from_channels
+	);
+
+	hls::stream<int> s_out_ids;
+#pragma HLS stream variable=s_out_ids depth=depth_data
+
+	hls::stream<float> s_out_dists;
+#pragma HLS stream variable=s_out_dists depth=depth_data
+
+	results_collection(
+		// in (initialization)
+		ef,
+		// in runtime (stream)
+    	s_query_batch_size_replicated[2 * N_CHANNEL + 6],
+		s_cand_batch_ctx_ids[1],
+		s_num_valid_candidates_base_level_total,
+		s_distances_base_level,
+		s_finish_gather_distances_from_channels,
+
+		// out (stream)
+		s_inserted_candidates,
+		s_num_inserted_candidates,
+		s_largest_result_queue_elements,
+		s_finish_query_results_collection,
+		s_out_ids,
+		s_out_dists
+	);
+
+	replicate_s_control<rep_factor_s_largest_result_queue_elements, result_t>(
+		// in (stream)
+    	s_query_batch_size_replicated[2 * N_CHANNEL + 7],
+		s_largest_result_queue_elements,
+		s_finish_query_results_collection,
+		
+		// out (stream)
+		s_largest_result_queue_elements_replicated,
+		s_finish_query_replicate_s_largest_result_queue_elements
+	);
+
+	// write in round robine same as split_queries
+	write_results(
+		ef,
+
+		// in streams
+		s_query_batch_size_replicated[2 * N_CHANNEL + 8], // -1: stop
+		s_finished_query_ids,
+		s_out_ids,
+		s_out_dists,
+		s_debug_signals,
+
+		// out streams
+		s_finish_batch,
+
+		// out
+		out_id,
+		out_dist,
+		mem_debug
+	);
+
+}
+
+}
@@ -12,6 +12,8 @@ Host CPU communicates with one or multiple FPGAs, can choose to use index or not
     "<2 + 3 * num_FPGA dataset> <3 + 3 * num_FPGA graph_type> <4 + 3 * num_FPGA max_degree> <5 + 3 * num_FPGA ef> " 
     "<6 + 3 * num_FPGA query_num> " "<7 + 3 * num_FPGA batch_size> "
     "<8 + 3 * num_FPGA query_window_size> <9 + 3 * num_FPGA batch_window_size> " 
+    "[<10 + 3 * num_FPGA arrival_mode (closed/poisson/trace)> <11 + 3 * num_FPGA offered QPS list/trace file> "
+    "[<12 + 3 * num_FPGA latency_SLO_ms> <13 + 3 * num_FPGA service time model, batch_size:ms,...>]] "
 */
 
 #include <algorithm>
@@ -19,6 +21,7 @@ Host CPU communicates with one or multiple FPGAs, can choose to use index or not
 #include <cassert>
 #include <chrono>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <mutex>
 #include <pthread.h>
@@ -33,7 +36,10 @@ Host CPU communicates with one or multiple FPGAs, can choose to use index or not
 #include <vector>
 #include <netinet/tcp.h>
 
+#include "adaptive_batching.hpp"
 #include "constants.hpp"
+#include "load_generator.hpp"
+#include "multi_FPGA_transport.hpp"
 #include "types.hpp"
 #include "utils.hpp"
 
@@ -63,8 +69,8 @@ public:
   const int ef;
   const int max_degree;
   const int query_num;
-  const int batch_size;
-  int total_batch_num; // total number of batches to send
+  const int batch_size; // max batch size with adaptive batching
+  int total_batch_num; // total number of batches to send (known once sent with adaptive batching)
   const int query_window_size; // gap between query IDs of C2F and F2C
   const int batch_window_size; // whether enable inter-batch pipeline overlap (0 = low latency; 1 = hgih throughput)
 
@@ -135,8 +141,23 @@ public:
   std::vector<float> gt_dist;
   std::vector<int> labels_base; // for HNSW, which can reorder the query IDs
 
+  // merged results of all FPGAs (top ef per query, ascending distance), written online by thread_F2C
+  //   as soon as the last FPGA's block of a query arrives; vector IDs are dataset IDs (HNSW labels applied)
+  std::vector<int> merged_vec_ID;
+  std::vector<float> merged_dist;
+  // consumer of the merged results, called by thread_F2C per query in query ID order (optional)
+  std::function<void(int query_id, const int* vec_ID, const float* dist, int topK)> result_callback;
+
   std::chrono::system_clock::time_point* batch_start_time_array;
   std::chrono::system_clock::time_point* batch_finish_time_array;
+  // per query: arrival (open-loop, see load_generator.hpp; closed-loop: = start) -> start sending the query
+  //   to the FPGAs -> merged results ready
+  ArrivalSchedule arrival_schedule;
+  DeadlineBatcher* deadline_batcher; // NULL: fixed batch size
+  int* batch_last_query_id; // per batch, set by the C2F thread before sending it
+  std::chrono::system_clock::time_point* query_arrival_time_array;
+  std::chrono::system_clock::time_point* query_start_time_array;
+  std::chrono::system_clock::time_point* query_finish_time_array;
   // end-to-end performance
   double QPS;
 
@@ -153,10 +174,15 @@ public:
     const int in_num_FPGA,
     const char** in_FPGA_IP_addr,
     const unsigned int* in_C2F_port,
-    const unsigned int* in_F2C_port) :
+    const unsigned int* in_F2C_port,
+    std::string in_arrival_mode = "closed",
+    std::string in_arrival_arg = "",
+    double in_latency_SLO_ms = 0,
+    std::string in_service_time_model = "") :
     dataset(in_dataset), graph_type(in_graph_type), max_degree(in_max_degree), ef(in_ef), query_num(in_query_num), batch_size(in_batch_size), 
     query_window_size(in_query_window_size), batch_window_size(in_batch_window_size),
-    num_FPGA(in_num_FPGA), FPGA_IP_addr(in_FPGA_IP_addr), C2F_port(in_C2F_port), F2C_port(in_F2C_port) {
+    num_FPGA(in_num_FPGA), FPGA_IP_addr(in_FPGA_IP_addr), C2F_port(in_C2F_port), F2C_port(in_F2C_port),
+    arrival_schedule(in_arrival_mode, in_arrival_arg, in_query_num, in_batch_size) {
 
     // if start with SIFT
     if (dataset.find("SIFT") == 0) { D = 128;}
@@ -168,6 +194,16 @@ public:
 
     // Initialize internal variables
     total_batch_num = query_num % batch_size == 0? query_num / batch_size : query_num / batch_size + 1;
+    deadline_batcher = NULL;
+    if (in_latency_SLO_ms > 0) {
+      if (!arrival_schedule.open_loop()) {
+        std::cout << "Adaptive batching needs an open-loop arrival mode (poisson or trace)" << std::endl;
+        exit(1);
+      }
+      deadline_batcher = new DeadlineBatcher(batch_size, in_latency_SLO_ms, in_service_time_model);
+    }
+    // upper bound of the batch number with adaptive batching
+    int max_batch_num = deadline_batcher? query_num : total_batch_num;
 
     start_F2C = 0;
     start_C2F = 0;
@@ -204,14 +240,20 @@ public:
     sock_f2c = (int*) malloc(num_FPGA * sizeof(int));
     sock_c2f = (int*) malloc(num_FPGA * sizeof(int));
 
+    // registered with the transport for the whole run (multi_FPGA_transport.hpp)
     for (int i = 0; i < num_FPGA; i++) {
-      buf_F2C_per_FPGA[i] = (char*) malloc(bytes_F2C_per_query * query_num);
+      buf_F2C_per_FPGA[i] = alloc_pinned_buffer(bytes_F2C_per_query * query_num);
     }
-    buf_C2F = (char*) malloc(bytes_vec * query_num); // only the queries
-    memset(buf_C2F, 0, bytes_vec * query_num);
+    buf_C2F = alloc_pinned_buffer(bytes_vec * query_num); // only the queries
 
-    batch_start_time_array = (std::chrono::system_clock::time_point*) malloc(total_batch_num * sizeof(std::chrono::system_clock::time_point));
-    batch_finish_time_array = (std::chrono::system_clock::time_point*) malloc(total_batch_num * sizeof(std::chrono::system_clock::time_point));
+    batch_start_time_array = (std::chrono::system_clock::time_point*) malloc(max_batch_num * sizeof(std::chrono::system_clock::time_point));
+    batch_finish_time_array = (std::chrono::system_clock::time_point*) malloc(max_batch_num * sizeof(std::chrono::system_clock::time_point));
+    batch_last_query_id = (int*) malloc(max_batch_num * sizeof(int));
+    query_arrival_time_array = (std::chrono::system_clock::time_point*) malloc(query_num * sizeof(std::chrono::system_clock::time_point));
+    query_start_time_array = (std::chrono::system_clock::time_point*) malloc(query_num * sizeof(std::chrono::system_clock::time_point));
+    query_finish_time_array = (std::chrono::system_clock::time_point*) malloc(query_num * sizeof(std::chrono::system_clock::time_point));
+    merged_vec_ID.resize(query_num * ef);
+    merged_dist.resize(query_num * ef);
 
     assert (in_num_FPGA < MAX_FPGA_NUM);
 
@@ -446,43 +488,6 @@ public:
 
   }
 
-  // C2F send batch header
-  void send_header(char *buf_header) {
-    for (int n = 0; n < num_FPGA; n++) {
-      size_t sent_header_bytes = 0;
-      while (sent_header_bytes < bytes_C2F_header) {
-        int C2F_bytes_this_iter = (bytes_C2F_header - sent_header_bytes) < C2F_PKG_SIZE ? (bytes_C2F_header - sent_header_bytes) : C2F_PKG_SIZE;
-        int C2F_bytes = send(sock_c2f[n], &buf_header[sent_header_bytes], C2F_bytes_this_iter, 0);
-        sent_header_bytes += C2F_bytes;
-        if (C2F_bytes == -1) {
-          printf("Sending data UNSUCCESSFUL!\n");
-          return;
-        }
-      }
-    }
-  }
-
-  // C2F send a single query
-  void send_query(char *buf_query_vec) {
-    for (int n = 0; n < num_FPGA; n++) {
-      size_t total_C2F_bytes = 0;
-      while (total_C2F_bytes < bytes_vec) {
-        int C2F_bytes_this_iter = (bytes_vec - total_C2F_bytes) < C2F_PKG_SIZE ? (bytes_vec - total_C2F_bytes) : C2F_PKG_SIZE;
-        int C2F_bytes = send(sock_c2f[n], buf_query_vec + total_C2F_bytes, C2F_bytes_this_iter, 0);
-        total_C2F_bytes += C2F_bytes;
-        if (C2F_bytes == -1) {
-          printf("Sending data UNSUCCESSFUL!\n");
-          return;
-        } else {
-          IF_DEBUG_DO(std::cout << "total C2F bytes = " << total_C2F_bytes << std::endl;);
-        }
-      }
-      if (total_C2F_bytes != bytes_vec) {
-        printf("Sending error, sending more bytes than a block\n");
-      }
-    }
-  }
-
   /* This method is meant to be run in a separate thread.
    * It establishes and maintains a connection to the FPGA.
    * It is resposible for sending the queries to the FPGA.
@@ -496,39 +501,83 @@ public:
       sock_c2f[i] = send_open_conn(FPGA_IP_addr[i], C2F_port[i]);
     }
 
+    MultiFPGASender sender(num_FPGA, sock_c2f);
+
     start_C2F = 1;
 
     ////////////////   Data transfer + Select Cells   ////////////////
 
     // used to prepare the header data in the exact layout the FPGA expects
     char buf_header[bytes_C2F_header];
+    memset(buf_header, 0, bytes_C2F_header);
 
     std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
 
-    for (int C2F_batch_id = 0; C2F_batch_id < total_batch_num; C2F_batch_id++) {
+    int C2F_batch_id = 0;
+    for (int first_query_id = 0; first_query_id < query_num; C2F_batch_id++) {
 
       std::cout << "C2F_batch_id: " << C2F_batch_id << std::endl;
+      int current_batch_size;
+      if (deadline_batcher) {
+        // wait until the batch is due for the SLO (adaptive_batching.hpp)
+        current_batch_size = deadline_batcher->form_batch(first_query_id, arrival_schedule, &finish_F2C_query_id, query_arrival_time_array);
+      } else {
+        current_batch_size = query_num - first_query_id < batch_size? query_num - first_query_id : batch_size;
+        // open-loop: wait until the queries of the batch have arrived
+        arrival_schedule.wait_for_batch(first_query_id, current_batch_size, &finish_F2C_query_id, query_arrival_time_array);
+      }
+      batch_last_query_id[C2F_batch_id] = first_query_id + current_batch_size - 1;
+
       sem_wait(&sem_batch_window_free_slots);
 
       batch_start_time_array[C2F_batch_id] = std::chrono::system_clock::now();
-      int current_batch_size = query_num - C2F_batch_id * batch_size < batch_size? query_num - C2F_batch_id * batch_size : batch_size;
       memcpy(buf_header, &current_batch_size, 4);
-      send_header(buf_header);
-
-      for (int query_id = C2F_batch_id * batch_size; query_id < C2F_batch_id * batch_size + current_batch_size; query_id++) {
 
+      // the header and the (contiguous) query vectors of the batch, in one writev per FPGA if the query window
+      //   has room for the whole batch; otherwise, the queries are sent in chunks as their slots free up (the
+      //   header with the first chunk), such that a query window smaller than the batch cannot block the batch
+      for (int sent_query_num = 0; sent_query_num < current_batch_size; ) {
         // this semaphore controls that the window size is adhered to
         // If the  semaphore currently has the value zero, then the call blocks
         //   until either it becomes possible to perform the decrement
         sem_wait(&sem_query_window_free_slots);
-
-        char* current_query_addr = buf_C2F + bytes_vec * query_id;
-        send_query(current_query_addr);
-
-        finish_C2F_query_id++;
-        std::cout << "C2F finish query_id " << finish_C2F_query_id << std::endl;
+        int chunk_query_num = 1;
+        while (sent_query_num + chunk_query_num < current_batch_size && sem_trywait(&sem_query_window_free_slots) == 0) {
+          chunk_query_num++;
+        }
+        int chunk_first_query_id = first_query_id + sent_query_num;
+
+        struct iovec iov[2];
+        int iovcnt = 0;
+        if (sent_query_num == 0) {
+          iov[iovcnt].iov_base = buf_header;
+          iov[iovcnt].iov_len = bytes_C2F_header;
+          iovcnt++;
+        }
+        iov[iovcnt].iov_base = buf_C2F + bytes_vec * chunk_first_query_id;
+        iov[iovcnt].iov_len = bytes_vec * chunk_query_num;
+        iovcnt++;
+        std::chrono::system_clock::time_point chunk_send_time = std::chrono::system_clock::now();
+        for (int query_id = chunk_first_query_id; query_id < chunk_first_query_id + chunk_query_num; query_id++) {
+          query_start_time_array[query_id] = chunk_send_time;
+          if (!arrival_schedule.open_loop()) {
+            query_arrival_time_array[query_id] = chunk_send_time;
+          }
+        }
+        if (!sender.send_to_all(iov, iovcnt)) {
+          return;
+        }
+        sent_query_num += chunk_query_num;
+        finish_C2F_query_id += chunk_query_num;
+      }
+      if (deadline_batcher) {
+        deadline_batcher->batch_sent(current_batch_size);
       }
+
+      first_query_id += current_batch_size;
+      std::cout << "C2F finish query_id " << finish_C2F_query_id << std::endl;
     }
+    total_batch_num = C2F_batch_id;
   
     std::chrono::system_clock::time_point end = std::chrono::system_clock::now();
     double durationUs = (std::chrono::duration_cast<std::chrono::microseconds>(end-start).count());
@@ -536,7 +585,10 @@ public:
     // send finish: set batch_size as -1
     int finish_batch_size = -1;
     memcpy(buf_header, &finish_batch_size, 4);
-    send_header(buf_header); 
+    struct iovec iov_finish;
+    iov_finish.iov_base = buf_header;
+    iov_finish.iov_len = bytes_C2F_header;
+    sender.send_to_all(&iov_finish, 1);
 
     std::cout << "C2F side Duration (us) = " << durationUs << std::endl;
     std::cout << "C2F side QPS () = " << query_num / (durationUs / 1000.0 / 1000.0) << std::endl;
@@ -545,26 +597,26 @@ public:
     return; 
   } 
 
-  void receive_answer_to_query(size_t byte_offset) {
+  // merge the results of all FPGAs of a query (each sorted by distance) into merged_vec_ID / merged_dist
+  void merge_answer_to_query(int query_id) {
 
+    size_t byte_offset = query_id * bytes_F2C_per_query;
+    const int* vec_ID_per_FPGA[MAX_FPGA_NUM];
+    const float* dist_per_FPGA[MAX_FPGA_NUM];
     for (int n = 0; n < num_FPGA; n++) {
-      size_t total_F2C_bytes = 0;
-      while (total_F2C_bytes < bytes_F2C_per_query) {
-        int F2C_bytes_this_iter = (bytes_F2C_per_query - total_F2C_bytes) < F2C_PKG_SIZE ? (bytes_F2C_per_query - total_F2C_bytes) : F2C_PKG_SIZE;
-        // IF_DEBUG_DO(std::cout << "F2C_bytes_this_iter" << F2C_bytes_this_iter << std::endl;);
-        int F2C_bytes = read(sock_f2c[n], &buf_F2C_per_FPGA[n][byte_offset + total_F2C_bytes], F2C_bytes_this_iter);
-        total_F2C_bytes += F2C_bytes;
-
-        if (F2C_bytes == -1) {
-          printf("Receiving data UNSUCCESSFUL!\n");
-          return;
-        } else {
-          IF_DEBUG_DO(std::cout << " F2C_bytes" << total_F2C_bytes << std::endl;);
-        }
-      }
+      vec_ID_per_FPGA[n] = (const int*) &buf_F2C_per_FPGA[n][byte_offset + bytes_F2C_header];
+      dist_per_FPGA[n] = (const float*) &buf_F2C_per_FPGA[n][byte_offset + bytes_F2C_header + bytes_results_vec_ID];
+    }
+    int* out_vec_ID = &merged_vec_ID[query_id * ef];
+    float* out_dist = &merged_dist[query_id * ef];
+    merge_sorted_results<MAX_FPGA_NUM>(num_FPGA, ef, vec_ID_per_FPGA, dist_per_FPGA, ef, out_vec_ID, out_dist);
 
-      if (total_F2C_bytes != bytes_F2C_per_query) {
-        printf("Receiving error, receiving more bytes than a block\n");
+    if (graph_type == "HNSW") {
+      // HNSW reorders label IDs
+      for (int i = 0; i < ef; i++) {
+        if (out_vec_ID[i] >= 0 && out_vec_ID[i] < (int) labels_base.size()) {
+          out_vec_ID[i] = labels_base[out_vec_ID[i]];
+        }
       }
     }
   }
@@ -588,24 +640,41 @@ public:
 
     std::chrono::system_clock::time_point start = std::chrono::system_clock::now(); // reset after recving the first query
 
-    for (int F2C_batch_id = 0; F2C_batch_id < total_batch_num; F2C_batch_id++) {
+    // the FPGAs complete out of order: a query is done once the results of all FPGAs have arrived
+    MultiFPGAReceiver receiver(num_FPGA, sock_f2c, buf_F2C_per_FPGA, bytes_F2C_per_query * query_num);
 
-      std::cout << "F2C_batch_id: " << F2C_batch_id << std::endl;
-      int current_batch_size = query_num - F2C_batch_id * batch_size < batch_size? query_num - F2C_batch_id * batch_size : batch_size;
+    int F2C_batch_id = 0;
+    int query_id = 0;
+    while (query_id < query_num) {
 
-      for (int query_id = F2C_batch_id * batch_size; query_id < F2C_batch_id * batch_size + current_batch_size; query_id++) {
+      ssize_t received_bytes = receiver.poll();
+      if (received_bytes == -1) {
+        return;
+      }
+      int received_query_num = received_bytes / bytes_F2C_per_query;
+
+      for (; query_id < received_query_num; query_id++) {
 
         IF_DEBUG_DO(std::cout << "F2C query_id " << query_id << std::endl;);
-        size_t byte_offset = query_id * bytes_F2C_per_query;
-        receive_answer_to_query(byte_offset);
+        merge_answer_to_query(query_id);
+        query_finish_time_array[query_id] = std::chrono::system_clock::now();
+        if (result_callback) {
+          result_callback(query_id, &merged_vec_ID[query_id * ef], &merged_dist[query_id * ef], ef);
+        }
 
         finish_F2C_query_id++;
         std::cout << "F2C finish query_id " << finish_F2C_query_id << std::endl;
         // sem_post() increments (unlocks) the semaphore pointed to by sem
         sem_post(&sem_query_window_free_slots);
+
+        // last query of the batch
+        if (query_id == batch_last_query_id[F2C_batch_id]) {
+          std::cout << "F2C_batch_id: " << F2C_batch_id << std::endl;
+          batch_finish_time_array[F2C_batch_id] = std::chrono::system_clock::now();
+          sem_post(&sem_batch_window_free_slots);
+          F2C_batch_id++;
+        }
       }
-      batch_finish_time_array[F2C_batch_id] = std::chrono::system_clock::now();
-      sem_post(&sem_batch_window_free_slots);
     }
 
     std::chrono::system_clock::time_point end = std::chrono::system_clock::now();
@@ -630,49 +699,9 @@ public:
 
   void calculate_recall() {
 
-  std::vector<int> out_id(query_num * ef, 0);
-  std::vector<float> out_dist(query_num * ef, 0);
-
-  for (int F2C_batch_id = 0; F2C_batch_id < total_batch_num; F2C_batch_id++) {
-    int current_batch_size = query_num - F2C_batch_id * batch_size < batch_size? query_num - F2C_batch_id * batch_size : batch_size;
-    for (int query_id = F2C_batch_id * batch_size; query_id < F2C_batch_id * batch_size + current_batch_size; query_id++) {
-
-      std::vector<std::pair<int, float>> out_id_dist(ef * num_FPGA, std::make_pair(-1, 1e20));
-      // Format: for each query
-      // packet 0: header (topK == ef)
-      // packet 1~k: topK results, including vec_ID (4-byte) array and dist_array (4-byte)
-      //    -> size = ceil(topK * 4 / 64) + ceil(topK * 4 / 64)
-
-      size_t byte_offset = query_id * bytes_F2C_per_query;
-      // merge N FPGA's results, sort by distance in ascending order
-      for (int n = 0; n < num_FPGA; n++) {
-        for (int i = 0; i < ef; i++) {
-          int vec_ID = *(int*)(&buf_F2C_per_FPGA[n][byte_offset + bytes_F2C_header + i * 4]);
-          float dist = *(float*)(&buf_F2C_per_FPGA[n][byte_offset + bytes_F2C_header + bytes_results_vec_ID + i * 4]);
-          out_id_dist[n * ef + i] = std::make_pair(vec_ID, dist);
-        }
-      }
-      std::sort(out_id_dist.begin(), out_id_dist.end(), [](const std::pair<int, float> &left, const std::pair<int, float> &right) {
-        return left.second < right.second;
-      });
-
-      // copy the top ef results
-      for (int i = 0; i < ef; i++) {
-        out_id[query_id * ef + i] = out_id_dist[i].first;
-        out_dist[query_id * ef + i] = out_id_dist[i].second;
-      }
-    }
-  }
-
-  if (graph_type == "HNSW") {
-    // HNSW reorders label IDs
-    for (int qid = 0; qid < query_num; qid++) {
-      for (int i = 0; i < ef; i++) {
-        out_id[qid * ef + i] = labels_base[out_id[qid * ef + i]];
-      }
-    }
-  }
-
+  // merged online by thread_F2C
+  const std::vector<int>& out_id = merged_vec_ID;
+  const std::vector<float>& out_dist = merged_dist;
 
   int top1_correct_count = 0;
   int top10_correct_count = 0;
@@ -766,6 +795,20 @@ public:
     // }
 
 
+    // end-to-end latency per query: arrival -> merged results ready, per offered load
+    std::vector<double> query_duration_ms_array;
+    for (int qid = 0; qid < query_num; qid++) {
+      double queryUs = (std::chrono::duration_cast<std::chrono::microseconds>(
+        query_finish_time_array[qid] - query_arrival_time_array[qid]).count());
+      query_duration_ms_array.push_back(queryUs / 1000.0);
+    }
+    std::string out_fname_load = "latency_vs_load_" + dataset + "_" + graph_type +
+      "_MD" + std::to_string(max_degree) + "_ef" + std::to_string(ef) + "_batch_size" + std::to_string(batch_size) + ".csv";
+    if (deadline_batcher) {
+      deadline_batcher->print_stats();
+    }
+    arrival_schedule.report_latency(query_arrival_time_array, query_finish_time_array, out_fname_load);
+
     double durationUs = (std::chrono::duration_cast<std::chrono::microseconds>(
       batch_finish_time_array[total_batch_num - 1] - batch_start_time_array[0]).count());
     double durationMs = durationUs / 1000.0;
@@ -785,6 +828,12 @@ public:
     }
     fclose(file_latency);
 
+	  std::string out_fname_query = "latency_ms_per_query_" + dataset + "_" + graph_type +
+		  "_MD" + std::to_string(max_degree) + "_ef" + std::to_string(ef) + "_batch_size" + std::to_string(batch_size) + ".double";
+    FILE *file_latency_query = fopen(out_fname_query.c_str(), "w");
+    fwrite(query_duration_ms_array.data(), sizeof(double), query_num, file_latency_query);
+    fclose(file_latency_query);
+
     // FILE *file_throughput = fopen("profile_QPS.double", "w");
     // fwrite(&QPS, sizeof(double), 1, file_throughput);
     // fclose(file_throughput);
@@ -802,12 +851,14 @@ int main(int argc, char const *argv[])
     "<2 + 3 * num_FPGA dataset> <3 + 3 * num_FPGA graph_type> <4 + 3 * num_FPGA max_degree> <5 + 3 * num_FPGA ef> " 
     "<6 + 3 * num_FPGA query_num> " "<7 + 3 * num_FPGA batch_size> "
     "<8 + 3 * num_FPGA query_window_size> <9 + 3 * num_FPGA batch_window_size> " 
+    "[<10 + 3 * num_FPGA arrival_mode (closed/poisson/trace)> <11 + 3 * num_FPGA offered QPS list/trace file> "
+    "[<12 + 3 * num_FPGA latency_SLO_ms> <13 + 3 * num_FPGA service time model, batch_size:ms,...>]] "
     << std::endl;
 
   int argv_cnt = 1;
   int num_FPGA = strtol(argv[argv_cnt++], NULL, 10);
   std::cout << "num_FPGA: " << num_FPGA << std::endl;
-  assert(argc == 10 + 3 * num_FPGA);
+  assert(argc == 10 + 3 * num_FPGA || argc == 12 + 3 * num_FPGA || argc == 14 + 3 * num_FPGA);
   assert(num_FPGA <= MAX_FPGA_NUM);
 
   const char* FPGA_IP_addr[num_FPGA];
@@ -865,6 +916,24 @@ int main(int argc, char const *argv[])
   std::cout << "batch_window_size: " << batch_window_size << 
     ", batch window size controls how many batches can be computed for index scan in advance (compute control)" << std::endl;
   assert (batch_window_size >= 1);
+
+  // closed = send as fast as the windows allow; poisson <QPS list, e.g., 5000,10000> / trace <arrival times .double> = open-loop
+  std::string arrival_mode = "closed";
+  std::string arrival_arg = "";
+  if (argc >= 12 + 3 * num_FPGA) {
+    arrival_mode = argv[argv_cnt++];
+    arrival_arg = argv[argv_cnt++];
+  }
+  std::cout << "arrival_mode: " << arrival_mode << " " << arrival_arg << std::endl;
+
+  // > 0: adaptive batching for this latency SLO, batch_size = max batch size (adaptive_batching.hpp)
+  double latency_SLO_ms = 0;
+  std::string service_time_model = "";
+  if (argc == 14 + 3 * num_FPGA) {
+    latency_SLO_ms = strtod(argv[argv_cnt++], NULL);
+    service_time_model = argv[argv_cnt++];
+  }
+  std::cout << "latency_SLO_ms: " << latency_SLO_ms << " " << service_time_model << std::endl;
     
   CPU_client cpu_coordinator(
     dataset,
@@ -878,7 +947,11 @@ int main(int argc, char const *argv[])
     num_FPGA,
     FPGA_IP_addr,
     C2F_port,
-    F2C_port);
+    F2C_port,
+    arrival_mode,
+    arrival_arg,
+    latency_SLO_ms,
+    service_time_model);
 
   cpu_coordinator.start_C2F_F2C_threads();
   cpu_coordinator.calculate_recall();
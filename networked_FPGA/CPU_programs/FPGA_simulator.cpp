@@ -6,6 +6,10 @@
 //  " << argv[0] << " <Tx (CPU) IP_addr> <Tx F2C_port> <Rx C2F_port> " 
 // 	"<TOPK/ef> <D> <query_num> " << std::endl;
 
+// Optional: <7 service time: 0 / batch_size:ms,... / per-batch latencies .double> <8 kernel mode: intra_query / inter_query>
+//   <9 FPGA index path for real results> <10 max_cand_per_group> <11 max_group_num_in_pipe> <12 search threads>
+//   (see kernel_emulator.hpp)
+
 // Network order:
 //   Open host_single_thread (CPU) first
 //   then open FPGA simulator
@@ -28,6 +32,7 @@
 #include <algorithm>
 
 #include "constants.hpp"
+#include "kernel_emulator.hpp"
 #include "types.hpp"
 #include "utils.hpp"
 
@@ -41,7 +46,8 @@ void thread_F2C(
   int* finish_recv_query_id,
   int* finish_all,
   int D,
-  int TOPK
+  int TOPK,
+  KernelEmulator* kernel
 ) { 
       
     // const char* IP_addr = send_thread_input.IP_addr;
@@ -84,34 +90,39 @@ void thread_F2C(
   ////////////////   Data transfer + Select Cells   ////////////////
 
 
-  int query_id = 0;
-  while (true) {
+  for (int batch_id = 0; ; batch_id++) {
 
-    volatile int cnt = 0;
-    while (query_id > *finish_recv_query_id && *finish_all == 0) {
-        cnt++;
-        // sleep(0.001);
-    }
-    if (query_id > *finish_recv_query_id && *finish_all == 1) {
+    if (!kernel->wait_for_batch(batch_id, finish_all)) {
       std::cout << "thread F2C finished all" << std::endl;
       break;
     }
 
-    std::cout << "send query_id " << query_id << std::endl;
-
-	// send data until finish_recv_query_id
-	int send_query_num_this_iter = *finish_recv_query_id - query_id + 1;
-	int total_sent_bytes = 0;
-	while (total_sent_bytes < send_query_num_this_iter * bytes_output_per_query) {
-		int send_bytes_this_iter = (send_query_num_this_iter * bytes_output_per_query - total_sent_bytes);
-		int sent_bytes = send(sock, out_buf + query_id * bytes_output_per_query + total_sent_bytes, send_bytes_this_iter, 0);
-		total_sent_bytes += sent_bytes;
-		if (sent_bytes == -1) {
-			printf("Sending data UNSUCCESSFUL!\n");
-			return;
+    // emulated kernel: the results and the time each query of the batch is done
+    std::vector<std::chrono::system_clock::time_point> query_done_time = kernel->process_batch(batch_id, out_buf, bytes_output_per_query);
+    int first_query_id = kernel->first_query_id(batch_id);
+    int batch_size = kernel->batch_size(batch_id);
+
+	// send the queries done at the same time together
+	for (int i = 0; i < batch_size; ) {
+		int send_query_num_this_iter = 1;
+		while (i + send_query_num_this_iter < batch_size && query_done_time[i + send_query_num_this_iter] == query_done_time[i]) {
+			send_query_num_this_iter++;
 		}
+		std::this_thread::sleep_until(query_done_time[i]);
+		int query_id = first_query_id + i;
+		std::cout << "send query_id " << query_id << std::endl;
+		size_t total_sent_bytes = 0;
+		while (total_sent_bytes < send_query_num_this_iter * bytes_output_per_query) {
+			int send_bytes_this_iter = (send_query_num_this_iter * bytes_output_per_query - total_sent_bytes);
+			int sent_bytes = send(sock, out_buf + query_id * bytes_output_per_query + total_sent_bytes, send_bytes_this_iter, 0);
+			if (sent_bytes == -1) {
+				printf("Sending data UNSUCCESSFUL!\n");
+				return;
+			}
+			total_sent_bytes += sent_bytes;
+		}
+		i += send_query_num_this_iter;
 	}
-	query_id += send_query_num_this_iter;
 
 //     // send data
 //     int total_sent_bytes = 0;
@@ -147,7 +158,8 @@ void thread_C2F(
   int* finish_recv_query_id,
   int* finish_all,
   int D,
-  int TOPK
+  int TOPK,
+  KernelEmulator* kernel
 ) { 
 
 
@@ -179,8 +191,7 @@ void thread_C2F(
   size_t bytes_input_per_query = bytes_vec;
 
   std::cout << "bytes_input_per_query: " << bytes_input_per_query << std::endl;
-  size_t FPGA_input_bytes = query_num * bytes_input_per_query;
-  std::vector<char ,aligned_allocator<char >> FPGA_input(FPGA_input_bytes);
+  // the queries are received into the buffers of the emulated kernel (kernel->query)
 
   printf("Start receiving data.\n");
 
@@ -215,13 +226,14 @@ void thread_C2F(
 	total_recv_bytes = 0;
 	while (total_recv_bytes < bytes_input_per_query * batch_size) {
 		int recv_bytes_this_iter = (bytes_input_per_query * batch_size - total_recv_bytes);
-		int recv_bytes = read(sock, FPGA_input.data() + total_recv_bytes, recv_bytes_this_iter);
+		int recv_bytes = read(sock, kernel->query(*finish_recv_query_id + 1) + total_recv_bytes, recv_bytes_this_iter);
 		total_recv_bytes += recv_bytes;
 		if (recv_bytes == -1) {
 			printf("Receiving data UNSUCCESSFUL!\n");
 			return;
 		}
 	}
+	kernel->batch_received(batch_size);
 	*finish_recv_query_id += batch_size;
 
 
@@ -262,7 +274,9 @@ int main(int argc, char const *argv[])
   //////////     Parameter Init     //////////
   
   std::cout << "Usage: " << argv[0] << " <Tx (CPU) IP_addr> <Tx F2C_port> <Rx C2F_port> " 
-  "<TOPK/ef> <D> <query_num> " << std::endl;
+  "<TOPK/ef> <D> <query_num> "
+  "[<service time: 0 / batch_size:ms,... / per-batch latencies .double> <kernel mode: intra_query / inter_query> "
+  "[<FPGA index path> <max_cand_per_group> <max_group_num_in_pipe> <search threads>]] " << std::endl;
 
   int argv_cnt = 1;
 
@@ -298,6 +312,28 @@ int main(int argc, char const *argv[])
       query_num = strtol(argv[argv_cnt++], NULL, 10);
   }
 
+  // emulated kernel (kernel_emulator.hpp): service time per batch, and results of a CPU search over the FPGA index
+  std::string service_time = "0";
+  std::string kernel_mode = "intra_query";
+  if (argc >= 9) {
+    service_time = argv[argv_cnt++];
+    kernel_mode = argv[argv_cnt++];
+  }
+  std::string FPGA_index_path = "";
+  int max_cand_per_group = 1;
+  int max_group_num_in_pipe = 1;
+  int num_search_threads = std::thread::hardware_concurrency();
+  if (argc >= 12) {
+    FPGA_index_path = argv[argv_cnt++];
+    max_cand_per_group = strtol(argv[argv_cnt++], NULL, 10);
+    max_group_num_in_pipe = strtol(argv[argv_cnt++], NULL, 10);
+  }
+  if (argc >= 13) {
+    num_search_threads = strtol(argv[argv_cnt++], NULL, 10);
+  }
+  KernelEmulator kernel(query_num, D, TOPK, service_time, kernel_mode, FPGA_index_path,
+    max_cand_per_group, max_group_num_in_pipe, num_search_threads);
+
   
   //////////     Networking Part     //////////
 
@@ -312,13 +348,14 @@ int main(int argc, char const *argv[])
 
   // launch 
   std::thread t_send(thread_F2C,
-  IP_addr, F2C_port, query_num, &start_send, &finish_recv_query_id, &finish_all, D, TOPK);
+  IP_addr, F2C_port, query_num, &start_send, &finish_recv_query_id, &finish_all, D, TOPK, &kernel);
   std::thread t_recv(thread_C2F,
-  C2F_port, query_num, &start_send, &finish_recv_query_id, &finish_all, D, TOPK);
+  C2F_port, query_num, &start_send, &finish_recv_query_id, &finish_all, D, TOPK, &kernel);
 
   // sync finish
   t_send.join();
   t_recv.join();
+  kernel.print_stats();
 
   return 0; 
 } 
\ No newline at end of file
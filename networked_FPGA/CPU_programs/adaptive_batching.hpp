@@ -0,0 +1,162 @@
+#pragma once
+
+/*
+Deadline-aware adaptive batching (CPU_client, CPU_client_simulator), for the open-loop arrival modes.
+
+With a fixed batch size, the first query of a batch waits for the last one to arrive, which dominates the
+  latency at low load, while small batches waste the FPGA throughput at high load. Given a latency SLO, the
+  batches are formed from the queue of arrived queries instead, up to batch_size queries:
+
+  * the service time of a batch of b queries, T(b), comes from the profiled FPGA latency per batch size
+    (ServiceTimeModel, e.g., "1:0.21,2:0.25,4:0.33,8:0.49,16:0.80" in ms, see launch_CPU_and_FPGA.py);
+  * the oldest query of the batch has the deadline arrival + SLO, so a batch of b queries can wait for one
+    more query until deadline - T(b + 1); once no more query can arrive in time, the partial batch is sent;
+  * while the FPGAs are still busy with the batches sent before (estimated by T of these batches), there
+    is no point in sending earlier, so the batch keeps growing until the FPGAs are expected to be free.
+
+A batch never spans two phases of the arrival schedule (load_generator.hpp).
+*/
+
+#include <stdlib.h>
+
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "load_generator.hpp"
+
+// FPGA service time per batch size, linearly interpolated between the profiled batch sizes and
+//   extrapolated with the slope of the last two beyond them
+class ServiceTimeModel {
+
+public:
+
+  std::vector<int> batch_sizes; // ascending
+  std::vector<double> batch_ms;
+
+  // "b_1:ms_1,b_2:ms_2,..."
+  ServiceTimeModel(const std::string& model) {
+    std::stringstream ss(model);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+      size_t colon = item.find(':');
+      if (colon == std::string::npos) {
+        std::cout << "Invalid service time model entry (batch_size:ms): " << item << std::endl;
+        exit(1);
+      }
+      int b = std::stoi(item.substr(0, colon));
+      double ms = std::stod(item.substr(colon + 1));
+      if (b < 1 || ms < 0 || (!batch_sizes.empty() && b <= batch_sizes.back())) {
+        std::cout << "Service time model needs ascending batch sizes >= 1, got: " << model << std::endl;
+        exit(1);
+      }
+      batch_sizes.push_back(b);
+      batch_ms.push_back(ms);
+    }
+    if (batch_sizes.empty()) {
+      std::cout << "Empty service time model" << std::endl;
+      exit(1);
+    }
+  }
+
+  double predict_ms(int b) const {
+    int num_points = batch_sizes.size();
+    if (num_points == 1 || b <= batch_sizes[0]) { return batch_ms[0]; }
+    int i = 1;
+    while (i < num_points - 1 && batch_sizes[i] < b) { i++; }
+    double slope = (batch_ms[i] - batch_ms[i - 1]) / (batch_sizes[i] - batch_sizes[i - 1]);
+    double ms = batch_ms[i - 1] + slope * (b - batch_sizes[i - 1]);
+    return ms > 0? ms : 0;
+  }
+
+  std::chrono::system_clock::duration predict(int b) const {
+    return std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::duration<double, std::milli>(predict_ms(b)));
+  }
+};
+
+class DeadlineBatcher {
+
+public:
+
+  const int max_batch_size;
+  const std::chrono::system_clock::duration SLO;
+  const ServiceTimeModel model;
+
+  // statistics
+  int num_full_batches; // max_batch_size queries
+  int num_deadline_batches; // sent partially to meet the deadline of the oldest query
+  int num_phase_end_batches; // sent partially at the end of a phase
+
+  DeadlineBatcher(int in_max_batch_size, double SLO_ms, const std::string& model_str) :
+    max_batch_size(in_max_batch_size),
+    SLO(std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::duration<double, std::milli>(SLO_ms))),
+    model(model_str), num_full_batches(0), num_deadline_batches(0), num_phase_end_batches(0) {
+
+    std::cout << "Adaptive batching: SLO = " << SLO_ms << " ms, max batch size = " << max_batch_size << std::endl;
+    for (int b = 1; b <= max_batch_size; b *= 2) {
+      std::cout << "  predicted service time of batch size " << b << " (ms): " << model.predict_ms(b) << std::endl;
+    }
+    if (model.predict_ms(1) > SLO_ms) {
+      std::cout << "Warning: a single query is predicted to take longer than the SLO" << std::endl;
+    }
+  }
+
+  // C2F thread: wait until the next batch, from first_query_id on, is due and return its number of queries;
+  //   the arrival times of its queries are written to query_arrival_time
+  int form_batch(int first_query_id, ArrivalSchedule& schedule, const int* finish_F2C_query_id,
+    std::chrono::system_clock::time_point* query_arrival_time) {
+
+    int phase_end_query = schedule.phase_end_query(first_query_id);
+    query_arrival_time[first_query_id] = schedule.arrival_time(first_query_id, finish_F2C_query_id);
+    std::this_thread::sleep_until(query_arrival_time[first_query_id]);
+
+    // all queries sent so far have completed (e.g., a new phase, or a batch faster than predicted)
+    std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
+    if (*(const volatile int*) finish_F2C_query_id >= first_query_id - 1 && FPGA_free_time > now) {
+      FPGA_free_time = now;
+    }
+
+    std::chrono::system_clock::time_point deadline = query_arrival_time[first_query_id] + SLO;
+    int batch_query_num = 1;
+    while (batch_query_num < max_batch_size && first_query_id + batch_query_num < phase_end_query) {
+      int qid = first_query_id + batch_query_num;
+      std::chrono::system_clock::time_point next_arrival = schedule.arrival_time(qid, finish_F2C_query_id);
+      std::chrono::system_clock::time_point latest_join = deadline - model.predict(batch_query_num + 1);
+      latest_join = FPGA_free_time > latest_join? FPGA_free_time : latest_join;
+      if (next_arrival > latest_join) {
+        // no more query in time: send at the latest moment it could have joined
+        std::this_thread::sleep_until(latest_join);
+        num_deadline_batches++;
+        return batch_query_num;
+      }
+      std::this_thread::sleep_until(next_arrival);
+      query_arrival_time[qid] = next_arrival;
+      batch_query_num++;
+    }
+    if (batch_query_num == max_batch_size) {
+      num_full_batches++;
+    } else {
+      num_phase_end_batches++;
+    }
+    return batch_query_num;
+  }
+
+  // C2F thread, once the batch is sent: the FPGAs process it after the batches sent before
+  void batch_sent(int batch_query_num) {
+    std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
+    FPGA_free_time = (FPGA_free_time > now? FPGA_free_time : now) + model.predict(batch_query_num);
+  }
+
+  void print_stats() const {
+    int num_batches = num_full_batches + num_deadline_batches + num_phase_end_batches;
+    std::cout << "Adaptive batching: " << num_batches << " batches, " << num_full_batches << " full, " <<
+      num_deadline_batches << " sent early for the SLO, " << num_phase_end_batches << " at the end of a phase" << std::endl;
+  }
+
+private:
+
+  std::chrono::system_clock::time_point FPGA_free_time; // estimated completion of the batches sent so far
+};
@@ -0,0 +1,198 @@
+#pragma once
+
+/*
+Kernel emulation of the FPGA_simulator, such that the CPU-side scheduling, batching, and multi-FPGA merging can
+  be load-tested without FPGAs.
+
+Service times: a batch starts once it is received and the previous batch is done, and takes:
+
+  * "0": no time (default), i.e., the results are echoed as soon as the queries arrive;
+  * "batch_size:ms,...": the profiled FPGA latency per batch size (ServiceTimeModel of adaptive_batching.hpp),
+    e.g., generated by launch_CPU_and_FPGA.py from the performance_profile_dir of the dataset, graph type,
+    max degree, ef, mc / mg, and bitstream (intra- or inter-query pickle);
+  * "<file>.double": the per-batch latencies in ms recorded by CPU_client (latency_ms_per_batch_*.double),
+    replayed in order and cyclically; they were measured on the CPU side and include the network.
+
+Kernel mode: the intra-query kernel searches the queries of a batch one after the other and returns each query
+  once done (evenly spread over the service time of the batch), the inter-query kernel searches them in parallel
+  and returns them together at the end of the batch.
+
+Results: zeros by default; with an FPGA index directory (the 1-channel ground layer files), the top-ef results
+  of each query are computed by the CPU engine of vector_search_baselines/FPGA_index_tools (cpu_search_engine.hpp)
+  with the traversal of the kernels (mc, mg), i.e., the node IDs and distances a real FPGA returns, such that
+  CPU_client computes a real recall. The search runs while the batch is emulated; if it takes longer than the
+  service time, the results are late and counted. The batches are searched on the thread pool of the engine, which
+  relies on the workers of a finished batch not taking tasks of it late (CPUSearchEngine::worker_loop).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "adaptive_batching.hpp"
+#include "../../vector_search_baselines/FPGA_index_tools/cpu_search_engine.hpp"
+
+class KernelEmulator {
+
+public:
+
+  const int query_num;
+  const int D;
+  const int ef;
+  const bool intra_query; // false: inter-query
+  const size_t bytes_vec; // per received query, padded to 64 bytes
+
+  KernelEmulator(int in_query_num, int in_D, int in_ef, const std::string& service_time, const std::string& kernel_mode,
+    const std::string& index_dir = "", int mc = 1, int mg = 1, int num_threads = std::thread::hardware_concurrency()) :
+    query_num(in_query_num), D(in_D), ef(in_ef), intra_query(kernel_mode != "inter_query"),
+    bytes_vec((D % FLOAT_PER_AXI == 0? D / FLOAT_PER_AXI : D / FLOAT_PER_AXI + 1) * BYTES_PER_AXI),
+    queries(query_num * bytes_vec), batch_first_query_id(query_num + 1, 0), batch_recv_time(query_num),
+    num_received_batches(0), num_late_batches(0), total_service_ms(0) {
+
+    if (kernel_mode != "intra_query" && kernel_mode != "inter_query") {
+      std::cout << "Unknown kernel mode: " << kernel_mode << " (intra_query or inter_query)" << std::endl;
+      exit(1);
+    }
+
+    if (service_time.size() > 7 && service_time.substr(service_time.size() - 7) == ".double") {
+      FILE* f = fopen(service_time.c_str(), "rb");
+      if (f == NULL) {
+        std::cout << "Cannot open " << service_time << std::endl;
+        exit(1);
+      }
+      double ms;
+      while (fread(&ms, sizeof(double), 1, f) == 1) { recorded_batch_ms.push_back(ms); }
+      fclose(f);
+      if (recorded_batch_ms.empty()) {
+        std::cout << "No batch latency in " << service_time << std::endl;
+        exit(1);
+      }
+      std::cout << "Replaying " << recorded_batch_ms.size() << " recorded batch latencies from " << service_time << std::endl;
+    } else if (service_time != "0") {
+      model = std::make_unique<ServiceTimeModel>(service_time);
+      for (size_t i = 0; i < model->batch_sizes.size(); i++) {
+        std::cout << "Service time of batch size " << model->batch_sizes[i] << " (ms): " << model->batch_ms[i] << std::endl;
+      }
+    }
+    std::cout << "Kernel mode: " << kernel_mode << std::endl;
+
+    if (!index_dir.empty()) {
+      index = std::make_unique<FPGAIndex>(index_dir, D);
+      engine = std::make_unique<CPUSearchEngine>(*index, num_threads);
+      params.ef = ef;
+      params.mc = mc;
+      params.mg = mg;
+      params.topK = ef;
+      std::cout << "Results from a CPU search over " << index_dir << ": num_nodes=" << index->num_nodes <<
+        " mc=" << mc << " mg=" << mg << " num_threads=" << num_threads << " distance=" << l2_sqr_simd_isa() << std::endl;
+    }
+  }
+
+  // C2F thread: the receive buffer of query qid
+  char* query(int qid) { return queries.data() + qid * bytes_vec; }
+
+  // C2F thread, once the queries of a batch are in their receive buffers
+  void batch_received(int batch_size) {
+    int b = num_received_batches.load();
+    batch_recv_time[b] = std::chrono::system_clock::now();
+    batch_first_query_id[b + 1] = batch_first_query_id[b] + batch_size;
+    num_received_batches.store(b + 1);
+  }
+
+  // F2C thread: wait until batch b is received, or return false once finish_all is set without it
+  bool wait_for_batch(int b, const int* finish_all) {
+    while (num_received_batches.load() <= b) {
+      if (*(const volatile int*) finish_all) { return num_received_batches.load() > b; }
+      std::this_thread::sleep_for(std::chrono::microseconds(10));
+    }
+    return true;
+  }
+
+  int first_query_id(int b) const { return batch_first_query_id[b]; }
+  int batch_size(int b) const { return batch_first_query_id[b + 1] - batch_first_query_id[b]; }
+
+  // F2C thread, in batch order: write the results of batch b (if an index is given) into out_buf, in the F2C
+  //   format (header, ef IDs, ef distances per query), and return the time each of its queries is done
+  std::vector<std::chrono::system_clock::time_point> process_batch(int b, char* out_buf, size_t bytes_output_per_query) {
+
+    int first = first_query_id(b);
+    int nq = batch_size(b);
+
+    // service time: after the previous batch
+    std::chrono::system_clock::time_point start = batch_recv_time[b] > kernel_free_time? batch_recv_time[b] : kernel_free_time;
+    double ms = batch_ms(b, nq);
+    total_service_ms += ms;
+    std::chrono::system_clock::time_point finish = start +
+      std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::duration<double, std::milli>(ms));
+    kernel_free_time = finish;
+
+    if (engine) {
+      // the received queries are padded to 64 bytes
+      search_input.resize((size_t) nq * D);
+      for (int i = 0; i < nq; i++) {
+        memcpy(&search_input[(size_t) i * D], query(first + i), D * sizeof(float));
+      }
+      engine->search(search_input.data(), nq, params, search_results);
+      size_t bytes_results_vec_ID = (ef % INT_PER_AXI == 0? ef / INT_PER_AXI : ef / INT_PER_AXI + 1) * BYTES_PER_AXI;
+      for (int i = 0; i < nq; i++) {
+        int* vec_ID = (int*) (out_buf + (first + i) * bytes_output_per_query + BYTES_PER_AXI);
+        float* dist = (float*) (out_buf + (first + i) * bytes_output_per_query + BYTES_PER_AXI + bytes_results_vec_ID);
+        const std::vector<std::pair<float, int>>& res = search_results[i];
+        for (int k = 0; k < ef; k++) {
+          vec_ID[k] = k < (int) res.size()? res[k].second : -1;
+          dist[k] = k < (int) res.size()? res[k].first : 1e20;
+        }
+      }
+      if (ms > 0 && std::chrono::system_clock::now() > finish) { num_late_batches++; }
+    }
+
+    std::vector<std::chrono::system_clock::time_point> query_done_time(nq, finish);
+    if (intra_query) {
+      for (int i = 0; i < nq; i++) {
+        query_done_time[i] = start + (finish - start) * (i + 1) / nq;
+      }
+    }
+    return query_done_time;
+  }
+
+  void print_stats() const {
+    int num_batches = num_received_batches.load();
+    std::cout << "Emulated " << num_batches << " batches, kernel time (ms): " << total_service_ms << std::endl;
+    if (engine) {
+      std::cout << "Batches whose CPU search took longer than the emulated service time: " << num_late_batches << std::endl;
+    }
+  }
+
+private:
+
+  std::vector<char> queries;
+  std::vector<int> batch_first_query_id; // per batch, plus the end of the last received one
+  std::vector<std::chrono::system_clock::time_point> batch_recv_time;
+  std::atomic<int> num_received_batches;
+
+  std::unique_ptr<ServiceTimeModel> model; // null: recorded_batch_ms, or no service time if empty
+  std::vector<double> recorded_batch_ms;
+  std::chrono::system_clock::time_point kernel_free_time;
+  int num_late_batches;
+  double total_service_ms;
+
+  std::unique_ptr<FPGAIndex> index; // null: no results
+  std::unique_ptr<CPUSearchEngine> engine; // uses index, declared after it to be destroyed first
+  DSTParams params;
+  std::vector<float> search_input;
+  std::vector<std::vector<std::pair<float, int>>> search_results;
+
+  double batch_ms(int b, int nq) const {
+    if (model) { return model->predict_ms(nq); }
+    if (!recorded_batch_ms.empty()) { return recorded_batch_ms[b % recorded_batch_ms.size()]; }
+    return 0;
+  }
+};
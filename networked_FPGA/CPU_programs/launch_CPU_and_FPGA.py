@@ -42,6 +42,8 @@ parser.add_argument('--cpu_client_simulator_exe_dir', type=str, default='./CPU_c
 # if run in the FPGA simulator mode
 parser.add_argument('--fpga_simulator_exe_dir', type=str, default='./FPGA_simulator', help="the FPGA simulator exe file")
 parser.add_argument('--fpga_id', type=int, default=0, help="the FPGA ID (should start from 0, 1, 2, ...)")
+parser.add_argument('--fpga_simulator_service_time', type=str, default=None, help="0, profile (from performance_profile_dir), batch_size:ms,..., or per-batch latencies (.double)")
+parser.add_argument('--fpga_simulator_index_path', type=str, default=None, help="FPGA index directory, for real results from the FPGA simulator")
 
 # optional runtim input arguments
 parser.add_argument('--ef', type=int, default=None)
@@ -52,6 +54,13 @@ parser.add_argument('--max_group_num_in_pipe', type=int, default=None)
 parser.add_argument('--graph_type', type=str, default=None)
 parser.add_argument('--dataset', type=str, default=None)
 parser.add_argument('--max_degree', type=int, default=None)
+# open-loop load (CPU_client / CPU_client_simulator): closed (default), poisson, or trace
+parser.add_argument('--arrival_mode', type=str, default=None)
+parser.add_argument('--offered_QPS_list', type=str, default=None, help="poisson: offered QPS per phase, e.g., 5000,10000,20000")
+parser.add_argument('--arrival_trace', type=str, default=None, help="trace: arrival time per query in us (.double)")
+# adaptive batching (open-loop only): batches up to batch_size queries, formed to meet the latency SLO
+parser.add_argument('--latency_SLO_ms', type=float, default=None)
+parser.add_argument('--service_time_model', type=str, default=None, help="FPGA latency per batch size, e.g., 1:0.2,2:0.3 (ms); default: from performance_profile_dir")
 					
 
 args = parser.parse_args()
@@ -113,6 +122,18 @@ graph_type = None
 dataset = None
 max_degree = None
 
+arrival_mode = 'closed'
+offered_QPS_list = None
+arrival_trace = None
+
+latency_SLO_ms = None
+service_time_model = None
+
+FPGA_simulator_service_time = None
+FPGA_simulator_kernel_mode = None
+FPGA_simulator_index_path_list = None
+FPGA_simulator_search_threads = None
+
 config_dict = {}
 with open(args.config_fname, "r") as f:
     config_dict.update(yaml.safe_load(f))
@@ -134,6 +155,18 @@ if args.dataset is not None:
 	dataset = args.dataset
 if args.max_degree is not None:
 	max_degree = args.max_degree
+if args.arrival_mode is not None:
+	arrival_mode = args.arrival_mode
+if args.offered_QPS_list is not None:
+	offered_QPS_list = [float(qps) for qps in args.offered_QPS_list.split(',')]
+if args.arrival_trace is not None:
+	arrival_trace = args.arrival_trace
+if args.latency_SLO_ms is not None:
+	latency_SLO_ms = args.latency_SLO_ms
+if args.service_time_model is not None:
+	service_time_model = args.service_time_model
+if args.fpga_simulator_service_time is not None:
+	FPGA_simulator_service_time = args.fpga_simulator_service_time
 
 if dataset is not None:
 	if dataset.startswith('SIFT'):
@@ -151,6 +184,78 @@ assert int(num_FPGA) == len(FPGA_IP_addr_list)
 assert int(num_FPGA) == len(C2F_port_list)
 assert int(num_FPGA) == len(F2C_port_list)
 
+def get_arrival_args():
+	"""
+	The optional open-loop arguments of CPU_client / CPU_client_simulator: <arrival_mode> <offered QPS list / trace file>
+	"""
+	if arrival_mode == 'closed':
+		return ''
+	elif arrival_mode == 'poisson':
+		assert offered_QPS_list is not None
+		return ' {} {} '.format(arrival_mode, ','.join([str(int(qps)) for qps in offered_QPS_list]))
+	elif arrival_mode == 'trace':
+		assert arrival_trace is not None
+		return ' {} {} '.format(arrival_mode, arrival_trace)
+	else:
+		raise NotImplementedError
+
+def get_service_time_model():
+	"""
+	The FPGA latency per batch size as "batch_size:ms,...", from the per-batch-size rows of the performance profile
+		(the batch_size=10000 rows are the throughput runs used for the "auto" max_cand_per_group / max_group_num_in_pipe)
+	"""
+	if service_time_model is not None:
+		return service_time_model
+	assert performance_profile_dir is not None and os.path.exists(performance_profile_dir) # load existing performance
+	df = pd.read_pickle(performance_profile_dir)
+	df = df.loc[(df['graph_type'] == graph_type) & (df['dataset'] == dataset) & (df['max_degree'] == max_degree) & (df['ef'] == ef) & (df['batch_size'] != 10000)]
+	df_config = df.loc[(df['max_cand_per_group'] == max_cand_per_group) & (df['max_group_num_in_pipe'] == max_group_num_in_pipe)]
+	if len(df_config) > 0:
+		df = df_config
+	else:
+		print("No latency profile for max_cand_per_group = {}, max_group_num_in_pipe = {}, using the best per batch size".format(
+			max_cand_per_group, max_group_num_in_pipe))
+	assert len(df) > 0, "No latency per batch size in {}".format(performance_profile_dir)
+	batch_ms = df.groupby('batch_size')['avg_latency_per_batch_ms'].min().sort_index()
+	return ','.join(['{}:{:.6f}'.format(b, ms) for b, ms in batch_ms.items()])
+
+def get_adaptive_batching_args():
+	"""
+	The optional adaptive batching arguments of CPU_client / CPU_client_simulator (after the arrival arguments): 
+		<latency_SLO_ms> <service time model>
+	"""
+	if latency_SLO_ms is None:
+		return ''
+	assert arrival_mode != 'closed', "adaptive batching needs an open-loop arrival_mode"
+	model = get_service_time_model()
+	print("Adaptive batching: SLO = {} ms, max batch size = {}, service time model (batch_size:ms) = {}".format(
+		latency_SLO_ms, batch_size, model))
+	return ' {} {} '.format(latency_SLO_ms, model)
+
+def load_latency_vs_load(fname):
+	"""
+	Latency vs offered load written by the CPU program, one row per phase (offered load), 
+		with the config appended such that the sweeps of different runs can be concatenated
+	"""
+	if not os.path.isfile(fname):
+		print("No latency vs offered load in ", fname)
+		return None
+	df = pd.read_csv(fname)
+	df['num_FPGA'] = num_FPGA
+	df['dataset'] = dataset
+	df['graph_type'] = graph_type
+	df['max_degree'] = max_degree
+	df['ef'] = ef
+	df['batch_size'] = batch_size
+	df['latency_SLO_ms'] = latency_SLO_ms
+	df['query_window_size'] = query_window_size
+	df['batch_window_size'] = batch_window_size
+	print("Latency vs offered load: ")
+	print(df[['arrival_mode', 'offered_QPS', 'achieved_QPS', 'p50_ms', 'p95_ms', 'p99_ms', 'p999_ms']])
+	df.to_pickle(fname.replace('.csv', '.pickle'))
+	print("Saved to ", fname.replace('.csv', '.pickle'))
+	return df
+
 # if query_window_size == 'auto':
 # 	query_msg_size = 4 * D * (nprobe + 1) # as an approximation
 
@@ -218,10 +323,14 @@ if mode == 'CPU_client':
 	cmd += ' {} '.format(batch_size)
 	cmd += ' {} '.format(query_window_size)
 	cmd += ' {} '.format(batch_window_size)
+	cmd += get_arrival_args()
+	cmd += get_adaptive_batching_args()
 	# cmd += ' {} '.format(cpu_cores)
 	print('Executing: ', cmd)
 	os.system(cmd)
 
+	load_latency_vs_load(f'latency_vs_load_{dataset}_{graph_type}_MD{max_degree}_ef{ef}_batch_size{batch_size}.csv')
+
 	# print('Loading and copying profile...')
 	latency_ms_distribution = np.fromfile(
 		f'latency_ms_per_batch_{dataset}_{graph_type}_MD{max_degree}_ef{ef}_batch_size{batch_size}.double', dtype=np.float64).reshape(-1,)
@@ -305,10 +414,14 @@ elif mode == 'CPU_client_simulator':
 	cmd += ' {} '.format(batch_size)
 	cmd += ' {} '.format(query_window_size)
 	cmd += ' {} '.format(batch_window_size)
+	cmd += get_arrival_args()
+	cmd += get_adaptive_batching_args()
 	# cmd += ' {} '.format(cpu_cores)
 	print('Executing: ', cmd)
 	os.system(cmd)
 
+	load_latency_vs_load('profile_latency_vs_load.csv')
+
 	print('Loading and copying profile...')
 	latency_ms_distribution = np.fromfile('profile_latency_ms_distribution.double', dtype=np.float64).reshape(-1,)
 	# deep copy latency_ms_distribution
@@ -340,7 +453,55 @@ elif mode == 'FPGA_simulator':
 // std::cout << "Usage: 
 //  " << argv[0] << " <Tx (CPU) IP_addr> <Tx F2C_port> <Rx C2F_port> " 
 // 	"<TOPK/ef> <D> <query_num> " << std::endl;
+// Optional: <7 service time> <8 kernel mode> <9 FPGA index path> <10 max_cand_per_group> <11 max_group_num_in_pipe> <12 search threads>
 	"""
+	def get_FPGA_simulator_kernel_args():
+		"""
+		The optional kernel emulation arguments of FPGA_simulator (kernel_emulator.hpp): the service time ("profile": 
+			the latency per batch size of performance_profile_dir), the kernel mode (from the intra- / inter-query 
+			profile by default), and the index whose search results are returned
+		"""
+		global max_cand_per_group, max_group_num_in_pipe
+		index_path = None
+		if args.fpga_simulator_index_path is not None:
+			index_path = args.fpga_simulator_index_path
+		elif FPGA_simulator_index_path_list is not None:
+			index_path = FPGA_simulator_index_path_list[fpga_id]
+		if FPGA_simulator_service_time is None and index_path is None:
+			return ''
+
+		if max_cand_per_group == "auto" or max_group_num_in_pipe == "auto":
+
+			assert os.path.exists(performance_profile_dir) # load existing performance
+			df = pd.read_pickle(performance_profile_dir)
+			df = df.loc[(df['graph_type'] == graph_type) & (df['dataset'] == dataset) & (df['max_degree'] == max_degree) & (df['ef'] == ef)]
+			# get the row with max performance (min time_ms_kernel)
+			row = df.loc[df['time_ms_kernel'].idxmin()]
+			print("Best performance: ", row)
+			max_cand_per_group = row['max_cand_per_group']
+			max_group_num_in_pipe = row['max_group_num_in_pipe']
+			print("Overwriting max_cand_per_group and max_group_num_in_pipe with the best performance: ", 
+				max_cand_per_group, max_group_num_in_pipe)
+
+		service_time = '0'
+		if FPGA_simulator_service_time == 'profile':
+			service_time = get_service_time_model()
+		elif FPGA_simulator_service_time is not None:
+			service_time = FPGA_simulator_service_time
+		kernel_mode = FPGA_simulator_kernel_mode
+		if kernel_mode is None:
+			kernel_mode = 'inter_query' if performance_profile_dir is not None and 'inter_query' in performance_profile_dir else 'intra_query'
+		print("FPGA simulator kernel: service time = {}, kernel mode = {}, index = {}".format(service_time, kernel_mode, index_path))
+
+		kernel_args = ' {} {} '.format(service_time, kernel_mode)
+		if index_path is not None:
+			kernel_args += ' {} {} {} '.format(index_path, 
+				max_cand_per_group if max_cand_per_group is not None else 1, 
+				max_group_num_in_pipe if max_group_num_in_pipe is not None else 1)
+			if FPGA_simulator_search_threads is not None:
+				kernel_args += ' {} '.format(FPGA_simulator_search_threads)
+		return kernel_args
+
 	cmd = ''
 	cmd += ' {} '.format(fpga_simulator_exe_dir)
 	cmd += ' {} '.format(CPU_IP_addr)
@@ -349,5 +510,6 @@ elif mode == 'FPGA_simulator':
 	cmd += ' {} '.format(ef)
 	cmd += ' {} '.format(D)
 	cmd += ' {} '.format(query_num)
+	cmd += get_FPGA_simulator_kernel_args()
 	print('Executing: ', cmd)
 	os.system(cmd)
\ No newline at end of file
@@ -0,0 +1,253 @@
+#pragma once
+
+/*
+Open-loop load generation and latency histograms (CPU_client, CPU_client_simulator).
+
+In the default closed-loop mode, a query is sent as soon as the batch and query windows allow it, so the
+  offered load adapts to the FPGAs and the latency under a given load is unknown. In the open-loop modes,
+  the queries arrive at precomputed times regardless of the completions:
+
+  * poisson <QPS_1,QPS_2,...>: one phase per offered load; the batches are split evenly among the phases,
+    and the queries of a phase arrive with exponential inter-arrival times (fixed seed). A phase starts
+    once all queries of the previous one have completed, such that the backlog of an overloaded phase does
+    not leak into the next.
+  * trace <file>: the arrival times of the queries in microseconds since the start, as doubles (.double).
+
+With a fixed batch size, a batch is sent once its last query has arrived (and the windows allow it; see
+  adaptive_batching.hpp for batches formed by a latency SLO instead), and the latency of a query is
+  measured from its arrival rather than from its send, such that the queueing on the CPU is included
+  (no coordinated omission).
+*/
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// HDR-style histogram of latencies in nanoseconds: buckets are linear within each power of 2, with
+//   2^sub_bucket_bits buckets per power of 2, i.e., the recorded values are exact up to 2^sub_bucket_bits ns
+//   and within 1 / 2^sub_bucket_bits (0.8%) above, with a fixed footprint of 64 * 128 counters
+class LatencyHistogram {
+
+public:
+
+  static const int sub_bucket_bits = 7;
+  static const int sub_bucket_num = 1 << sub_bucket_bits;
+
+  LatencyHistogram() : counts(64 * sub_bucket_num, 0), total_count(0), min_ns(UINT64_MAX), max_ns(0), sum_ns(0) {}
+
+  void record(uint64_t ns) {
+    counts[bucket_index(ns)]++;
+    total_count++;
+    min_ns = ns < min_ns? ns : min_ns;
+    max_ns = ns > max_ns? ns : max_ns;
+    sum_ns += ns;
+  }
+
+  void record(std::chrono::system_clock::duration duration) {
+    long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+    record((uint64_t) (ns > 0? ns : 0));
+  }
+
+  size_t count() const { return total_count; }
+  double min_ms() const { return total_count? min_ns / 1e6 : 0; }
+  double max_ms() const { return max_ns / 1e6; }
+  double mean_ms() const { return total_count? (double) sum_ns / total_count / 1e6 : 0; }
+
+  // the highest value equivalent to the bucket of the p-th percentile (p in 0 ~ 100), capped by the max
+  double percentile_ms(double p) const {
+    if (total_count == 0) { return 0; }
+    size_t target = (size_t) ceil(p / 100.0 * total_count);
+    target = target < 1? 1 : target;
+    size_t cumulated = 0;
+    for (size_t i = 0; i < counts.size(); i++) {
+      cumulated += counts[i];
+      if (cumulated >= target) {
+        uint64_t ns = bucket_highest_value(i);
+        return (ns < max_ns? ns : max_ns) / 1e6;
+      }
+    }
+    return max_ms();
+  }
+
+  void print(const std::string& name) const {
+    std::cout << name << " (" << total_count << " queries): " << std::endl;
+    std::cout << "  Min (ms): " << min_ms() << std::endl;
+    std::cout << "  P50 (ms): " << percentile_ms(50) << std::endl;
+    std::cout << "  P95 (ms): " << percentile_ms(95) << std::endl;
+    std::cout << "  P99 (ms): " << percentile_ms(99) << std::endl;
+    std::cout << "  P99.9 (ms): " << percentile_ms(99.9) << std::endl;
+    std::cout << "  Max (ms): " << max_ms() << std::endl;
+    std::cout << "  Average (ms): " << mean_ms() << std::endl;
+  }
+
+private:
+
+  std::vector<size_t> counts;
+  size_t total_count;
+  uint64_t min_ns;
+  uint64_t max_ns;
+  uint64_t sum_ns;
+
+  static size_t bucket_index(uint64_t ns) {
+    if (ns < (uint64_t) sub_bucket_num) { return ns; }
+    int msb = 63 - __builtin_clzll(ns);
+    int shift = msb - sub_bucket_bits;
+    return (size_t) (shift + 1) * sub_bucket_num + ((ns >> shift) - sub_bucket_num);
+  }
+
+  static uint64_t bucket_highest_value(size_t index) {
+    if (index < (size_t) sub_bucket_num) { return index; }
+    int shift = index / sub_bucket_num - 1;
+    uint64_t sub_bucket = index % sub_bucket_num + sub_bucket_num;
+    return (sub_bucket << shift) + ((1ull << shift) - 1);
+  }
+};
+
+class ArrivalSchedule {
+
+public:
+
+  std::string mode; // closed, poisson, or trace
+  std::vector<double> offered_QPS; // per phase, 0 for closed-loop
+  std::vector<int> phase_first_query; // per phase, plus query_num at the end
+  std::vector<double> arrival_us; // per query, relative to the start of its phase
+  std::vector<std::chrono::system_clock::time_point> phase_start_time; // set by arrival_time
+
+  ArrivalSchedule(const std::string& in_mode, const std::string& arg, int query_num, int batch_size) : mode(in_mode) {
+
+    int total_batch_num = query_num % batch_size == 0? query_num / batch_size : query_num / batch_size + 1;
+    arrival_us.resize(query_num, 0);
+
+    if (mode == "closed") {
+      offered_QPS.push_back(0);
+      phase_first_query = {0, query_num};
+    } else if (mode == "poisson") {
+      std::stringstream ss(arg);
+      std::string item;
+      while (std::getline(ss, item, ',')) {
+        double QPS = atof(item.c_str());
+        if (!(QPS > 0)) {
+          std::cout << "Offered loads have to be positive QPS, got: " << item << std::endl;
+          exit(1);
+        }
+        offered_QPS.push_back(QPS);
+      }
+      int num_phases = offered_QPS.size();
+      if (num_phases == 0 || num_phases > total_batch_num) {
+        std::cout << "Need 1 ~ " << total_batch_num << " offered loads, got: " << arg << std::endl;
+        exit(1);
+      }
+      // the phases start at batch boundaries
+      std::mt19937 rng(0);
+      for (int p = 0; p < num_phases; p++) {
+        phase_first_query.push_back((long) p * total_batch_num / num_phases * batch_size);
+      }
+      phase_first_query.push_back(query_num);
+      for (int p = 0; p < num_phases; p++) {
+        std::exponential_distribution<double> inter_arrival_us(offered_QPS[p] / 1e6);
+        double t = 0;
+        for (int qid = phase_first_query[p]; qid < phase_first_query[p + 1]; qid++) {
+          t += inter_arrival_us(rng);
+          arrival_us[qid] = t;
+        }
+      }
+    } else if (mode == "trace") {
+      FILE* f = fopen(arg.c_str(), "rb");
+      if (f == NULL || fread(arrival_us.data(), sizeof(double), query_num, f) != (size_t) query_num) {
+        std::cout << "Cannot read " << query_num << " arrival times from " << arg << std::endl;
+        exit(1);
+      }
+      fclose(f);
+      double span_us = arrival_us[query_num - 1] - arrival_us[0];
+      offered_QPS.push_back(span_us > 0? (query_num - 1) / (span_us / 1e6) : 0);
+      phase_first_query = {0, query_num};
+    } else {
+      std::cout << "Unknown arrival mode: " << mode << " (closed, poisson, or trace)" << std::endl;
+      exit(1);
+    }
+  }
+
+  bool open_loop() const { return mode != "closed"; }
+  int num_phases() const { return offered_QPS.size(); }
+
+  // the first query of the next phase, i.e., batches starting at qid must not go beyond it
+  int phase_end_query(int qid) const {
+    int phase = 0;
+    while (phase_first_query[phase + 1] <= qid) { phase++; }
+    return phase_first_query[phase + 1];
+  }
+
+  // open-loop, C2F thread, in query order: the arrival time of query qid; at the first query of a phase,
+  //   wait until all queries before it have completed (finish_F2C_query_id) and start the phase
+  std::chrono::system_clock::time_point arrival_time(int qid, const int* finish_F2C_query_id) {
+    int phase = phase_start_time.size();
+    if (phase < num_phases() && qid == phase_first_query[phase]) {
+      while (*(const volatile int*) finish_F2C_query_id < qid - 1) {
+        std::this_thread::sleep_for(std::chrono::microseconds(10));
+      }
+      phase_start_time.push_back(std::chrono::system_clock::now());
+    }
+    return phase_start_time.back() +
+      std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::duration<double, std::micro>(arrival_us[qid]));
+  }
+
+  // open-loop, C2F thread before sending a batch: set the arrival times of the queries of the batch and
+  //   wait until the last one has arrived
+  void wait_for_batch(int first_query_id, int batch_query_num, const int* finish_F2C_query_id,
+    std::chrono::system_clock::time_point* query_arrival_time) {
+
+    if (!open_loop()) { return; }
+    for (int qid = first_query_id; qid < first_query_id + batch_query_num; qid++) {
+      query_arrival_time[qid] = arrival_time(qid, finish_F2C_query_id);
+    }
+    std::this_thread::sleep_until(query_arrival_time[first_query_id + batch_query_num - 1]);
+  }
+
+  // latency per phase from the arrival to the completion of each query: printed, and written to csv_fname
+  //   as one row per phase (offered and achieved QPS, latency percentiles in ms)
+  void report_latency(const std::chrono::system_clock::time_point* query_arrival_time,
+    const std::chrono::system_clock::time_point* query_finish_time, const std::string& csv_fname) const {
+
+    FILE* f = fopen(csv_fname.c_str(), "w");
+    if (f == NULL) {
+      std::cout << "Cannot write " << csv_fname << ", printing the latency only" << std::endl;
+    } else {
+      fprintf(f, "arrival_mode,phase,offered_QPS,achieved_QPS,query_num,min_ms,p50_ms,p95_ms,p99_ms,p999_ms,max_ms,mean_ms\n");
+    }
+    for (int p = 0; p < num_phases(); p++) {
+      int first_query = phase_first_query[p];
+      int last_query = phase_first_query[p + 1];
+      LatencyHistogram histogram;
+      std::chrono::system_clock::time_point start = query_arrival_time[first_query];
+      std::chrono::system_clock::time_point end = query_finish_time[first_query];
+      for (int qid = first_query; qid < last_query; qid++) {
+        histogram.record(query_finish_time[qid] - query_arrival_time[qid]);
+        start = query_arrival_time[qid] < start? query_arrival_time[qid] : start;
+        end = query_finish_time[qid] > end? query_finish_time[qid] : end;
+      }
+      if (open_loop()) { start = phase_start_time[p]; }
+      double duration_us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+      double achieved_QPS = (last_query - first_query) / (duration_us / 1e6);
+
+      std::cout << "Phase " << p << ": offered QPS = " << offered_QPS[p] << ", achieved QPS = " << achieved_QPS << std::endl;
+      histogram.print("Latency from queries (arrival -> results)");
+      if (f == NULL) { continue; }
+      fprintf(f, "%s,%d,%f,%f,%d,%f,%f,%f,%f,%f,%f,%f\n", mode.c_str(), p, offered_QPS[p], achieved_QPS,
+        last_query - first_query, histogram.min_ms(), histogram.percentile_ms(50), histogram.percentile_ms(95),
+        histogram.percentile_ms(99), histogram.percentile_ms(99.9), histogram.max_ms(), histogram.mean_ms());
+    }
+    if (f != NULL) {
+      fclose(f);
+      std::cout << "Latency vs offered load written to " << csv_fname << std::endl;
+    }
+  }
+};
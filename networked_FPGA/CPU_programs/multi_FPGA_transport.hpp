@@ -0,0 +1,244 @@
+#pragma once
+
+/*
+Event-driven transport between the CPU client and multiple FPGAs (CPU_client, CPU_client_simulator).
+
+The sockets are switched to non-blocking mode and multiplexed with epoll, such that a slow FPGA does not
+  block the transfers of the others:
+
+  * C2F, MultiFPGASender: a batch (header + query vectors) is sent with one writev per FPGA; the FPGAs
+    whose socket buffer is full are resumed when epoll reports them writable, while the others are done.
+    EPOLLOUT is armed (EPOLLONESHOT) only while a socket has bytes pending, as a drained socket is
+    always writable and would wake up epoll_wait in a busy loop.
+  * F2C, MultiFPGAReceiver: every FPGA streams its results into its own receive buffer, which covers all
+    queries of the run (no copies); whichever FPGA has data is read, as many bytes as available, and
+    a query is complete once the results of all FPGAs have arrived, in whatever order the FPGAs finish.
+
+The send and receive buffers are page-aligned and pinned (mlock) once at startup (pin_buffer), such that
+  the kernel does not fault on them during the run.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <vector>
+
+// page-aligned buffer, pinned in memory if RLIMIT_MEMLOCK allows
+char* alloc_pinned_buffer(size_t bytes) {
+  void* ptr = nullptr;
+  if (posix_memalign(&ptr, 4096, bytes)) {
+    printf("Allocating %lu bytes UNSUCCESSFUL!\n", bytes);
+    exit(EXIT_FAILURE);
+  }
+  memset(ptr, 0, bytes);
+  if (mlock(ptr, bytes)) {
+    std::cout << "Warning: cannot pin " << bytes << " bytes (" << strerror(errno) <<
+      "), consider raising ulimit -l" << std::endl;
+  }
+  return (char*) ptr;
+}
+
+void set_nonblocking(int sock) {
+  int flags = fcntl(sock, F_GETFL, 0);
+  if (flags == -1 || fcntl(sock, F_SETFL, flags | O_NONBLOCK) == -1) {
+    perror("fcntl");
+    exit(EXIT_FAILURE);
+  }
+}
+
+class MultiFPGASender {
+
+public:
+
+  MultiFPGASender(int in_num_FPGA, const int* in_sock) : num_FPGA(in_num_FPGA), sock(in_sock, in_sock + in_num_FPGA) {
+    epoll_fd = epoll_create1(0);
+    if (epoll_fd == -1) {
+      perror("epoll_create1");
+      exit(EXIT_FAILURE);
+    }
+    for (int n = 0; n < num_FPGA; n++) {
+      set_nonblocking(sock[n]);
+      // registered disarmed, see arm_writable
+      struct epoll_event ev;
+      ev.events = EPOLLONESHOT;
+      ev.data.u32 = n;
+      if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sock[n], &ev) == -1) {
+        perror("epoll_ctl");
+        exit(EXIT_FAILURE);
+      }
+    }
+  }
+
+  ~MultiFPGASender() { close(epoll_fd); }
+
+  // send the same iovcnt buffers to every FPGA, return false on a connection error
+  bool send_to_all(const struct iovec* iov, int iovcnt) {
+
+    size_t total_bytes = 0;
+    for (int i = 0; i < iovcnt; i++) { total_bytes += iov[i].iov_len; }
+
+    std::vector<size_t> sent_bytes(num_FPGA, 0);
+    int num_pending = num_FPGA;
+    for (int n = 0; n < num_FPGA; n++) {
+      if (!send_remaining(n, iov, iovcnt, total_bytes, sent_bytes[n])) { return false; }
+      if (sent_bytes[n] == total_bytes) { num_pending--; }
+      else if (!arm_writable(n)) { return false; }
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+    while (num_pending > 0) {
+      int num_events = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+      if (num_events == -1) {
+        if (errno == EINTR) { continue; }
+        perror("epoll_wait");
+        return false;
+      }
+      for (int e = 0; e < num_events; e++) {
+        // the event disarmed the socket (EPOLLONESHOT); re-arm it only if bytes are still pending
+        int n = events[e].data.u32;
+        if (sent_bytes[n] == total_bytes) { continue; } // error / hang-up of an idle socket
+        if (!send_remaining(n, iov, iovcnt, total_bytes, sent_bytes[n])) { return false; }
+        if (sent_bytes[n] == total_bytes) { num_pending--; }
+        else if (!arm_writable(n)) { return false; }
+      }
+    }
+    return true;
+  }
+
+private:
+
+  static const int MAX_EVENTS = 16;
+
+  const int num_FPGA;
+  std::vector<int> sock;
+  int epoll_fd;
+
+  // report the next time the socket of FPGA n is writable, once
+  bool arm_writable(int n) {
+    struct epoll_event ev;
+    ev.events = EPOLLOUT | EPOLLONESHOT;
+    ev.data.u32 = n;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, sock[n], &ev) == -1) {
+      perror("epoll_ctl");
+      return false;
+    }
+    return true;
+  }
+
+  // writev from sent_bytes on, until done or the socket buffer is full
+  bool send_remaining(int n, const struct iovec* iov, int iovcnt, size_t total_bytes, size_t& sent_bytes) {
+    while (sent_bytes < total_bytes) {
+      // skip the buffers sent already
+      struct iovec iov_remaining[iovcnt];
+      int cnt = 0;
+      size_t offset = sent_bytes;
+      for (int i = 0; i < iovcnt; i++) {
+        if (offset >= iov[i].iov_len) {
+          offset -= iov[i].iov_len;
+          continue;
+        }
+        iov_remaining[cnt].iov_base = (char*) iov[i].iov_base + offset;
+        iov_remaining[cnt].iov_len = iov[i].iov_len - offset;
+        offset = 0;
+        cnt++;
+      }
+      ssize_t C2F_bytes = writev(sock[n], iov_remaining, cnt);
+      if (C2F_bytes == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) { return true; }
+        if (errno == EINTR) { continue; }
+        printf("Sending data UNSUCCESSFUL!\n");
+        return false;
+      }
+      sent_bytes += C2F_bytes;
+    }
+    return true;
+  }
+};
+
+class MultiFPGAReceiver {
+
+public:
+
+  MultiFPGAReceiver(int in_num_FPGA, const int* in_sock, char* const* in_buf, size_t in_bytes_buf) :
+    num_FPGA(in_num_FPGA), sock(in_sock, in_sock + in_num_FPGA), buf(in_buf, in_buf + in_num_FPGA),
+    bytes_buf(in_bytes_buf), received_bytes(in_num_FPGA, 0) {
+    epoll_fd = epoll_create1(0);
+    if (epoll_fd == -1) {
+      perror("epoll_create1");
+      exit(EXIT_FAILURE);
+    }
+    for (int n = 0; n < num_FPGA; n++) {
+      set_nonblocking(sock[n]);
+      struct epoll_event ev;
+      ev.events = EPOLLIN;
+      ev.data.u32 = n;
+      if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sock[n], &ev) == -1) {
+        perror("epoll_ctl");
+        exit(EXIT_FAILURE);
+      }
+    }
+  }
+
+  ~MultiFPGAReceiver() { close(epoll_fd); }
+
+  // wait until any FPGA has data and read all that is available;
+  //   return the bytes received from every FPGA (the minimum over the FPGAs), or -1 on a connection error
+  ssize_t poll() {
+
+    struct epoll_event events[MAX_EVENTS];
+    int num_events = 0;
+    while (num_events == 0) {
+      num_events = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+      if (num_events == -1) {
+        if (errno == EINTR) { num_events = 0; continue; }
+        perror("epoll_wait");
+        return -1;
+      }
+    }
+
+    for (int e = 0; e < num_events; e++) {
+      int n = events[e].data.u32;
+      while (received_bytes[n] < bytes_buf) {
+        ssize_t F2C_bytes = read(sock[n], buf[n] + received_bytes[n], bytes_buf - received_bytes[n]);
+        if (F2C_bytes == -1) {
+          if (errno == EAGAIN || errno == EWOULDBLOCK) { break; }
+          if (errno == EINTR) { continue; }
+          printf("Receiving data UNSUCCESSFUL!\n");
+          return -1;
+        } else if (F2C_bytes == 0) {
+          printf("Receiving data UNSUCCESSFUL! FPGA %d closed the connection\n", n);
+          return -1;
+        }
+        received_bytes[n] += F2C_bytes;
+      }
+      if (received_bytes[n] == bytes_buf) { // all results of this FPGA received
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, sock[n], NULL);
+      }
+    }
+
+    size_t min_received_bytes = bytes_buf;
+    for (int n = 0; n < num_FPGA; n++) {
+      min_received_bytes = received_bytes[n] < min_received_bytes? received_bytes[n] : min_received_bytes;
+    }
+    return min_received_bytes;
+  }
+
+private:
+
+  static const int MAX_EVENTS = 16;
+
+  const int num_FPGA;
+  std::vector<int> sock;
+  std::vector<char*> buf;
+  const size_t bytes_buf; // per FPGA
+  std::vector<size_t> received_bytes; // per FPGA
+  int epoll_fd;
+};
@@ -2,6 +2,7 @@
 
 #include <stdio.h> 
 #include <stdlib.h> 
+#include <string.h>
 #include <sys/socket.h> 
 #include <arpa/inet.h> 
 #include <netinet/tcp.h>
@@ -140,4 +141,51 @@ std::string concat_dir(std::string dir, std::string filename) {
     } else {
         return dir + "/" + filename;
     }
-}
\ No newline at end of file
+}
+
+// k-way merge of the per-FPGA results of a query (CPU_client::thread_F2C):
+//   each of the num_lists lists holds list_len (vec_ID, dist) pairs sorted by distance in ascending order,
+//   as sent by the FPGAs; the topK smallest are written to out_vec_ID / out_dist, in ascending order.
+// The list heads are kept in a dense array of max_lists distances (exhausted and unused lists at 1e20),
+//   such that selecting the next result is a fixed-length, branch-free arg-min over the heads, which the
+//   compiler vectorizes, instead of sorting num_lists * list_len pairs.
+template <int max_lists>
+void merge_sorted_results(
+  int num_lists, int list_len, const int* const* vec_ID, const float* const* dist,
+  int topK, int* out_vec_ID, float* out_dist) {
+
+  if (num_lists == 1) {
+    int n = topK < list_len? topK : list_len;
+    memcpy(out_vec_ID, vec_ID[0], n * sizeof(int));
+    memcpy(out_dist, dist[0], n * sizeof(float));
+    for (int i = n; i < topK; i++) { out_vec_ID[i] = -1; out_dist[i] = 1e20f; }
+    return;
+  }
+
+  const float large_float = 1e20f;
+  float head_dist[max_lists];
+  int head_pos[max_lists];
+  for (int n = 0; n < max_lists; n++) {
+    head_pos[n] = 0;
+    head_dist[n] = n < num_lists && list_len > 0? dist[n][0] : large_float;
+  }
+
+  for (int i = 0; i < topK; i++) {
+    int min_n = 0;
+    float min_dist = head_dist[0];
+    for (int n = 1; n < max_lists; n++) {
+      bool smaller = head_dist[n] < min_dist;
+      min_dist = smaller? head_dist[n] : min_dist;
+      min_n = smaller? n : min_n;
+    }
+    if (min_dist >= large_float) { // all lists exhausted
+      out_vec_ID[i] = -1;
+      out_dist[i] = large_float;
+      continue;
+    }
+    int pos = head_pos[min_n]++;
+    out_vec_ID[i] = vec_ID[min_n][pos];
+    out_dist[i] = min_dist;
+    head_dist[min_n] = pos + 1 < list_len? dist[min_n][pos + 1] : large_float;
+  }
+}
@@ -50,4 +50,14 @@ const int depth_network_in = 512; // data FIFOs without wide data types
 const int depth_data = 512; // data FIFOs without wide data types
 const int depth_control = 16;
 const int depth_fetched_vectors = 512; // 512-bit width to memory
-const int depth_query_vectors = 128; // 512-bit width to memory
\ No newline at end of file
+const int depth_query_vectors = 128; // 512-bit width to memory
+
+// layouts in DRAM (layout flags in meta.bin), this kernel only supports the original ones (flags = 0):
+//   bit 0, VECTOR_LAYOUT_PADDED: each vector is followed by a 64-byte visited padding (the original format)
+//          VECTOR_LAYOUT_COMPACT: vectors are contiguous (FPGA_multi_DDR kernels only)
+//   bit 1, LINK_LAYOUT_ORIGINAL: 64-byte header + links (the original format)
+//          LINK_LAYOUT_PACKED: links follow the count in the first word (FPGA_multi_DDR kernels only)
+#define VECTOR_LAYOUT_PADDED 0
+#define VECTOR_LAYOUT_COMPACT 1
+#define LINK_LAYOUT_ORIGINAL 0
+#define LINK_LAYOUT_PACKED 1
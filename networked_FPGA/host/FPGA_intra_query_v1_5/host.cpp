@@ -282,7 +282,6 @@ int main(int argc, char **argv) {
         fread(&entry_point_id, sizeof(int), 1, f_metadata);
         fread(&max_link_num_upper, sizeof(int), 1, f_metadata);
         fread(&max_link_num_base, sizeof(int), 1, f_metadata);
-        fclose(f_metadata);
         std::cout << "num_db_vec=" << num_db_vec << std::endl;
         std::cout << "max_level=" << max_level << std::endl;
         std::cout << "entry_point_id=" << entry_point_id << std::endl;
@@ -292,11 +291,21 @@ int main(int argc, char **argv) {
         fread(&num_db_vec, sizeof(int), 1, f_metadata);
         fread(&entry_point_id, sizeof(int), 1, f_metadata);
         fread(&max_link_num_base, sizeof(int), 1, f_metadata);
-        fclose(f_metadata);
         std::cout << "num_db_vec=" << num_db_vec << std::endl;
         std::cout << "entry_point_id=" << entry_point_id << std::endl;
         std::cout << "max_link_num_base=" << max_link_num_base << std::endl;
     }
+    // optional last field, absent in the original format (layout flags, see constants.hpp)
+    int layout_flags = 0;
+    if (fread(&layout_flags, sizeof(int), 1, f_metadata) != 1) {
+        layout_flags = 0;
+    }
+    fclose(f_metadata);
+    if (layout_flags != 0) {
+        std::cout << "This kernel only supports the original layouts, convert the index with "
+            "--vector_layout padded --link_layout original" << std::endl;
+        exit(1);
+    }
     
     size_t bytes_per_vec = d * sizeof(float);
     size_t bytes_per_db_vec_plus_padding = d % 16 == 0? d * sizeof(float) + 64 : (d + 16 - d % 16) * sizeof(float) + 64;
@@ -1,2 +1,2 @@
 # $1 -> dir of the new folder, e.g. ../new_folder
-cp -r cp_script.sh xrt.ini Makefile connectivity.cfg src synthesis.tcl .gitignore $1
+cp -r cp_script.sh xrt.ini Makefile connectivity.cfg src synthesis.tcl run_benchmark.sh .gitignore $1
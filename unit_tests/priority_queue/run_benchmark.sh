@@ -0,0 +1,39 @@
+#!/bin/bash
+# C-sim (correctness vs. std::sort, src/tb.cpp) and csynth (latency / II) of the result queue variants
+#   over several hardware queue sizes, one Vitis HLS project per configuration (hls_output_<variant>_<size>).
+# The latency / II and resource tables of queue_operations are collected in benchmark_summary.txt.
+# e.g., ./run_benchmark.sh > benchmark.out 2>&1
+
+SIZES="16 32 64 128"
+# hybrid: register tier of 64, runtime queue sizes > 64 use the BRAM tier (up to 512)
+HYBRID_SIZES="64"
+BITONIC_BATCH_SIZE=16
+SUMMARY=benchmark_summary.txt
+
+run_config() {
+    # $1: variant name, $2: QUEUE_VARIANT, $3: HARDWARE_QUEUE_SIZE
+    export PQ_PROJECT=hls_output_$1_$3
+    export PQ_CFLAGS="-DQUEUE_VARIANT=$2 -DHARDWARE_QUEUE_SIZE=$3 -DBITONIC_BATCH_SIZE=$BITONIC_BATCH_SIZE"
+    vitis_hls -f synthesis.tcl > $PQ_PROJECT.log 2>&1
+    echo "===== $1 HARDWARE_QUEUE_SIZE=$3 BITONIC_BATCH_SIZE=$BITONIC_BATCH_SIZE =====" >> $SUMMARY
+    grep "Overall:" $PQ_PROJECT.log >> $SUMMARY
+    report=$PQ_PROJECT/xcu250-figd2104-2L-e/syn/report/queue_operations_csynth.rpt
+    if [ -f $report ]; then
+        # latency summary, per-loop latency / II (the insertion loops should show II=1), and resources
+        awk '/\+ Latency:/,/== Interface/' $report >> $SUMMARY
+    else
+        echo "no csynth report, see $PQ_PROJECT.log" >> $SUMMARY
+    fi
+}
+
+rm -f $SUMMARY
+for size in $SIZES; do
+    run_config systolic 0 $size
+done
+for size in $HYBRID_SIZES; do
+    run_config hybrid 1 $size
+done
+for size in $SIZES; do
+    run_config bitonic 2 $size
+done
+cat $SUMMARY
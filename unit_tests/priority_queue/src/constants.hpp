@@ -10,6 +10,26 @@ const int float_per_axi = FLOAT_PER_AXI;
 // largest 32-bit float: 3.4028237 × 10^38
 const float large_float = 1E+20f; // 1E+20f is large enough for cosine similarity
 
+// queue variant under test (-DQUEUE_VARIANT=..., see run_benchmark.sh):
+//   QUEUE_VARIANT_SYSTOLIC: Priority_queue, one insertion per cycle, then runtime_queue_size / 2 sort rounds
+//   QUEUE_VARIANT_HYBRID: Two_tier_result_queue, registers staging into a sorted BRAM tier for sizes > HARDWARE_QUEUE_SIZE
+//   QUEUE_VARIANT_BITONIC: Bitonic_result_queue, batches of BITONIC_BATCH_SIZE merged by a bitonic network
+#define QUEUE_VARIANT_SYSTOLIC 0
+#define QUEUE_VARIANT_HYBRID 1
+#define QUEUE_VARIANT_BITONIC 2
+#ifndef QUEUE_VARIANT
+#define QUEUE_VARIANT QUEUE_VARIANT_SYSTOLIC
+#endif
+
+#ifndef HARDWARE_QUEUE_SIZE
+#define HARDWARE_QUEUE_SIZE 128
+#endif
+#ifndef BITONIC_BATCH_SIZE
+#define BITONIC_BATCH_SIZE 16
+#endif
+
 // max queue sizes
-const int hardware_result_queue_size = 128;
-const int hardware_candidate_queue_size = 128;
\ No newline at end of file
+const int hardware_result_queue_size = HARDWARE_QUEUE_SIZE;
+const int hardware_candidate_queue_size = 128;
+const int hardware_large_result_queue_size = 512;
+const int bitonic_batch_size = BITONIC_BATCH_SIZE;
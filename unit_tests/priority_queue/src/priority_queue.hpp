@@ -11,15 +11,13 @@ class Priority_queue<result_t, hardware_queue_size, Collect_smallest> {
 
     public: 
 
-        result_t* queue;
+        // a member rather than a constructor-local array, such that it outlives the constructor in C-sim
+        result_t queue[hardware_queue_size];
 		int runtime_queue_size;
 
         Priority_queue(const int runtime_queue_size) {
 #pragma HLS inline
-
-        	result_t queue_array[hardware_queue_size];
-#pragma HLS array_partition variable=queue_array complete
-			this->queue = queue_array;
+#pragma HLS array_partition variable=queue complete
 			this->runtime_queue_size = runtime_queue_size; // must <= hardware_queue_size
 			reset_queue();
         }
@@ -133,3 +131,306 @@ class Priority_queue<result_t, hardware_queue_size, Collect_smallest> {
 			}
 		}
 };
+
+// Result queue of runtime size ef up to bram_queue_size.
+//   ef <= hardware_queue_size: the systolic Priority_queue above (insert at the largest position, one
+//     compare-swap round per insertion, full sort per iteration), with the same results.
+//   ef > hardware_queue_size: two tiers. The register tier stages the elements smaller than the largest
+//     result (one per cycle, unsorted). The BRAM tier keeps the ef results sorted by distance.
+//     sort() sorts the staged elements and merges them into the BRAM tier from its tail, where the
+//     num_staged largest elements of both tiers fall off. This costs hardware_queue_size / 2 +
+//     num_staged + (BRAM elements moved) cycles. The caller has to sort() when num_free() reaches 0.
+//     Between two sorts, elements are compared to the largest result as of the last sort.
+template<const int hardware_queue_size, const int bram_queue_size>
+class Two_tier_result_queue {
+
+    public:
+
+        result_t queue[hardware_queue_size]; // register tier
+        result_t sorted[bram_queue_size]; // BRAM tier, ascending distances
+        int runtime_queue_size;
+        bool two_tier;
+        int num_staged;
+        float largest_dist; // two tiers: sorted[runtime_queue_size - 1].dist
+
+        Two_tier_result_queue(const int runtime_queue_size) {
+#pragma HLS inline
+#pragma HLS array_partition variable=queue complete
+#pragma HLS bind_storage variable=sorted type=RAM_2P impl=BRAM
+            this->runtime_queue_size = runtime_queue_size; // must <= bram_queue_size
+            this->two_tier = runtime_queue_size > hardware_queue_size;
+            reset_queue();
+        }
+
+        void compare_swap(int idxA, int idxB) {
+            // if smaller -> swap to right
+#pragma HLS inline
+            if (this->queue[idxA].dist < this->queue[idxB].dist) {
+                result_t regA = this->queue[idxA];
+                result_t regB = this->queue[idxB];
+                this->queue[idxA] = regB;
+                this->queue[idxB] = regA;
+            }
+        }
+
+        void compare_swap_array_step_A() {
+#pragma HLS inline
+            for (int j = 0; j < hardware_queue_size / 2; j++) {
+#pragma HLS UNROLL
+                compare_swap(2 * j, 2 * j + 1);
+            }
+        }
+
+        void compare_swap_array_step_B() {
+#pragma HLS inline
+            for (int j = 0; j < (hardware_queue_size - 1) / 2; j++) {
+#pragma HLS UNROLL
+                compare_swap(2 * j + 1, 2 * j + 2);
+            }
+        }
+
+        void reset_queue() {
+#pragma HLS inline
+            // register tier: 0 ~ runtime_queue_size - 1 valid (large_float) in single tier mode,
+            //   all invalid (-large_float, sorted behind any staged element) in two tier mode
+            for (int i = 0; i < hardware_queue_size; i++) {
+#pragma HLS UNROLL
+                this->queue[i].node_id = -1;
+                this->queue[i].level_id = -1;
+                this->queue[i].dist = !this->two_tier && i < this->runtime_queue_size? large_float : -large_float;
+            }
+            if (this->two_tier) {
+                for (int i = 0; i < this->runtime_queue_size; i++) {
+#pragma HLS pipeline II=1
+                    this->sorted[i].node_id = -1;
+                    this->sorted[i].level_id = -1;
+                    this->sorted[i].dist = large_float;
+                }
+            }
+            this->num_staged = 0;
+            this->largest_dist = large_float;
+        }
+
+        // number of insertions before the next sort() is required
+        int num_free() {
+#pragma HLS inline
+            return this->two_tier? hardware_queue_size - this->num_staged : bram_queue_size;
+        }
+
+        // insert one element, II=1 in the caller's pipelined loop; returns whether it was inserted
+        bool insert(result_t reg) {
+#pragma HLS inline
+            bool inserted = false;
+            if (this->two_tier) {
+                if (reg.dist < this->largest_dist) {
+                    for (int i = hardware_queue_size - 1; i > 0; i--) {
+#pragma HLS UNROLL
+                        this->queue[i] = this->queue[i - 1];
+                    }
+                    this->queue[0] = reg;
+                    this->num_staged++;
+                    inserted = true;
+                }
+            } else if (reg.dist < this->queue[0].dist) {
+                this->queue[0] = reg;
+                compare_swap_array_step_A();
+                compare_swap_array_step_B();
+                inserted = true;
+            }
+            return inserted;
+        }
+
+        // single tier: full sort; two tiers: merge the staged elements into the BRAM tier
+        void sort() {
+#pragma HLS inline
+            const int sort_swap_round = this->two_tier? hardware_queue_size / 2 :
+                (this->runtime_queue_size % 2 == 0? this->runtime_queue_size / 2 : (this->runtime_queue_size + 1) / 2);
+            for (int i = 0; i < sort_swap_round; i++) {
+#pragma HLS pipeline II=1
+                compare_swap_array_step_A();
+                compare_swap_array_step_B();
+            }
+            if (this->two_tier) {
+                merge_staged();
+            }
+        }
+
+        float largest() {
+#pragma HLS inline
+            return this->two_tier? this->largest_dist : this->queue[0].dist;
+        }
+
+        // i-th smallest result, after sort()
+        result_t result(int i) {
+#pragma HLS inline
+            return this->two_tier? this->sorted[i] : this->queue[this->runtime_queue_size - 1 - i];
+        }
+
+    private:
+
+        // merge the sorted register tier (descending from position 0) into the BRAM tier from its tail:
+        //   output position k = i + num_left > i, such that no BRAM element is overwritten before it is read
+        void merge_staged() {
+#pragma HLS inline
+            int i = this->runtime_queue_size - 1;
+            int num_left = this->num_staged;
+            for (int k = this->runtime_queue_size - 1 + this->num_staged; num_left > 0; k--) {
+#pragma HLS pipeline II=1
+#pragma HLS dependence variable=sorted inter false
+                result_t reg_sorted = this->sorted[i >= 0? i : 0];
+                bool take_staged = i < 0 || this->queue[0].dist > reg_sorted.dist;
+                result_t reg = take_staged? this->queue[0] : reg_sorted;
+                if (take_staged) {
+                    for (int j = 0; j < hardware_queue_size - 1; j++) {
+#pragma HLS UNROLL
+                        this->queue[j] = this->queue[j + 1];
+                    }
+                    this->queue[hardware_queue_size - 1].node_id = -1;
+                    this->queue[hardware_queue_size - 1].level_id = -1;
+                    this->queue[hardware_queue_size - 1].dist = -large_float;
+                    num_left--;
+                } else {
+                    i--;
+                }
+                if (k < this->runtime_queue_size) {
+                    this->sorted[k] = reg;
+                }
+            }
+            this->num_staged = 0;
+            this->largest_dist = this->sorted[this->runtime_queue_size - 1].dist;
+        }
+};
+
+
+// Result queue with batch insertion (ef <= hardware_queue_size, both powers of 2 >= batch_size):
+//   insert() stages up to batch_size elements smaller than the ef-th result, one per cycle; sort()
+//   sorts the batch with a bitonic sorting network, keeps the hardware_queue_size smallest of the
+//   queue and the reversed batch (an element-wise min, which leaves a bitonic sequence), and sorts
+//   that sequence with a bitonic merge network. Thus the queue is always sorted, and a batch costs
+//   the latency of log2(batch_size) * (log2(batch_size) + 1) / 2 + 1 + log2(hardware_queue_size)
+//   compare-swap stages rather than the hardware_queue_size / 2 rounds of the systolic queue.
+//   The caller has to sort() when num_free() reaches 0, as for Two_tier_result_queue.
+template<const int hardware_queue_size, const int batch_size>
+class Bitonic_result_queue {
+
+    public:
+
+        result_t queue[hardware_queue_size]; // ascending distances
+        result_t batch[batch_size];
+        int runtime_queue_size;
+        int num_staged;
+
+        Bitonic_result_queue(const int runtime_queue_size) {
+#pragma HLS inline
+#pragma HLS array_partition variable=queue complete
+#pragma HLS array_partition variable=batch complete
+            this->runtime_queue_size = runtime_queue_size; // must <= hardware_queue_size
+            reset_queue();
+        }
+
+        void reset_queue() {
+#pragma HLS inline
+            for (int i = 0; i < hardware_queue_size; i++) {
+#pragma HLS UNROLL
+                this->queue[i].node_id = -1;
+                this->queue[i].level_id = -1;
+                this->queue[i].dist = large_float;
+            }
+            reset_batch();
+        }
+
+        // number of insertions before the next sort() is required
+        int num_free() {
+#pragma HLS inline
+            return batch_size - this->num_staged;
+        }
+
+        // stage one element, II=1 in the caller's pipelined loop; returns whether it was staged
+        bool insert(result_t reg) {
+#pragma HLS inline
+            bool inserted = false;
+            if (reg.dist < largest()) {
+                for (int i = batch_size - 1; i > 0; i--) {
+#pragma HLS UNROLL
+                    this->batch[i] = this->batch[i - 1];
+                }
+                this->batch[0] = reg;
+                this->num_staged++;
+                inserted = true;
+            }
+            return inserted;
+        }
+
+        void sort() {
+#pragma HLS inline
+            // bitonic sort of the batch, ascending
+            for (int k = 2; k <= batch_size; k *= 2) {
+#pragma HLS UNROLL
+                for (int j = k / 2; j > 0; j /= 2) {
+#pragma HLS UNROLL
+                    for (int i = 0; i < batch_size; i++) {
+#pragma HLS UNROLL
+                        int l = i ^ j;
+                        if (l > i) {
+                            bool ascending = (i & k) == 0;
+                            compare_swap(this->batch, i, l, ascending);
+                        }
+                    }
+                }
+            }
+            // the smaller of queue[i] and the reversed batch: the hardware_queue_size smallest, bitonic
+            for (int i = hardware_queue_size - batch_size; i < hardware_queue_size; i++) {
+#pragma HLS UNROLL
+                result_t reg = this->batch[hardware_queue_size - 1 - i];
+                if (reg.dist < this->queue[i].dist) {
+                    this->queue[i] = reg;
+                }
+            }
+            // bitonic merge, ascending
+            for (int j = hardware_queue_size / 2; j > 0; j /= 2) {
+#pragma HLS UNROLL
+                for (int i = 0; i < hardware_queue_size; i++) {
+#pragma HLS UNROLL
+                    int l = i ^ j;
+                    if (l > i) {
+                        compare_swap(this->queue, i, l, true);
+                    }
+                }
+            }
+            reset_batch();
+        }
+
+        float largest() {
+#pragma HLS inline
+            return this->queue[this->runtime_queue_size - 1].dist;
+        }
+
+        // i-th smallest result
+        result_t result(int i) {
+#pragma HLS inline
+            return this->queue[i];
+        }
+
+    private:
+
+        void reset_batch() {
+#pragma HLS inline
+            for (int i = 0; i < batch_size; i++) {
+#pragma HLS UNROLL
+                this->batch[i].node_id = -1;
+                this->batch[i].level_id = -1;
+                this->batch[i].dist = large_float;
+            }
+            this->num_staged = 0;
+        }
+
+        // ascending: the smaller element to idxA (idxA < idxB)
+        void compare_swap(result_t* array, int idxA, int idxB, bool ascending) {
+#pragma HLS inline
+            if ((array[idxA].dist > array[idxB].dist) == ascending) {
+                result_t regA = array[idxA];
+                array[idxA] = array[idxB];
+                array[idxB] = regA;
+            }
+        }
+};
@@ -0,0 +1,66 @@
+// C-simulation testbench of the queue variant selected by QUEUE_VARIANT (constants.hpp): for several
+//   runtime queue sizes and input sizes, the ascending queue content and IDs after insert & sort are
+//   compared to std::sort. The latency / II of the variants are compared by run_benchmark.sh (csynth).
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <iostream>
+#include <tuple>
+#include <vector>
+
+#include "constants.hpp"
+
+extern "C" void vadd(int runtime_queue_size, int input_array_size, int iter_insert_sort, int iter_pop,
+	float* input_array, float* sorted_array);
+
+int main(int argc, char** argv)
+{
+	const int runtime_queue_sizes[] = {16, 64, 128, 256, 512};
+	const int input_array_sizes[] = {16, 256, 1024};
+	const int iter_insert_sort = 2;
+
+	std::cout << "QUEUE_VARIANT=" << QUEUE_VARIANT << " HARDWARE_QUEUE_SIZE=" << HARDWARE_QUEUE_SIZE <<
+		" BITONIC_BATCH_SIZE=" << BITONIC_BATCH_SIZE << std::endl;
+
+	int num_failed = 0;
+	for (int runtime_queue_size : runtime_queue_sizes) {
+#if QUEUE_VARIANT == QUEUE_VARIANT_HYBRID
+		if (runtime_queue_size > hardware_large_result_queue_size) { continue; }
+#else
+		if (runtime_queue_size > hardware_result_queue_size) { continue; }
+#endif
+		for (int input_array_size : input_array_sizes) {
+
+			int iter_pop = runtime_queue_size;
+			std::vector<float> input_array(input_array_size);
+			std::vector<float> sorted_array(runtime_queue_size * 2 + 1);
+			for (int i = 0; i < input_array_size; i++) {
+				input_array[i] = (float)rand() / (float)RAND_MAX;
+			}
+			std::vector<std::tuple<float, int>> sw_sorted_array(input_array_size);
+			for (int i = 0; i < input_array_size; i++) {
+				sw_sorted_array[i] = std::make_tuple(input_array[i], i);
+			}
+			std::sort(sw_sorted_array.begin(), sw_sorted_array.end());
+
+			vadd(runtime_queue_size, input_array_size, iter_insert_sort, iter_pop,
+				input_array.data(), sorted_array.data());
+
+			int sorted_size = runtime_queue_size < input_array_size? runtime_queue_size : input_array_size;
+			int mismatch_dist = 0, mismatch_id = 0;
+			for (int i = 0; i < sorted_size; i++) {
+				if (sorted_array[i] != std::get<0>(sw_sorted_array[i])) { mismatch_dist++; }
+				if (sorted_array[runtime_queue_size + i] != std::get<1>(sw_sorted_array[i])) { mismatch_id++; }
+			}
+			std::cout << "runtime_queue_size=" << runtime_queue_size << " input_array_size=" << input_array_size <<
+				(mismatch_dist + mismatch_id == 0? " Match" : " Mismatch") <<
+				" (distances: " << mismatch_dist << " / " << sorted_size <<
+				", IDs: " << mismatch_id << " / " << sorted_size << ")" << std::endl;
+			if (mismatch_dist + mismatch_id > 0) { num_failed++; }
+		}
+	}
+
+	std::cout << (num_failed == 0? "Overall: Match" : "Overall: Mismatch") << std::endl;
+	return num_failed == 0? 0 : 1;
+}
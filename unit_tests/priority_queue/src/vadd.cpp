@@ -47,6 +47,7 @@ void queue_operations(
 	hls::stream<cand_t>& s_top_candidates
 ) {
 
+#if QUEUE_VARIANT == QUEUE_VARIANT_SYSTOLIC
 	Priority_queue<result_t, hardware_result_queue_size, Collect_smallest> result_queue(runtime_queue_size);
 
 	for (int i = 0; i < iter_insert_sort; i++) {
@@ -63,6 +64,45 @@ void queue_operations(
 	for (int i = 0; i < iter_pop; i++) {
 		result_queue.pop_top(s_top_candidates);
 	}
+#else
+#if QUEUE_VARIANT == QUEUE_VARIANT_HYBRID
+	Two_tier_result_queue<hardware_result_queue_size, hardware_large_result_queue_size> result_queue(runtime_queue_size);
+#else
+	Bitonic_result_queue<hardware_result_queue_size, bitonic_batch_size> result_queue(runtime_queue_size);
+#endif
+
+	// insert as results_collection: up to num_free() elements, then merge the staged ones
+	for (int i = 0; i < iter_insert_sort; i++) {
+		result_queue.reset_queue();
+		int num_left = s_num_inserted_candidates.read();
+		while (num_left > 0) {
+			int num_free = result_queue.num_free();
+			int num_insertion = num_left < num_free? num_left : num_free;
+			for (int j = 0; j < num_insertion; j++) {
+				#pragma HLS pipeline II=1
+				result_queue.insert(s_input.read());
+			}
+			num_left -= num_insertion;
+			if (result_queue.num_free() == 0) {
+				result_queue.sort();
+			}
+		}
+		result_queue.sort();
+	}
+
+	// write results in ascending order
+	for (int i = 0; i < runtime_queue_size; i++) {
+		#pragma HLS pipeline II=1
+		s_output.write(result_queue.result(i).dist);
+	}
+
+	// no pop: the results in ascending order instead
+	for (int i = 0; i < iter_pop; i++) {
+		#pragma HLS pipeline II=1
+		cand_t reg_cand = {i < runtime_queue_size? result_queue.result(i).node_id : -1, 0};
+		s_top_candidates.write(reg_cand);
+	}
+#endif
 }
 
 void write_memory(
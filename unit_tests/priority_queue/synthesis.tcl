@@ -1,10 +1,18 @@
-open_project hls_output 
+# PQ_PROJECT / PQ_CFLAGS: set by run_benchmark.sh per queue variant and size (defaults of constants.hpp otherwise)
+set project hls_output
+if {[info exists ::env(PQ_PROJECT)]} { set project $::env(PQ_PROJECT) }
+set bench_cflags ""
+if {[info exists ::env(PQ_CFLAGS)]} { set bench_cflags $::env(PQ_CFLAGS) }
+
+open_project $project
 open_solution xcu250-figd2104-2L-e
 # open_solution xcu280-fsvh2892-2L-e  
-add_files -cflags "-std=c++11" src/vadd.cpp 
+add_files -cflags "-std=c++11 $bench_cflags" src/vadd.cpp 
+add_files -tb -cflags "-std=c++11 $bench_cflags" src/tb.cpp
 set_top vadd 
 set_part xcu250-figd2104-2L-e
 create_clock -period 140MHz
 config_interface -m_axi_addr64
+csim_design
 csynth_design
 exit
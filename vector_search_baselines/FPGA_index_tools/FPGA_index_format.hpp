@@ -0,0 +1,389 @@
+#pragma once
+
+// The FPGA graph index format, as produced by scripts_hnsw/hnsw.py (save_as_FPGA_format)
+//   and scripts_nsg/nsg_to_FPGA.py, and consumed by the host programs:
+//
+// meta.bin
+//   HNSW: cur_element_count, maxlevel_, enterpoint_node_, maxM_, maxM0_ (each 4B int)
+//   NSG: num_nodes, entry point, width (each 4B int)
+//   optionally followed by the layout flags (4B int, 0 if absent): bit 0 = VECTOR_LAYOUT_COMPACT,
+//     bit 1 = LINK_LAYOUT_PACKED, bit 2 = NEIGHBOR_CODES_PQ, bits 3 ~ 4 = VectorType of the ground
+//     vectors (0 = fp32, 1 = fp16, 2 = int8, see vector_codec.hpp)
+// ground_links_{nc}_chan_{c}.bin, per node:
+//   LINK_LAYOUT_ORIGINAL: [64 B header = num_links (4B int) + 60 byte paddings] + N [64B actual links] + paddings (to 64 B)
+//   LINK_LAYOUT_PACKED: num_links (4B int, at most max degree) + N links, padded to the same 64B multiple
+//     for all nodes; the kernels only fetch the ceil((num_links + 1) / 16) populated 64B words
+//   NEIGHBOR_CODES_PQ: the words the kernels fetch for the links are directly followed by the M-byte PQ codes
+//     of the neighbors (in link order), padded to 64B, such that the links and the codes of a node are one
+//     sequential read; the node stride grows by max_link_num_base x M bytes, padded to 64B
+// ground_vectors_{nc}_chan_{c}.bin, per node:
+//   VECTOR_LAYOUT_PADDED: [vector (4B float) + padding] + [visited (4B int, init as -1) + padding]
+//   VECTOR_LAYOUT_COMPACT: [vector (4B float) + padding], as the visited tags are kept in the
+//     on-chip Bloom filters rather than in DRAM since the multi_layer_v2 kernels
+//   the vector elements are fp16 / int8 rather than 4B floats if the vector type in meta.bin says so
+//   node i is stored in channel i % nc, at position i / nc
+// ground_labels.bin (HNSW, or reordered NSG): 4B label per node
+// upper_links.bin (HNSW only), per node and per level:
+//   [num_links (4B int) + padding] + N [64B actual links] + paddings (to 64 B)
+// upper_links_pointers.bin (HNSW only): 8B byte address of each node's upper links
+// channel_placement_{nc}.bin (channel-balanced indexes only): nc x 4B node counts per channel,
+//   then the 4B labels of each channel's nodes in position order
+// pq_codebook.bin (NEIGHBOR_CODES_PQ only): M (4B int), then M x 256 x ceil(dim / M) 4B float centroids
+//   (see pq_codec.hpp)
+// hot_nodes.bin (optional, profile_hot_nodes): 4B node IDs, most frequently fetched first, loaded into
+//   the hot node cache of the intra-query kernel
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <atomic>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define BYTES_PER_AXI 64
+#define INT_PER_AXI 16
+#define FLOAT_PER_AXI 16
+
+// concat dir, in a namespace as the programs including the tools may have their own (networked_FPGA/CPU_programs/utils.hpp)
+namespace fpga_index {
+
+std::string concat_dir(std::string dir, std::string filename) {
+    if (dir.back() == '/') {
+        return dir + filename;
+    } else {
+        return dir + "/" + filename;
+    }
+}
+
+} // namespace fpga_index
+
+std::string ground_vectors_fname(int nc, int c) {
+    return "ground_vectors_" + std::to_string(nc) + "_chan_" + std::to_string(c) + ".bin";
+}
+
+std::string ground_links_fname(int nc, int c) {
+    return "ground_links_" + std::to_string(nc) + "_chan_" + std::to_string(c) + ".bin";
+}
+
+// e.g., "1,2,4,8,16"
+std::vector<int> parse_num_channels(const std::string& s) {
+    std::vector<int> num_channels;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) { num_channels.push_back(std::stoi(item)); }
+    return num_channels;
+}
+
+// Channel-balanced placement (balance_FPGA_channels, CHANNEL_PLACEMENT_BALANCED in the kernels):
+//   the node IDs in the links encode the channel in bits [30 : 31 - log2(nc)] and the position
+//   within the channel in the bits below; bit 31 stays 0 such that the IDs remain positive ints
+int channel_addr_bits(int nc) {
+    int bits = 0;
+    while ((1 << bits) < nc) { bits++; }
+    return bits;
+}
+
+uint32_t placed_node_id(int nc, int c, uint32_t pos) {
+    return ((uint32_t) c << (31 - channel_addr_bits(nc))) | pos;
+}
+
+std::string channel_placement_fname(int nc) {
+    return "channel_placement_" + std::to_string(nc) + ".bin";
+}
+
+std::string hot_nodes_fname() {
+    return "hot_nodes.bin";
+}
+
+std::string pq_codebook_fname() {
+    return "pq_codebook.bin";
+}
+
+size_t round_up_to_AXI(size_t bytes) {
+    return (bytes + BYTES_PER_AXI - 1) / BYTES_PER_AXI * BYTES_PER_AXI;
+}
+
+// same values as LINK_LAYOUT_* in the kernels
+enum LinkLayout { LINK_LAYOUT_ORIGINAL = 0, LINK_LAYOUT_PACKED = 1 };
+
+LinkLayout parse_link_layout(const std::string& s) {
+    if (s == "original") { return LINK_LAYOUT_ORIGINAL; }
+    else if (s == "packed") { return LINK_LAYOUT_PACKED; }
+    std::cout << "Unsupported link layout " << s << " (original/packed)" << std::endl;
+    exit(EXIT_FAILURE);
+}
+
+// same values as NEIGHBOR_CODES_* in the kernels
+enum NeighborCodes { NEIGHBOR_CODES_NONE = 0, NEIGHBOR_CODES_PQ = 1 };
+
+NeighborCodes parse_neighbor_codes(const std::string& s) {
+    if (s == "none") { return NEIGHBOR_CODES_NONE; }
+    else if (s == "pq") { return NEIGHBOR_CODES_PQ; }
+    std::cout << "Unsupported neighbor codes " << s << " (none/pq)" << std::endl;
+    exit(EXIT_FAILURE);
+}
+
+// original: 64B header + links padded to 64B; packed: count + links padded to 64B;
+//   + the neighbor codes (code_bytes per link) padded to 64B
+size_t bytes_per_ground_links(int max_degree, LinkLayout layout = LINK_LAYOUT_ORIGINAL, int code_bytes = 0) {
+    size_t bytes_codes = round_up_to_AXI((size_t) max_degree * code_bytes);
+    if (layout == LINK_LAYOUT_PACKED) { return round_up_to_AXI((1 + max_degree) * sizeof(int)) + bytes_codes; }
+    return BYTES_PER_AXI + round_up_to_AXI(max_degree * sizeof(int)) + bytes_codes;
+}
+
+// number of 64B words holding the count and the links of a node
+size_t populated_link_words(uint32_t num_links, int max_degree, LinkLayout layout) {
+    if (layout == LINK_LAYOUT_ORIGINAL) { return bytes_per_ground_links(max_degree) / BYTES_PER_AXI; }
+    return round_up_to_AXI((1 + num_links) * sizeof(int)) / BYTES_PER_AXI;
+}
+
+// number of 64B words holding the neighbor codes of a node, right after its populated link words
+size_t populated_code_words(uint32_t num_links, int code_bytes) {
+    return round_up_to_AXI((size_t) num_links * code_bytes) / BYTES_PER_AXI;
+}
+
+// same values as VECTOR_LAYOUT_* in the kernels
+enum VectorLayout { VECTOR_LAYOUT_PADDED = 0, VECTOR_LAYOUT_COMPACT = 1 };
+
+VectorLayout parse_vector_layout(const std::string& s) {
+    if (s == "padded") { return VECTOR_LAYOUT_PADDED; }
+    else if (s == "compact") { return VECTOR_LAYOUT_COMPACT; }
+    std::cout << "Unsupported vector layout " << s << " (padded/compact)" << std::endl;
+    exit(EXIT_FAILURE);
+}
+
+// storage type of the ground layer vectors, same values as VECTOR_TYPE_* in the kernels (see vector_codec.hpp)
+enum VectorType { VECTOR_FP32 = 0, VECTOR_FP16 = 1, VECTOR_INT8 = 2 };
+
+// vector padded to 64B (+ 64B visited flag)
+size_t bytes_per_ground_vector(int dim, VectorLayout layout = VECTOR_LAYOUT_PADDED) {
+    return round_up_to_AXI(dim * sizeof(float)) + (layout == VECTOR_LAYOUT_PADDED? BYTES_PER_AXI : 0);
+}
+
+// 64B header + links padded to 64B, per upper level
+size_t bytes_per_upper_level(int M) {
+    return BYTES_PER_AXI + round_up_to_AXI(M * sizeof(int));
+}
+
+// only the first min(link_count, max_degree) links are kept; link_count is stored as it is in the
+//   original layout, and as the number of kept links in the packed layout. neighbor_codes (optional):
+//   code_bytes per kept link, in link order
+void encode_ground_links(uint32_t link_count, const uint32_t* links, int max_degree, char* out,
+    LinkLayout layout = LINK_LAYOUT_ORIGINAL, const uint8_t* neighbor_codes = nullptr, int code_bytes = 0) {
+    memset(out, 0, bytes_per_ground_links(max_degree, layout, code_bytes));
+    uint32_t n = link_count < (uint32_t) max_degree? link_count : max_degree;
+    if (layout == LINK_LAYOUT_PACKED) {
+        memcpy(out, &n, sizeof(uint32_t));
+        memcpy(out + sizeof(uint32_t), links, n * sizeof(uint32_t));
+    } else {
+        memcpy(out, &link_count, sizeof(uint32_t));
+        memcpy(out + BYTES_PER_AXI, links, n * sizeof(uint32_t));
+    }
+    if (neighbor_codes) {
+        memcpy(out + populated_link_words(n, max_degree, layout) * BYTES_PER_AXI, neighbor_codes, (size_t) n * code_bytes);
+    }
+}
+
+void encode_ground_vector(const float* vec, int dim, char* out, VectorLayout layout = VECTOR_LAYOUT_PADDED) {
+    size_t bytes_vec = round_up_to_AXI(dim * sizeof(float));
+    memset(out, 0, bytes_per_ground_vector(dim, layout));
+    memcpy(out, vec, dim * sizeof(float));
+    if (layout == VECTOR_LAYOUT_PADDED) {
+        // -1 used for visited flag
+        memset(out + bytes_vec, 0xff, sizeof(int));
+    }
+}
+
+// Read-only memory-mapped input file (hnswlib .bin, .nsg, or raw datasets)
+class MappedInput {
+
+public:
+
+    const char* data = nullptr;
+    size_t bytes = 0;
+
+    // sequential: the file is streamed through once, front to back (otherwise random access)
+    MappedInput(const std::string& fname, bool sequential = true) {
+        int fd = open(fname.c_str(), O_RDONLY);
+        if (fd < 0) { perror(fname.c_str()); exit(EXIT_FAILURE); }
+        struct stat stat_buf;
+        fstat(fd, &stat_buf);
+        bytes = stat_buf.st_size;
+        void* ptr = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (ptr == MAP_FAILED) { perror("mmap"); exit(EXIT_FAILURE); }
+        madvise(ptr, bytes, sequential? MADV_SEQUENTIAL : MADV_RANDOM);
+        data = (const char*) ptr;
+    }
+
+    ~MappedInput() {
+        if (data) { munmap((void*) data, bytes); }
+    }
+
+    MappedInput(const MappedInput&) = delete;
+    MappedInput& operator=(const MappedInput&) = delete;
+};
+
+// Output file written at explicit offsets (pwrite), such that disjoint node ranges
+//   of the same file can be produced by different threads
+class OutputFile {
+
+public:
+
+    std::string fname;
+    int fd;
+
+    OutputFile(const std::string& fname, size_t bytes) : fname(fname) {
+        fd = open(fname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) { perror(fname.c_str()); exit(EXIT_FAILURE); }
+        if (ftruncate(fd, bytes) != 0) { perror("ftruncate"); exit(EXIT_FAILURE); }
+    }
+
+    ~OutputFile() { close(fd); }
+
+    OutputFile(const OutputFile&) = delete;
+    OutputFile& operator=(const OutputFile&) = delete;
+
+    void write_at(const char* buf, size_t bytes, size_t offset) {
+        size_t total_written_bytes = 0;
+        while (total_written_bytes < bytes) {
+            ssize_t written_bytes = pwrite(fd, buf + total_written_bytes, bytes - total_written_bytes, offset + total_written_bytes);
+            if (written_bytes <= 0) { perror(fname.c_str()); exit(EXIT_FAILURE); }
+            total_written_bytes += written_bytes;
+        }
+    }
+};
+
+void write_file(const std::string& fname, const char* buf, size_t bytes) {
+    OutputFile f(fname, bytes);
+    f.write_at(buf, bytes, 0);
+}
+
+// meta.bin: 5 ints for HNSW, 3 ints for NSG, + 1 int of layout flags if a layout is not the original one
+//   (the PQ code size of NEIGHBOR_CODES_PQ is the first int of pq_codebook.bin)
+struct FPGAIndexMeta {
+
+    bool is_hnsw;
+    int num_nodes;
+    int max_level = 0; // HNSW only
+    int entry_point;
+    int max_link_num_upper = 0; // HNSW only
+    int max_link_num_base;
+    VectorLayout vector_layout = VECTOR_LAYOUT_PADDED;
+    LinkLayout link_layout = LINK_LAYOUT_ORIGINAL;
+    NeighborCodes neighbor_codes = NEIGHBOR_CODES_NONE;
+    VectorType vector_type = VECTOR_FP32;
+    int pq_m = 0; // code bytes per neighbor, NEIGHBOR_CODES_PQ only
+
+    FPGAIndexMeta(bool is_hnsw) : is_hnsw(is_hnsw) {}
+
+    FPGAIndexMeta(const std::string& index_dir) {
+        MappedInput meta(fpga_index::concat_dir(index_dir, "meta.bin"));
+        const int* m = (const int*) meta.data;
+        size_t num_ints = meta.bytes / sizeof(int);
+        is_hnsw = num_ints >= 5;
+        if (is_hnsw) {
+            num_nodes = m[0]; max_level = m[1]; entry_point = m[2]; max_link_num_upper = m[3]; max_link_num_base = m[4];
+        } else {
+            num_nodes = m[0]; entry_point = m[1]; max_link_num_base = m[2];
+        }
+        if (num_ints == 4 || num_ints == 6) {
+            int flags = m[num_ints - 1];
+            vector_layout = (VectorLayout) (flags & 1);
+            link_layout = (LinkLayout) ((flags >> 1) & 1);
+            neighbor_codes = (NeighborCodes) ((flags >> 2) & 1);
+            vector_type = (VectorType) ((flags >> 3) & 3);
+        }
+        if (neighbor_codes == NEIGHBOR_CODES_PQ) {
+            MappedInput codebook(fpga_index::concat_dir(index_dir, pq_codebook_fname()));
+            pq_m = *(const int*) codebook.data;
+        }
+    }
+
+    int code_bytes() const { return neighbor_codes == NEIGHBOR_CODES_PQ? pq_m : 0; }
+
+    void save(const std::string& index_dir) const {
+        std::vector<int> m;
+        if (is_hnsw) {
+            m = {num_nodes, max_level, entry_point, max_link_num_upper, max_link_num_base};
+        } else {
+            m = {num_nodes, entry_point, max_link_num_base};
+        }
+        // the original layouts are left implicit, such that the python scripts' indexes are unchanged
+        int flags = vector_layout | (link_layout << 1) | (neighbor_codes << 2) | (vector_type << 3);
+        if (flags != 0) { m.push_back(flags); }
+        write_file(fpga_index::concat_dir(index_dir, "meta.bin"), (const char*) m.data(), m.size() * sizeof(int));
+    }
+};
+
+// Run task(0) ... task(num_tasks - 1) on num_threads threads, tasks are fetched dynamically
+void parallel_for(size_t num_tasks, int num_threads, const std::function<void(size_t)>& task) {
+    std::atomic<size_t> next_task(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; t++) {
+        threads.emplace_back([&] {
+            while (true) {
+                size_t i = next_task.fetch_add(1);
+                if (i >= num_tasks) { break; }
+                task(i);
+            }
+        });
+    }
+    for (auto& t : threads) { t.join(); }
+}
+
+// Stream out ground_vectors_{nc}_chan_{c}.bin and ground_links_{nc}_chan_{c}.bin for all nc
+//   in one parallel pass. Every (file, chunk of nodes) is a task, thus the memory footprint is
+//   bounded by num_threads * nodes_per_chunk nodes, regardless of the graph size.
+//
+//   encode_links(node_id, out) / encode_vector(node_id, out) fill the per-node records.
+void write_ground_layer_per_channel(
+    const std::string& out_dir, size_t num_nodes, const std::vector<int>& num_channels,
+    size_t bytes_per_links, size_t bytes_per_vector,
+    const std::function<void(size_t, char*)>& encode_links,
+    const std::function<void(size_t, char*)>& encode_vector,
+    int num_threads, size_t nodes_per_chunk = 64 * 1024) {
+
+    struct Task { OutputFile* file; bool is_links; int nc; int c; size_t start_pos; size_t end_pos; };
+
+    std::vector<OutputFile*> files;
+    std::vector<Task> tasks;
+    for (int nc : num_channels) {
+        for (int c = 0; c < nc; c++) {
+            size_t nodes_in_chan = num_nodes / nc + (c < (int) (num_nodes % nc)? 1 : 0);
+            for (int is_links = 0; is_links < 2; is_links++) {
+                std::string fname = is_links? ground_links_fname(nc, c) : ground_vectors_fname(nc, c);
+                size_t bytes_per_node = is_links? bytes_per_links : bytes_per_vector;
+                files.push_back(new OutputFile(fpga_index::concat_dir(out_dir, fname), nodes_in_chan * bytes_per_node));
+                for (size_t start_pos = 0; start_pos < nodes_in_chan; start_pos += nodes_per_chunk) {
+                    size_t end_pos = start_pos + nodes_per_chunk < nodes_in_chan? start_pos + nodes_per_chunk : nodes_in_chan;
+                    tasks.push_back({files.back(), (bool) is_links, nc, c, start_pos, end_pos});
+                }
+            }
+        }
+    }
+
+    parallel_for(tasks.size(), num_threads, [&](size_t i) {
+        const Task& t = tasks[i];
+        size_t bytes_per_node = t.is_links? bytes_per_links : bytes_per_vector;
+        std::vector<char> buf((t.end_pos - t.start_pos) * bytes_per_node);
+        for (size_t pos = t.start_pos; pos < t.end_pos; pos++) {
+            size_t node_id = pos * t.nc + t.c;
+            char* out = buf.data() + (pos - t.start_pos) * bytes_per_node;
+            if (t.is_links) { encode_links(node_id, out); } else { encode_vector(node_id, out); }
+        }
+        t.file->write_at(buf.data(), buf.size(), t.start_pos * bytes_per_node);
+    });
+
+    for (auto f : files) { delete f; }
+}
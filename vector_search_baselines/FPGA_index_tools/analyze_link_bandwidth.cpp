@@ -0,0 +1,172 @@
+// analyze_link_bandwidth: DRAM traffic of the base layer adjacency fetch (fetch_neighbor_ids) with the
+//   original link layout (64B header + all max degree links fetched) versus the packed one (count and
+//   links in the same words, only ceil((num_links + 1) / 16) words fetched, see FPGA_index_format.hpp).
+//
+// Per index, the degree distribution of the ground layer (mean, p50, p99, max) and the 512-bit words
+//   per adjacency fetch in both layouts are reported, over all nodes and, if queries are given, over
+//   the candidates expanded by a best-first search of them (the nodes the kernel actually fetches).
+//   Nodes with more than 15 links need a second, dependent burst in the packed layout, as the count
+//   has to be read first; their share is reported as well.
+//
+// Example Usage:
+//   ./analyze_link_bandwidth --FPGA_index_path ../data/FPGA_hnsw/SIFT10M_MD64,../data/FPGA_hnsw/Deep10M_MD64
+//   ./analyze_link_bandwidth --FPGA_index_path ../data/FPGA_hnsw/SIFT10M_MD64 --dbname SIFT10M
+//       --query_path /mnt/scratch/wenqi/Faiss_experiments/bigann/bigann_query.bvecs
+//
+// --FPGA_index_path, --dbname and --query_path take comma-separated lists of the same length (the
+//   queries are optional, and need the dbname for the dimension and the file format)
+// Optional: --num_queries 10000 --ef 64 --num_threads <hardware concurrency> --dim <from dbname, for all indexes>
+
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "FPGA_index_format.hpp"
+#include "dataset.hpp"
+#include "graph_search.hpp"
+
+std::vector<std::string> split_list(const std::string& s) {
+    std::vector<std::string> items;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) { items.push_back(item); }
+    return items;
+}
+
+// number of nodes per degree (0 ~ max degree), and the words fetched per node in both layouts
+struct DegreeStats {
+    int max_degree;
+    std::vector<size_t> count;
+    size_t total = 0;
+
+    DegreeStats(int max_degree) : max_degree(max_degree), count(max_degree + 1, 0) {}
+
+    void add(uint32_t degree, size_t n = 1) { count[degree] += n; total += n; }
+
+    double mean() const {
+        double sum = 0;
+        for (int d = 0; d <= max_degree; d++) { sum += (double) d * count[d]; }
+        return total? sum / total : 0;
+    }
+
+    int percentile(double p) const {
+        size_t target = (size_t) (p * total);
+        size_t acc = 0;
+        for (int d = 0; d <= max_degree; d++) {
+            acc += count[d];
+            if (acc > target) { return d; }
+        }
+        return max_degree;
+    }
+
+    int max() const {
+        for (int d = max_degree; d >= 0; d--) { if (count[d]) { return d; } }
+        return 0;
+    }
+
+    double words(LinkLayout layout) const {
+        double sum = 0;
+        for (int d = 0; d <= max_degree; d++) { sum += (double) populated_link_words(d, max_degree, layout) * count[d]; }
+        return total? sum / total : 0;
+    }
+
+    // share of the nodes fetched with two bursts in the packed layout (the count and the links span more than a word)
+    double two_bursts() const {
+        size_t n = 0;
+        for (int d = 0; d <= max_degree; d++) {
+            if (populated_link_words(d, max_degree, LINK_LAYOUT_PACKED) > 1) { n += count[d]; }
+        }
+        return total? (double) n / total : 0;
+    }
+
+    void print(const std::string& name) const {
+        double words_original = words(LINK_LAYOUT_ORIGINAL);
+        double words_packed = words(LINK_LAYOUT_PACKED);
+        std::cout << "  " << name << ": nodes=" << total << " degree mean=" << mean() << " p50=" << percentile(0.5) <<
+            " p99=" << percentile(0.99) << " max=" << max() << std::endl;
+        std::cout << "    words/fetch original=" << words_original << " packed=" << words_packed <<
+            " bandwidth saved=" << (words_original > 0? 100 * (1 - words_packed / words_original) : 0) << "%" <<
+            " two-burst fetches=" << 100 * two_bursts() << "%" << std::endl;
+    }
+};
+
+int main(int argc, char** argv) {
+
+    std::cout << "Usage: " << argv[0] << " --FPGA_index_path <dir1,dir2,...> [--dbname <name1,name2,...>] "
+        "[--query_path <queries1,queries2,...>] [--num_queries N] [--ef EF] [--num_threads N] [--dim D]" << std::endl;
+
+    std::map<std::string, std::string> args;
+    for (int i = 1; i + 1 < argc; i += 2) { args[argv[i]] = argv[i + 1]; }
+
+    std::vector<std::string> index_dirs = split_list(args["--FPGA_index_path"]);
+    std::vector<std::string> dbnames = split_list(args["--dbname"]);
+    std::vector<std::string> query_paths = split_list(args["--query_path"]);
+    int num_queries = args.count("--num_queries")? std::stoi(args["--num_queries"]) : 10000;
+    int ef = args.count("--ef")? std::stoi(args["--ef"]) : 64;
+    int num_threads = args.count("--num_threads")? std::stoi(args["--num_threads"]) : std::thread::hardware_concurrency();
+
+    if (index_dirs.empty()) {
+        std::cout << "Missing index path" << std::endl;
+        return -1;
+    }
+
+    for (size_t i = 0; i < index_dirs.size(); i++) {
+        const std::string& dir = index_dirs[i];
+        std::string name = i < dbnames.size()? dbnames[i] : dir;
+        FPGAIndexMeta meta(dir);
+        int max_degree = meta.max_link_num_base;
+        size_t bytes_per_links = bytes_per_ground_links(max_degree, meta.link_layout, meta.code_bytes());
+        MappedInput links_file(fpga_index::concat_dir(dir, ground_links_fname(1, 0)), false);
+        if (links_file.bytes != (size_t) meta.num_nodes * bytes_per_links) {
+            std::cout << name << ": ground links size does not match meta.bin" << std::endl;
+            return -1;
+        }
+        std::cout << name << " (" << (meta.link_layout == LINK_LAYOUT_PACKED? "packed" : "original") <<
+            " layout, max degree " << max_degree << ", bytes/node original=" << bytes_per_ground_links(max_degree) <<
+            " packed=" << bytes_per_ground_links(max_degree, LINK_LAYOUT_PACKED) << ")" << std::endl;
+
+        DegreeStats all_nodes(max_degree);
+        for (size_t n = 0; n < (size_t) meta.num_nodes; n++) {
+            uint32_t degree = *(const uint32_t*) (links_file.data + n * bytes_per_links);
+            all_nodes.add(degree < (uint32_t) max_degree? degree : max_degree);
+        }
+        all_nodes.print("all nodes");
+
+        std::string query_path = i < query_paths.size()? query_paths[i] : "";
+        if (query_path.empty()) { continue; }
+        if (i >= dbnames.size()) {
+            std::cout << "  --dbname is needed to replay the queries" << std::endl;
+            continue;
+        }
+        int dim = args.count("--dim")? std::stoi(args["--dim"]) : dim_from_dbname(dbnames[i]);
+        FPGAIndex index(dir, dim);
+        DatasetReader query_reader(query_path, format_from_dbname(dbnames[i]), dim);
+        int nq = num_queries < (int) query_reader.num_vectors? num_queries : query_reader.num_vectors;
+
+        std::vector<std::vector<size_t>> per_thread_count(num_threads, std::vector<size_t>(max_degree + 1, 0));
+        std::atomic<int> next_thread_slot(0);
+        parallel_for(nq, num_threads, [&](size_t q) {
+            thread_local std::unique_ptr<VisitedList> visited; // freed at thread exit
+            thread_local std::vector<float> query;
+            thread_local std::vector<int> expanded;
+            thread_local int slot = -1;
+            if (!visited) { visited.reset(new VisitedList(index.num_nodes)); }
+            if (slot < 0) { slot = next_thread_slot++; }
+            query.resize(dim);
+            query_reader.get(q, query.data());
+            expanded.clear();
+            search_ground_layer(index, query.data(), ef, *visited, nullptr, nullptr, nullptr, &expanded);
+            for (int id : expanded) { per_thread_count[slot][index.num_links(id)]++; }
+        });
+        DegreeStats fetched(max_degree);
+        for (int t = 0; t < num_threads; t++) {
+            for (int d = 0; d <= max_degree; d++) { fetched.add(d, per_thread_count[t][d]); }
+        }
+        fetched.print("expanded by " + std::to_string(nq) + " queries (ef=" + std::to_string(ef) + ")");
+        std::cout << "    fetches/query=" << (double) fetched.total / nq << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,282 @@
+// balance_FPGA_channels: place the nodes of an FPGA-format index on the DRAM channels by visit
+//   frequency, instead of the round-robin placement (node i in channel i % nc).
+//
+// With the round-robin placement, the hot nodes close to the entry point, and the neighbors
+//   fetched in the same iteration, can pile up on one channel; as gather_distances_from_channels
+//   waits for all channels, the most loaded channel sets the latency of every iteration.
+//
+// The visit frequency of every node is profiled on a query sample (--query_path, replayed with
+//   a best-first search on the input index, or --trace_path, a per_query_ids_*.int trace of
+//   eval_trace_FPGA_inter_query_v1.3). The visited nodes are then assigned in decreasing order of
+//   frequency to the channel with the lowest cost = accumulated load + --co_access_weight x load of
+//   the already placed siblings (nodes sharing a visited in-neighbor, i.e., fetched in the same
+//   iteration) in that channel. The unvisited nodes fill up the channels to equal node counts.
+//   Within a channel, the nodes keep the input order (e.g., of reorder_FPGA_index).
+//
+// Output (for a single --num_channels nc, as the placement depends on nc):
+//   meta.bin (entry point as placed ID), ground_links_{nc}_chan_{c}.bin and
+//   ground_vectors_{nc}_chan_{c}.bin with the links as placed IDs (see placed_node_id), and
+//   channel_placement_{nc}.bin to translate the results back to labels. The upper layers of
+//   HNSW are not copied, as the kernels only search the base layer.
+//   Kernels and host have to be compiled with CHANNEL_PLACEMENT_BALANCED (constants.hpp).
+//
+// Example Usage:
+//   ./balance_FPGA_channels --dbname SIFT10M --FPGA_index_path ../data/FPGA_hnsw/SIFT10M_MD64
+//       --out_FPGA_index_path ../data/FPGA_hnsw/SIFT10M_MD64_balanced_4_chan --num_channels 4
+//       --query_path /mnt/scratch/wenqi/Faiss_experiments/bigann/bigann_query.bvecs
+//   (without --out_FPGA_index_path, only the load report is produced)
+//
+// Optional: --num_queries 10000 --ef 64 --cand_batch_size 1 (candidates per kernel iteration, mc)
+//   --co_access_weight 1.0 --max_siblings 8 --num_threads <hardware concurrency> --dim <from dbname>
+
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "FPGA_index_format.hpp"
+#include "dataset.hpp"
+#include "graph_search.hpp"
+#include "pq_codec.hpp"
+
+// Greedy placement, returns the channel of each node
+std::vector<int> place_nodes(const FPGAIndex& index, const InEdges& in, const std::vector<uint32_t>& freq,
+    int nc, double co_access_weight, int max_siblings) {
+
+    size_t num_nodes = index.num_nodes;
+    size_t capacity = (num_nodes + nc - 1) / nc;
+    std::vector<int> channel(num_nodes, -1);
+    std::vector<double> load(nc, 0);
+    std::vector<size_t> count(nc, 0);
+
+    std::vector<uint32_t> hot;
+    for (size_t i = 0; i < num_nodes; i++) { if (freq[i] > 0) { hot.push_back(i); } }
+    std::stable_sort(hot.begin(), hot.end(), [&](uint32_t a, uint32_t b) { return freq[a] > freq[b]; });
+
+    std::vector<double> co_access(nc);
+    for (uint32_t v : hot) {
+        std::fill(co_access.begin(), co_access.end(), 0);
+        int num_parents = 0;
+        for (size_t k = in.offsets[v]; k < in.offsets[v + 1] && num_parents < max_siblings; k++) {
+            uint32_t p = in.ids[k];
+            if (freq[p] == 0) { continue; } // never expanded
+            num_parents++;
+            const uint32_t* links = index.links(p);
+            for (uint32_t j = 0; j < index.num_links(p); j++) {
+                uint32_t s = links[j];
+                if (s != v && channel[s] >= 0) { co_access[channel[s]] += std::min(freq[s], freq[v]); }
+            }
+        }
+        int best = -1;
+        double best_cost = 0;
+        for (int c = 0; c < nc; c++) {
+            if (count[c] >= capacity) { continue; }
+            double cost = load[c] + co_access_weight * co_access[c];
+            if (best == -1 || cost < best_cost) { best = c; best_cost = cost; }
+        }
+        channel[v] = best;
+        load[best] += freq[v];
+        count[best]++;
+    }
+
+    int c = 0;
+    for (size_t i = 0; i < num_nodes; i++) {
+        if (channel[i] >= 0) { continue; }
+        while (count[c] >= capacity) { c = (c + 1) % nc; }
+        channel[i] = c;
+        count[c]++;
+        c = (c + 1) % nc;
+    }
+    return channel;
+}
+
+// max / mean vector fetches per channel, over all fetches, and per kernel iteration
+//   (sum of the max over the sum of the mean), if the expansion sizes are known
+void report_channel_load(const std::vector<std::vector<int>>& traces, const std::vector<std::vector<int>>& expansion_sizes,
+    int nc, int cand_batch_size, const std::function<int(int)>& channel_of) {
+
+    std::vector<size_t> total(nc, 0);
+    std::vector<size_t> per_iter(nc, 0);
+    size_t accesses = 0;
+    double sum_iter_max = 0;
+    double sum_iter_mean = 0;
+    for (size_t q = 0; q < traces.size(); q++) {
+        for (int id : traces[q]) { total[channel_of(id)]++; }
+        accesses += traces[q].size();
+        if (expansion_sizes.empty()) { continue; }
+
+        // the first fetch is the entry point, then the neighbors of every expansion
+        size_t pos = 1;
+        const std::vector<int>& sizes = expansion_sizes[q];
+        for (size_t e = 0; e < sizes.size(); e += cand_batch_size) {
+            std::fill(per_iter.begin(), per_iter.end(), 0);
+            size_t n = 0;
+            for (size_t b = e; b < e + cand_batch_size && b < sizes.size(); b++) {
+                for (int j = 0; j < sizes[b]; j++) { per_iter[channel_of(traces[q][pos++])]++; n++; }
+            }
+            sum_iter_max += *std::max_element(per_iter.begin(), per_iter.end());
+            sum_iter_mean += (double) n / nc;
+        }
+    }
+    std::cout << "  total max/mean=" << (double) *std::max_element(total.begin(), total.end()) * nc / accesses;
+    if (!expansion_sizes.empty()) {
+        std::cout << " per-iteration max/mean=" << sum_iter_max / sum_iter_mean;
+    }
+    std::cout << std::endl;
+}
+
+void write_balanced_index(const FPGAIndex& index, const std::string& in_dir, const std::string& out_dir,
+    int nc, const std::vector<int>& channel, int num_threads) {
+
+    size_t num_nodes = index.num_nodes;
+    int max_degree = index.meta.max_link_num_base;
+
+    // positions within the channels keep the input order
+    std::vector<std::vector<uint32_t>> nodes_per_channel(nc);
+    std::vector<uint32_t> placed_id(num_nodes);
+    for (size_t i = 0; i < num_nodes; i++) {
+        int c = channel[i];
+        placed_id[i] = placed_node_id(nc, c, nodes_per_channel[c].size());
+        nodes_per_channel[c].push_back(i);
+    }
+
+    FPGAIndexMeta meta = index.meta;
+    meta.entry_point = placed_id[index.meta.entry_point];
+    meta.save(out_dir);
+    // the neighbor codes move with the links, the codebook is unchanged
+    if (meta.neighbor_codes == NEIGHBOR_CODES_PQ) {
+        ProductQuantizer pq(index.dim);
+        pq.load(in_dir);
+        pq.save(out_dir);
+    }
+
+    // labels: the existing labels (HNSW), or the input IDs (NSG)
+    std::vector<uint32_t> placement;
+    for (int c = 0; c < nc; c++) { placement.push_back(nodes_per_channel[c].size()); }
+    std::string fname_labels = fpga_index::concat_dir(in_dir, "ground_labels.bin");
+    struct stat stat_buf;
+    bool has_labels = stat(fname_labels.c_str(), &stat_buf) == 0;
+    MappedInput* in_labels = has_labels? new MappedInput(fname_labels) : nullptr;
+    for (int c = 0; c < nc; c++) {
+        for (uint32_t i : nodes_per_channel[c]) {
+            placement.push_back(has_labels? ((const uint32_t*) in_labels->data)[i] : i);
+        }
+    }
+    delete in_labels;
+    write_file(fpga_index::concat_dir(out_dir, channel_placement_fname(nc)), (const char*) placement.data(), placement.size() * sizeof(uint32_t));
+
+    struct Task { OutputFile* file; bool is_links; int c; size_t start_pos; size_t end_pos; };
+    std::vector<OutputFile*> files;
+    std::vector<Task> tasks;
+    size_t nodes_per_chunk = 64 * 1024;
+    for (int c = 0; c < nc; c++) {
+        size_t nodes_in_chan = nodes_per_channel[c].size();
+        for (int is_links = 0; is_links < 2; is_links++) {
+            std::string fname = is_links? ground_links_fname(nc, c) : ground_vectors_fname(nc, c);
+            size_t bytes_per_node = is_links? index.bytes_per_links : index.bytes_per_vector;
+            files.push_back(new OutputFile(fpga_index::concat_dir(out_dir, fname), nodes_in_chan * bytes_per_node));
+            for (size_t start_pos = 0; start_pos < nodes_in_chan; start_pos += nodes_per_chunk) {
+                size_t end_pos = start_pos + nodes_per_chunk < nodes_in_chan? start_pos + nodes_per_chunk : nodes_in_chan;
+                tasks.push_back({files.back(), (bool) is_links, c, start_pos, end_pos});
+            }
+        }
+    }
+    parallel_for(tasks.size(), num_threads, [&](size_t t_id) {
+        const Task& t = tasks[t_id];
+        size_t bytes_per_node = t.is_links? index.bytes_per_links : index.bytes_per_vector;
+        std::vector<char> buf((t.end_pos - t.start_pos) * bytes_per_node);
+        std::vector<uint32_t> links;
+        for (size_t pos = t.start_pos; pos < t.end_pos; pos++) {
+            uint32_t i = nodes_per_channel[t.c][pos];
+            char* out = buf.data() + (pos - t.start_pos) * bytes_per_node;
+            if (t.is_links) {
+                links.resize(index.num_links(i));
+                for (size_t j = 0; j < links.size(); j++) { links[j] = placed_id[index.links(i)[j]]; }
+                encode_ground_links(index.stored_link_count(i), links.data(), max_degree, out, index.meta.link_layout,
+                    index.meta.code_bytes()? index.neighbor_codes(i) : nullptr, index.meta.code_bytes());
+            } else {
+                memcpy(out, index.vector(i), index.bytes_per_vector);
+            }
+        }
+        t.file->write_at(buf.data(), buf.size(), t.start_pos * bytes_per_node);
+    });
+    for (auto f : files) { delete f; }
+}
+
+int main(int argc, char** argv) {
+
+    std::cout << "Usage: " << argv[0] << " --dbname <e.g., SIFT10M> --FPGA_index_path <in_dir> --num_channels <nc> "
+        "[--out_FPGA_index_path <out_dir>] "
+        "(--trace_path <per_query_ids_*.int> | --query_path <queries> [--num_queries N] [--ef EF]) "
+        "[--cand_batch_size MC] [--co_access_weight W] [--max_siblings S] [--num_threads N] [--dim D]" << std::endl;
+
+    std::map<std::string, std::string> args;
+    for (int i = 1; i + 1 < argc; i += 2) { args[argv[i]] = argv[i + 1]; }
+
+    std::string dbname = args.count("--dbname")? args["--dbname"] : "SIFT1M";
+    std::string in_dir = args["--FPGA_index_path"];
+    std::string out_dir = args["--out_FPGA_index_path"];
+    std::string trace_path = args["--trace_path"];
+    std::string query_path = args["--query_path"];
+    int nc = args.count("--num_channels")? std::stoi(args["--num_channels"]) : 4;
+    int num_queries = args.count("--num_queries")? std::stoi(args["--num_queries"]) : 10000;
+    int ef = args.count("--ef")? std::stoi(args["--ef"]) : 64;
+    int cand_batch_size = args.count("--cand_batch_size")? std::stoi(args["--cand_batch_size"]) : 1;
+    double co_access_weight = args.count("--co_access_weight")? std::stod(args["--co_access_weight"]) : 1.0;
+    int max_siblings = args.count("--max_siblings")? std::stoi(args["--max_siblings"]) : 8;
+    int num_threads = args.count("--num_threads")? std::stoi(args["--num_threads"]) : std::thread::hardware_concurrency();
+    int dim = args.count("--dim")? std::stoi(args["--dim"]) : dim_from_dbname(dbname);
+
+    if (in_dir.empty() || (trace_path.empty() && query_path.empty())) {
+        std::cout << "Missing input path or query profile" << std::endl;
+        return -1;
+    }
+    if (nc < 1 || nc > 16 || (nc & (nc - 1)) != 0) {
+        std::cout << "num_channels has to be 2^n, up to 16" << std::endl;
+        return -1;
+    }
+
+    FPGAIndex index(in_dir, dim);
+    std::cout << "num_nodes=" << index.num_nodes << " max_degree=" << index.meta.max_link_num_base <<
+        " num_channels=" << nc << std::endl;
+
+    std::vector<std::vector<int>> traces;
+    std::vector<std::vector<int>> expansion_sizes;
+    if (!trace_path.empty()) {
+        traces = load_traces(trace_path);
+    } else {
+        traces = replay_traces(index, query_path, dbname, num_queries, ef, num_threads, &expansion_sizes);
+    }
+    std::vector<uint32_t> freq(index.num_nodes, 0);
+    for (auto& t : traces) { for (int id : t) { freq[id]++; } }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    InEdges in(index);
+    std::vector<int> channel = place_nodes(index, in, freq, nc, co_access_weight, max_siblings);
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "Placement duration: " <<
+        std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() / 1000.0 << " sec" << std::endl;
+
+    std::cout << "Channel load of " << traces.size() << " queries (vector fetches per channel)" << std::endl;
+    std::cout << "Round-robin placement (node_id % " << nc << "):" << std::endl;
+    report_channel_load(traces, expansion_sizes, nc, cand_batch_size, [&](int id) { return id % nc; });
+    std::cout << "Balanced placement:" << std::endl;
+    report_channel_load(traces, expansion_sizes, nc, cand_batch_size, [&](int id) { return channel[id]; });
+
+    if (!out_dir.empty()) {
+        mkdir(out_dir.c_str(), 0755);
+        start = std::chrono::high_resolution_clock::now();
+        write_balanced_index(index, in_dir, out_dir, nc, channel, num_threads);
+        end = std::chrono::high_resolution_clock::now();
+        std::cout << "Channel-balanced FPGA index saved, duration: " <<
+            std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() / 1000.0 << " sec" << std::endl;
+    }
+
+    return 0;
+}
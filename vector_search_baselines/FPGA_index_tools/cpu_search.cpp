@@ -0,0 +1,166 @@
+// cpu_search: CPU baseline on the same FPGA-format index bytes as the kernels (cpu_search_engine.hpp),
+//   with the delayed-synchronization traversal of the kernels (mc = max_cand_per_group,
+//   mg = max_group_num_in_pipe), and inter-query parallelism over a pool of threads.
+//
+// Per (mc, mg): recall@1 / recall@10, hops (expanded candidates), visited nodes (evaluated
+//   neighbors), iterations (groups), QPS of the batch, and the mean / P95 latency of a query.
+//
+// Indexes with neighbor codes (hnsw_nsg_to_FPGA --neighbor_codes pq): --pq_slack 1.0,1.2 runs each (mc, mg)
+//   again with the neighbor code pre-filter of the intra-query kernel (see cpu_search_engine.hpp), and also
+//   reports the neighbors dropped per query (filtered) before their vectors are fetched; 0 = off.
+//
+// Example Usage:
+//   ./cpu_search --dbname SIFT1M --FPGA_index_path ../data/FPGA_hnsw/SIFT1M_MD64
+//       --query_path /mnt/scratch/wenqi/Faiss_experiments/bigann/bigann_query.bvecs
+//       --gt_path /mnt/scratch/wenqi/Faiss_experiments/bigann/gnd/idx_1M.ivecs --mc 1,2,4 --mg 1,2,4
+//
+// Ground truth: .ivecs or ibin (see load_ground_truth in dataset.hpp)
+// Optional: --num_queries 10000 --ef 64 --num_threads <hardware concurrency> --dim <from dbname>
+//   --batch_size <num_queries> (queries per engine call; the latency is measured per query in its batch)
+//   --pq_slack 0
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "FPGA_index_format.hpp"
+#include "cpu_search_engine.hpp"
+#include "dataset.hpp"
+#include "graph_search.hpp"
+
+std::vector<int> parse_int_list(const std::string& s) {
+    std::vector<int> values;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) { values.push_back(std::stoi(item)); }
+    return values;
+}
+
+std::vector<float> parse_float_list(const std::string& s) {
+    std::vector<float> values;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) { values.push_back(std::stof(item)); }
+    return values;
+}
+
+int main(int argc, char** argv) {
+
+    std::cout << "Usage: " << argv[0] << " --dbname <e.g., SIFT1M> --FPGA_index_path <in_dir> --query_path <queries> "
+        "--gt_path <.ivecs/ibin> [--mc 1,2,4] [--mg 1,2,4] [--num_queries N] [--ef EF] [--num_threads N] [--dim D] "
+        "[--batch_size N] [--pq_slack 0]" << std::endl;
+
+    std::map<std::string, std::string> args;
+    for (int i = 1; i + 1 < argc; i += 2) { args[argv[i]] = argv[i + 1]; }
+
+    std::string dbname = args.count("--dbname")? args["--dbname"] : "SIFT1M";
+    std::string in_dir = args["--FPGA_index_path"];
+    std::string query_path = args["--query_path"];
+    std::string gt_path = args["--gt_path"];
+    std::vector<int> mc_list = parse_int_list(args.count("--mc")? args["--mc"] : "1");
+    std::vector<int> mg_list = parse_int_list(args.count("--mg")? args["--mg"] : "1");
+    int num_queries = args.count("--num_queries")? std::stoi(args["--num_queries"]) : 10000;
+    int ef = args.count("--ef")? std::stoi(args["--ef"]) : 64;
+    int num_threads = args.count("--num_threads")? std::stoi(args["--num_threads"]) : std::thread::hardware_concurrency();
+    int dim = args.count("--dim")? std::stoi(args["--dim"]) : dim_from_dbname(dbname);
+    std::vector<float> pq_slack_list = parse_float_list(args.count("--pq_slack")? args["--pq_slack"] : "0");
+
+    if (in_dir.empty() || query_path.empty() || gt_path.empty()) {
+        std::cout << "Missing index, query, or ground truth path" << std::endl;
+        return -1;
+    }
+
+    FPGAIndex index(in_dir, dim);
+    DatasetReader query_reader(query_path, format_from_dbname(dbname), dim);
+    if (num_queries > (int) query_reader.num_vectors) { num_queries = query_reader.num_vectors; }
+    std::vector<std::vector<int>> gt = load_ground_truth(gt_path, num_queries);
+    if ((int) gt.size() < num_queries) { num_queries = gt.size(); }
+    std::vector<float> queries((size_t) num_queries * dim);
+    for (int q = 0; q < num_queries; q++) { query_reader.get(q, &queries[(size_t) q * dim]); }
+    std::vector<int> labels = load_result_labels(in_dir, index.num_nodes);
+    int batch_size = args.count("--batch_size")? std::stoi(args["--batch_size"]) : num_queries;
+    if (batch_size < 1) { batch_size = 1; }
+
+    ProductQuantizer pq(dim);
+    bool has_pq = index.meta.neighbor_codes == NEIGHBOR_CODES_PQ;
+    if (has_pq) { pq.load(in_dir); }
+    for (float slack : pq_slack_list) {
+        if (slack > 0 && !has_pq) {
+            std::cout << "--pq_slack needs an index with neighbor codes" << std::endl;
+            return -1;
+        }
+    }
+
+    CPUSearchEngine engine(index, num_threads);
+    std::cout << "num_nodes=" << index.num_nodes << " dim=" << dim << " num_queries=" << num_queries <<
+        " ef=" << ef << " num_threads=" << num_threads << " batch_size=" << batch_size <<
+        " distance=" << l2_sqr_simd_isa() << std::endl;
+
+    for (int mc : mc_list) {
+        for (int mg : mg_list) {
+          for (float slack : pq_slack_list) {
+            DSTParams params;
+            params.ef = ef;
+            params.mc = mc;
+            params.mg = mg;
+            params.topK = std::min(ef, 10);
+            params.pq = slack > 0? &pq : nullptr;
+            params.pq_filter_slack = slack;
+
+            std::vector<std::vector<std::pair<float, int>>> results;
+            std::vector<DSTStats> stats;
+            std::vector<std::vector<std::pair<float, int>>> batch_results;
+            std::vector<DSTStats> batch_stats;
+            std::vector<double> latency_ms;
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int b = 0; b < num_queries; b += batch_size) {
+                int nq = std::min(batch_size, num_queries - b);
+                auto batch_start = std::chrono::high_resolution_clock::now();
+                engine.search(&queries[(size_t) b * dim], nq, params, batch_results, &batch_stats);
+                auto batch_end = std::chrono::high_resolution_clock::now();
+                double ms = std::chrono::duration_cast<std::chrono::microseconds>(batch_end - batch_start).count() / 1000.0;
+                results.insert(results.end(), batch_results.begin(), batch_results.end());
+                stats.insert(stats.end(), batch_stats.begin(), batch_stats.end());
+                latency_ms.insert(latency_ms.end(), nq, ms);
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            double duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1e6;
+
+            int recall_1 = 0, recall_10 = 0;
+            double hops = 0, visited = 0, iterations = 0, filtered = 0, latency_sum = 0;
+            for (int q = 0; q < num_queries; q++) {
+                if (!results[q].empty() && !gt[q].empty() && labels[results[q][0].second] == gt[q][0]) { recall_1++; }
+                for (size_t i = 0; i < results[q].size() && i < 10; i++) {
+                    int label = labels[results[q][i].second];
+                    for (size_t j = 0; j < gt[q].size() && j < 10; j++) {
+                        if (gt[q][j] == label) { recall_10++; break; }
+                    }
+                }
+                hops += stats[q].hops;
+                visited += stats[q].visited;
+                iterations += stats[q].iterations;
+                filtered += stats[q].filtered;
+                latency_sum += latency_ms[q];
+            }
+            std::sort(latency_ms.begin(), latency_ms.end());
+            std::cout << "mc=" << mc << " mg=" << mg;
+            if (slack > 0) { std::cout << " pq_slack=" << slack << " filtered=" << filtered / num_queries; }
+            std::cout <<
+                " recall@1=" << (double) recall_1 / num_queries <<
+                " recall@10=" << (double) recall_10 / num_queries / 10 <<
+                " hops=" << hops / num_queries <<
+                " visited=" << visited / num_queries <<
+                " iterations=" << iterations / num_queries <<
+                " QPS=" << num_queries / duration <<
+                " latency mean=" << latency_sum / num_queries << " ms" <<
+                " P95=" << latency_ms[(size_t) (0.95 * (num_queries - 1))] << " ms" << std::endl;
+          }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,276 @@
+#pragma once
+
+// Multi-threaded CPU search over the FPGA index format (the same ground_links / ground_vectors bytes
+//   the kernels read), with the delayed-synchronization traversal of the kernels: up to mc candidates
+//   are expanded per group (max_cand_per_group), and up to mg groups are in flight
+//   (max_group_num_in_pipe), i.e., the candidates of a group are selected before the results of the
+//   previous mg - 1 groups are known. mc = mg = 1 is the plain best-first search of search_ground_layer.
+//
+// Used as CPU baseline on identical graph bytes (cpu_search), and as fallback when an FPGA is busy or
+//   being reset: CPUSearchEngine keeps a pool of worker threads with their own visited lists, and
+//   search() distributes a batch of queries over them.
+//
+// The distances use AVX-512 or AVX2 (+FMA) if the compiler targets them (-march=native), and the
+//   vectors and the adjacency of the next nodes are prefetched while the current ones are evaluated.
+//
+// With the neighbor codes of the index (NEIGHBOR_CODES_PQ) and DSTParams::pq, the neighbors are pre-filtered
+//   like in split_tasks_to_channels of the intra-query kernel: the approximate distance of each neighbor is
+//   looked up from its PQ code in the adjacency block, and only the neighbors within pq_filter_slack times
+//   the largest result are marked visited and re-ranked with the exact distance (their vectors fetched).
+
+#include <stdint.h>
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "FPGA_index_format.hpp"
+#include "graph_search.hpp"
+#include "pq_codec.hpp"
+
+inline float l2_sqr_simd(const float* a, const float* b, int dim) {
+    float dist = 0;
+    int d = 0;
+#if defined(__AVX512F__)
+    __m512 sum = _mm512_setzero_ps();
+    for (; d + 16 <= dim; d += 16) {
+        __m512 diff = _mm512_sub_ps(_mm512_loadu_ps(a + d), _mm512_loadu_ps(b + d));
+        sum = _mm512_fmadd_ps(diff, diff, sum);
+    }
+    // through memory rather than _mm512_reduce_add_ps, which trips -Wmaybe-uninitialized in GCC 12
+    alignas(64) float lanes[16];
+    _mm512_store_ps(lanes, sum);
+    for (int i = 0; i < 16; i++) { dist += lanes[i]; }
+#elif defined(__AVX2__)
+    __m256 sum = _mm256_setzero_ps();
+    for (; d + 8 <= dim; d += 8) {
+        __m256 diff = _mm256_sub_ps(_mm256_loadu_ps(a + d), _mm256_loadu_ps(b + d));
+#if defined(__FMA__)
+        sum = _mm256_fmadd_ps(diff, diff, sum);
+#else
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(diff, diff));
+#endif
+    }
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    dist = _mm_cvtss_f32(s);
+#endif
+    for (; d < dim; d++) {
+        float diff = a[d] - b[d];
+        dist += diff * diff;
+    }
+    return dist;
+}
+
+inline const char* l2_sqr_simd_isa() {
+#if defined(__AVX512F__)
+    return "AVX-512";
+#elif defined(__AVX2__)
+    return "AVX2";
+#else
+    return "scalar";
+#endif
+}
+
+struct DSTParams {
+    int ef = 64;
+    int mc = 1; // max_cand_per_group
+    int mg = 1; // max_group_num_in_pipe
+    int topK = 10;
+    const ProductQuantizer* pq = nullptr; // neighbor code pre-filter, nullptr = off
+    float pq_filter_slack = 1.0f;
+};
+
+struct DSTStats {
+    int hops = 0; // expanded candidates
+    int visited = 0; // evaluated neighbors (vectors fetched)
+    int iterations = 0; // groups
+    int filtered = 0; // neighbors dropped by the neighbor code pre-filter
+};
+
+// Searches one query on the calling thread; returns up to topK (distance, node ID) sorted by distance.
+//   entry_point < 0: the entry point of meta.bin (e.g., the result of an upper layer descent otherwise).
+std::vector<std::pair<float, int>> search_dst(const FPGAIndex& index, const float* query, const DSTParams& params,
+    VisitedList& visited, DSTStats* stats = nullptr, int entry_point = -1) {
+
+    typedef std::pair<float, int> dist_id;
+    std::priority_queue<dist_id, std::vector<dist_id>, std::greater<dist_id>> candidates; // min-heap
+    std::priority_queue<dist_id> results; // max-heap of the best ef
+    std::deque<std::vector<int>> groups_in_flight;
+    std::vector<int> to_evaluate;
+    const size_t prefetch_distance = 4;
+    thread_local std::vector<float> pq_lut;
+    if (params.pq) {
+        pq_lut.resize((size_t) params.pq->M * ProductQuantizer::num_centroids);
+        params.pq->compute_lut(query, pq_lut.data());
+    }
+
+    visited.reset();
+    int ep = entry_point >= 0? entry_point : index.meta.entry_point;
+    visited.visit(ep);
+    float dist_ep = l2_sqr_simd(query, index.vector(ep), index.dim);
+    candidates.emplace(dist_ep, ep);
+    results.emplace(dist_ep, ep);
+    DSTStats st;
+    st.visited = 1;
+
+    // largest result once the queue is full, as known when the groups are issued
+    float threshold = params.ef > 1? std::numeric_limits<float>::max() : dist_ep;
+    while (true) {
+        // issue groups until mg are in flight
+        while ((int) groups_in_flight.size() < params.mg) {
+            std::vector<int> group;
+            while ((int) group.size() < params.mc && !candidates.empty() && candidates.top().first <= threshold) {
+                group.push_back(candidates.top().second);
+                candidates.pop();
+                index.prefetch_links(group.back());
+            }
+            if (group.empty()) { break; }
+            st.hops += group.size();
+            st.iterations++;
+            groups_in_flight.push_back(std::move(group));
+        }
+        if (groups_in_flight.empty()) { break; }
+
+        // the oldest group completes
+        to_evaluate.clear();
+        for (int cand : groups_in_flight.front()) {
+            uint32_t n = index.num_links(cand);
+            const uint32_t* links = index.links(cand);
+            const uint8_t* codes = params.pq? index.neighbor_codes(cand) : nullptr;
+            for (uint32_t j = 0; j < n; j++) {
+                // filtered neighbors stay unvisited, such that a later expansion may still evaluate them
+                if (codes && params.pq->adc(pq_lut.data(), codes + j * params.pq->M) > params.pq_filter_slack * threshold) {
+                    st.filtered++;
+                    continue;
+                }
+                if (visited.visit(links[j])) {
+                    to_evaluate.push_back(links[j]);
+                    if (to_evaluate.size() <= prefetch_distance) { index.prefetch_vector(links[j]); }
+                }
+            }
+        }
+        groups_in_flight.pop_front();
+        st.visited += to_evaluate.size();
+        for (size_t i = 0; i < to_evaluate.size(); i++) {
+            if (i + prefetch_distance < to_evaluate.size()) { index.prefetch_vector(to_evaluate[i + prefetch_distance]); }
+            int nb = to_evaluate[i];
+            float dist = l2_sqr_simd(query, index.vector(nb), index.dim);
+            if ((int) results.size() < params.ef || dist < results.top().first) {
+                candidates.emplace(dist, nb);
+                results.emplace(dist, nb);
+                if ((int) results.size() > params.ef) { results.pop(); }
+            }
+        }
+        if ((int) results.size() >= params.ef) { threshold = results.top().first; }
+    }
+    if (stats) { *stats = st; }
+
+    while ((int) results.size() > params.topK) { results.pop(); }
+    std::vector<dist_id> out(results.size());
+    for (int i = (int) out.size() - 1; i >= 0; i--) { out[i] = results.top(); results.pop(); }
+    return out;
+}
+
+// Pool of search threads over one index; search() blocks until the batch is done, and is not meant
+//   to be called concurrently from several threads.
+class CPUSearchEngine {
+
+public:
+
+    CPUSearchEngine(const FPGAIndex& index, int num_threads) : index(index) {
+        for (int t = 0; t < num_threads; t++) { workers.emplace_back([this] { worker_loop(); }); }
+    }
+
+    ~CPUSearchEngine() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        cv_start.notify_all();
+        for (auto& t : workers) { t.join(); }
+    }
+
+    int num_threads() const { return workers.size(); }
+
+    // queries: nq x dim; results[q]: up to topK (distance, node ID); stats and entry_points are optional
+    void search(const float* queries, size_t nq, const DSTParams& params,
+        std::vector<std::vector<std::pair<float, int>>>& results,
+        std::vector<DSTStats>* stats = nullptr, const int* entry_points = nullptr) {
+
+        results.assign(nq, std::vector<std::pair<float, int>>());
+        if (stats) { stats->assign(nq, DSTStats()); }
+        std::unique_lock<std::mutex> lock(mutex);
+        task = [&, queries, entry_points](size_t q, VisitedList& visited) {
+            results[q] = search_dst(index, queries + q * index.dim, params, visited,
+                stats? &(*stats)[q] : nullptr, entry_points? entry_points[q] : -1);
+        };
+        num_tasks = nq;
+        next_task = 0;
+        num_done = 0;
+        batch_id++;
+        cv_start.notify_all();
+        // also wait for the workers that joined the batch late, such that none runs this task later; workers
+        //   only join while the batch is unfinished, i.e., before this returns
+        cv_done.wait(lock, [&] { return num_done == num_tasks && num_active == 0; });
+        task = nullptr;
+    }
+
+private:
+
+    const FPGAIndex& index;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable cv_start;
+    std::condition_variable cv_done;
+    std::function<void(size_t, VisitedList&)> task;
+    size_t num_tasks = 0;
+    std::atomic<size_t> next_task{0};
+    size_t num_done = 0;
+    int num_active = 0;
+    uint64_t batch_id = 0;
+    bool stop = false;
+
+    void worker_loop() {
+        VisitedList visited(index.num_nodes);
+        uint64_t seen_batch = 0;
+        while (true) {
+            std::function<void(size_t, VisitedList&)> local_task;
+            size_t n;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv_start.wait(lock, [&] { return stop || batch_id != seen_batch; });
+                if (stop) { return; }
+                seen_batch = batch_id;
+                // a worker waking up after search() has returned must not join: the next search() may reset
+                //   next_task while it is still counting with the old batch (and its cleared task)
+                if (num_done == num_tasks) { continue; }
+                local_task = task;
+                n = num_tasks;
+                num_active++;
+            }
+            size_t done = 0;
+            while (true) {
+                size_t q = next_task.fetch_add(1);
+                if (q >= n) { break; }
+                local_task(q, visited);
+                done++;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            num_done += done;
+            num_active--;
+            if (num_done == num_tasks && num_active == 0) { cv_done.notify_all(); }
+        }
+    }
+};
@@ -0,0 +1,109 @@
+#pragma once
+
+// Memory-mapped raw dataset files, converted to float on access, following scripts_nsg/utils.py:
+//   bvecs (SIFT): per vector [dim (4B int), dim x uint8]
+//   fbin (Deep, GLOVE): [num_vectors (4B), dim (4B)], then num_vectors x dim x float32
+//   i8bin (SPACEV): [num_vectors (4B), dim (4B)], then num_vectors x dim x int8
+//   raw_fvecs (SBERT): num_vectors x dim x float32, no header
+
+#include <stdint.h>
+#include <string>
+#include <iostream>
+
+#include "FPGA_index_format.hpp"
+
+enum DatasetFormat { BVECS, FBIN, I8BIN, RAW_FVECS };
+
+// same dataset naming as the python scripts, e.g., SIFT10M, Deep1M, SPACEV10M
+int dim_from_dbname(const std::string& dbname) {
+    if (dbname.find("SIFT") != std::string::npos) { return 128; }
+    else if (dbname.find("Deep") != std::string::npos) { return 96; }
+    else if (dbname.find("GLOVE") != std::string::npos) { return 300; }
+    else if (dbname.find("SBERT") != std::string::npos) { return 384; }
+    else if (dbname.find("SPACEV") != std::string::npos) { return 100; }
+    std::cout << "Unsupported database name " << dbname << std::endl;
+    exit(EXIT_FAILURE);
+}
+
+DatasetFormat format_from_dbname(const std::string& dbname) {
+    if (dbname.find("SIFT") != std::string::npos) { return BVECS; }
+    else if (dbname.find("Deep") != std::string::npos || dbname.find("GLOVE") != std::string::npos) { return FBIN; }
+    else if (dbname.find("SBERT") != std::string::npos) { return RAW_FVECS; }
+    else if (dbname.find("SPACEV") != std::string::npos) { return I8BIN; }
+    std::cout << "Unsupported database name " << dbname << std::endl;
+    exit(EXIT_FAILURE);
+}
+
+class DatasetReader {
+
+public:
+
+    DatasetFormat format;
+    int dim;
+    size_t num_vectors; // available in the file (the index may use a prefix of it)
+
+    DatasetReader(const std::string& fname, DatasetFormat format, int dim) :
+        format(format), dim(dim), file(fname) {
+
+        if (format == BVECS) {
+            bytes_per_vector = 4 + dim;
+            header_bytes = 4; // per vector
+            num_vectors = file.bytes / bytes_per_vector;
+        } else if (format == FBIN || format == I8BIN) {
+            size_t elem_bytes = format == FBIN? sizeof(float) : sizeof(int8_t);
+            bytes_per_vector = dim * elem_bytes;
+            header_bytes = 0;
+            int file_dim = ((const int*) file.data)[1];
+            if (file_dim != dim) {
+                std::cout << "Dimension mismatch: " << file_dim << " in file, expected " << dim << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            num_vectors = (file.bytes - 8) / bytes_per_vector;
+        } else {
+            bytes_per_vector = dim * sizeof(float);
+            header_bytes = 0;
+            num_vectors = file.bytes / bytes_per_vector;
+        }
+    }
+
+    void get(size_t i, float* out) const {
+        if (format == BVECS) {
+            const uint8_t* v = (const uint8_t*) (file.data + i * bytes_per_vector + header_bytes);
+            for (int d = 0; d < dim; d++) { out[d] = (float) v[d]; }
+        } else if (format == FBIN) {
+            memcpy(out, file.data + 8 + i * bytes_per_vector, bytes_per_vector);
+        } else if (format == I8BIN) {
+            const int8_t* v = (const int8_t*) (file.data + 8 + i * bytes_per_vector);
+            for (int d = 0; d < dim; d++) { out[d] = (float) v[d]; }
+        } else {
+            memcpy(out, file.data + i * bytes_per_vector, bytes_per_vector);
+        }
+    }
+
+private:
+
+    MappedInput file;
+    size_t bytes_per_vector;
+    size_t header_bytes;
+};
+
+// ground truth IDs, k per query, of the first num_queries queries:
+//   .ivecs: per query [k (4B int), k x 4B IDs]; ibin: [num_queries (4B), k (4B)], then the IDs
+std::vector<std::vector<int>> load_ground_truth(const std::string& fname, int num_queries) {
+    MappedInput file(fname);
+    const int* ids = (const int*) file.data;
+    std::vector<std::vector<int>> gt;
+    bool is_ivecs = fname.size() > 6 && fname.substr(fname.size() - 6) == ".ivecs";
+    if (is_ivecs) {
+        size_t pos = 0;
+        while (pos < file.bytes / sizeof(int) && (int) gt.size() < num_queries) {
+            int k = ids[pos];
+            gt.emplace_back(ids + pos + 1, ids + pos + 1 + k);
+            pos += 1 + k;
+        }
+    } else {
+        int n = ids[0], k = ids[1];
+        for (int q = 0; q < n && q < num_queries; q++) { gt.emplace_back(ids + 2 + (size_t) q * k, ids + 2 + (size_t) (q + 1) * k); }
+    }
+    return gt;
+}
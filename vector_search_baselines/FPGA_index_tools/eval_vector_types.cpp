@@ -0,0 +1,134 @@
+// eval_vector_types: recall and throughput of the reduced-precision vector formats (fp16, int8, see
+//   vector_codec.hpp) against fp32 on the same graph, before building the corresponding bitstreams.
+//
+// The fp32 ground layer of an FPGA-format index is encoded in memory to each format, and the queries
+//   are searched with the same best-first search (search_ground_layer_with), using the CPU reference
+//   of compute_distances_sub_PE_A<VECTOR_TYPE> as distance, i.e., the distances the kernel computes.
+//   Per format, the report shows recall@1 / recall@10 against the ground truth, the CPU QPS, the
+//   512-bit words fetched per vector, and the vector bytes fetched from DRAM per query.
+//
+// Example Usage:
+//   ./eval_vector_types --dbname SIFT1M --FPGA_index_path ../data/FPGA_hnsw/SIFT1M_MD64
+//       --query_path /mnt/scratch/wenqi/Faiss_experiments/bigann/bigann_query.bvecs
+//       --gt_path /mnt/scratch/wenqi/Faiss_experiments/bigann/gnd/idx_1M.ivecs
+//
+// Ground truth: .ivecs or ibin (see load_ground_truth in dataset.hpp)
+// Optional: --num_queries 10000 --ef 64 --vector_types fp32,fp16,int8 --num_threads <hardware concurrency>
+//   --dim <from dbname>
+
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "FPGA_index_format.hpp"
+#include "dataset.hpp"
+#include "graph_search.hpp"
+#include "vector_codec.hpp"
+
+int main(int argc, char** argv) {
+
+    std::cout << "Usage: " << argv[0] << " --dbname <e.g., SIFT1M> --FPGA_index_path <in_dir> --query_path <queries> "
+        "--gt_path <.ivecs/ibin> [--num_queries N] [--ef EF] [--vector_types fp32,fp16,int8] [--num_threads N] [--dim D]" << std::endl;
+
+    std::map<std::string, std::string> args;
+    for (int i = 1; i + 1 < argc; i += 2) { args[argv[i]] = argv[i + 1]; }
+
+    std::string dbname = args.count("--dbname")? args["--dbname"] : "SIFT1M";
+    std::string in_dir = args["--FPGA_index_path"];
+    std::string query_path = args["--query_path"];
+    std::string gt_path = args["--gt_path"];
+    int num_queries = args.count("--num_queries")? std::stoi(args["--num_queries"]) : 10000;
+    int ef = args.count("--ef")? std::stoi(args["--ef"]) : 64;
+    std::string vector_types_str = args.count("--vector_types")? args["--vector_types"] : "fp32,fp16,int8";
+    int num_threads = args.count("--num_threads")? std::stoi(args["--num_threads"]) : std::thread::hardware_concurrency();
+    int dim = args.count("--dim")? std::stoi(args["--dim"]) : dim_from_dbname(dbname);
+
+    if (in_dir.empty() || query_path.empty() || gt_path.empty()) {
+        std::cout << "Missing index, query, or ground truth path" << std::endl;
+        return -1;
+    }
+
+    FPGAIndex index(in_dir, dim);
+    DatasetReader query_reader(query_path, format_from_dbname(dbname), dim);
+    if (num_queries > (int) query_reader.num_vectors) { num_queries = query_reader.num_vectors; }
+    std::vector<float> queries((size_t) num_queries * dim);
+    for (int q = 0; q < num_queries; q++) { query_reader.get(q, &queries[(size_t) q * dim]); }
+    std::vector<std::vector<int>> gt = load_ground_truth(gt_path, num_queries);
+    if ((int) gt.size() < num_queries) { num_queries = gt.size(); }
+
+    std::vector<int> labels = load_result_labels(in_dir, index.num_nodes);
+    std::cout << "num_nodes=" << index.num_nodes << " dim=" << dim << " num_queries=" << num_queries <<
+        " ef=" << ef << " num_threads=" << num_threads << std::endl;
+
+    std::stringstream ss(vector_types_str);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        VectorType t = parse_vector_type(item);
+
+        // encode the database, and the queries as sent by the host
+        Int8Quantizer quantizer(dim);
+        if (t == VECTOR_INT8) {
+            quantizer.train(index.num_nodes, [&](size_t i, float* out) { memcpy(out, index.vector(i), dim * sizeof(float)); }, num_threads);
+        }
+        size_t bytes_per_vec = bytes_per_typed_vector(dim, t);
+        std::vector<char> db(index.num_nodes * bytes_per_vec);
+        parallel_for(index.num_nodes, num_threads, [&](size_t i) {
+            encode_typed_vector(index.vector(i), dim, t, &quantizer, &db[i * bytes_per_vec]);
+        });
+        std::vector<float> queries_sent(queries);
+        std::vector<float> weights((size_t) num_queries * dim, 1);
+        if (t == VECTOR_INT8) {
+            for (int q = 0; q < num_queries; q++) {
+                quantizer.transform_query(&queries[(size_t) q * dim], &queries_sent[(size_t) q * dim], &weights[(size_t) q * dim]);
+            }
+        }
+
+        std::vector<std::vector<std::pair<float, int>>> results(num_queries);
+        std::vector<size_t> num_evaluated(num_queries);
+        auto start = std::chrono::high_resolution_clock::now();
+        parallel_for(num_queries, num_threads, [&](size_t q) {
+            thread_local std::unique_ptr<VisitedList> visited; // freed at thread exit
+            thread_local std::vector<int> trace;
+            if (!visited) { visited.reset(new VisitedList(index.num_nodes)); }
+            const float* query = &queries_sent[q * dim];
+            const float* w = &weights[q * dim];
+            trace.clear();
+            auto search = [&](auto dist_to) { return search_ground_layer_with(index, dist_to, ef, *visited, &trace); };
+            if (t == VECTOR_FP32) {
+                results[q] = search([&](size_t i) { return typed_l2_sqr<VECTOR_FP32>(query, w, &db[i * bytes_per_vec], dim); });
+            } else if (t == VECTOR_FP16) {
+                results[q] = search([&](size_t i) { return typed_l2_sqr<VECTOR_FP16>(query, w, &db[i * bytes_per_vec], dim); });
+            } else {
+                results[q] = search([&](size_t i) { return typed_l2_sqr<VECTOR_INT8>(query, w, &db[i * bytes_per_vec], dim); });
+            }
+            num_evaluated[q] = trace.size();
+        });
+        auto end = std::chrono::high_resolution_clock::now();
+        double duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1e6;
+
+        int recall_1 = 0, recall_10 = 0;
+        size_t total_evaluated = 0;
+        for (int q = 0; q < num_queries; q++) {
+            total_evaluated += num_evaluated[q];
+            if (!results[q].empty() && !gt[q].empty() && labels[results[q][0].second] == gt[q][0]) { recall_1++; }
+            for (size_t i = 0; i < results[q].size() && i < 10; i++) {
+                int label = labels[results[q][i].second];
+                for (size_t j = 0; j < gt[q].size() && j < 10; j++) {
+                    if (gt[q][j] == label) { recall_10++; break; }
+                }
+            }
+        }
+        double evaluated_per_query = (double) total_evaluated / num_queries;
+        std::cout << vector_type_name(t) << ": recall@1=" << (double) recall_1 / num_queries <<
+            " recall@10=" << (double) recall_10 / num_queries / 10 <<
+            " QPS=" << num_queries / duration <<
+            " words/vector=" << bytes_per_vec / BYTES_PER_AXI <<
+            " vectors/query=" << evaluated_per_query <<
+            " vector bytes/query=" << evaluated_per_query * bytes_per_vec << std::endl;
+    }
+
+    return 0;
+}
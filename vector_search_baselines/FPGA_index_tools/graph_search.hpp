@@ -0,0 +1,273 @@
+#pragma once
+
+// In-memory view of an FPGA-format index (the 1-channel ground layer files) and a
+//   best-first search over its ground layer, following the FPGA kernels: the search
+//   starts from the entry point in meta.bin, and every unvisited neighbor is fetched
+//   and evaluated (a "neighbor access" in the eval_trace kernels).
+
+#include <stdint.h>
+#include <math.h>
+
+#include <algorithm>
+#include <memory>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "FPGA_index_format.hpp"
+#include "dataset.hpp"
+
+class FPGAIndex {
+
+public:
+
+    FPGAIndexMeta meta;
+    int dim;
+    size_t num_nodes;
+    size_t bytes_per_links;
+    size_t bytes_per_vector;
+
+    FPGAIndex(const std::string& index_dir, int dim) :
+        meta(index_dir), dim(dim),
+        links_file(fpga_index::concat_dir(index_dir, ground_links_fname(1, 0)), false),
+        vectors_file(fpga_index::concat_dir(index_dir, ground_vectors_fname(1, 0)), false) {
+
+        if (meta.vector_type != VECTOR_FP32) {
+            // vector() returns 4B floats, the fp16 / int8 formats are decoded by vector_codec.hpp only
+            std::cout << "FPGAIndex: " << index_dir << " stores fp16 / int8 vectors, only fp32 indexes are supported" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        num_nodes = meta.num_nodes;
+        bytes_per_links = bytes_per_ground_links(meta.max_link_num_base, meta.link_layout, meta.code_bytes());
+        links_offset = meta.link_layout == LINK_LAYOUT_PACKED? sizeof(uint32_t) : BYTES_PER_AXI;
+        bytes_per_vector = bytes_per_ground_vector(dim, meta.vector_layout);
+        if (links_file.bytes != num_nodes * bytes_per_links || vectors_file.bytes != num_nodes * bytes_per_vector) {
+            std::cout << "FPGAIndex: file sizes do not match meta.bin, wrong dim?" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // number of valid links, i.e., min(stored count, max degree)
+    uint32_t num_links(size_t i) const {
+        uint32_t n = *(const uint32_t*) (links_file.data + i * bytes_per_links);
+        return n < (uint32_t) meta.max_link_num_base? n : meta.max_link_num_base;
+    }
+
+    uint32_t stored_link_count(size_t i) const {
+        return *(const uint32_t*) (links_file.data + i * bytes_per_links);
+    }
+
+    const uint32_t* links(size_t i) const {
+        return (const uint32_t*) (links_file.data + i * bytes_per_links + links_offset);
+    }
+
+    // NEIGHBOR_CODES_PQ: meta.pq_m bytes per link, in link order
+    const uint8_t* neighbor_codes(size_t i) const {
+        return (const uint8_t*) (links_file.data + i * bytes_per_links +
+            populated_link_words(num_links(i), meta.max_link_num_base, meta.link_layout) * BYTES_PER_AXI);
+    }
+
+    const float* vector(size_t i) const {
+        return (const float*) (vectors_file.data + i * bytes_per_vector);
+    }
+
+    // software prefetch of a node's adjacency / first cache lines of its vector (cpu_search_engine.hpp)
+    void prefetch_links(size_t i) const {
+        const char* p = links_file.data + i * bytes_per_links;
+        __builtin_prefetch(p, 0, 3);
+        __builtin_prefetch(p + links_offset, 0, 3);
+    }
+
+    void prefetch_vector(size_t i) const {
+        const char* p = vectors_file.data + i * bytes_per_vector;
+        for (size_t off = 0; off < bytes_per_vector && off < 4 * 64; off += 64) { __builtin_prefetch(p + off, 0, 3); }
+    }
+
+private:
+
+    size_t links_offset;
+    MappedInput links_file;
+    MappedInput vectors_file;
+};
+
+// node ID -> label, to compare search results against the ground truth: ground_labels.bin
+//   (HNSW, or reordered NSG), or the node IDs themselves
+std::vector<int> load_result_labels(const std::string& index_dir, size_t num_nodes) {
+    std::vector<int> labels(num_nodes);
+    std::string fname_labels = fpga_index::concat_dir(index_dir, "ground_labels.bin");
+    struct stat stat_buf;
+    if (stat(fname_labels.c_str(), &stat_buf) == 0 && stat_buf.st_size > 0) {
+        MappedInput labels_file(fname_labels);
+        memcpy(labels.data(), labels_file.data, num_nodes * sizeof(int));
+    } else {
+        for (size_t i = 0; i < num_nodes; i++) { labels[i] = i; }
+    }
+    return labels;
+}
+
+float l2_sqr(const float* a, const float* b, int dim) {
+    float dist = 0;
+    for (int d = 0; d < dim; d++) {
+        float diff = a[d] - b[d];
+        dist += diff * diff;
+    }
+    return dist;
+}
+
+// Visited set that is reset in O(1) by bumping the epoch, one per search thread
+class VisitedList {
+
+public:
+
+    VisitedList(size_t num_nodes) : tags(num_nodes, 0) {}
+
+    void reset() {
+        epoch++;
+        if (epoch == 0) { std::fill(tags.begin(), tags.end(), 0); epoch = 1; }
+    }
+
+    // returns true if i was not visited before
+    bool visit(size_t i) {
+        if (tags[i] == epoch) { return false; }
+        tags[i] = epoch;
+        return true;
+    }
+
+private:
+
+    std::vector<uint32_t> tags;
+    uint32_t epoch = 0;
+};
+
+// Best-first search on the ground layer with a result queue of size ef; returns the
+//   (distance, node ID) results sorted by distance. dist_to(i) is the query's distance to node i.
+//   If trace is not null, the IDs of all evaluated neighbors are appended in access order; if
+//   expansion_sizes is not null, the number of neighbors evaluated per expanded candidate
+//   (one kernel iteration) is appended; if expanded is not null, the IDs of the expanded
+//   candidates (one adjacency fetch each) are appended.
+template<typename DistFn>
+std::vector<std::pair<float, int>> search_ground_layer_with(
+    const FPGAIndex& index, const DistFn& dist_to, int ef, VisitedList& visited,
+    std::vector<int>* trace = nullptr, int* num_hops = nullptr, std::vector<int>* expansion_sizes = nullptr,
+    std::vector<int>* expanded = nullptr) {
+
+    typedef std::pair<float, int> dist_id;
+    std::priority_queue<dist_id, std::vector<dist_id>, std::greater<dist_id>> candidates; // min-heap
+    std::priority_queue<dist_id> results; // max-heap of the best ef
+
+    visited.reset();
+    int ep = index.meta.entry_point;
+    visited.visit(ep);
+    float dist_ep = dist_to(ep);
+    candidates.emplace(dist_ep, ep);
+    results.emplace(dist_ep, ep);
+    if (trace) { trace->push_back(ep); }
+
+    int hops = 0;
+    while (!candidates.empty()) {
+        dist_id cur = candidates.top();
+        if (cur.first > results.top().first && (int) results.size() >= ef) { break; }
+        candidates.pop();
+        hops++;
+        if (expanded) { expanded->push_back(cur.second); }
+
+        uint32_t n = index.num_links(cur.second);
+        const uint32_t* links = index.links(cur.second);
+        int num_evaluated = 0;
+        for (uint32_t j = 0; j < n; j++) {
+            int nb = links[j];
+            if (!visited.visit(nb)) { continue; }
+            num_evaluated++;
+            if (trace) { trace->push_back(nb); }
+            float dist = dist_to(nb);
+            if ((int) results.size() < ef || dist < results.top().first) {
+                candidates.emplace(dist, nb);
+                results.emplace(dist, nb);
+                if ((int) results.size() > ef) { results.pop(); }
+            }
+        }
+        if (expansion_sizes) { expansion_sizes->push_back(num_evaluated); }
+    }
+    if (num_hops) { *num_hops = hops; }
+
+    std::vector<dist_id> out(results.size());
+    for (int i = (int) out.size() - 1; i >= 0; i--) { out[i] = results.top(); results.pop(); }
+    return out;
+}
+
+// search_ground_layer_with on the fp32 vectors of the index
+std::vector<std::pair<float, int>> search_ground_layer(
+    const FPGAIndex& index, const float* query, int ef, VisitedList& visited,
+    std::vector<int>* trace = nullptr, int* num_hops = nullptr, std::vector<int>* expansion_sizes = nullptr,
+    std::vector<int>* expanded = nullptr) {
+    return search_ground_layer_with(index, [&](size_t i) { return l2_sqr(query, index.vector(i), index.dim); },
+        ef, visited, trace, num_hops, expansion_sizes, expanded);
+}
+
+// In-neighbors in CSR format
+struct InEdges {
+    std::vector<size_t> offsets;
+    std::vector<uint32_t> ids;
+
+    InEdges(const FPGAIndex& index) : offsets(index.num_nodes + 1, 0) {
+        for (size_t i = 0; i < index.num_nodes; i++) {
+            const uint32_t* links = index.links(i);
+            for (uint32_t j = 0; j < index.num_links(i); j++) { offsets[links[j] + 1]++; }
+        }
+        for (size_t i = 0; i < index.num_nodes; i++) { offsets[i + 1] += offsets[i]; }
+        ids.resize(offsets.back());
+        std::vector<size_t> pos(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < index.num_nodes; i++) {
+            const uint32_t* links = index.links(i);
+            for (uint32_t j = 0; j < index.num_links(i); j++) { ids[pos[links[j]]++] = i; }
+        }
+    }
+
+    size_t degree(size_t i) const { return offsets[i + 1] - offsets[i]; }
+};
+
+// Per query: -1, node IDs, -2 (eval_trace_FPGA_inter_query_v1.3 per_query_ids_*.int)
+std::vector<std::vector<int>> load_traces(const std::string& fname) {
+    MappedInput file(fname);
+    const int* ids = (const int*) file.data;
+    size_t num = file.bytes / sizeof(int);
+    std::vector<std::vector<int>> traces;
+    for (size_t i = 0; i < num; i++) {
+        if (ids[i] == -1) { traces.emplace_back(); }
+        else if (ids[i] != -2 && !traces.empty()) { traces.back().push_back(ids[i]); }
+    }
+    return traces;
+}
+
+void save_traces(const std::string& fname, const std::vector<std::vector<int>>& traces) {
+    std::vector<int> ids;
+    for (auto& t : traces) {
+        ids.push_back(-1);
+        ids.insert(ids.end(), t.begin(), t.end());
+        ids.push_back(-2);
+    }
+    write_file(fname, (const char*) ids.data(), ids.size() * sizeof(int));
+}
+
+// Search the first num_queries queries and return their traces, optionally with the
+//   per-iteration expansion sizes (see search_ground_layer)
+std::vector<std::vector<int>> replay_traces(const FPGAIndex& index, const std::string& query_path,
+    const std::string& dbname, int num_queries, int ef, int num_threads,
+    std::vector<std::vector<int>>* expansion_sizes = nullptr) {
+
+    DatasetReader queries(query_path, format_from_dbname(dbname), index.dim);
+    if (num_queries > (int) queries.num_vectors) { num_queries = queries.num_vectors; }
+    std::vector<std::vector<int>> traces(num_queries);
+    if (expansion_sizes) { expansion_sizes->assign(num_queries, std::vector<int>()); }
+    parallel_for(num_queries, num_threads, [&](size_t q) {
+        thread_local std::unique_ptr<VisitedList> visited; // freed at thread exit
+        thread_local std::vector<float> query;
+        if (!visited) { visited.reset(new VisitedList(index.num_nodes)); }
+        query.resize(index.dim);
+        queries.get(q, query.data());
+        search_ground_layer(index, query.data(), ef, *visited, &traces[q], nullptr,
+            expansion_sizes? &(*expansion_sizes)[q] : nullptr);
+    });
+    return traces;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+// Software stand-in for hls::stream in the dataflow models (intra_query_pipeline_model): a bounded
+//   single-producer single-consumer FIFO between two stage threads, blocking on read when empty and
+//   on write when full, as the FIFOs between the PEs of the kernels.
+//
+// Every element carries the simulated cycle at which the producer stage emitted it. Each stage thread
+//   keeps its own cycle counter (stage_cycle), which advances to the element's cycle on read, such that
+//   the cycle estimates follow the data dependencies between the stages rather than the scheduling of
+//   the threads on the host. The stages add their own costs to stage_cycle (see the cost model).
+
+#include <stdint.h>
+
+#include <atomic>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace sim {
+
+// simulated cycle of the calling stage thread
+thread_local uint64_t stage_cycle = 0;
+
+template<typename T>
+class stream {
+
+public:
+
+    stream(size_t depth = 4096) {
+        size_t capacity = 1;
+        while (capacity < depth) { capacity <<= 1; }
+        buf.resize(capacity);
+        mask = capacity - 1;
+    }
+
+    stream(const stream&) = delete;
+    stream& operator=(const stream&) = delete;
+
+    bool empty() const { return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire); }
+
+    bool full() const { return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire) > mask; }
+
+    // emitted at the current cycle of the stage
+    void write(const T& v) { write_at(v, stage_cycle); }
+
+    // emitted at the given cycle, e.g., the completion cycle of a pipelined unit of the stage
+    void write_at(const T& v, uint64_t cycle) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        for (int spin = 0; t - head.load(std::memory_order_acquire) > mask; spin++) { backoff(spin); }
+        buf[t & mask] = std::make_pair(v, cycle);
+        tail.store(t + 1, std::memory_order_release);
+    }
+
+    T read() {
+        size_t h = head.load(std::memory_order_relaxed);
+        for (int spin = 0; h == tail.load(std::memory_order_acquire); spin++) { backoff(spin); }
+        std::pair<T, uint64_t> e = buf[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        if (e.second > stage_cycle) { stage_cycle = e.second; }
+        return e.first;
+    }
+
+private:
+
+    static void backoff(int spin) {
+        if (spin > 64) { std::this_thread::yield(); }
+    }
+
+    std::vector<std::pair<T, uint64_t>> buf;
+    size_t mask;
+    std::atomic<size_t> head{0};
+    std::atomic<size_t> tail{0};
+};
+
+} // namespace sim
@@ -0,0 +1,317 @@
+// hnsw_nsg_to_FPGA: convert a hnswlib (.bin) or NSG (.nsg) index to the FPGA format,
+//   writing byte-identical files to scripts_hnsw/hnsw_to_FPGA.py and scripts_nsg/nsg_to_FPGA.py,
+//   but in one parallel pass over memory-mapped inputs with bounded memory.
+//
+// Example Usage:
+//   ./hnsw_nsg_to_FPGA --graph_type HNSW --dbname SIFT10M
+//       --CPU_index_path ../data/CPU_hnsw_indexes/SIFT10M_index_MD64.bin --FPGA_index_path ../data/FPGA_hnsw/SIFT10M_MD64
+//   ./hnsw_nsg_to_FPGA --graph_type NSG --dbname SIFT10M
+//       --CPU_index_path ../data/CPU_NSG_index/SIFT10M_index_MD64.nsg --FPGA_index_path ../data/FPGA_NSG/SIFT10M_MD64
+//       --dataset_path /mnt/scratch/wenqi/Faiss_experiments/bigann/bigann_base.bvecs
+//
+// Optional: --num_channels 1,2,4,8,16 (default) --num_threads <hardware concurrency> --dim <from dbname>
+//   --vector_type fp32 (default) / fp16 / int8 (see vector_codec.hpp, VECTOR_TYPE in the kernels)
+//   --vector_layout padded (default, with the 64B visited padding) / compact (see FPGA_index_format.hpp)
+//   --link_layout original (default, 64B header) / packed (count + links, see FPGA_index_format.hpp)
+//   --neighbor_codes none (default) / pq (the PQ codes of the neighbors follow the links, see pq_codec.hpp)
+//   --pq_m 16 (code bytes per neighbor, has to divide 64 and match PQ_M in the kernels)
+
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "FPGA_index_format.hpp"
+#include "dataset.hpp"
+#include "pq_codec.hpp"
+#include "vector_codec.hpp"
+
+// hnswlib .bin header: https://github.com/WenqiJiang/hnswlib-eval/blob/master/hnswlib/hnswalg.h#L588-L616
+struct HNSWHeader {
+    uint64_t offsetLevel0_;
+    uint64_t max_elements_;
+    uint64_t cur_element_count;
+    uint64_t size_data_per_element_;
+    uint64_t label_offset_;
+    uint64_t offsetData_;
+    int32_t maxlevel_;
+    int32_t enterpoint_node_;
+    uint64_t maxM_;
+    uint64_t maxM0_;
+    uint64_t M_;
+    double mult_;
+    uint64_t ef_construction_;
+};
+static_assert(sizeof(HNSWHeader) == 96, "hnswlib header is 96 bytes");
+
+// int8: per-dimension scale / offset over all vectors, saved to vector_quantization.bin
+void train_quantizer(Int8Quantizer& quantizer, VectorType vector_type, size_t num_nodes,
+    const std::function<void(size_t, float*)>& get, const std::string& out_dir, int num_threads) {
+    if (vector_type != VECTOR_INT8) { return; }
+    quantizer.train(num_nodes, get, num_threads);
+    quantizer.save(out_dir);
+}
+
+// NEIGHBOR_CODES_PQ: the codebook is trained on all vectors and saved to pq_codebook.bin, returns the
+//   pq.M-byte codes of all nodes (empty otherwise)
+std::vector<uint8_t> encode_neighbor_codes(ProductQuantizer& pq, NeighborCodes neighbor_codes, size_t num_nodes,
+    const std::function<void(size_t, float*)>& get, const std::string& out_dir, int num_threads) {
+    std::vector<uint8_t> codes;
+    if (neighbor_codes != NEIGHBOR_CODES_PQ) { return codes; }
+    auto start = std::chrono::high_resolution_clock::now();
+    pq.train(num_nodes, get, num_threads);
+    pq.save(out_dir);
+    codes.resize(num_nodes * pq.M);
+    parallel_for(num_nodes, num_threads, [&](size_t i) {
+        thread_local std::vector<float> vec;
+        vec.resize(pq.dim);
+        get(i, vec.data());
+        pq.encode(vec.data(), &codes[i * pq.M]);
+    });
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "PQ codes (M=" << pq.M << ") trained and encoded in " <<
+        std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() / 1000.0 << " sec" << std::endl;
+    return codes;
+}
+
+// the codes of the kept links of a node, in link order (nullptr without neighbor codes)
+const uint8_t* gather_neighbor_codes(const std::vector<uint8_t>& codes, int code_bytes,
+    uint32_t link_count, const uint32_t* links, int max_degree) {
+    if (codes.empty()) { return nullptr; }
+    thread_local std::vector<uint8_t> buf;
+    uint32_t n = link_count < (uint32_t) max_degree? link_count : max_degree;
+    buf.resize((size_t) n * code_bytes);
+    for (uint32_t j = 0; j < n; j++) { memcpy(&buf[j * code_bytes], &codes[(size_t) links[j] * code_bytes], code_bytes); }
+    return buf.data();
+}
+
+void convert_hnsw(const std::string& index_path, const std::string& out_dir, int dim,
+    const std::vector<int>& num_channels, VectorType vector_type, VectorLayout vector_layout, LinkLayout link_layout,
+    NeighborCodes neighbor_codes, int pq_m, int num_threads) {
+
+    MappedInput index(index_path);
+    HNSWHeader h;
+    memcpy(&h, index.data, sizeof(HNSWHeader));
+    std::cout << "cur_element_count " << h.cur_element_count << std::endl;
+    std::cout << "size_data_per_element_ " << h.size_data_per_element_ << std::endl;
+    std::cout << "maxlevel_ " << h.maxlevel_ << std::endl;
+    std::cout << "enterpoint_node_ " << h.enterpoint_node_ << std::endl;
+    std::cout << "maxM_ " << h.maxM_ << std::endl;
+    std::cout << "maxM0_ " << h.maxM0_ << std::endl;
+    std::cout << "M_ " << h.M_ << std::endl;
+
+    size_t size_link_count = 4;
+    size_t size_links = h.maxM0_ * 4;
+    size_t size_vectors = dim * 4;
+    size_t size_label = 8;
+    if (h.size_data_per_element_ != size_link_count + size_links + size_vectors + size_label) {
+        std::cout << "size_data_per_element_ mismatch, wrong dim?" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    size_t num_nodes = h.cur_element_count;
+    const char* data_level0 = index.data + sizeof(HNSWHeader);
+    int maxM0 = h.maxM0_;
+
+    // meta
+    FPGAIndexMeta meta(true);
+    meta.num_nodes = h.cur_element_count; meta.max_level = h.maxlevel_; meta.entry_point = h.enterpoint_node_;
+    meta.max_link_num_upper = h.maxM_; meta.max_link_num_base = h.maxM0_; meta.vector_layout = vector_layout;
+    meta.link_layout = link_layout; meta.neighbor_codes = neighbor_codes; meta.vector_type = vector_type;
+    meta.save(out_dir);
+
+    auto get_vector = [&](size_t i, float* out) {
+        memcpy(out, data_level0 + i * h.size_data_per_element_ + size_link_count + size_links, size_vectors);
+    };
+    Int8Quantizer quantizer(dim);
+    train_quantizer(quantizer, vector_type, num_nodes, get_vector, out_dir, num_threads);
+    ProductQuantizer pq(dim, pq_m);
+    std::vector<uint8_t> codes = encode_neighbor_codes(pq, neighbor_codes, num_nodes, get_vector, out_dir, num_threads);
+    int code_bytes = codes.empty()? 0 : pq.M;
+
+    // ground layer, per channel
+    write_ground_layer_per_channel(out_dir, num_nodes, num_channels,
+        bytes_per_ground_links(maxM0, link_layout, code_bytes), bytes_per_ground_vector(dim, vector_type, vector_layout),
+        [&](size_t i, char* out) {
+            const char* element = data_level0 + i * h.size_data_per_element_;
+            uint32_t link_count = *(const uint32_t*) element;
+            const uint32_t* links = (const uint32_t*) (element + size_link_count);
+            encode_ground_links(link_count, links, maxM0, out, link_layout,
+                gather_neighbor_codes(codes, code_bytes, link_count, links, maxM0), code_bytes);
+        },
+        [&](size_t i, char* out) {
+            const char* element = data_level0 + i * h.size_data_per_element_;
+            encode_ground_vector((const float*) (element + size_link_count + size_links), dim, vector_type, vector_layout, &quantizer, out);
+        },
+        num_threads);
+
+    // labels (8B in hnswlib, 4B in FPGA format)
+    std::vector<uint32_t> labels(num_nodes);
+    for (size_t i = 0; i < num_nodes; i++) {
+        uint64_t label;
+        memcpy(&label, data_level0 + i * h.size_data_per_element_ + size_link_count + size_links + size_vectors, sizeof(label));
+        labels[i] = (uint32_t) label;
+    }
+    write_file(fpga_index::concat_dir(out_dir, "ground_labels.bin"), (const char*) labels.data(), num_nodes * sizeof(uint32_t));
+
+    // upper layers: scan the variable-length link lists once to get the per-node input / output offsets
+    size_t size_links_per_element_ = h.maxM_ * 4 + 4;
+    size_t bytes_per_level = bytes_per_upper_level(h.M_);
+    std::vector<size_t> in_offsets(num_nodes);
+    std::vector<uint64_t> upper_links_pointers(num_nodes);
+    std::vector<int> levels(num_nodes);
+    size_t start_byte_pointer = sizeof(HNSWHeader) + h.max_elements_ * h.size_data_per_element_;
+    size_t total_upper_bytes = 0;
+    for (size_t i = 0; i < num_nodes; i++) {
+        uint32_t linkListSize;
+        memcpy(&linkListSize, index.data + start_byte_pointer, 4);
+        start_byte_pointer += 4;
+        in_offsets[i] = start_byte_pointer;
+        levels[i] = linkListSize / size_links_per_element_;
+        start_byte_pointer += linkListSize;
+        upper_links_pointers[i] = total_upper_bytes;
+        total_upper_bytes += levels[i] * bytes_per_level;
+    }
+    if (start_byte_pointer != index.bytes) {
+        std::cout << "Unexpected index file size" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    OutputFile upper_links(fpga_index::concat_dir(out_dir, "upper_links.bin"), total_upper_bytes);
+    size_t nodes_per_chunk = 256 * 1024;
+    size_t num_chunks = (num_nodes + nodes_per_chunk - 1) / nodes_per_chunk;
+    parallel_for(num_chunks, num_threads, [&](size_t chunk) {
+        size_t start = chunk * nodes_per_chunk;
+        size_t end = start + nodes_per_chunk < num_nodes? start + nodes_per_chunk : num_nodes;
+        size_t end_bytes = end < num_nodes? upper_links_pointers[end] : total_upper_bytes;
+        std::vector<char> buf(end_bytes - upper_links_pointers[start], 0);
+        for (size_t i = start; i < end; i++) {
+            const uint32_t* links = (const uint32_t*) (index.data + in_offsets[i]);
+            char* out = buf.data() + upper_links_pointers[i] - upper_links_pointers[start];
+            for (int j = 0; j < levels[i]; j++) {
+                // count, then M_ links (stride 1 + M_ as in hnsw.py)
+                memcpy(out, &links[j * (1 + h.M_)], sizeof(uint32_t));
+                memcpy(out + BYTES_PER_AXI, &links[j * (1 + h.M_) + 1], h.M_ * sizeof(uint32_t));
+                out += bytes_per_level;
+            }
+        }
+        upper_links.write_at(buf.data(), buf.size(), upper_links_pointers[start]);
+    });
+    write_file(fpga_index::concat_dir(out_dir, "upper_links_pointers.bin"),
+        (const char*) upper_links_pointers.data(), num_nodes * sizeof(uint64_t));
+}
+
+void convert_nsg(const std::string& index_path, const std::string& dataset_path, const std::string& dbname,
+    const std::string& out_dir, int dim, const std::vector<int>& num_channels, VectorType vector_type,
+    VectorLayout vector_layout, LinkLayout link_layout, NeighborCodes neighbor_codes, int pq_m, int num_threads) {
+
+    MappedInput index(index_path);
+    uint32_t width = ((const uint32_t*) index.data)[0];
+    uint32_t ep = ((const uint32_t*) index.data)[1];
+
+    // per node: k (4B) + k x 4B IDs; scan once for the offsets
+    std::vector<size_t> offsets;
+    size_t pointer = 8;
+    while (pointer < index.bytes) {
+        offsets.push_back(pointer);
+        uint32_t k;
+        memcpy(&k, index.data + pointer, 4);
+        pointer += 4 + k * 4;
+    }
+    size_t num_nodes = offsets.size();
+    std::cout << "num_nodes " << num_nodes << " width " << width << " ep " << ep << std::endl;
+
+    DatasetReader dataset(dataset_path, format_from_dbname(dbname), dim);
+    if (dataset.num_vectors < num_nodes) {
+        std::cout << "The number of vertices in the index and data do not match" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    FPGAIndexMeta meta(false);
+    meta.num_nodes = num_nodes; meta.entry_point = ep; meta.max_link_num_base = width; meta.vector_layout = vector_layout;
+    meta.link_layout = link_layout; meta.neighbor_codes = neighbor_codes; meta.vector_type = vector_type;
+    meta.save(out_dir);
+
+    auto get_vector = [&](size_t i, float* out) { dataset.get(i, out); };
+    Int8Quantizer quantizer(dim);
+    train_quantizer(quantizer, vector_type, num_nodes, get_vector, out_dir, num_threads);
+    ProductQuantizer pq(dim, pq_m);
+    std::vector<uint8_t> codes = encode_neighbor_codes(pq, neighbor_codes, num_nodes, get_vector, out_dir, num_threads);
+    int code_bytes = codes.empty()? 0 : pq.M;
+
+    write_ground_layer_per_channel(out_dir, num_nodes, num_channels,
+        bytes_per_ground_links(width, link_layout, code_bytes), bytes_per_ground_vector(dim, vector_type, vector_layout),
+        [&](size_t i, char* out) {
+            const uint32_t* node = (const uint32_t*) (index.data + offsets[i]);
+            encode_ground_links(node[0], node + 1, width, out, link_layout,
+                gather_neighbor_codes(codes, code_bytes, node[0], node + 1, width), code_bytes);
+        },
+        [&](size_t i, char* out) {
+            thread_local std::vector<float> vec;
+            vec.resize(dim);
+            dataset.get(i, vec.data());
+            encode_ground_vector(vec.data(), dim, vector_type, vector_layout, &quantizer, out);
+        },
+        num_threads);
+}
+
+int main(int argc, char** argv) {
+
+    std::cout << "Usage: " << argv[0] << " --graph_type <HNSW/NSG> --dbname <e.g., SIFT10M> "
+        "--CPU_index_path <.bin/.nsg> --FPGA_index_path <out_dir> [--dataset_path <raw vectors, NSG only>] "
+        "[--num_channels 1,2,4,8,16] [--num_threads N] [--dim D] [--vector_type fp32/fp16/int8] [--vector_layout padded/compact] "
+        "[--link_layout original/packed] [--neighbor_codes none/pq] [--pq_m 16]" << std::endl;
+
+    std::map<std::string, std::string> args;
+    for (int i = 1; i + 1 < argc; i += 2) { args[argv[i]] = argv[i + 1]; }
+
+    std::string graph_type = args.count("--graph_type")? args["--graph_type"] : "HNSW";
+    std::string dbname = args.count("--dbname")? args["--dbname"] : "SIFT1M";
+    std::string index_path = args["--CPU_index_path"];
+    std::string out_dir = args["--FPGA_index_path"];
+    std::string dataset_path = args["--dataset_path"];
+    std::vector<int> num_channels = parse_num_channels(args.count("--num_channels")? args["--num_channels"] : "1,2,4,8,16");
+    int num_threads = args.count("--num_threads")? std::stoi(args["--num_threads"]) : std::thread::hardware_concurrency();
+    int dim = args.count("--dim")? std::stoi(args["--dim"]) : dim_from_dbname(dbname);
+    VectorType vector_type = parse_vector_type(args.count("--vector_type")? args["--vector_type"] : "fp32");
+    VectorLayout vector_layout = parse_vector_layout(args.count("--vector_layout")? args["--vector_layout"] : "padded");
+    LinkLayout link_layout = parse_link_layout(args.count("--link_layout")? args["--link_layout"] : "original");
+    NeighborCodes neighbor_codes = parse_neighbor_codes(args.count("--neighbor_codes")? args["--neighbor_codes"] : "none");
+    int pq_m = args.count("--pq_m")? std::stoi(args["--pq_m"]) : 16;
+
+    if (index_path.empty() || out_dir.empty() || (graph_type == "NSG" && dataset_path.empty())) {
+        std::cout << "Missing input / output path" << std::endl;
+        return -1;
+    }
+    // the kernels hold 64 / pq_m codes per 512-bit word, and the padded subspaces within the padded query
+    if (neighbor_codes == NEIGHBOR_CODES_PQ &&
+        (pq_m < 1 || 64 % pq_m != 0 || (size_t) pq_m * ((dim + pq_m - 1) / pq_m) > round_up_to_AXI(dim * sizeof(float)) / sizeof(float))) {
+        std::cout << "pq_m has to divide 64, and ceil(dim / pq_m) x pq_m must not exceed dim padded to 16" << std::endl;
+        return -1;
+    }
+    std::cout << "graph_type=" << graph_type << " dbname=" << dbname << " dim=" << dim <<
+        " vector_type=" << vector_type_name(vector_type) << " vector_layout=" << vector_layout <<
+        " link_layout=" << link_layout << " neighbor_codes=" << neighbor_codes <<
+        (neighbor_codes == NEIGHBOR_CODES_PQ? " pq_m=" + std::to_string(pq_m) : "") << " num_threads=" << num_threads << std::endl;
+    mkdir(out_dir.c_str(), 0755);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    if (graph_type == "HNSW") {
+        convert_hnsw(index_path, out_dir, dim, num_channels, vector_type, vector_layout, link_layout, neighbor_codes, pq_m, num_threads);
+    } else if (graph_type == "NSG") {
+        convert_nsg(index_path, dataset_path, dbname, out_dir, dim, num_channels, vector_type, vector_layout, link_layout,
+            neighbor_codes, pq_m, num_threads);
+    } else {
+        std::cout << "Unknown graph type\n";
+        return -1;
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "FPGA format saved, duration: " <<
+        std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() / 1000.0 << " sec" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,877 @@
+// intra_query_pipeline_model: functional and performance model of the intra-query dataflow pipeline of
+//   FPGA_multi_DDR/FPGA_intra_query_v1.5_support_batching_longer_FIFO, to sweep parameters (mc / mg, ef,
+//   channels) and evaluate design changes in minutes on a CPU instead of sw_emu / hw_emu.
+//
+// The stages of the kernel run as threads connected by bounded FIFOs (sim::stream in hls_stream_model.hpp):
+//
+//   task_scheduler -> fetch_neighbor_ids -> split_tasks_to_channels -> N x bloom_fetch_compute
+//     -> N x filter_computed_distances -> gather_distances_from_channels -> results_collection
+//     -> (inserted candidates, largest result distance) -> task_scheduler / filter_computed_distances
+//
+// Functionally, each stage follows its kernel counterpart: the candidate and result queues are the
+//   systolic queues of priority_queue.hpp (insert at the largest position + one compare-swap round, full
+//   sort once per batch; for ef > 64, the two-tier result queue), the visited check is the per-channel
+//   Bloom filter of bloom_filter.hpp (same MurmurHash2, seeds and number of buckets as the host sets
+//   them), node i is stored in channel i % N, and the distances are computed on the fp32 vectors. As the
+//   stages only use blocking reads, the results are deterministic; unlike the kernel,
+//   gather_distances_from_channels forwards the channels in order rather than in arrival order, which may
+//   change the insertion order into the result queue.
+//
+// Each stage advances its simulated cycle counter with a cost model (CostModel below, at kernel_frequency):
+//   pipelined loops cost one cycle per element (II=1), DRAM reads cost dram_latency cycles before the first
+//   512-bit word and one cycle per word after it, FIFOs add fifo_latency cycles between stages. FIFO
+//   back-pressure is not modeled, as the kernel FIFOs are sized for one batch. Queries are processed
+//   one after the other as in the kernel; the query sample is split over independent pipeline instances
+//   (--num_pipelines) to use all cores, which does not change the per-query results or cycles.
+//
+// Speculative link prefetch (--prefetch, runtime_num_prefetch_candidates of the kernel): after each batch,
+//   the scheduler hints the next queue heads to fetch_neighbor_ids, which reads their links into staging
+//   slots (max_prefetch_candidates, round-robin) before the next pop; a pop of a staged node streams the
+//   links from the slot without DRAM access. The hints travel in order with the popped candidates, as the
+//   kernel serves pops before hints.
+//
+// Hot node cache (--hot_nodes N): the first N nodes of hot_nodes.bin in the index directory (profile_hot_nodes)
+//   are placed in the direct-mapped caches of the kernel (hardware_hot_nodes_per_channel slots per channel);
+//   the links and vectors of the cached nodes are read without DRAM latency.
+//
+// Reported per (mc, mg, prefetch): recall@1 / recall@10, hops (expanded candidates), visited nodes (vectors
+//   fetched and computed), iterations (batches), latency, and the QPS of one kernel; with prefetch, the hit
+//   rate (staged blocks that were popped), the hops served from the staging slots, and the latency per
+//   iteration (hop latency) compared to no prefetch.
+//
+// Example Usage:
+//   ./intra_query_pipeline_model --dbname SIFT1M --FPGA_index_path ../data/FPGA_hnsw/SIFT1M_MD64
+//       --query_path /mnt/scratch/wenqi/Faiss_experiments/bigann/bigann_query.bvecs
+//       --gt_path /mnt/scratch/wenqi/Faiss_experiments/bigann/gnd/idx_1M.ivecs --mc 1,2,4 --mg 1,2,4
+//
+// Optional: --num_channels 4 --ef 64 --candidate_queue_size 32 --num_queries 1000 --num_pipelines <cores / threads per pipeline>
+//   --dim <from dbname> --freq_mhz 200 --dram_latency 60 --fifo_latency 2 --bloom_latency 8 --compute_latency 30
+//   --bloom_reset epoch (or sweep: the Bloom filter reset between queries, BLOOM_RESET_MODE in constants.hpp)
+//   --prefetch 0 (list of the number of prefetched queue heads, e.g., 0,1,2) --hot_nodes 0
+
+#include <math.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FPGA_index_format.hpp"
+#include "dataset.hpp"
+#include "graph_search.hpp"
+#include "hls_stream_model.hpp"
+
+using sim::stage_cycle;
+
+const float large_float = 1E+20f; // as in constants.hpp
+const int hardware_result_queue_size = 64;
+const int hardware_large_result_queue_size = 512;
+const int END_OF_QUERY = -1;
+const int END_OF_ALL = -2;
+const int max_prefetch_candidates = 2; // as in constants.hpp
+const int hardware_hot_nodes_per_channel = 256; // as in constants.hpp
+
+// cycles at kernel_frequency
+struct CostModel {
+    double freq_mhz = 200;
+    int dram_latency = 60; // address to first 512-bit word
+    int fifo_latency = 2; // between two stages
+    int bloom_latency = 8; // hash + check_update pipeline depth
+    int compute_latency = 30; // distance PE pipeline depth
+};
+
+struct PipelineConfig {
+    int num_channels;
+    int mc; // max_cand_batch_size
+    int mg; // max_async_stage_num
+    int ef;
+    int candidate_queue_size;
+    int bloom_addr_bits;
+    bool bloom_reset_epoch; // BLOOM_RESET_EPOCH, otherwise BLOOM_RESET_SWEEP (constants.hpp)
+    int words_per_vector;
+    int num_prefetch; // runtime_num_prefetch_candidates
+    std::vector<bool> hot; // per node: in the hot node cache
+    CostModel cost;
+};
+
+struct result_t {
+    int node_id;
+    float dist;
+};
+
+// systolic queue of priority_queue.hpp (Collect_smallest): the largest element at position 0,
+//   the smallest at size - 1
+class SystolicQueue {
+
+public:
+
+    std::vector<result_t> queue;
+
+    SystolicQueue(int size) : queue(size) { reset(); }
+
+    void reset() { for (auto& e : queue) { e = {-1, large_float}; } }
+
+    int size() const { return queue.size(); }
+
+    const result_t& largest() const { return queue[0]; }
+
+    const result_t& smallest() const { return queue.back(); }
+
+    void compare_swap_round() {
+        for (int j = 0; 2 * j + 1 < size(); j++) { compare_swap(2 * j, 2 * j + 1); }
+        for (int j = 0; 2 * j + 2 < size(); j++) { compare_swap(2 * j + 1, 2 * j + 2); }
+    }
+
+    // returns true if inserted
+    bool insert(const result_t& r) {
+        if (r.dist < queue[0].dist) {
+            queue[0] = r;
+            compare_swap_round();
+            return true;
+        }
+        return false;
+    }
+
+    // cycles
+    int sort() {
+        int rounds = (size() + 1) / 2;
+        for (int i = 0; i < rounds; i++) { compare_swap_round(); }
+        return rounds;
+    }
+
+    result_t pop_smallest() {
+        result_t r = queue.back();
+        for (int i = size() - 1; i > 0; i--) { queue[i] = queue[i - 1]; }
+        queue[0] = {-1, large_float};
+        return r;
+    }
+
+private:
+
+    void compare_swap(int a, int b) {
+        if (queue[a].dist < queue[b].dist) { std::swap(queue[a], queue[b]); }
+    }
+};
+
+// Two_tier_result_queue of priority_queue.hpp: the systolic queue for ef <= hardware_result_queue_size,
+//   otherwise up to hardware_result_queue_size elements staged in registers, merged from the tail into
+//   the sorted BRAM tier (ef elements) by sort()
+class ResultQueue {
+
+public:
+
+    ResultQueue(int ef) : ef(ef), two_tier(ef > hardware_result_queue_size), systolic(two_tier? 1 : ef) { reset(); }
+
+    void reset() {
+        systolic.reset();
+        staged.clear();
+        sorted.assign(two_tier? ef : 0, {-1, large_float});
+    }
+
+    // insertions before sort() is required
+    int num_free() const { return two_tier? hardware_result_queue_size - (int) staged.size() : ef; }
+
+    // returns true if inserted (two tiers: staged)
+    bool insert(const result_t& r) {
+        if (!two_tier) { return systolic.insert(r); }
+        if (r.dist < largest()) {
+            staged.push_back(r);
+            return true;
+        }
+        return false;
+    }
+
+    // cycles
+    int sort() {
+        if (!two_tier) { return systolic.sort(); }
+        std::sort(staged.begin(), staged.end(), [](const result_t& a, const result_t& b) { return a.dist < b.dist; });
+        int cycles = hardware_result_queue_size / 2;
+        // merge_staged: binary search for the BRAM elements that stay (a read + compare per step), then one
+        //   cycle per BRAM element moved and per staged element
+        float smallest_staged = staged.empty()? large_float : staged[0].dist;
+        int num_fixed = 0, hi = ef;
+        while (num_fixed < hi) {
+            int mid = (num_fixed + hi) / 2;
+            if (sorted[mid].dist <= smallest_staged) { num_fixed = mid + 1; } else { hi = mid; }
+            cycles += 2;
+        }
+        cycles += ef - num_fixed + (int) staged.size();
+        int i = ef - 1, j = (int) staged.size() - 1;
+        for (int k = ef - 1 + (int) staged.size(); j >= 0; k--) {
+            bool take_staged = i < 0 || staged[j].dist > sorted[i].dist;
+            result_t r = take_staged? staged[j--] : sorted[i--];
+            if (k < ef) { sorted[k] = r; }
+        }
+        staged.clear();
+        return cycles;
+    }
+
+    float largest() const { return two_tier? sorted[ef - 1].dist : systolic.largest().dist; }
+
+    // ascending distances, valid entries only
+    std::vector<int> result_ids() const {
+        std::vector<int> ids;
+        for (int i = 0; i < ef; i++) {
+            const result_t& r = two_tier? sorted[i] : systolic.queue[ef - 1 - i];
+            if (r.node_id >= 0) { ids.push_back(r.node_id); }
+        }
+        return ids;
+    }
+
+private:
+
+    int ef;
+    bool two_tier;
+    SystolicQueue systolic;
+    std::vector<result_t> staged;
+    std::vector<result_t> sorted;
+};
+
+// BloomFilter of bloom_filter.hpp: num_hash_funs MurmurHash2 with seeds hash_seed + i, 2^addr_bits bits
+class BloomModel {
+
+public:
+
+    BloomModel(int addr_bits, bool reset_epoch) : addr_bits(addr_bits), reset_epoch(reset_epoch),
+        bits((1ull << addr_bits) / 64, 0) {}
+
+    // returns the cycles of next_query() in the kernel: BLOOM_RESET_SWEEP clears one 512-bit bucket
+    //   per cycle, BLOOM_RESET_EPOCH only sweeps the (8-bit) epoch tags when the epoch wraps
+    int next_query() {
+        std::fill(bits.begin(), bits.end(), 0);
+        int sweep_cycles = addr_bits > 9? 1 << (addr_bits - 9) : 1;
+        if (!reset_epoch) { return sweep_cycles; }
+        if (epoch == max_epoch) {
+            epoch = 1;
+            return sweep_cycles;
+        }
+        epoch++;
+        return 1;
+    }
+
+    // returns true if the node may have been visited, marks it as visited
+    bool check_update(uint32_t key) {
+        int match = 0;
+        for (int i = 0; i < num_hash_funs; i++) {
+            uint32_t bit = murmur_hash2_key_len4(key, hash_seed + i) & ((1u << addr_bits) - 1);
+            uint64_t& word = bits[bit / 64];
+            if (word & (1ull << (bit % 64))) { match++; }
+            else { word |= 1ull << (bit % 64); }
+        }
+        return match == num_hash_funs;
+    }
+
+private:
+
+    static const int num_hash_funs = 3;
+    static const uint32_t hash_seed = 1;
+    static const int max_epoch = 255; // BLOOM_EPOCH_BITS = 8
+    int addr_bits;
+    bool reset_epoch;
+    int epoch = 1;
+    std::vector<uint64_t> bits;
+
+    static uint32_t murmur_hash2_key_len4(uint32_t key, uint32_t seed) {
+        const uint32_t m = 0x5bd1e995;
+        uint32_t k = key;
+        k *= m;
+        k ^= k >> 24;
+        k *= m;
+        uint32_t h = seed ^ 4;
+        h *= m;
+        h ^= k;
+        h ^= h >> 13;
+        h *= m;
+        h ^= h >> 15;
+        return h;
+    }
+};
+
+struct QueryStats {
+    std::vector<int> result_ids; // sorted by distance
+    int hops = 0;
+    int iterations = 0;
+    uint64_t start_cycle = 0;
+    uint64_t finish_cycle = 0;
+    std::vector<int> visited_per_channel;
+    int prefetched = 0; // link blocks staged by fetch_neighbor_ids
+    int prefetch_hits = 0; // pops served from a staging slot
+    int hot_link_hits = 0;
+    std::vector<int> hot_vector_hits_per_channel;
+};
+
+// one instance of the kernel pipeline, processing its queries one after the other
+class PipelineModel {
+
+public:
+
+    PipelineModel(const FPGAIndex& index, const PipelineConfig& config,
+        const std::vector<float>& queries, const std::vector<int>& query_ids, std::vector<QueryStats>& stats) :
+        index(index), config(config), nc(config.num_channels), queries(queries), query_ids(query_ids), stats(stats),
+        s_neighbor_ids_per_channel(nc), s_distances_per_channel(nc), s_distances_filtered_per_channel(nc),
+        s_largest_result_per_channel(nc) {}
+
+    void run() {
+        std::vector<std::thread> threads;
+        threads.emplace_back([&] { task_scheduler(); });
+        threads.emplace_back([&] { fetch_neighbor_ids(); });
+        threads.emplace_back([&] { split_tasks_to_channels(); });
+        for (int c = 0; c < nc; c++) {
+            threads.emplace_back([&, c] { bloom_fetch_compute(c); });
+            threads.emplace_back([&, c] { filter_computed_distances(c); });
+        }
+        threads.emplace_back([&] { gather_distances_from_channels(); });
+        threads.emplace_back([&] { results_collection(); });
+        for (auto& t : threads) { t.join(); }
+    }
+
+    static int threads_per_pipeline(int nc) { return 5 + 2 * nc; }
+
+private:
+
+    const FPGAIndex& index;
+    const PipelineConfig& config;
+    const int nc;
+    const std::vector<float>& queries;
+    const std::vector<int>& query_ids;
+    std::vector<QueryStats>& stats;
+
+    // scheduler -> fetch_neighbor_ids: node IDs and prefetch hints; -> split: candidates per batch
+    sim::stream<int> s_top_candidates;
+    sim::stream<int> s_cand_batch_size;
+    // fetch_neighbor_ids -> split: per node, num_links then the links
+    sim::stream<int> s_neighbor_ids_raw;
+    // split -> bloom_fetch_compute: per batch, num_neighbors then the neighbors
+    std::vector<sim::stream<int>> s_neighbor_ids_per_channel;
+    // bloom_fetch_compute -> filter -> gather: per batch, num_valid then the distances
+    std::vector<sim::stream<result_t>> s_distances_per_channel;
+    std::vector<sim::stream<result_t>> s_distances_filtered_per_channel;
+    // gather -> results_collection: per batch and channel, num_valid then the distances
+    sim::stream<result_t> s_distances;
+    // results_collection -> scheduler
+    sim::stream<int> s_num_inserted_candidates;
+    sim::stream<result_t> s_inserted_candidates;
+    sim::stream<float> s_largest_result;
+    std::vector<sim::stream<float>> s_largest_result_per_channel;
+    sim::stream<int> s_finish_query;
+
+    const float* query(int qid) const { return &queries[(size_t) query_ids[qid] * index.dim]; }
+
+    // counts travel in the node_id field of the result streams
+    static result_t count_token(int n) { return {n, 0}; }
+
+    // prefetch hints travel in the node ID stream below END_OF_ALL
+    static int prefetch_token(int node_id) { return END_OF_ALL - 1 - node_id; }
+    static int prefetch_node_id(int token) { return END_OF_ALL - 1 - token; }
+
+    void task_scheduler() {
+        stage_cycle = 0;
+        const int fifo = config.cost.fifo_latency;
+        SystolicQueue candidate_queue(config.candidate_queue_size);
+        for (size_t qid = 0; qid < query_ids.size(); qid++) {
+            QueryStats& st = stats[query_ids[qid]];
+            st.start_cycle = stage_cycle;
+            stage_cycle += config.words_per_vector; // receive and replicate the query vector
+
+            candidate_queue.reset();
+            stage_cycle += fifo;
+            s_top_candidates.write(index.meta.entry_point);
+            s_cand_batch_size.write(1);
+            int on_the_fly = 1;
+            st.hops = 1;
+            st.iterations = 1;
+
+            while (true) {
+                for (int c = 0; c < nc; c++) {
+                    int num_insertion = s_num_inserted_candidates.read();
+                    for (int i = 0; i < num_insertion; i++) {
+                        candidate_queue.insert(s_inserted_candidates.read());
+                        stage_cycle++;
+                    }
+                    stage_cycle++;
+                }
+                on_the_fly--;
+                stage_cycle += candidate_queue.sort();
+                float threshold = s_largest_result.read();
+
+                for (int oid = on_the_fly; oid < config.mg; oid++) {
+                    int batch_size = 0;
+                    for (int bid = 0; bid < config.mc; bid++) {
+                        const result_t& top = candidate_queue.smallest();
+                        if (top.dist <= threshold && top.dist < large_float) {
+                            stage_cycle++;
+                            s_top_candidates.write_at(candidate_queue.pop_smallest().node_id, stage_cycle + fifo);
+                            batch_size++;
+                        } else {
+                            break;
+                        }
+                    }
+                    if (batch_size == 0) { break; }
+                    s_cand_batch_size.write_at(batch_size, stage_cycle + fifo);
+                    on_the_fly++;
+                    st.hops += batch_size;
+                    st.iterations++;
+                }
+                // the next queue heads, without popping them
+                for (int pid = 0; pid < config.num_prefetch && pid < candidate_queue.size(); pid++) {
+                    const result_t& head = candidate_queue.queue[candidate_queue.size() - 1 - pid];
+                    if (head.dist <= threshold && head.dist < large_float) {
+                        s_top_candidates.write_at(prefetch_token(head.node_id), stage_cycle + fifo);
+                    }
+                }
+                if (on_the_fly == 0) { break; }
+            }
+            s_top_candidates.write(END_OF_QUERY);
+            s_cand_batch_size.write(END_OF_QUERY);
+            s_finish_query.read();
+        }
+        s_top_candidates.write(END_OF_ALL);
+        s_cand_batch_size.write(END_OF_ALL);
+    }
+
+    // reads the count in the first 512-bit word, then the rest of the node's words; in the packed layout,
+    //   the remaining populated words are a second, dependent burst. Prefetched nodes are read the same way
+    //   into a staging slot, from which a later pop streams one word per cycle, as from the hot node cache.
+    void fetch_neighbor_ids() {
+        stage_cycle = 0;
+        const int max_degree = index.meta.max_link_num_base;
+        const LinkLayout layout = index.meta.link_layout;
+        const int first_link_slot = layout == LINK_LAYOUT_PACKED? 1 : INT_PER_AXI;
+        std::vector<int> staged_node_ids(max_prefetch_candidates, -1);
+        int next_slot = 0;
+        size_t qid = 0;
+        while (true) {
+            int token = s_top_candidates.read();
+            if (token == END_OF_ALL) { break; }
+            if (token == END_OF_QUERY) {
+                std::fill(staged_node_ids.begin(), staged_node_ids.end(), -1);
+                qid++;
+                continue;
+            }
+            bool is_prefetch = token < END_OF_ALL;
+            int node_id = is_prefetch? prefetch_node_id(token) : token;
+            QueryStats& st = stats[query_ids[qid]];
+            auto staged = std::find(staged_node_ids.begin(), staged_node_ids.end(), node_id);
+            uint32_t num_links = index.num_links(node_id);
+            const uint32_t* links = index.links(node_id);
+            int words = populated_link_words(num_links, max_degree, layout);
+            bool is_hot = config.hot[node_id];
+            if (staged != staged_node_ids.end() || is_hot) {
+                if (is_prefetch) { continue; }
+                if (is_hot) {
+                    st.hot_link_hits++;
+                } else {
+                    *staged = -1;
+                    st.prefetch_hits++;
+                }
+                uint64_t first_word = stage_cycle + 1;
+                s_neighbor_ids_raw.write_at(num_links, first_word);
+                for (uint32_t i = 0; i < num_links; i++) {
+                    int word = (first_link_slot + i) / INT_PER_AXI;
+                    s_neighbor_ids_raw.write_at(links[i], first_word + word + config.cost.fifo_latency);
+                }
+                stage_cycle = first_word + words;
+                continue;
+            }
+            uint64_t first_word = stage_cycle + config.cost.dram_latency;
+            uint64_t second_burst = layout == LINK_LAYOUT_PACKED? first_word + config.cost.dram_latency : first_word;
+            if (is_prefetch) {
+                staged_node_ids[next_slot] = node_id;
+                next_slot = (next_slot + 1) % max_prefetch_candidates;
+                st.prefetched++;
+            } else {
+                s_neighbor_ids_raw.write_at(num_links, first_word);
+                for (uint32_t i = 0; i < num_links; i++) {
+                    int word = (first_link_slot + i) / INT_PER_AXI;
+                    s_neighbor_ids_raw.write_at(links[i], (word == 0? first_word : second_burst + word) + config.cost.fifo_latency);
+                }
+            }
+            stage_cycle = (words == 1? first_word : second_burst + words - 1) + 1;
+        }
+    }
+
+    void split_tasks_to_channels() {
+        stage_cycle = 0;
+        std::vector<std::vector<int>> per_channel(nc);
+        while (true) {
+            int batch_size = s_cand_batch_size.read();
+            if (batch_size < 0) {
+                for (int c = 0; c < nc; c++) { s_neighbor_ids_per_channel[c].write(batch_size); }
+                if (batch_size == END_OF_ALL) { break; }
+                continue;
+            }
+            for (auto& ids : per_channel) { ids.clear(); }
+            for (int b = 0; b < batch_size; b++) {
+                int num_links = s_neighbor_ids_raw.read();
+                stage_cycle++;
+                for (int i = 0; i < num_links; i++) {
+                    int link = s_neighbor_ids_raw.read();
+                    stage_cycle++;
+                    per_channel[link % nc].push_back(link);
+                }
+            }
+            // the counts are sent once the batch is split, the PEs wait for them before reading the IDs
+            stage_cycle += config.cost.fifo_latency;
+            for (int c = 0; c < nc; c++) {
+                s_neighbor_ids_per_channel[c].write(per_channel[c].size());
+                for (int link : per_channel[c]) { s_neighbor_ids_per_channel[c].write(link); }
+            }
+        }
+    }
+
+    // Bloom filter (II=1), then fetch_vectors and the distance PEs as two pipelined units with their own
+    //   availability cycles (DRAM bandwidth: one 512-bit word per cycle, compute: one word per cycle)
+    void bloom_fetch_compute(int c) {
+        stage_cycle = 0;
+        const CostModel& cost = config.cost;
+        BloomModel bloom(config.bloom_addr_bits, config.bloom_reset_epoch);
+        uint64_t fetch_free = 0, compute_free = 0;
+        size_t qid = 0;
+        std::vector<int> valid;
+        std::vector<uint64_t> valid_cycle;
+        int visited = 0, hot_hits = 0;
+        while (true) {
+            int num_neighbors = s_neighbor_ids_per_channel[c].read();
+            if (num_neighbors < 0) {
+                s_distances_per_channel[c].write(count_token(num_neighbors));
+                if (num_neighbors == END_OF_ALL) { break; }
+                stats[query_ids[qid]].visited_per_channel[c] = visited;
+                stats[query_ids[qid]].hot_vector_hits_per_channel[c] = hot_hits;
+                visited = 0;
+                hot_hits = 0;
+                qid++;
+                stage_cycle += bloom.next_query();
+                continue;
+            }
+            valid.clear();
+            valid_cycle.clear();
+            for (int i = 0; i < num_neighbors; i++) {
+                int node_id = s_neighbor_ids_per_channel[c].read();
+                stage_cycle++;
+                if (!bloom.check_update(node_id)) {
+                    valid.push_back(node_id);
+                    valid_cycle.push_back(stage_cycle + cost.bloom_latency);
+                }
+            }
+            visited += valid.size();
+            s_distances_per_channel[c].write_at(count_token(valid.size()), stage_cycle + cost.bloom_latency + cost.fifo_latency);
+            const float* q = query(qid);
+            for (size_t i = 0; i < valid.size(); i++) {
+                uint64_t issue = std::max(valid_cycle[i], fetch_free);
+                fetch_free = issue + config.words_per_vector;
+                bool is_hot = config.hot[valid[i]];
+                hot_hits += is_hot;
+                uint64_t last_word = issue + (is_hot? 0 : cost.dram_latency) + config.words_per_vector;
+                compute_free = std::max(last_word, compute_free + config.words_per_vector);
+                float dist = l2_sqr(q, index.vector(valid[i]), index.dim);
+                s_distances_per_channel[c].write_at({valid[i], dist}, compute_free + cost.compute_latency + cost.fifo_latency);
+            }
+        }
+    }
+
+    // drops the distances above the largest result of the previous batch (not available for the first one)
+    void filter_computed_distances(int c) {
+        stage_cycle = 0;
+        bool first_iter = true;
+        std::vector<result_t> filtered;
+        while (true) {
+            int num_valid = s_distances_per_channel[c].read().node_id;
+            if (num_valid < 0) {
+                if (num_valid == END_OF_QUERY) { s_largest_result_per_channel[c].read(); }
+                s_distances_filtered_per_channel[c].write(count_token(num_valid));
+                if (num_valid == END_OF_ALL) { break; }
+                first_iter = true;
+                continue;
+            }
+            float threshold = large_float;
+            if (!first_iter) { threshold = s_largest_result_per_channel[c].read(); }
+            first_iter = false;
+            filtered.clear();
+            for (int i = 0; i < num_valid; i++) {
+                result_t r = s_distances_per_channel[c].read();
+                stage_cycle++;
+                if (r.dist < threshold) { filtered.push_back(r); }
+            }
+            stage_cycle += config.cost.fifo_latency;
+            s_distances_filtered_per_channel[c].write(count_token(filtered.size()));
+            for (const result_t& r : filtered) { s_distances_filtered_per_channel[c].write(r); }
+        }
+    }
+
+    void gather_distances_from_channels() {
+        stage_cycle = 0;
+        while (true) {
+            int first_num = 0;
+            for (int c = 0; c < nc; c++) {
+                int num_valid = s_distances_filtered_per_channel[c].read().node_id;
+                if (c == 0) { first_num = num_valid; }
+                if (first_num < 0) { continue; } // all channels forward the same end token
+                stage_cycle++;
+                s_distances.write(count_token(num_valid));
+                for (int i = 0; i < num_valid; i++) {
+                    result_t r = s_distances_filtered_per_channel[c].read();
+                    stage_cycle++;
+                    s_distances.write_at(r, stage_cycle + config.cost.fifo_latency);
+                }
+            }
+            if (first_num < 0) {
+                s_distances.write(count_token(first_num));
+                if (first_num == END_OF_ALL) { break; }
+            }
+        }
+    }
+
+    void results_collection() {
+        stage_cycle = 0;
+        const int fifo = config.cost.fifo_latency;
+        ResultQueue result_queue(config.ef);
+        size_t qid = 0;
+        while (true) {
+            int num_first = s_distances.read().node_id;
+            if (num_first == END_OF_ALL) { break; }
+            if (num_first == END_OF_QUERY) {
+                QueryStats& st = stats[query_ids[qid]];
+                st.result_ids = result_queue.result_ids();
+                stage_cycle += config.ef; // write_results
+                st.finish_cycle = stage_cycle;
+                s_finish_query.write_at(0, stage_cycle + fifo);
+                result_queue.reset();
+                qid++;
+                continue;
+            }
+            bool inserted_any = false;
+            for (int c = 0; c < nc; c++) {
+                int num_valid = c == 0? num_first : s_distances.read().node_id;
+                int num_inserted = 0;
+                for (int i = 0; i < num_valid; i++) {
+                    result_t r = s_distances.read();
+                    // two tiers: the staging registers are merged into BRAM once full
+                    if (result_queue.num_free() == 0) { stage_cycle += result_queue.sort(); }
+                    stage_cycle++;
+                    if (result_queue.insert(r)) {
+                        s_inserted_candidates.write_at(r, stage_cycle + fifo);
+                        num_inserted++;
+                    }
+                }
+                inserted_any |= num_inserted > 0;
+                s_num_inserted_candidates.write_at(num_inserted, stage_cycle + fifo);
+            }
+            if (inserted_any) { stage_cycle += result_queue.sort(); }
+            float largest = result_queue.largest();
+            s_largest_result.write_at(largest, stage_cycle + fifo);
+            for (int c = 0; c < nc; c++) { s_largest_result_per_channel[c].write_at(largest, stage_cycle + fifo); }
+        }
+    }
+};
+
+std::vector<int> parse_int_list(const std::string& s) {
+    std::vector<int> values;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) { values.push_back(std::stoi(item)); }
+    return values;
+}
+
+// the first num_hot_nodes of hot_nodes.bin, placed as by the kernel: direct-mapped on the low bits of the
+//   position in the channel, a node whose slot is taken by a hotter one is not cached
+std::vector<bool> load_hot_node_cache(const std::string& index_dir, size_t num_nodes, int nc, int num_hot_nodes) {
+    std::vector<bool> hot(num_nodes, false);
+    if (num_hot_nodes <= 0) { return hot; }
+    MappedInput file(fpga_index::concat_dir(index_dir, hot_nodes_fname()));
+    const int* ids = (const int*) file.data;
+    int num = std::min<int>(num_hot_nodes, file.bytes / sizeof(int));
+    int bits = channel_addr_bits(nc);
+    std::vector<int> tags((size_t) nc * hardware_hot_nodes_per_channel, -1);
+    for (int i = 0; i < num; i++) {
+        int id = ids[i];
+        size_t slot = (size_t) (id % nc) * hardware_hot_nodes_per_channel + ((id >> bits) & (hardware_hot_nodes_per_channel - 1));
+        if (tags[slot] == -1) {
+            tags[slot] = id;
+            hot[id] = true;
+        }
+    }
+    return hot;
+}
+
+// as set by the host (runtime_n_bucket_addr_bits): 256K buckets in total, split over the channels
+int bloom_addr_bits_from_channels(int nc) {
+    return 8 + 10 - channel_addr_bits(nc);
+}
+
+int main(int argc, char** argv) {
+
+    std::cout << "Usage: " << argv[0] << " --dbname <e.g., SIFT1M> --FPGA_index_path <in_dir> --query_path <queries> "
+        "--gt_path <.ivecs/ibin> [--mc 1,2,4] [--mg 1,2,4] [--num_channels 4] [--ef 64] [--candidate_queue_size 32] "
+        "[--num_queries 1000] [--num_pipelines N] [--dim D] [--freq_mhz 200] [--dram_latency 60] [--fifo_latency 2] "
+        "[--bloom_latency 8] [--compute_latency 30] [--bloom_reset epoch|sweep] [--prefetch 0,1,2] [--hot_nodes N]" << std::endl;
+
+    std::map<std::string, std::string> args;
+    for (int i = 1; i + 1 < argc; i += 2) { args[argv[i]] = argv[i + 1]; }
+
+    std::string dbname = args.count("--dbname")? args["--dbname"] : "SIFT1M";
+    std::string in_dir = args["--FPGA_index_path"];
+    std::string query_path = args["--query_path"];
+    std::string gt_path = args["--gt_path"];
+    std::vector<int> mc_list = parse_int_list(args.count("--mc")? args["--mc"] : "1,2,4");
+    std::vector<int> mg_list = parse_int_list(args.count("--mg")? args["--mg"] : "1,2,4");
+    std::vector<int> prefetch_list = parse_int_list(args.count("--prefetch")? args["--prefetch"] : "0");
+    int num_hot_nodes = args.count("--hot_nodes")? std::stoi(args["--hot_nodes"]) : 0;
+    int num_channels = args.count("--num_channels")? std::stoi(args["--num_channels"]) : 4;
+    int ef = args.count("--ef")? std::stoi(args["--ef"]) : 64;
+    int candidate_queue_size = args.count("--candidate_queue_size")? std::stoi(args["--candidate_queue_size"]) : 32;
+    int num_queries = args.count("--num_queries")? std::stoi(args["--num_queries"]) : 1000;
+    int dim = args.count("--dim")? std::stoi(args["--dim"]) : dim_from_dbname(dbname);
+    int num_pipelines = args.count("--num_pipelines")? std::stoi(args["--num_pipelines"]) :
+        std::max(1, (int) std::thread::hardware_concurrency() / PipelineModel::threads_per_pipeline(num_channels));
+    CostModel cost;
+    if (args.count("--freq_mhz")) { cost.freq_mhz = std::stod(args["--freq_mhz"]); }
+    if (args.count("--dram_latency")) { cost.dram_latency = std::stoi(args["--dram_latency"]); }
+    if (args.count("--fifo_latency")) { cost.fifo_latency = std::stoi(args["--fifo_latency"]); }
+    if (args.count("--bloom_latency")) { cost.bloom_latency = std::stoi(args["--bloom_latency"]); }
+    if (args.count("--compute_latency")) { cost.compute_latency = std::stoi(args["--compute_latency"]); }
+    std::string bloom_reset = args.count("--bloom_reset")? args["--bloom_reset"] : "epoch";
+
+    if (in_dir.empty() || query_path.empty() || gt_path.empty()) {
+        std::cout << "Missing index, query, or ground truth path" << std::endl;
+        return -1;
+    }
+    if (bloom_reset != "epoch" && bloom_reset != "sweep") {
+        std::cout << "--bloom_reset has to be epoch or sweep" << std::endl;
+        return -1;
+    }
+    if (ef < 1 || ef > hardware_large_result_queue_size) {
+        std::cout << "ef has to be between 1 and " << hardware_large_result_queue_size << std::endl;
+        return -1;
+    }
+    if (num_channels < 1 || num_channels > 16 || (num_channels & (num_channels - 1)) != 0) {
+        std::cout << "The number of channels has to be 1, 2, 4, 8, or 16" << std::endl;
+        return -1;
+    }
+    for (int prefetch : prefetch_list) {
+        if (prefetch < 0 || prefetch > max_prefetch_candidates) {
+            std::cout << "--prefetch has to be between 0 and " << max_prefetch_candidates << std::endl;
+            return -1;
+        }
+    }
+
+    FPGAIndex index(in_dir, dim);
+    DatasetReader query_reader(query_path, format_from_dbname(dbname), dim);
+    if (num_queries > (int) query_reader.num_vectors) { num_queries = query_reader.num_vectors; }
+    std::vector<std::vector<int>> gt = load_ground_truth(gt_path, num_queries);
+    if ((int) gt.size() < num_queries) { num_queries = gt.size(); }
+    std::vector<float> queries((size_t) num_queries * dim);
+    for (int q = 0; q < num_queries; q++) { query_reader.get(q, &queries[(size_t) q * dim]); }
+    std::vector<int> labels = load_result_labels(in_dir, index.num_nodes);
+    num_pipelines = std::min(num_pipelines, num_queries);
+
+    PipelineConfig config;
+    config.num_channels = num_channels;
+    config.ef = ef;
+    config.candidate_queue_size = candidate_queue_size;
+    config.bloom_addr_bits = bloom_addr_bits_from_channels(num_channels);
+    config.bloom_reset_epoch = bloom_reset == "epoch";
+    config.words_per_vector = (dim + FLOAT_PER_AXI - 1) / FLOAT_PER_AXI;
+    config.hot = load_hot_node_cache(in_dir, index.num_nodes, num_channels, num_hot_nodes);
+    config.cost = cost;
+
+    std::cout << "num_nodes=" << index.num_nodes << " dim=" << dim << " max_degree=" << index.meta.max_link_num_base <<
+        " link_layout=" << (index.meta.link_layout == LINK_LAYOUT_PACKED? "packed" : "original") <<
+        " num_queries=" << num_queries << " num_channels=" << num_channels << " ef=" << ef <<
+        " candidate_queue_size=" << candidate_queue_size << " num_pipelines=" << num_pipelines <<
+        " bloom_reset=" << bloom_reset << std::endl;
+    std::cout << "cost model: freq_mhz=" << cost.freq_mhz << " dram_latency=" << cost.dram_latency <<
+        " fifo_latency=" << cost.fifo_latency << " bloom_latency=" << cost.bloom_latency <<
+        " compute_latency=" << cost.compute_latency << std::endl;
+    std::cout << std::fixed << std::setprecision(4);
+
+    for (int mc : mc_list) {
+        for (int mg : mg_list) {
+            // cycles per iteration without prefetch, for the hop latency reduction
+            double hop_latency_no_prefetch = 0;
+            for (int prefetch : prefetch_list) {
+                config.mc = mc;
+                config.mg = mg;
+                config.num_prefetch = prefetch;
+                std::vector<QueryStats> stats(num_queries);
+                for (auto& st : stats) {
+                    st.visited_per_channel.assign(num_channels, 0);
+                    st.hot_vector_hits_per_channel.assign(num_channels, 0);
+                }
+                // queries split into contiguous ranges per pipeline instance
+                std::vector<std::vector<int>> query_ids(num_pipelines);
+                for (int q = 0; q < num_queries; q++) { query_ids[(size_t) q * num_pipelines / num_queries].push_back(q); }
+
+                auto start = std::chrono::high_resolution_clock::now();
+                std::vector<std::thread> pipelines;
+                for (int p = 0; p < num_pipelines; p++) {
+                    pipelines.emplace_back([&, p] {
+                        PipelineModel model(index, config, queries, query_ids[p], stats);
+                        model.run();
+                    });
+                }
+                for (auto& t : pipelines) { t.join(); }
+                auto end = std::chrono::high_resolution_clock::now();
+                double duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() / 1000.0;
+
+                int recall_1 = 0, recall_10 = 0;
+                double hops = 0, iterations = 0, visited = 0, cycles = 0, max_channel_share = 0;
+                double prefetched = 0, prefetch_hits = 0, hot_link_hits = 0, hot_vector_hits = 0;
+                for (int q = 0; q < num_queries; q++) {
+                    const QueryStats& st = stats[q];
+                    if (!st.result_ids.empty() && !gt[q].empty() && labels[st.result_ids[0]] == gt[q][0]) { recall_1++; }
+                    for (size_t i = 0; i < st.result_ids.size() && i < 10; i++) {
+                        int label = labels[st.result_ids[i]];
+                        for (size_t j = 0; j < gt[q].size() && j < 10; j++) {
+                            if (gt[q][j] == label) { recall_10++; break; }
+                        }
+                    }
+                    hops += st.hops;
+                    iterations += st.iterations;
+                    int visited_q = 0, visited_max = 0;
+                    for (int v : st.visited_per_channel) { visited_q += v; visited_max = std::max(visited_max, v); }
+                    visited += visited_q;
+                    if (visited_q > 0) { max_channel_share += (double) visited_max * num_channels / visited_q; }
+                    cycles += st.finish_cycle - st.start_cycle;
+                    prefetched += st.prefetched;
+                    prefetch_hits += st.prefetch_hits;
+                    hot_link_hits += st.hot_link_hits;
+                    for (int h : st.hot_vector_hits_per_channel) { hot_vector_hits += h; }
+                }
+                double cycles_per_query = cycles / num_queries;
+                double latency_us = cycles_per_query / cost.freq_mhz;
+                double hop_latency = cycles / iterations;
+                if (prefetch == 0) { hop_latency_no_prefetch = hop_latency; }
+                std::cout << "mc=" << mc << " mg=" << mg << " prefetch=" << prefetch <<
+                    " recall@1=" << (double) recall_1 / num_queries <<
+                    " recall@10=" << (double) recall_10 / num_queries / 10 <<
+                    " hops=" << hops / num_queries <<
+                    " visited=" << visited / num_queries <<
+                    " iterations=" << iterations / num_queries <<
+                    " channel max/mean=" << max_channel_share / num_queries <<
+                    " cycles/query=" << cycles_per_query <<
+                    " latency=" << latency_us << " us" <<
+                    " QPS=" << 1e6 / latency_us <<
+                    " hop latency=" << hop_latency << " cycles";
+                if (prefetch > 0) {
+                    std::cout << " prefetch hit rate=" << (prefetched > 0? prefetch_hits / prefetched : 0) <<
+                        " hops from prefetch=" << prefetch_hits / hops;
+                    if (hop_latency_no_prefetch > 0) {
+                        std::cout << " hop latency reduction=" << 1 - hop_latency / hop_latency_no_prefetch;
+                    }
+                }
+                if (num_hot_nodes > 0) {
+                    std::cout << " hot link hit rate=" << hot_link_hits / hops <<
+                        " hot vector hit rate=" << (visited > 0? hot_vector_hits / visited : 0);
+                }
+                std::cout << " (model time " << duration << " s)" << std::endl;
+            }
+        }
+    }
+
+    return 0;
+}
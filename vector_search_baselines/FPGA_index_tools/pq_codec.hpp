@@ -0,0 +1,148 @@
+#pragma once
+
+// Product quantization of the neighbor codes (NEIGHBOR_CODES_PQ, see FPGA_index_format.hpp), matching
+//   FPGA_intra_query_v1.5 (neighbor_codes.hpp, PQ_M in constants.hpp):
+//
+// The dim dimensions are split into M subspaces of dsub = ceil(dim / M) dimensions (the last one is
+//   zero-padded), each quantized to 256 centroids by k-means, such that a vector is encoded as M bytes.
+//   pq_codebook.bin stores M (4B int), then the M x 256 x dsub 4B float centroids.
+//
+// The distance of a query to an encoded vector is approximated by sum_m lut[m][code[m]], where
+//   lut[m][k] is the squared L2 distance of the query's subvector m to centroid k (asymmetric distance
+//   computation); the lookup table is computed once per query.
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "FPGA_index_format.hpp"
+
+class ProductQuantizer {
+
+public:
+
+    static const int num_centroids = 256;
+
+    int dim;
+    int M;
+    int dsub;
+    std::vector<float> centroids; // M x num_centroids x dsub
+
+    ProductQuantizer(int dim, int M = 16) : dim(dim), M(M), dsub((dim + M - 1) / M),
+        centroids((size_t) M * num_centroids * dsub, 0) {}
+
+    // k-means per subspace on up to max_train_vectors of get(i, out), i < num_vectors, sampled with a fixed stride
+    void train(size_t num_vectors, const std::function<void(size_t, float*)>& get, int num_threads,
+        size_t max_train_vectors = 64 * 1024, int num_iters = 20) {
+
+        size_t n = num_vectors < max_train_vectors? num_vectors : max_train_vectors;
+        std::vector<float> train_vectors(n * M * dsub, 0);
+        parallel_for(n, num_threads, [&](size_t i) {
+            get(i * (num_vectors / n), &train_vectors[i * M * dsub]);
+        });
+
+        parallel_for(M, num_threads, [&](size_t m) {
+            std::vector<float> sub(n * dsub);
+            for (size_t i = 0; i < n; i++) {
+                memcpy(&sub[i * dsub], &train_vectors[(i * M + m) * dsub], dsub * sizeof(float));
+            }
+            std::mt19937 rng(m);
+            std::uniform_int_distribution<size_t> random_vector(0, n - 1);
+            float* c = &centroids[m * num_centroids * dsub];
+            for (int k = 0; k < num_centroids; k++) { memcpy(&c[k * dsub], &sub[random_vector(rng) * dsub], dsub * sizeof(float)); }
+
+            std::vector<int> assignment(n);
+            std::vector<float> sums((size_t) num_centroids * dsub);
+            std::vector<size_t> counts(num_centroids);
+            for (int iter = 0; iter < num_iters; iter++) {
+                for (size_t i = 0; i < n; i++) { assignment[i] = nearest_centroid(c, &sub[i * dsub]); }
+                std::fill(sums.begin(), sums.end(), 0);
+                std::fill(counts.begin(), counts.end(), 0);
+                for (size_t i = 0; i < n; i++) {
+                    counts[assignment[i]]++;
+                    for (int d = 0; d < dsub; d++) { sums[assignment[i] * dsub + d] += sub[i * dsub + d]; }
+                }
+                for (int k = 0; k < num_centroids; k++) {
+                    if (counts[k] == 0) { // empty cluster: restart from a random training vector
+                        memcpy(&c[k * dsub], &sub[random_vector(rng) * dsub], dsub * sizeof(float));
+                        continue;
+                    }
+                    for (int d = 0; d < dsub; d++) { c[k * dsub + d] = sums[k * dsub + d] / counts[k]; }
+                }
+            }
+        });
+    }
+
+    void load(const std::string& index_dir) {
+        MappedInput file(fpga_index::concat_dir(index_dir, pq_codebook_fname()));
+        M = *(const int*) file.data;
+        dsub = (dim + M - 1) / M;
+        centroids.resize((size_t) M * num_centroids * dsub);
+        if (file.bytes != sizeof(int) + centroids.size() * sizeof(float)) {
+            std::cout << pq_codebook_fname() << " does not match dim " << dim << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        memcpy(centroids.data(), file.data + sizeof(int), centroids.size() * sizeof(float));
+    }
+
+    void save(const std::string& index_dir) const {
+        std::vector<char> buf(sizeof(int) + centroids.size() * sizeof(float));
+        memcpy(buf.data(), &M, sizeof(int));
+        memcpy(buf.data() + sizeof(int), centroids.data(), centroids.size() * sizeof(float));
+        write_file(fpga_index::concat_dir(index_dir, pq_codebook_fname()), buf.data(), buf.size());
+    }
+
+    // M bytes
+    void encode(const float* vec, uint8_t* code) const {
+        std::vector<float> padded((size_t) M * dsub, 0);
+        memcpy(padded.data(), vec, dim * sizeof(float));
+        for (int m = 0; m < M; m++) {
+            code[m] = nearest_centroid(&centroids[m * num_centroids * dsub], &padded[m * dsub]);
+        }
+    }
+
+    // M x num_centroids
+    void compute_lut(const float* query, float* lut) const {
+        for (int m = 0; m < M; m++) {
+            for (int k = 0; k < num_centroids; k++) {
+                const float* c = &centroids[(m * num_centroids + k) * dsub];
+                float dist = 0;
+                for (int d = 0; d < dsub; d++) {
+                    int dim_id = m * dsub + d;
+                    float diff = (dim_id < dim? query[dim_id] : 0) - c[d];
+                    dist += diff * diff;
+                }
+                lut[m * num_centroids + k] = dist;
+            }
+        }
+    }
+
+    float adc(const float* lut, const uint8_t* code) const {
+        float dist = 0;
+        for (int m = 0; m < M; m++) { dist += lut[m * num_centroids + code[m]]; }
+        return dist;
+    }
+
+private:
+
+    int nearest_centroid(const float* c, const float* x) const {
+        int best = 0;
+        float best_dist = std::numeric_limits<float>::max();
+        for (int k = 0; k < num_centroids; k++) {
+            float dist = 0;
+            for (int d = 0; d < dsub; d++) {
+                float diff = x[d] - c[k * dsub + d];
+                dist += diff * diff;
+            }
+            if (dist < best_dist) { best_dist = dist; best = k; }
+        }
+        return best;
+    }
+};
@@ -0,0 +1,173 @@
+// profile_hot_nodes: rank the nodes of an FPGA-format index by how often the kernels fetch them, for
+//   the hot node cache of the intra-query kernel (hot_nodes.bin, see FPGA_index_format.hpp).
+//
+// All queries start at the same entry point, so the first hops of every query fetch the vectors and
+//   links of the same few nodes. The queries of a sample (--query_path) are replayed with a best-first
+//   search on the index; every evaluated neighbor counts as a vector fetch, every expanded candidate as
+//   a link fetch, and the nodes are ranked by the sum of both. The top --num_hot_nodes are saved with
+//   --out_path, most frequent first.
+//
+// The kernel caches up to --cache_slots nodes per channel, direct-mapped on the low bits of the
+//   position within the channel (node i in channel i % nc at position i / nc); the list is loaded in
+//   order, so a node whose slot is already taken by a more frequent one stays in DRAM. For each cache
+//   size, the report gives the cached nodes, the on-chip bytes, and the share of vector and link
+//   fetches served by the cache, over all hops and over the first --first_hops hops of each query.
+//
+// Example Usage:
+//   ./profile_hot_nodes --dbname SIFT10M --FPGA_index_path ../data/FPGA_hnsw/SIFT10M_MD64
+//       --query_path /mnt/scratch/wenqi/Faiss_experiments/bigann/bigann_query.bvecs
+//       --out_path ../data/FPGA_hnsw/SIFT10M_MD64/hot_nodes.bin
+//
+// Optional: --num_queries 10000 --ef 64 --num_hot_nodes 1024 --num_channels 4 --cache_slots 64,256,1024
+//   --first_hops 8 --num_threads <hardware concurrency> --dim <from dbname>
+//   Profile with other queries than the ones evaluated, e.g., a slice of the learn set.
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "FPGA_index_format.hpp"
+#include "dataset.hpp"
+#include "graph_search.hpp"
+
+std::vector<int> parse_int_list(const std::string& s) {
+    std::vector<int> values;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) { values.push_back(std::stoi(item)); }
+    return values;
+}
+
+// vector fetches (trace, starting with the entry point) and link fetches (expanded) of one query
+struct QueryProfile {
+    std::vector<int> trace;
+    std::vector<int> expansion_sizes;
+    std::vector<int> expanded;
+};
+
+// the nodes the kernel caches out of the ranked list, as placed by the direct-mapped cache
+std::vector<bool> simulate_cache(const std::vector<int>& ranked, size_t num_nodes, int nc, int slots_per_channel) {
+    int bits = channel_addr_bits(nc);
+    std::vector<int> tags((size_t) nc * slots_per_channel, -1);
+    std::vector<bool> cached(num_nodes, false);
+    for (int id : ranked) {
+        size_t slot = (size_t) (id % nc) * slots_per_channel + ((id >> bits) & (slots_per_channel - 1));
+        if (tags[slot] == -1) {
+            tags[slot] = id;
+            cached[id] = true;
+        }
+    }
+    return cached;
+}
+
+int main(int argc, char** argv) {
+
+    std::cout << "Usage: " << argv[0] << " --dbname <e.g., SIFT10M> --FPGA_index_path <in_dir> --query_path <queries> "
+        "[--out_path <hot_nodes.bin>] [--num_queries N] [--ef EF] [--num_hot_nodes 1024] [--num_channels 4] "
+        "[--cache_slots 64,256,1024] [--first_hops 8] [--num_threads N] [--dim D]" << std::endl;
+
+    std::map<std::string, std::string> args;
+    for (int i = 1; i + 1 < argc; i += 2) { args[argv[i]] = argv[i + 1]; }
+
+    std::string dbname = args.count("--dbname")? args["--dbname"] : "SIFT1M";
+    std::string in_dir = args["--FPGA_index_path"];
+    std::string query_path = args["--query_path"];
+    std::string out_path = args["--out_path"];
+    int num_queries = args.count("--num_queries")? std::stoi(args["--num_queries"]) : 10000;
+    int ef = args.count("--ef")? std::stoi(args["--ef"]) : 64;
+    int num_hot_nodes = args.count("--num_hot_nodes")? std::stoi(args["--num_hot_nodes"]) : 1024;
+    int nc = args.count("--num_channels")? std::stoi(args["--num_channels"]) : 4;
+    std::vector<int> cache_slots = parse_int_list(args.count("--cache_slots")? args["--cache_slots"] : "64,256,1024");
+    int first_hops = args.count("--first_hops")? std::stoi(args["--first_hops"]) : 8;
+    int num_threads = args.count("--num_threads")? std::stoi(args["--num_threads"]) : std::thread::hardware_concurrency();
+    int dim = args.count("--dim")? std::stoi(args["--dim"]) : dim_from_dbname(dbname);
+
+    if (in_dir.empty() || query_path.empty()) {
+        std::cout << "Missing index or query path" << std::endl;
+        return -1;
+    }
+    if (nc < 1 || nc > 16 || (nc & (nc - 1)) != 0) {
+        std::cout << "num_channels has to be 2^n, up to 16" << std::endl;
+        return -1;
+    }
+    for (int s : cache_slots) {
+        if (s < 1 || (s & (s - 1)) != 0) {
+            std::cout << "cache_slots have to be 2^n" << std::endl;
+            return -1;
+        }
+    }
+
+    FPGAIndex index(in_dir, dim);
+    DatasetReader query_reader(query_path, format_from_dbname(dbname), dim);
+    if (num_queries > (int) query_reader.num_vectors) { num_queries = query_reader.num_vectors; }
+    std::cout << "num_nodes=" << index.num_nodes << " max_degree=" << index.meta.max_link_num_base <<
+        " num_queries=" << num_queries << " ef=" << ef << " num_channels=" << nc << std::endl;
+
+    std::vector<QueryProfile> profiles(num_queries);
+    parallel_for(num_queries, num_threads, [&](size_t q) {
+        thread_local std::unique_ptr<VisitedList> visited; // freed at thread exit
+        thread_local std::vector<float> query;
+        if (!visited) { visited.reset(new VisitedList(index.num_nodes)); }
+        query.resize(dim);
+        query_reader.get(q, query.data());
+        QueryProfile& p = profiles[q];
+        search_ground_layer(index, query.data(), ef, *visited, &p.trace, nullptr, &p.expansion_sizes, &p.expanded);
+    });
+
+    std::vector<uint32_t> vector_fetches(index.num_nodes, 0);
+    std::vector<uint32_t> link_fetches(index.num_nodes, 0);
+    for (const QueryProfile& p : profiles) {
+        for (int id : p.trace) { vector_fetches[id]++; }
+        for (int id : p.expanded) { link_fetches[id]++; }
+    }
+    std::vector<int> ranked;
+    for (size_t i = 0; i < index.num_nodes; i++) {
+        if (vector_fetches[i] + link_fetches[i] > 0) { ranked.push_back(i); }
+    }
+    std::stable_sort(ranked.begin(), ranked.end(), [&](int a, int b) {
+        return vector_fetches[a] + link_fetches[a] > vector_fetches[b] + link_fetches[b]; });
+    if ((int) ranked.size() > num_hot_nodes) { ranked.resize(num_hot_nodes); }
+
+    // on-chip words per cached node: the vector without the visited padding, and the link stride
+    size_t vector_words = index.bytes_per_vector / BYTES_PER_AXI - (index.meta.vector_layout == VECTOR_LAYOUT_PADDED? 1 : 0);
+    size_t link_words = index.bytes_per_links / BYTES_PER_AXI;
+    std::cout << "Hot node cache (" << ranked.size() << " ranked nodes, " << vector_words << " vector + " <<
+        link_words << " link words per node):" << std::endl;
+    for (int slots : cache_slots) {
+        std::vector<bool> cached = simulate_cache(ranked, index.num_nodes, nc, slots);
+        size_t num_cached = std::count(cached.begin(), cached.end(), true);
+        size_t vec_hits = 0, vec_total = 0, link_hits = 0, link_total = 0;
+        size_t first_hits = 0, first_total = 0;
+        for (const QueryProfile& p : profiles) {
+            for (int id : p.trace) { vec_hits += cached[id]; }
+            for (int id : p.expanded) { link_hits += cached[id]; }
+            vec_total += p.trace.size();
+            link_total += p.expanded.size();
+            // the entry point, then the first hops: one link fetch and its evaluated neighbors each
+            size_t pos = 0;
+            if (!p.trace.empty()) { first_hits += cached[p.trace[pos++]]; first_total++; }
+            for (size_t h = 0; h < p.expanded.size() && (int) h < first_hops; h++) {
+                first_hits += cached[p.expanded[h]];
+                first_total++;
+                for (int j = 0; j < p.expansion_sizes[h]; j++) { first_hits += cached[p.trace[pos++]]; first_total++; }
+            }
+        }
+        double on_chip_MB = (double) nc * slots * (vector_words + link_words) * BYTES_PER_AXI / 1024 / 1024;
+        std::cout << "  slots/channel=" << slots << " cached=" << num_cached << " on-chip=" << on_chip_MB << " MB" <<
+            " vector hit rate=" << (double) vec_hits / std::max<size_t>(vec_total, 1) <<
+            " link hit rate=" << (double) link_hits / std::max<size_t>(link_total, 1) <<
+            " first " << first_hops << " hops hit rate=" << (double) first_hits / std::max<size_t>(first_total, 1) << std::endl;
+    }
+
+    if (!out_path.empty()) {
+        write_file(out_path, (const char*) ranked.data(), ranked.size() * sizeof(int));
+        std::cout << "Saved " << ranked.size() << " hot nodes to " << out_path << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,452 @@
+// reorder_FPGA_index: renumber the nodes of an FPGA-format index for memory locality.
+//
+// The FPGA files keep the hnswlib / NSG internal node order, thus the neighbors of a node are
+//   scattered over the whole index, i.e., almost every vector / link fetch opens a new DRAM row.
+//   This tool computes a locality-improving permutation of the node IDs, and writes a new index
+//   with remapped links (ground and upper layers), entry point, vectors, and labels:
+//
+//   --order bfs: breadth-first order from the entry point
+//   --order rcm: reverse Cuthill-McKee (BFS with neighbors sorted by degree, reversed)
+//   --order gorder: Gorder-style greedy ordering, maximizing the number of shared edges / common
+//     in-neighbors within a sliding window of the last --gorder_window placed nodes
+//   --order degree: degree-aware grouping on top of BFS, hub nodes (high in-degree, thus the
+//     most frequently visited ones) are packed together at the lowest IDs
+//
+// Channel balance is kept by construction: the new node i is still stored in channel i % nc.
+// ground_labels.bin maps the new IDs to the original labels; for NSG, where the original label
+//   is the node ID, ground_labels.bin is newly written and has to be applied to the results.
+// reorder_new_to_old.bin stores the permutation (4B old ID per new ID).
+//
+// Report: the per-channel access balance and DRAM row locality, before and after reordering,
+//   computed from query traces, either
+//   (a) --trace_path: per_query_ids_*.int saved by eval_trace_FPGA_inter_query_v1.3
+//       (per query: -1, IDs of the evaluated neighbors, -2), or
+//   (b) --query_path: replayed by a best-first search on the input index (ef = --ef),
+//       optionally saved in the same format by --save_trace.
+//
+// Example Usage:
+//   ./reorder_FPGA_index --dbname SIFT10M --FPGA_index_path ../data/FPGA_hnsw/SIFT10M_MD64
+//       --out_FPGA_index_path ../data/FPGA_hnsw/SIFT10M_MD64_gorder --order gorder
+//       --query_path /mnt/scratch/wenqi/Faiss_experiments/bigann/bigann_query.bvecs
+//   (without --out_FPGA_index_path, only the report is produced)
+//
+// Optional: --num_channels 1,2,4,8,16 (default) --num_threads <hardware concurrency> --dim <from dbname>
+//   --gorder_window 5 --gorder_max_siblings 8 --num_queries 10000 --ef 64 --dram_page_bytes 8192
+
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "FPGA_index_format.hpp"
+#include "dataset.hpp"
+#include "graph_search.hpp"
+#include "pq_codec.hpp"
+
+// BFS from the entry point, then from the next unreached node (in ID order) if any
+std::vector<uint32_t> order_bfs(const FPGAIndex& index) {
+    std::vector<uint32_t> order;
+    order.reserve(index.num_nodes);
+    std::vector<char> visited(index.num_nodes, 0);
+    size_t next_start = 0;
+    size_t start = index.meta.entry_point;
+    while (true) {
+        visited[start] = 1;
+        size_t head = order.size();
+        order.push_back(start);
+        while (head < order.size()) {
+            uint32_t cur = order[head++];
+            const uint32_t* links = index.links(cur);
+            for (uint32_t j = 0; j < index.num_links(cur); j++) {
+                if (!visited[links[j]]) { visited[links[j]] = 1; order.push_back(links[j]); }
+            }
+        }
+        while (next_start < index.num_nodes && visited[next_start]) { next_start++; }
+        if (next_start == index.num_nodes) { break; }
+        start = next_start;
+    }
+    return order;
+}
+
+// Reverse Cuthill-McKee: every BFS starts from the unreached node with the lowest degree,
+//   and the neighbors are enqueued in increasing order of degree
+std::vector<uint32_t> order_rcm(const FPGAIndex& index) {
+    std::vector<uint32_t> by_degree(index.num_nodes);
+    for (size_t i = 0; i < index.num_nodes; i++) { by_degree[i] = i; }
+    std::stable_sort(by_degree.begin(), by_degree.end(),
+        [&](uint32_t a, uint32_t b) { return index.num_links(a) < index.num_links(b); });
+
+    std::vector<uint32_t> order;
+    order.reserve(index.num_nodes);
+    std::vector<char> visited(index.num_nodes, 0);
+    std::vector<uint32_t> nbs;
+    for (uint32_t start : by_degree) {
+        if (visited[start]) { continue; }
+        visited[start] = 1;
+        size_t head = order.size();
+        order.push_back(start);
+        while (head < order.size()) {
+            uint32_t cur = order[head++];
+            const uint32_t* links = index.links(cur);
+            nbs.clear();
+            for (uint32_t j = 0; j < index.num_links(cur); j++) {
+                if (!visited[links[j]]) { visited[links[j]] = 1; nbs.push_back(links[j]); }
+            }
+            std::stable_sort(nbs.begin(), nbs.end(),
+                [&](uint32_t a, uint32_t b) { return index.num_links(a) < index.num_links(b); });
+            order.insert(order.end(), nbs.begin(), nbs.end());
+        }
+    }
+    std::reverse(order.begin(), order.end());
+    return order;
+}
+
+// Max-priority queue over small integer scores with O(1) increment / decrement,
+//   implemented as one doubly linked list per score (the "unit heap" of Gorder)
+class UnitHeap {
+
+public:
+
+    UnitHeap(size_t n) : key(n, 0), prev(n), next(n), removed(n, 0), head(1, -1) {
+        for (size_t i = 0; i < n; i++) { push_front(i); }
+    }
+
+    void inc(int v) {
+        if (removed[v]) { return; }
+        unlink(v);
+        key[v]++;
+        if (key[v] >= (int) head.size()) { head.push_back(-1); }
+        push_front(v);
+        if (key[v] > top) { top = key[v]; }
+    }
+
+    void dec(int v) {
+        if (removed[v]) { return; }
+        unlink(v);
+        key[v]--;
+        push_front(v);
+    }
+
+    void remove(int v) {
+        if (removed[v]) { return; }
+        unlink(v);
+        removed[v] = 1;
+    }
+
+    // returns -1 if empty
+    int pop_max() {
+        while (top > 0 && head[top] == -1) { top--; }
+        int v = head[top];
+        if (v != -1) { remove(v); }
+        return v;
+    }
+
+private:
+
+    std::vector<int> key;
+    std::vector<int> prev;
+    std::vector<int> next;
+    std::vector<char> removed;
+    std::vector<int> head; // per score
+    int top = 0;
+
+    void push_front(int v) {
+        prev[v] = -1;
+        next[v] = head[key[v]];
+        if (next[v] != -1) { prev[next[v]] = v; }
+        head[key[v]] = v;
+    }
+
+    void unlink(int v) {
+        if (prev[v] != -1) { next[prev[v]] = next[v]; } else { head[key[v]] = next[v]; }
+        if (next[v] != -1) { prev[next[v]] = prev[v]; }
+    }
+};
+
+// Gorder (Wei et al., SIGMOD'16): greedily place the node with the highest score against the
+//   last `window` placed nodes, score = #edges in either direction + #common in-neighbors.
+//   Only the first max_siblings in-neighbors of a node are expanded for the common in-neighbor
+//   term, as the in-degree of hub nodes is unbounded.
+std::vector<uint32_t> order_gorder(const FPGAIndex& index, const InEdges& in, int window, int max_siblings) {
+    UnitHeap heap(index.num_nodes);
+    std::vector<uint32_t> order;
+    order.reserve(index.num_nodes);
+    std::deque<uint32_t> placed;
+
+    auto update = [&](uint32_t v, bool enter) {
+        auto change = [&](uint32_t x) { if (enter) { heap.inc(x); } else { heap.dec(x); } };
+        const uint32_t* links = index.links(v);
+        for (uint32_t j = 0; j < index.num_links(v); j++) { change(links[j]); }
+        size_t in_end = in.offsets[v + 1];
+        for (size_t k = in.offsets[v]; k < in_end; k++) { change(in.ids[k]); }
+        size_t sibling_end = std::min(in_end, in.offsets[v] + max_siblings);
+        for (size_t k = in.offsets[v]; k < sibling_end; k++) {
+            uint32_t p = in.ids[k];
+            const uint32_t* p_links = index.links(p);
+            for (uint32_t j = 0; j < index.num_links(p); j++) {
+                if (p_links[j] != v) { change(p_links[j]); }
+            }
+        }
+    };
+
+    uint32_t v = index.meta.entry_point;
+    heap.remove(v);
+    while (true) {
+        order.push_back(v);
+        placed.push_back(v);
+        update(v, true);
+        if ((int) placed.size() > window) {
+            update(placed.front(), false);
+            placed.pop_front();
+        }
+        int next = heap.pop_max();
+        if (next == -1) { break; }
+        v = next;
+    }
+    return order;
+}
+
+// Degree-based grouping on top of BFS: nodes are bucketed by floor(log2(in-degree)), buckets
+//   in decreasing order of in-degree, the BFS order is kept within each bucket
+std::vector<uint32_t> order_degree(const FPGAIndex& index, const InEdges& in) {
+    std::vector<uint32_t> bfs = order_bfs(index);
+    auto bucket = [&](uint32_t v) {
+        size_t d = in.degree(v);
+        int b = 0;
+        while (d > 1) { d >>= 1; b++; }
+        return b;
+    };
+    std::stable_sort(bfs.begin(), bfs.end(), [&](uint32_t a, uint32_t b) { return bucket(a) > bucket(b); });
+    return bfs;
+}
+
+// Per-channel vector fetches of the traces, node i stored in channel i % nc at i / nc
+void report_access_balance(const std::vector<std::vector<int>>& traces, const std::vector<uint32_t>& old_to_new,
+    const std::vector<int>& num_channels, size_t bytes_per_vector, size_t dram_page_bytes) {
+
+    for (int nc : num_channels) {
+        std::vector<size_t> total_per_channel(nc, 0);
+        double sum_query_imbalance = 0;
+        size_t page_hits = 0;
+        size_t accesses = 0;
+        size_t pages_touched = 0;
+        std::vector<size_t> per_channel(nc);
+        std::vector<int64_t> last_page(nc);
+        std::vector<std::vector<int64_t>> pages(nc);
+        for (auto& t : traces) {
+            if (t.empty()) { continue; }
+            std::fill(per_channel.begin(), per_channel.end(), 0);
+            std::fill(last_page.begin(), last_page.end(), -1);
+            for (auto& p : pages) { p.clear(); }
+            for (int old_id : t) {
+                size_t id = old_to_new.empty()? old_id : old_to_new[old_id];
+                int c = id % nc;
+                int64_t page = (id / nc) * bytes_per_vector / dram_page_bytes;
+                per_channel[c]++;
+                if (page == last_page[c]) { page_hits++; }
+                last_page[c] = page;
+                pages[c].push_back(page);
+            }
+            size_t max_c = 0;
+            for (int c = 0; c < nc; c++) {
+                total_per_channel[c] += per_channel[c];
+                max_c = std::max(max_c, per_channel[c]);
+                std::sort(pages[c].begin(), pages[c].end());
+                pages_touched += std::unique(pages[c].begin(), pages[c].end()) - pages[c].begin();
+            }
+            sum_query_imbalance += (double) max_c * nc / t.size();
+            accesses += t.size();
+        }
+        size_t max_total = *std::max_element(total_per_channel.begin(), total_per_channel.end());
+        std::cout << "  nc=" << nc <<
+            " total max/mean=" << (double) max_total * nc / accesses <<
+            " per-query max/mean=" << sum_query_imbalance / traces.size() <<
+            " same-row consecutive accesses=" << 100.0 * page_hits / accesses << "%" <<
+            " rows per query=" << (double) pages_touched / traces.size() << std::endl;
+    }
+}
+
+void write_reordered_index(const FPGAIndex& index, const std::string& in_dir, const std::string& out_dir,
+    const std::vector<uint32_t>& new_to_old, const std::vector<uint32_t>& old_to_new,
+    const std::vector<int>& num_channels, int num_threads) {
+
+    size_t num_nodes = index.num_nodes;
+    int max_degree = index.meta.max_link_num_base;
+
+    FPGAIndexMeta meta = index.meta;
+    meta.entry_point = old_to_new[index.meta.entry_point];
+    meta.save(out_dir);
+    // the neighbor codes move with the links, the codebook is unchanged
+    if (meta.neighbor_codes == NEIGHBOR_CODES_PQ) {
+        ProductQuantizer pq(index.dim);
+        pq.load(in_dir);
+        pq.save(out_dir);
+    }
+
+    write_ground_layer_per_channel(out_dir, num_nodes, num_channels,
+        index.bytes_per_links, index.bytes_per_vector,
+        [&](size_t i, char* out) {
+            thread_local std::vector<uint32_t> links;
+            uint32_t old_id = new_to_old[i];
+            links.resize(index.num_links(old_id));
+            for (size_t j = 0; j < links.size(); j++) { links[j] = old_to_new[index.links(old_id)[j]]; }
+            encode_ground_links(index.stored_link_count(old_id), links.data(), max_degree, out, index.meta.link_layout,
+                index.meta.code_bytes()? index.neighbor_codes(old_id) : nullptr, index.meta.code_bytes());
+        },
+        [&](size_t i, char* out) {
+            memcpy(out, index.vector(new_to_old[i]), index.bytes_per_vector);
+        },
+        num_threads);
+
+    // labels: compose with the existing labels (HNSW), or the original IDs (NSG)
+    std::vector<uint32_t> labels(num_nodes);
+    std::string fname_labels = fpga_index::concat_dir(in_dir, "ground_labels.bin");
+    struct stat stat_buf;
+    if (stat(fname_labels.c_str(), &stat_buf) == 0) {
+        MappedInput in_labels(fname_labels);
+        for (size_t i = 0; i < num_nodes; i++) { labels[i] = ((const uint32_t*) in_labels.data)[new_to_old[i]]; }
+    } else {
+        for (size_t i = 0; i < num_nodes; i++) { labels[i] = new_to_old[i]; }
+    }
+    write_file(fpga_index::concat_dir(out_dir, "ground_labels.bin"), (const char*) labels.data(), num_nodes * sizeof(uint32_t));
+    write_file(fpga_index::concat_dir(out_dir, "reorder_new_to_old.bin"), (const char*) new_to_old.data(), num_nodes * sizeof(uint32_t));
+
+    if (!meta.is_hnsw) { return; }
+
+    // upper layers: move every node's levels to the new position and remap the IDs
+    MappedInput in_upper_links(fpga_index::concat_dir(in_dir, "upper_links.bin"));
+    MappedInput in_pointers(fpga_index::concat_dir(in_dir, "upper_links_pointers.bin"));
+    const uint64_t* in_ptr = (const uint64_t*) in_pointers.data;
+    auto in_bytes = [&](size_t old_id) {
+        return (old_id + 1 < num_nodes? in_ptr[old_id + 1] : in_upper_links.bytes) - in_ptr[old_id];
+    };
+    std::vector<uint64_t> upper_links_pointers(num_nodes);
+    size_t total_upper_bytes = 0;
+    for (size_t i = 0; i < num_nodes; i++) {
+        upper_links_pointers[i] = total_upper_bytes;
+        total_upper_bytes += in_bytes(new_to_old[i]);
+    }
+
+    int M = meta.max_link_num_upper;
+    size_t bytes_per_level = bytes_per_upper_level(M);
+    OutputFile upper_links(fpga_index::concat_dir(out_dir, "upper_links.bin"), total_upper_bytes);
+    size_t nodes_per_chunk = 256 * 1024;
+    size_t num_chunks = (num_nodes + nodes_per_chunk - 1) / nodes_per_chunk;
+    parallel_for(num_chunks, num_threads, [&](size_t chunk) {
+        size_t start = chunk * nodes_per_chunk;
+        size_t end = start + nodes_per_chunk < num_nodes? start + nodes_per_chunk : num_nodes;
+        size_t end_bytes = end < num_nodes? upper_links_pointers[end] : total_upper_bytes;
+        std::vector<char> buf(end_bytes - upper_links_pointers[start]);
+        for (size_t i = start; i < end; i++) {
+            size_t old_id = new_to_old[i];
+            char* out = buf.data() + upper_links_pointers[i] - upper_links_pointers[start];
+            size_t bytes = in_bytes(old_id);
+            memcpy(out, in_upper_links.data + in_ptr[old_id], bytes);
+            for (size_t level = 0; level < bytes / bytes_per_level; level++) {
+                uint32_t* level_links = (uint32_t*) (out + level * bytes_per_level);
+                uint32_t n = std::min(level_links[0], (uint32_t) M);
+                for (uint32_t j = 0; j < n; j++) {
+                    level_links[INT_PER_AXI + j] = old_to_new[level_links[INT_PER_AXI + j]];
+                }
+            }
+        }
+        upper_links.write_at(buf.data(), buf.size(), upper_links_pointers[start]);
+    });
+    write_file(fpga_index::concat_dir(out_dir, "upper_links_pointers.bin"),
+        (const char*) upper_links_pointers.data(), num_nodes * sizeof(uint64_t));
+}
+
+int main(int argc, char** argv) {
+
+    std::cout << "Usage: " << argv[0] << " --dbname <e.g., SIFT10M> --FPGA_index_path <in_dir> "
+        "[--out_FPGA_index_path <out_dir>] [--order bfs/rcm/gorder/degree] "
+        "[--trace_path <per_query_ids_*.int> | --query_path <queries> [--num_queries N] [--ef EF] [--save_trace <fname>]] "
+        "[--num_channels 1,2,4,8,16] [--num_threads N] [--dim D] [--gorder_window W] [--gorder_max_siblings S] "
+        "[--dram_page_bytes B]" << std::endl;
+
+    std::map<std::string, std::string> args;
+    for (int i = 1; i + 1 < argc; i += 2) { args[argv[i]] = argv[i + 1]; }
+
+    std::string dbname = args.count("--dbname")? args["--dbname"] : "SIFT1M";
+    std::string in_dir = args["--FPGA_index_path"];
+    std::string out_dir = args["--out_FPGA_index_path"];
+    std::string order_type = args.count("--order")? args["--order"] : "gorder";
+    std::string trace_path = args["--trace_path"];
+    std::string query_path = args["--query_path"];
+    std::string save_trace_path = args["--save_trace"];
+    std::vector<int> num_channels = parse_num_channels(args.count("--num_channels")? args["--num_channels"] : "1,2,4,8,16");
+    int num_threads = args.count("--num_threads")? std::stoi(args["--num_threads"]) : std::thread::hardware_concurrency();
+    int dim = args.count("--dim")? std::stoi(args["--dim"]) : dim_from_dbname(dbname);
+    int gorder_window = args.count("--gorder_window")? std::stoi(args["--gorder_window"]) : 5;
+    int gorder_max_siblings = args.count("--gorder_max_siblings")? std::stoi(args["--gorder_max_siblings"]) : 8;
+    int num_queries = args.count("--num_queries")? std::stoi(args["--num_queries"]) : 10000;
+    int ef = args.count("--ef")? std::stoi(args["--ef"]) : 64;
+    size_t dram_page_bytes = args.count("--dram_page_bytes")? std::stoul(args["--dram_page_bytes"]) : 8192;
+
+    if (in_dir.empty()) {
+        std::cout << "Missing input path" << std::endl;
+        return -1;
+    }
+
+    FPGAIndex index(in_dir, dim);
+    std::cout << "num_nodes=" << index.num_nodes << " max_degree=" << index.meta.max_link_num_base <<
+        " graph_type=" << (index.meta.is_hnsw? "HNSW" : "NSG") << " order=" << order_type << std::endl;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<uint32_t> new_to_old;
+    if (order_type == "bfs") {
+        new_to_old = order_bfs(index);
+    } else if (order_type == "rcm") {
+        new_to_old = order_rcm(index);
+    } else if (order_type == "gorder") {
+        InEdges in(index);
+        new_to_old = order_gorder(index, in, gorder_window, gorder_max_siblings);
+    } else if (order_type == "degree") {
+        InEdges in(index);
+        new_to_old = order_degree(index, in);
+    } else {
+        std::cout << "Unknown order\n";
+        return -1;
+    }
+    if (new_to_old.size() != index.num_nodes) {
+        std::cout << "Error: the ordering is not a permutation" << std::endl;
+        return -1;
+    }
+    std::vector<uint32_t> old_to_new(index.num_nodes);
+    for (size_t i = 0; i < index.num_nodes; i++) { old_to_new[new_to_old[i]] = i; }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "Ordering duration: " <<
+        std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() / 1000.0 << " sec" << std::endl;
+
+    std::vector<std::vector<int>> traces;
+    if (!trace_path.empty()) {
+        traces = load_traces(trace_path);
+    } else if (!query_path.empty()) {
+        traces = replay_traces(index, query_path, dbname, num_queries, ef, num_threads);
+        if (!save_trace_path.empty()) { save_traces(save_trace_path, traces); }
+    }
+    if (!traces.empty()) {
+        std::cout << "Vector fetches of " << traces.size() << " queries, DRAM row = " << dram_page_bytes << " bytes" << std::endl;
+        std::cout << "Original order:" << std::endl;
+        report_access_balance(traces, std::vector<uint32_t>(), num_channels, index.bytes_per_vector, dram_page_bytes);
+        std::cout << "Reordered (" << order_type << "):" << std::endl;
+        report_access_balance(traces, old_to_new, num_channels, index.bytes_per_vector, dram_page_bytes);
+    }
+
+    if (!out_dir.empty()) {
+        mkdir(out_dir.c_str(), 0755);
+        start = std::chrono::high_resolution_clock::now();
+        write_reordered_index(index, in_dir, out_dir, new_to_old, old_to_new, num_channels, num_threads);
+        end = std::chrono::high_resolution_clock::now();
+        std::cout << "Reordered FPGA index saved, duration: " <<
+            std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() / 1000.0 << " sec" << std::endl;
+    }
+
+    return 0;
+}
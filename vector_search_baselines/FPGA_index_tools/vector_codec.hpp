@@ -0,0 +1,206 @@
+#pragma once
+
+// Reduced-precision storage of the ground layer vectors, matching VECTOR_TYPE in
+//   FPGA_intra_query_v1.5 (constants.hpp, compute_distances_sub_PE_A):
+//
+// fp32: 16 elements per 64B word (the default format)
+// fp16: 32 elements per 64B word, IEEE half, rounded to nearest even; subnormals are flushed
+//   to zero and overflows saturate to the largest finite half
+// int8: 64 elements per 64B word, x[d] ~ scale[d] * code[d] + offset[d], code in [-128, 127];
+//   vector_quantization.bin stores dim x 4B float scales, then dim x 4B float offsets
+//
+// The vector is padded to 64B (and followed by the 64B visited padding in VECTOR_LAYOUT_PADDED). For int8,
+//   the host sends q'[d] = (q[d] - offset[d]) / scale[d] and the weights w[d] = scale[d]^2, such
+//   that the kernel computes sum_d w[d] * (q'[d] - code[d])^2 without touching the offsets.
+//
+// The type is recorded in bits 3 ~ 4 of the meta.bin layout flags (FPGAIndexMeta::vector_type), such that the
+//   hosts refuse an index of another type than their VECTOR_TYPE.
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "FPGA_index_format.hpp"
+
+VectorType parse_vector_type(const std::string& s) {
+    if (s == "fp32") { return VECTOR_FP32; }
+    else if (s == "fp16") { return VECTOR_FP16; }
+    else if (s == "int8") { return VECTOR_INT8; }
+    std::cout << "Unsupported vector type " << s << " (fp32/fp16/int8)" << std::endl;
+    exit(EXIT_FAILURE);
+}
+
+const char* vector_type_name(VectorType t) {
+    return t == VECTOR_FP32? "fp32" : t == VECTOR_FP16? "fp16" : "int8";
+}
+
+size_t bytes_per_element(VectorType t) {
+    return t == VECTOR_FP32? 4 : t == VECTOR_FP16? 2 : 1;
+}
+
+// vector only, padded to 64B (the number of 512-bit words the kernel fetches is this / 64)
+size_t bytes_per_typed_vector(int dim, VectorType t) {
+    return round_up_to_AXI(dim * bytes_per_element(t));
+}
+
+// vector padded to 64B (+ 64B visited flag)
+size_t bytes_per_ground_vector(int dim, VectorType t, VectorLayout layout) {
+    return bytes_per_typed_vector(dim, t) + (layout == VECTOR_LAYOUT_PADDED? BYTES_PER_AXI : 0);
+}
+
+uint16_t float_to_half_bits(float f) {
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    uint16_t sign = (x >> 16) & 0x8000;
+    uint32_t exponent_fp32 = (x >> 23) & 0xff;
+    uint32_t mantissa = x & 0x7fffff;
+    if (exponent_fp32 == 0xff) { return sign | 0x7c00 | (mantissa? 0x200 : 0); } // inf / nan
+    int exponent = (int) exponent_fp32 - 127 + 15;
+    if (exponent <= 0) { return sign; } // flush to zero, as the kernel does
+    uint32_t half_mantissa = mantissa >> 13;
+    uint32_t rest = mantissa & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (half_mantissa & 1))) {
+        half_mantissa++;
+        if (half_mantissa == 0x400) { half_mantissa = 0; exponent++; }
+    }
+    if (exponent >= 31) { return sign | 0x7bff; }
+    return sign | (exponent << 10) | half_mantissa;
+}
+
+// same as half_bits_to_float in the kernel
+float half_bits_to_float(uint16_t h) {
+    uint32_t sign = (uint32_t) (h >> 15) << 31;
+    uint32_t exponent = (h >> 10) & 0x1f;
+    uint32_t mantissa = h & 0x3ff;
+    uint32_t x;
+    if (exponent == 0) { x = sign; }
+    else if (exponent == 31) { x = sign | (0xffu << 23) | (mantissa << 13); }
+    else { x = sign | ((exponent + 112) << 23) | (mantissa << 13); }
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+class Int8Quantizer {
+
+public:
+
+    int dim;
+    std::vector<float> scale;
+    std::vector<float> offset;
+
+    Int8Quantizer(int dim) : dim(dim), scale(dim, 1), offset(dim, 0) {}
+
+    // per-dimension min / max over get(i, out), i < num_vectors; dimensions holding integers
+    //   within a range of 256 values (e.g., SIFT uint8, SPACEV int8) are encoded losslessly
+    void train(size_t num_vectors, const std::function<void(size_t, float*)>& get, int num_threads) {
+        std::vector<float> min_val(dim, INFINITY), max_val(dim, -INFINITY);
+        std::vector<char> integral(dim, 1);
+        std::mutex mtx;
+        size_t vectors_per_chunk = 64 * 1024;
+        size_t num_chunks = (num_vectors + vectors_per_chunk - 1) / vectors_per_chunk;
+        parallel_for(num_chunks, num_threads, [&](size_t chunk) {
+            std::vector<float> vec(dim), local_min(dim, INFINITY), local_max(dim, -INFINITY);
+            std::vector<char> local_integral(dim, 1);
+            size_t end = (chunk + 1) * vectors_per_chunk < num_vectors? (chunk + 1) * vectors_per_chunk : num_vectors;
+            for (size_t i = chunk * vectors_per_chunk; i < end; i++) {
+                get(i, vec.data());
+                for (int d = 0; d < dim; d++) {
+                    local_min[d] = vec[d] < local_min[d]? vec[d] : local_min[d];
+                    local_max[d] = vec[d] > local_max[d]? vec[d] : local_max[d];
+                    if (vec[d] != floorf(vec[d])) { local_integral[d] = 0; }
+                }
+            }
+            std::lock_guard<std::mutex> lock(mtx);
+            for (int d = 0; d < dim; d++) {
+                min_val[d] = local_min[d] < min_val[d]? local_min[d] : min_val[d];
+                max_val[d] = local_max[d] > max_val[d]? local_max[d] : max_val[d];
+                integral[d] &= local_integral[d];
+            }
+        });
+        for (int d = 0; d < dim; d++) {
+            float range = max_val[d] - min_val[d];
+            if (integral[d] && range <= 255) { scale[d] = 1; }
+            else { scale[d] = range > 0? range / 255 : 1; }
+            offset[d] = min_val[d] + 128 * scale[d];
+        }
+    }
+
+    void load(const std::string& index_dir) {
+        MappedInput file(fpga_index::concat_dir(index_dir, "vector_quantization.bin"));
+        if (file.bytes != 2 * dim * sizeof(float)) {
+            std::cout << "vector_quantization.bin does not match dim " << dim << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        memcpy(scale.data(), file.data, dim * sizeof(float));
+        memcpy(offset.data(), file.data + dim * sizeof(float), dim * sizeof(float));
+    }
+
+    void save(const std::string& index_dir) const {
+        std::vector<float> buf(scale);
+        buf.insert(buf.end(), offset.begin(), offset.end());
+        write_file(fpga_index::concat_dir(index_dir, "vector_quantization.bin"), (const char*) buf.data(), buf.size() * sizeof(float));
+    }
+
+    int8_t encode(int d, float x) const {
+        float code = roundf((x - offset[d]) / scale[d]);
+        code = code < -128? -128 : code > 127? 127 : code;
+        return (int8_t) code;
+    }
+
+    // q' and the weights of the query as sent by the host
+    void transform_query(const float* query, float* query_transformed, float* weights) const {
+        for (int d = 0; d < dim; d++) {
+            query_transformed[d] = (query[d] - offset[d]) / scale[d];
+            weights[d] = scale[d] * scale[d];
+        }
+    }
+};
+
+// vector only (bytes_per_typed_vector); quantizer is used for int8 only
+void encode_typed_vector(const float* vec, int dim, VectorType t, const Int8Quantizer* quantizer, char* out) {
+    memset(out, 0, bytes_per_typed_vector(dim, t));
+    if (t == VECTOR_FP32) {
+        memcpy(out, vec, dim * sizeof(float));
+    } else if (t == VECTOR_FP16) {
+        uint16_t* h = (uint16_t*) out;
+        for (int d = 0; d < dim; d++) { h[d] = float_to_half_bits(vec[d]); }
+    } else {
+        int8_t* c = (int8_t*) out;
+        for (int d = 0; d < dim; d++) { c[d] = quantizer->encode(d, vec[d]); }
+    }
+}
+
+// vector (+ visited padding), bytes_per_ground_vector(dim, t, layout)
+void encode_ground_vector(const float* vec, int dim, VectorType t, VectorLayout layout,
+    const Int8Quantizer* quantizer, char* out) {
+    size_t bytes_vec = bytes_per_typed_vector(dim, t);
+    encode_typed_vector(vec, dim, t, quantizer, out);
+    if (layout == VECTOR_LAYOUT_PADDED) {
+        memset(out + bytes_vec, 0, BYTES_PER_AXI);
+        // -1 used for visited flag
+        memset(out + bytes_vec, 0xff, sizeof(int));
+    }
+}
+
+// CPU reference of compute_distances_sub_PE_A<VECTOR_TYPE>: query is q' (int8) or q (fp32 / fp16),
+//   weights is only read for int8
+template<VectorType t>
+float typed_l2_sqr(const float* query, const float* weights, const char* db_vec, int dim) {
+    float dist = 0;
+    for (int d = 0; d < dim; d++) {
+        float x;
+        if (t == VECTOR_FP32) { x = ((const float*) db_vec)[d]; }
+        else if (t == VECTOR_FP16) { x = half_bits_to_float(((const uint16_t*) db_vec)[d]); }
+        else { x = (float) ((const int8_t*) db_vec)[d]; }
+        float diff = query[d] - x;
+        dist += t == VECTOR_INT8? weights[d] * diff * diff : diff * diff;
+    }
+    return dist;
+}